@@ -8,8 +8,13 @@ SECTION .multiboot
 
 SECTION .text
 global start
+extern multiboot_magic
+extern multiboot_info_addr
 start:
     cli
     mov esp, 0x9FB00
+    ; Keep the loader's magic and info pointer for the memory manager
+    mov [multiboot_magic], eax
+    mov [multiboot_info_addr], ebx
     call kmain32
     hlt
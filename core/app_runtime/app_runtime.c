@@ -1,63 +1,90 @@
 #include "app_runtime.h"
+#include "../../kernel64/include/zswap.h"
+#include "../../kernel64/include/page_alloc.h"
 #include <stdio.h>
 #include <string.h>
 
 void app_runtime_init(app_runtime_t* rt) {
     memset(rt, 0, sizeof(*rt));
-    rt->next_app_id = 1;
+    slot_map_init(&rt->map, rt->apps, sizeof(app_container_t), rt->dense_slot, rt->slots, MAX_APPS);
     printf("[AppRuntime] Initialized.\n");
 }
 
+static app_container_t* find_app(app_runtime_t* rt, int app_id) {
+    return (app_container_t*)slot_map_get(&rt->map, app_id);
+}
+
+// The descriptors live in the arena: the zswap LRU links them by address,
+// and the container itself moves when another app is destroyed
+static void alloc_pages(app_container_t* app, uint32_t n) {
+    if (app->rgroup != RG_ROOT && rgroup_try_charge_mem(app->rgroup, (uint64_t)n * PAGE_SIZE) != 0) return;
+    app->pages = (anon_page_t*)arena_zalloc(app->arena, n * sizeof(anon_page_t));
+    uint32_t i = 0;
+    while (app->pages && i < n && anon_page_alloc(&app->pages[i]) == 0) ++i;
+    app->nr_pages = i;
+    if (app->rgroup != RG_ROOT && i < n) rgroup_uncharge_mem(app->rgroup, (uint64_t)(n - i) * PAGE_SIZE);
+    if (i < n) printf("[AppRuntime] App %d: only %u of %u pages\n", app->id, i, n);
+}
+
+static void free_pages(app_container_t* app) {
+    for (uint32_t i = 0; i < app->nr_pages; ++i) anon_page_free(&app->pages[i]);
+    if (app->rgroup != RG_ROOT) rgroup_uncharge_mem(app->rgroup, (uint64_t)app->nr_pages * PAGE_SIZE);
+    app->pages = NULL;
+    app->nr_pages = 0;
+}
+
 int app_runtime_register(app_runtime_t* rt, const char* name, app_type_t type) {
-    if (rt->app_count >= MAX_APPS) return -1;
-    app_container_t* app = &rt->apps[rt->app_count++];
-    app->id = rt->next_app_id++;
+    app_container_t* app;
+    int id = slot_map_insert(&rt->map, (void**)&app);
+    if (id < 0) return -1;
+    app->id = id;
     app->type = type;
     strncpy(app->name, name, sizeof(app->name)-1);
     app->name[sizeof(app->name)-1] = '\0';
     app->running = false;
     app->instance = NULL;
+    app->process_id = -1;
+    app->window_id = -1;
+    app->rgroup = rgroup_create(app->name, RG_ROOT);
+    if (app->rgroup < 0) app->rgroup = RG_ROOT;
+    app->arena = arena_create(0);
+    if (app->rgroup != RG_ROOT) arena_set_rgroup(app->arena, app->rgroup); // Counts against its memory limit
+    app->pages = NULL;
+    app->nr_pages = 0;
+    alloc_pages(app, APP_PAGES);
     printf("[AppRuntime] Registered app %d: '%s' (type %d)\n", app->id, app->name, app->type);
     return app->id;
 }
 
 int app_runtime_start(app_runtime_t* rt, int app_id) {
-    for (int i = 0; i < rt->app_count; ++i) {
-        if (rt->apps[i].id == app_id && !rt->apps[i].running) {
-            rt->apps[i].running = true;
-            printf("[AppRuntime] Started app %d: '%s'\n", app_id, rt->apps[i].name);
-            return 0;
-        }
-    }
-    return -1;
+    app_container_t* app = find_app(rt, app_id);
+    if (!app || app->running) return -1;
+    app->running = true;
+    printf("[AppRuntime] Started app %d: '%s'\n", app_id, app->name);
+    return 0;
 }
 
 int app_runtime_stop(app_runtime_t* rt, int app_id) {
-    for (int i = 0; i < rt->app_count; ++i) {
-        if (rt->apps[i].id == app_id && rt->apps[i].running) {
-            rt->apps[i].running = false;
-            printf("[AppRuntime] Stopped app %d: '%s'\n", app_id, rt->apps[i].name);
-            return 0;
-        }
-    }
-    return -1;
+    app_container_t* app = find_app(rt, app_id);
+    if (!app || !app->running) return -1;
+    app->running = false;
+    printf("[AppRuntime] Stopped app %d: '%s'\n", app_id, app->name);
+    return 0;
 }
 
 int app_runtime_destroy(app_runtime_t* rt, int app_id) {
-    for (int i = 0; i < rt->app_count; ++i) {
-        if (rt->apps[i].id == app_id) {
-            printf("[AppRuntime] Destroyed app %d: '%s'\n", app_id, rt->apps[i].name);
-            // Shift remaining apps down
-            for (int j = i; j < rt->app_count - 1; ++j) rt->apps[j] = rt->apps[j+1];
-            rt->app_count--;
-            return 0;
-        }
-    }
-    return -1;
+    app_container_t* app = find_app(rt, app_id);
+    if (!app) return -1;
+    printf("[AppRuntime] Destroyed app %d: '%s'\n", app_id, app->name);
+    free_pages(app);
+    arena_release(app->arena); // Uncharges the group, which can then go
+    if (app->rgroup != RG_ROOT) rgroup_destroy(app->rgroup);
+    slot_map_remove(&rt->map, app_id); // Last app moves into the hole
+    return 0;
 }
 
 void app_runtime_tick(app_runtime_t* rt) {
-    for (int i = 0; i < rt->app_count; ++i) {
+    for (uint32_t i = 0; i < rt->map.count; ++i) {
         if (rt->apps[i].running) {
             printf("[AppRuntime] App %d ('%s') running.\n", rt->apps[i].id, rt->apps[i].name);
             // TODO: Call into WASM/JVM/Electron/etc. instance
@@ -66,29 +93,44 @@ void app_runtime_tick(app_runtime_t* rt) {
 }
 
 void app_runtime_list(app_runtime_t* rt) {
-    printf("[AppRuntime] App list (%d total):\n", rt->app_count);
-    for (int i = 0; i < rt->app_count; ++i) {
+    printf("[AppRuntime] App list (%u total):\n", rt->map.count);
+    for (uint32_t i = 0; i < rt->map.count; ++i) {
         printf("  App %d: '%s' (type %d) %s\n", rt->apps[i].id, rt->apps[i].name, rt->apps[i].type, rt->apps[i].running ? "[RUNNING]" : "");
     }
 }
 
 void app_runtime_set_process_id(app_runtime_t* rt, int app_id, int process_id) {
-    for (int i = 0; i < rt->app_count; ++i) {
-        if (rt->apps[i].id == app_id) {
-            rt->apps[i].process_id = process_id;
-            printf("[AppRuntime] Set process %d for app %d ('%s')\n", process_id, app_id, rt->apps[i].name);
-            return;
-        }
-    }
+    app_container_t* app = find_app(rt, app_id);
+    if (!app) return;
+    app->process_id = process_id;
+    printf("[AppRuntime] Set process %d for app %d ('%s')\n", process_id, app_id, app->name);
 }
 
 void app_runtime_set_window_id(app_runtime_t* rt, int app_id, int window_id) {
-    for (int i = 0; i < rt->app_count; ++i) {
-        if (rt->apps[i].id == app_id) {
-            rt->apps[i].window_id = window_id;
-            printf("[AppRuntime] Set window %d for app %d ('%s')\n", window_id, app_id, rt->apps[i].name);
-            return;
-        }
-    }
+    app_container_t* app = find_app(rt, app_id);
+    if (!app) return;
+    app->window_id = window_id;
+    printf("[AppRuntime] Set window %d for app %d ('%s')\n", window_id, app_id, app->name);
+}
+
+int app_runtime_get_rgroup(app_runtime_t* rt, int app_id) {
+    app_container_t* app = find_app(rt, app_id);
+    return app ? app->rgroup : RG_ROOT;
+}
+
+arena_t* app_runtime_get_arena(app_runtime_t* rt, int app_id) {
+    app_container_t* app = find_app(rt, app_id);
+    return app ? app->arena : NULL;
+}
+
+void* app_runtime_map_page(app_runtime_t* rt, int app_id, uint32_t page) {
+    app_container_t* app = find_app(rt, app_id);
+    if (!app || page >= app->nr_pages) return NULL;
+    return anon_page_map(&app->pages[page]);
+}
+
+void app_runtime_unmap_page(app_runtime_t* rt, int app_id, uint32_t page) {
+    app_container_t* app = find_app(rt, app_id);
+    if (!app || page >= app->nr_pages) return;
+    anon_page_unmap(&app->pages[page]);
 }
- 
\ No newline at end of file
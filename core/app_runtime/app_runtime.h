@@ -1,7 +1,13 @@
 #ifndef APP_RUNTIME_H
 #define APP_RUNTIME_H
 #include <stdbool.h>
+#include "../../kernel64/include/slot_map.h"
+#include "../resource_manager/resource_group.h"
+#include "../../kernel64/include/arena.h"
 #define MAX_APPS 32
+#define APP_PAGES 16 // Anonymous pages of instance memory per app
+
+struct anon_page;
 
 typedef enum {
     APP_TYPE_NATIVE,
@@ -11,19 +17,24 @@ typedef enum {
 } app_type_t;
 
 typedef struct app_container {
-    int id;
+    int id; // Slot map handle
     app_type_t type;
     char name[64];
     bool running;
     void* instance; // Pointer to VM/JVM/etc.
     int process_id; // Associated process
     int window_id; // Associated window
+    int rgroup; // Resource group for the app and its processes
+    arena_t* arena; // Per-app allocations, all released when the app is destroyed
+    struct anon_page* pages; // Instance memory; cold unmapped pages go to zswap
+    uint32_t nr_pages;
 } app_container_t;
 
 typedef struct app_runtime {
-    app_container_t apps[MAX_APPS];
-    int app_count;
-    int next_app_id;
+    app_container_t apps[MAX_APPS]; // Dense: [0, map.count) are live
+    uint32_t dense_slot[MAX_APPS];
+    slot_entry_t slots[MAX_APPS];
+    slot_map_t map;
 } app_runtime_t;
 
 void app_runtime_init(app_runtime_t* rt);
@@ -35,5 +46,9 @@ void app_runtime_tick(app_runtime_t* rt);
 void app_runtime_list(app_runtime_t* rt);
 void app_runtime_set_process_id(app_runtime_t* rt, int app_id, int process_id);
 void app_runtime_set_window_id(app_runtime_t* rt, int app_id, int window_id);
+int app_runtime_get_rgroup(app_runtime_t* rt, int app_id);
+arena_t* app_runtime_get_arena(app_runtime_t* rt, int app_id);
+void* app_runtime_map_page(app_runtime_t* rt, int app_id, uint32_t page); // Swaps in if needed
+void app_runtime_unmap_page(app_runtime_t* rt, int app_id, uint32_t page);
 
 #endif // APP_RUNTIME_H 
\ No newline at end of file
@@ -6,7 +6,8 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include "jit/jit_backend.h"
-#include <time.h>
+#include "../kernel64/include/ktime.h"
+#include "resource_manager/resource_group.h"
 
 #define VM_MAX_REGS 16
 #define VM_MAX_STACK 256
@@ -26,6 +27,7 @@ typedef enum {
     VM_STORE,
     VM_SYSCALL,
     VM_HALT,
+    VM_RDTIME, // reg = monotonic ms, read from the shared clock page (no syscall)
     // ... extend as needed ...
 } vm_opcode_t;
 
@@ -106,6 +108,8 @@ void vm_recover(vm_t* vm) {
 // VM interpreter loop
 int vm_run(vm_t* vm) {
     if (!vm || !vm->code) return -1;
+    if (rgroup_throttled(vm->rgroup, RG_CPU)) return -2;
+    uint64_t start_us = ktime_us();
     static vm_snapshot_t last_snap;
     vm_snapshot(vm, &last_snap);
     vm->halted = false;
@@ -196,7 +200,7 @@ int vm_run(vm_t* vm) {
                         vm->halted = true;
                         break;
                     case 2: { // get time
-                        uint32_t t = (uint32_t)time(NULL);
+                        uint32_t t = (uint32_t)ktime_real_seconds();
                         if (arg0 < VM_MAX_REGS) vm->regs[arg0] = t;
                         break;
                     }
@@ -209,6 +213,11 @@ int vm_run(vm_t* vm) {
             case VM_HALT:
                 vm->halted = true;
                 break;
+            case VM_RDTIME: {
+                uint8_t reg = vm->code[vm->pc++];
+                if (reg < VM_MAX_REGS) vm->regs[reg] = (uint32_t)ktime_ms();
+                break;
+            }
             // ... implement more instructions ...
             default:
                 // Security: Invalid opcode, halt and recover
@@ -218,6 +227,7 @@ int vm_run(vm_t* vm) {
                 break;
         }
     }
+    rgroup_charge(vm->rgroup, RG_CPU, ktime_us() - start_us);
     return 0;
 }
 
@@ -37,9 +37,10 @@ typedef struct {
     uint8_t* code;
     size_t code_size;
     bool halted;
+    int rgroup; // Resource group charged for run time (0: root)
 } vm_t;
 
-int vm_run(vm_t* vm);
+int vm_run(vm_t* vm); // -2 while the VM's resource group is over its CPU quota
 int vm_jit_compile(vm_t* vm, vm_arch_t arch);
 void vm_recover(vm_t* vm);
 
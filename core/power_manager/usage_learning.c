@@ -1,12 +1,12 @@
 #include "usage_learning.h"
 #include <stdio.h>
-#include <time.h>
+#include "../../kernel64/include/ktime.h"
 
 static const char* USAGE_LOG_FILE = "usage_learning.log";
 
 void usage_learning_init(void) {
     FILE* f = fopen(USAGE_LOG_FILE, "a");
-    if (f) { fprintf(f, "[Init] Usage learning started at %ld\n", time(NULL)); fclose(f); }
+    if (f) { fprintf(f, "[Init] Usage learning started at %ld\n", (long)ktime_real_seconds()); fclose(f); }
     printf("[UsageLearning] Initialized.\n");
 }
 
@@ -1,10 +1,12 @@
 #include "process_manager.h"
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 
 void process_manager_init(process_table_t* pt) {
     memset(pt, 0, sizeof(*pt));
-    pt->next_process_id = 1;
+    slot_map_init(&pt->map, pt->processes, sizeof(process_t), pt->dense_slot, pt->slots, MAX_PROCESSES);
+    prio_rq_init(&pt->rq);
     printf("[ProcessManager] Initialized.\n");
 }
 
@@ -19,47 +21,157 @@ void sandbox_process(process_t* proc) {
     printf("[Sandbox] Process %d ('%s') sandboxed.\n", proc->id, proc->name);
 }
 
+static process_t* proc_of(prio_entity_t* e) {
+    return (process_t*)((char*)e - offsetof(process_t, rq));
+}
+
+// A process whose group ran out of CPU quota leaves the run queue until
+// rgroup_tick() releases the group, so picking never skips over it again
+static void throttle_park(process_table_t* pt, process_t* proc) {
+    prio_rq_dequeue(&pt->rq, &proc->rq);
+    proc->rq.prev = NULL;
+    proc->rq.next = pt->throttled;
+    if (pt->throttled) pt->throttled->prev = &proc->rq;
+    pt->throttled = &proc->rq;
+    proc->throttled = true;
+}
+
+static void throttle_unpark(process_table_t* pt, process_t* proc) {
+    if (proc->rq.prev) proc->rq.prev->next = proc->rq.next;
+    else pt->throttled = proc->rq.next;
+    if (proc->rq.next) proc->rq.next->prev = proc->rq.prev;
+    proc->rq.next = proc->rq.prev = NULL;
+    proc->throttled = false;
+    if (proc->state == PROC_RUNNING) prio_rq_enqueue(&pt->rq, &proc->rq);
+}
+
 int process_create(process_table_t* pt, const char* name, int app_id) {
-    if (pt->process_count >= MAX_PROCESSES) return -1;
     if (!mac_enforce_policy(name, "system", 1)) return -1;
-    process_t* proc = &pt->processes[pt->process_count++];
-    proc->id = pt->next_process_id++;
+    process_t* proc;
+    int id = slot_map_insert(&pt->map, (void**)&proc);
+    if (id < 0) return -1;
+    proc->id = id;
     strncpy(proc->name, name, sizeof(proc->name)-1);
     proc->name[sizeof(proc->name)-1] = '\0';
     proc->state = PROC_RUNNING;
     proc->app_id = app_id;
     proc->window_id = -1;
+    proc->rgroup = RG_ROOT;
+    prio_entity_init(&proc->rq, PRIO_DEFAULT);
+    prio_rq_enqueue(&pt->rq, &proc->rq);
     sandbox_process(proc);
     printf("[ProcessManager] Created process %d for app %d ('%s')\n", proc->id, app_id, proc->name);
     return proc->id;
 }
 
 int process_destroy(process_table_t* pt, int process_id) {
-    for (int i = 0; i < pt->process_count; ++i) {
-        if (pt->processes[i].id == process_id) {
-            printf("[ProcessManager] Destroyed process %d ('%s')\n", process_id, pt->processes[i].name);
-            for (int j = i; j < pt->process_count - 1; ++j) pt->processes[j] = pt->processes[j+1];
-            pt->process_count--;
-            return 0;
+    process_t* proc = process_find(pt, process_id);
+    if (!proc) return -1;
+    printf("[ProcessManager] Destroyed process %d ('%s')\n", process_id, proc->name);
+    if (proc->throttled) {
+        proc->state = PROC_STOPPED;
+        throttle_unpark(pt, proc);
+    }
+    prio_rq_dequeue(&pt->rq, &proc->rq);
+    if (pt->current == proc) pt->current = NULL;
+    // The last entry fills the hole; fix its queue links and the current pointer
+    process_t* last = &pt->processes[pt->map.count - 1];
+    int i = slot_map_remove(&pt->map, process_id);
+    if ((uint32_t)i < pt->map.count) {
+        process_t* moved = &pt->processes[i];
+        if (moved->throttled) {
+            if (moved->rq.prev) moved->rq.prev->next = &moved->rq;
+            else pt->throttled = &moved->rq;
+            if (moved->rq.next) moved->rq.next->prev = &moved->rq;
+        } else {
+            prio_rq_relocate(&pt->rq, &moved->rq);
         }
+        if (pt->current == last) pt->current = moved;
+    }
+    return 0;
+}
+
+process_t* process_find(process_table_t* pt, int process_id) {
+    return (process_t*)slot_map_get(&pt->map, process_id);
+}
+
+int process_set_priority(process_table_t* pt, int process_id, int priority) {
+    process_t* proc = process_find(pt, process_id);
+    if (!proc) return -1;
+    if (proc->throttled) {
+        // Parked on pt->throttled through the rq links: keep them, only
+        // the level and slice change; unpark enqueues at the new level
+        prio_entity_t* next = proc->rq.next;
+        prio_entity_t* prev = proc->rq.prev;
+        prio_entity_init(&proc->rq, priority);
+        proc->rq.next = next;
+        proc->rq.prev = prev;
+    } else {
+        prio_rq_set_priority(&pt->rq, &proc->rq, priority);
     }
-    return -1;
+    return 0;
+}
+
+int process_set_state(process_table_t* pt, int process_id, process_state_t state) {
+    process_t* proc = process_find(pt, process_id);
+    if (!proc) return -1;
+    proc->state = state;
+    if (proc->throttled) {
+        // Stays parked; throttle_unpark() checks the state when the group is released
+    } else if (state == PROC_RUNNING) prio_rq_enqueue(&pt->rq, &proc->rq);
+    else prio_rq_dequeue(&pt->rq, &proc->rq);
+    if (state != PROC_RUNNING && pt->current == proc) pt->current = NULL;
+    return 0;
+}
+
+int process_set_rgroup(process_table_t* pt, int process_id, int rgroup) {
+    process_t* proc = process_find(pt, process_id);
+    if (!proc) return -1;
+    proc->rgroup = rgroup;
+    return 0;
 }
 
+// O(1) priority scheduler: charge the current slice, then take the head of
+// the highest non-empty level from the ready bitmap. Processes of throttled
+// groups are parked as they come up and only re-checked after a release.
 void process_schedule(process_table_t* pt) {
-    // Simple round-robin scheduler
-    for (int i = 0; i < pt->process_count; ++i) {
-        if (pt->processes[i].state == PROC_RUNNING) {
-            if (!mac_enforce_policy(pt->processes[i].name, "system", 2)) continue;
-            printf("[ProcessManager] Scheduled process %d ('%s')\n", pt->processes[i].id, pt->processes[i].name);
-            // Simulate running the process
+    if (pt->current) {
+        prio_rq_charge(&pt->rq, &pt->current->rq, PROCESS_TICK_MS);
+        rgroup_charge(pt->current->rgroup, RG_CPU, PROCESS_TICK_MS * 1000);
+    }
+    uint32_t seq = rgroup_unthrottle_seq();
+    if (pt->throttled && seq != pt->throttle_seq) {
+        pt->throttle_seq = seq;
+        for (prio_entity_t* e = pt->throttled; e; ) {
+            prio_entity_t* next = e->next;
+            if (!rgroup_throttled(proc_of(e)->rgroup, RG_CPU)) throttle_unpark(pt, proc_of(e));
+            e = next;
         }
     }
+    prio_entity_t* next;
+    while ((next = prio_rq_peek(&pt->rq)) && rgroup_throttled(proc_of(next)->rgroup, RG_CPU)) {
+        throttle_park(pt, proc_of(next));
+    }
+    // Over its weighted share while the CPU is contended: a peer goes first
+    if (next && next->next && rgroup_over_share(proc_of(next)->rgroup)) {
+        prio_rq_charge(&pt->rq, next, next->timeslice_ms);
+        next = prio_rq_peek(&pt->rq);
+    }
+    pt->current = next ? proc_of(next) : NULL;
+    if (!pt->current) return;
+    if (!mac_enforce_policy(pt->current->name, "system", 2)) {
+        // Denied: push it behind its peers for this round
+        prio_rq_charge(&pt->rq, &pt->current->rq, pt->current->rq.timeslice_ms);
+        pt->current = NULL;
+        return;
+    }
+    printf("[ProcessManager] Scheduled process %d ('%s')\n", pt->current->id, pt->current->name);
+    // Simulate running the process
 }
 
 void process_list(process_table_t* pt) {
-    printf("[ProcessManager] Process list (%d total):\n", pt->process_count);
-    for (int i = 0; i < pt->process_count; ++i) {
-        printf("  Process %d: '%s' (app %d) state %d\n", pt->processes[i].id, pt->processes[i].name, pt->processes[i].app_id, pt->processes[i].state);
+    printf("[ProcessManager] Process list (%u total):\n", pt->map.count);
+    for (uint32_t i = 0; i < pt->map.count; ++i) {
+        printf("  Process %d: '%s' (app %d) state %d prio %d%s\n", pt->processes[i].id, pt->processes[i].name, pt->processes[i].app_id, pt->processes[i].state, pt->processes[i].rq.priority, pt->processes[i].throttled ? " [THROTTLED]" : "");
     }
 } 
\ No newline at end of file
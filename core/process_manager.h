@@ -1,7 +1,11 @@
 #ifndef PROCESS_MANAGER_H
 #define PROCESS_MANAGER_H
 #include <stdbool.h>
-#define MAX_PROCESSES 64
+#include "../kernel64/include/prio_sched.h"
+#include "../kernel64/include/slot_map.h"
+#include "resource_manager/resource_group.h"
+#define MAX_PROCESSES 4096
+#define PROCESS_TICK_MS 10 // Run time charged per process_schedule() call
 
 typedef enum {
     PROC_RUNNING,
@@ -10,26 +14,38 @@ typedef enum {
 } process_state_t;
 
 typedef struct process {
-    int id;
+    int id; // Slot map handle
     char name[64];
     process_state_t state;
     int app_id; // Associated app
     int window_id; // Associated window
     bool sandboxed;
+    int rgroup; // Resource group charged for its CPU time
+    bool throttled; // Parked on the table's throttled list, off the run queue
+    prio_entity_t rq; // Run queue link (priority 0 highest .. 31 lowest)
     // Add more fields as needed (registers, stack, etc.)
 } process_t;
 
 typedef struct process_table {
-    process_t processes[MAX_PROCESSES];
-    int process_count;
-    int next_process_id;
+    process_t processes[MAX_PROCESSES]; // Dense: [0, map.count) are live
+    uint32_t dense_slot[MAX_PROCESSES];
+    slot_entry_t slots[MAX_PROCESSES];
+    slot_map_t map;
+    prio_rq_t rq; // Runnable processes, bitmap-indexed by priority
+    process_t* current;
+    prio_entity_t* throttled; // Runnable but their group is over its CPU quota
+    uint32_t throttle_seq; // rgroup_unthrottle_seq() when the list was last checked
 } process_table_t;
 
 void process_manager_init(process_table_t* pt);
 int process_create(process_table_t* pt, const char* name, int app_id);
 int process_destroy(process_table_t* pt, int process_id);
 void process_schedule(process_table_t* pt);
+int process_set_priority(process_table_t* pt, int process_id, int priority);
+int process_set_state(process_table_t* pt, int process_id, process_state_t state);
+int process_set_rgroup(process_table_t* pt, int process_id, int rgroup);
 void process_list(process_table_t* pt);
+process_t* process_find(process_table_t* pt, int process_id);
 bool mac_enforce_policy(const char* subject, const char* object, int action);
 void sandbox_process(process_t* proc);
 
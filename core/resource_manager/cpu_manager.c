@@ -1,7 +1,9 @@
 #include "cpu_manager.h"
-#include <windows.h>
 #include <stdio.h>
 
+#ifdef _WIN32
+#include <windows.h>
+
 static ULONGLONG last_idle = 0, last_kernel = 0, last_user = 0;
 static float last_cpu_usage = 0.0f;
 
@@ -22,6 +24,44 @@ float cpu_manager_get_usage(void) {
     return usage;
 }
 
+float cpu_manager_get_pressure(void) { return 0.0f; }
+#else
+#include "procfs.h"
+
+static procfs_file_t stat_file = PROCFS_FILE("/proc/stat");
+static procfs_file_t psi_file = PROCFS_FILE("/proc/pressure/cpu");
+static uint64_t last_busy = 0, last_total = 0;
+static float last_cpu_usage = 0.0f;
+
+// Aggregate "cpu  user nice system idle iowait irq softirq steal ..." line
+float cpu_manager_get_usage(void) {
+    char buf[1024]; // Only the first line is needed; a short read is fine
+    if (procfs_read(&stat_file, buf, sizeof(buf)) < 0) return last_cpu_usage;
+    const char* p = buf;
+    if (!procfs_match(&p, "cpu ")) return last_cpu_usage;
+    uint64_t v[8] = {0}, total = 0;
+    for (int i = 0; i < 8 && procfs_parse_u64(&p, &v[i]) == 0; ++i) total += v[i];
+    uint64_t busy = total - v[3] - v[4]; // idle and iowait are not busy
+    if (total > last_total && last_total) {
+        uint64_t dt = total - last_total;
+        uint64_t db = busy >= last_busy ? busy - last_busy : 0;
+        last_cpu_usage = (float)db / (float)dt;
+    }
+    last_busy = busy;
+    last_total = total;
+    return last_cpu_usage;
+}
+
+// PSI: share of the last 10 s in which some runnable task waited for a CPU
+float cpu_manager_get_pressure(void) {
+    char buf[256];
+    float v = 0.0f;
+    if (procfs_read(&psi_file, buf, sizeof(buf)) < 0) return 0.0f;
+    procfs_pressure_avg10(buf, &v);
+    return v;
+}
+#endif
+
 void cpu_manager_update(void) { float u = cpu_manager_get_usage(); printf("[CPUManager] CPU usage: %.2f\n", u); }
 void cpu_manager_scale(void) {
     // Use Windows Job Objects or SetPriorityClass to scale CPU usage
@@ -30,8 +70,10 @@ void cpu_manager_prioritize(void) {
     // Use SetThreadPriority or SetPriorityClass to prioritize critical CPU tasks
 }
 void cpu_manager_power_adjust(void) {
+#ifdef _WIN32
     SYSTEM_POWER_STATUS ps;
     if (GetSystemPowerStatus(&ps) && ps.ACLineStatus == 0) {
         // On battery: reduce CPU frequency (if supported)
     }
+#endif
 } 
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef CPU_MANAGER_H
 #define CPU_MANAGER_H
 
+float cpu_manager_get_usage(void); // 0.0-1.0, queries the OS directly
+float cpu_manager_get_pressure(void); // PSI some avg10, 0.0-1.0 (Linux only)
 void cpu_manager_update(void);
 void cpu_manager_scale(void);
 void cpu_manager_prioritize(void);
@@ -2,51 +2,62 @@
 #include <stdio.h>
 #ifdef _WIN32
 #include <windows.h>
-#include <dxgi.h>
-#include <d3d11.h>
+#include <dxgi1_4.h>
 #pragma comment(lib, "dxgi.lib")
-#pragma comment(lib, "d3d11.lib")
 #endif
 
-// Query real GPU usage using DXGI and D3D11 (Windows 10+)
-float gpu_manager_get_usage(void) {
 #ifdef _WIN32
+// Adapter that reports a local memory budget, found once and kept: enumerating
+// adapters and creating D3D11 devices on every sample is far too expensive
+static IDXGIAdapter3* cached_adapter = NULL;
+static int gpu_probe_failed = 0;
+
+static IDXGIAdapter3* gpu_find_adapter(void) {
     IDXGIFactory1* pFactory = NULL;
     if (FAILED(CreateDXGIFactory1(&IID_IDXGIFactory1, (void**)&pFactory))) {
         printf("[GPUManager] Failed to create DXGIFactory1.\n");
-        return 0.0f;
+        return NULL;
     }
     IDXGIAdapter1* pAdapter = NULL;
-    float usage = 0.0f;
-    for (UINT i = 0; pFactory->lpVtbl->EnumAdapters1(pFactory, i, &pAdapter) != DXGI_ERROR_NOT_FOUND; ++i) {
-        DXGI_ADAPTER_DESC1 desc;
-        pAdapter->lpVtbl->GetDesc1(pAdapter, &desc);
-        // Query D3D11 device for usage
-        ID3D11Device* pDevice = NULL;
-        ID3D11DeviceContext* pContext = NULL;
-        D3D_FEATURE_LEVEL fl;
-        if (D3D11CreateDevice((IDXGIAdapter*)pAdapter, D3D_DRIVER_TYPE_UNKNOWN, NULL, 0, NULL, 0, D3D11_SDK_VERSION, &pDevice, &fl, &pContext) == S_OK) {
-            // Query for DXGI 1.4+ (Win10+) for real usage
-            IDXGIDevice3* pDXGIDevice3 = NULL;
-            if (SUCCEEDED(pDevice->lpVtbl->QueryInterface(pDevice, &IID_IDXGIDevice3, (void**)&pDXGIDevice3))) {
-                DXGI_QUERY_VIDEO_MEMORY_INFO memInfo = {0};
-                if (SUCCEEDED(pDXGIDevice3->lpVtbl->QueryVideoMemoryInfo(pDXGIDevice3, 0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memInfo))) {
-                    if (memInfo.Budget > 0)
-                        usage = (float)memInfo.CurrentUsage / (float)memInfo.Budget;
-                }
-                pDXGIDevice3->lpVtbl->Release(pDXGIDevice3);
+    IDXGIAdapter3* found = NULL;
+    for (UINT i = 0; !found && pFactory->lpVtbl->EnumAdapters1(pFactory, i, &pAdapter) != DXGI_ERROR_NOT_FOUND; ++i) {
+        // DXGI 1.4+ (Win10+) exposes per-adapter video memory usage
+        IDXGIAdapter3* pAdapter3 = NULL;
+        if (SUCCEEDED(pAdapter->lpVtbl->QueryInterface(pAdapter, &IID_IDXGIAdapter3, (void**)&pAdapter3))) {
+            DXGI_QUERY_VIDEO_MEMORY_INFO memInfo = {0};
+            if (SUCCEEDED(pAdapter3->lpVtbl->QueryVideoMemoryInfo(pAdapter3, 0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memInfo)) &&
+                memInfo.Budget > 0) {
+                found = pAdapter3;
+            } else {
+                pAdapter3->lpVtbl->Release(pAdapter3);
             }
-            pContext->lpVtbl->Release(pContext);
-            pDevice->lpVtbl->Release(pDevice);
         }
         pAdapter->lpVtbl->Release(pAdapter);
-        if (usage > 0.0f) break;
     }
     pFactory->lpVtbl->Release(pFactory);
-    printf("[GPUManager] Real GPU usage: %.2f\n", usage);
-    return usage;
+    return found;
+}
+#endif
+
+// Real GPU usage (local video memory in use vs. budget) via DXGI 1.4
+float gpu_manager_get_usage(void) {
+#ifdef _WIN32
+    if (!cached_adapter && !gpu_probe_failed) {
+        cached_adapter = gpu_find_adapter();
+        gpu_probe_failed = cached_adapter == NULL;
+        if (gpu_probe_failed) printf("[GPUManager] No adapter reports a memory budget.\n");
+    }
+    if (!cached_adapter) return 0.0f;
+    DXGI_QUERY_VIDEO_MEMORY_INFO memInfo = {0};
+    if (FAILED(cached_adapter->lpVtbl->QueryVideoMemoryInfo(cached_adapter, 0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memInfo)) ||
+        memInfo.Budget == 0) {
+        // Adapter went away (driver reset, hot unplug): probe again next time
+        cached_adapter->lpVtbl->Release(cached_adapter);
+        cached_adapter = NULL;
+        return 0.0f;
+    }
+    return (float)memInfo.CurrentUsage / (float)memInfo.Budget;
 #else
-    printf("[GPUManager] GPU usage not implemented on this platform.\n");
     return 0.0f;
 #endif
 }
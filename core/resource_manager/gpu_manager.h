@@ -1,6 +1,7 @@
 #ifndef GPU_MANAGER_H
 #define GPU_MANAGER_H
 
+float gpu_manager_get_usage(void); // 0.0-1.0, queries the OS directly
 void gpu_manager_update(void);
 void gpu_manager_scale(void);
 void gpu_manager_prioritize(void);
@@ -1,6 +1,11 @@
 #include "io_manager.h"
-#include <windows.h>
 #include <stdio.h>
+
+// Normalize to a 0.0-1.0 scale (arbitrary: 1GB/s = 1.0)
+#define IO_MAX_BYTES_PER_SEC 1e9
+
+#ifdef _WIN32
+#include <windows.h>
 #include <pdh.h>
 #pragma comment(lib, "pdh.lib")
 
@@ -27,13 +32,111 @@ float io_manager_get_usage(void) {
         printf("[IOManager] Failed to get PDH counter value\n");
         return 0.0f;
     }
-    // Normalize to a 0.0-1.0 scale (arbitrary: 1GB/s = 1.0)
-    double max_bytes_per_sec = 1e9;
-    float usage = (float)(value.doubleValue / max_bytes_per_sec);
+    float usage = (float)(value.doubleValue / IO_MAX_BYTES_PER_SEC);
     if (usage > 1.0f) usage = 1.0f;
     return usage;
 }
 
+float io_manager_get_pressure(void) { return 0.0f; }
+#else
+#include <stdlib.h>
+#include <string.h>
+#include "procfs.h"
+
+#define IO_MAX_DISKS 64
+#define IO_DISKSTATS_INITIAL 16384
+#define IO_DISKSTATS_MAX (1024 * 1024)
+
+static procfs_file_t diskstats_file = PROCFS_FILE("/proc/diskstats");
+static procfs_file_t psi_file = PROCFS_FILE("/proc/pressure/io");
+static uint64_t last_sectors = 0, last_ns = 0;
+static float last_io_usage = 0.0f;
+static char* diskstats_buf = NULL;
+static size_t diskstats_cap = 0;
+
+// Whole-disk check against sysfs, cached per device name so a sample costs no
+// extra syscalls. Partitions would double count their disk; loop, ram and
+// device-mapper devices are stacked on top of real disks.
+static struct { char name[32]; int is_disk; } disk_cache[IO_MAX_DISKS];
+static int disk_cache_count = 0;
+
+static int is_whole_disk(const char* name) {
+    for (int i = 0; i < disk_cache_count; ++i) {
+        if (strcmp(disk_cache[i].name, name) == 0) return disk_cache[i].is_disk;
+    }
+    int is_disk = 0;
+    if (strncmp(name, "loop", 4) && strncmp(name, "ram", 3) && strncmp(name, "zram", 4) && strncmp(name, "dm-", 3)) {
+        char rel[64];
+        snprintf(rel, sizeof(rel), "/sys/block/%s", name);
+        is_disk = procfs_exists(rel);
+    }
+    if (disk_cache_count < IO_MAX_DISKS) {
+        snprintf(disk_cache[disk_cache_count].name, sizeof(disk_cache[0].name), "%s", name);
+        disk_cache[disk_cache_count++].is_disk = is_disk;
+    }
+    return is_disk;
+}
+
+// "major minor name reads rmerged sectors_read ms_read writes wmerged sectors_written ..."
+// The buffer doubles whenever the file no longer fits; a partial read would
+// undercount the sectors, so past IO_DISKSTATS_MAX the sample is skipped.
+static int read_diskstats(void) {
+    for (;;) {
+        if (!diskstats_buf) {
+            diskstats_buf = malloc(IO_DISKSTATS_INITIAL);
+            if (!diskstats_buf) return -1;
+            diskstats_cap = IO_DISKSTATS_INITIAL;
+        }
+        if (procfs_read(&diskstats_file, diskstats_buf, diskstats_cap) < 0) return -1;
+        if (!diskstats_file.truncated) return 0;
+        if (diskstats_cap >= IO_DISKSTATS_MAX) {
+            static int warned = 0;
+            if (!warned) printf("[IOManager] /proc/diskstats exceeds %d bytes, skipping samples\n", IO_DISKSTATS_MAX);
+            warned = 1;
+            return -1;
+        }
+        char* grown = realloc(diskstats_buf, diskstats_cap * 2);
+        if (!grown) return -1;
+        diskstats_buf = grown;
+        diskstats_cap *= 2;
+    }
+}
+
+float io_manager_get_usage(void) {
+    if (read_diskstats() != 0) return last_io_usage;
+    uint64_t now = procfs_now_ns(), sectors = 0;
+    const char* p = diskstats_buf;
+    while (*p) {
+        uint64_t f[7];
+        char name[32];
+        if (procfs_parse_u64(&p, &f[0]) == 0 && procfs_parse_u64(&p, &f[0]) == 0 &&
+            procfs_parse_word(&p, name, sizeof(name)) == 0) {
+            int ok = 1;
+            for (int i = 0; i < 7 && ok; ++i) ok = procfs_parse_u64(&p, &f[i]) == 0;
+            if (ok && is_whole_disk(name)) sectors += f[2] + f[6];
+        }
+        procfs_skip_line(&p);
+    }
+    if (last_ns && now > last_ns && sectors >= last_sectors) {
+        double bytes_per_sec = (double)(sectors - last_sectors) * 512.0 * 1e9 / (double)(now - last_ns);
+        last_io_usage = (float)(bytes_per_sec / IO_MAX_BYTES_PER_SEC);
+        if (last_io_usage > 1.0f) last_io_usage = 1.0f;
+    }
+    last_sectors = sectors;
+    last_ns = now;
+    return last_io_usage;
+}
+
+// PSI: share of the last 10 s in which some task stalled on I/O
+float io_manager_get_pressure(void) {
+    char buf[256];
+    float v = 0.0f;
+    if (procfs_read(&psi_file, buf, sizeof(buf)) < 0) return 0.0f;
+    procfs_pressure_avg10(buf, &v);
+    return v;
+}
+#endif
+
 void io_manager_update(void) { float u = io_manager_get_usage(); printf("[IOManager] IO usage: %.2f\n", u); }
 void io_manager_scale(void) {
     // Use Windows APIs to monitor and scale IO usage (e.g., SetProcessWorkingSetSize, IO throttling)
@@ -42,8 +145,10 @@ void io_manager_prioritize(void) {
     // Use SetPriorityClass or IO priority APIs to prioritize IO tasks
 }
 void io_manager_power_adjust(void) {
+#ifdef _WIN32
     SYSTEM_POWER_STATUS ps;
     if (GetSystemPowerStatus(&ps) && ps.ACLineStatus == 0) {
         // On battery: reduce IO activity
     }
+#endif
 } 
\ No newline at end of file
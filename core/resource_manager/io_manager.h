@@ -1,6 +1,8 @@
 #ifndef IO_MANAGER_H
 #define IO_MANAGER_H
 
+float io_manager_get_usage(void); // 0.0-1.0, queries the OS directly
+float io_manager_get_pressure(void); // PSI some avg10, 0.0-1.0 (Linux only)
 void io_manager_update(void);
 void io_manager_scale(void);
 void io_manager_prioritize(void);
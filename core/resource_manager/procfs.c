@@ -0,0 +1,166 @@
+#ifndef _WIN32
+#include "procfs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+static char root[PROCFS_PATH_MAX] = "";
+static unsigned root_gen = 1;
+static int root_loaded = 0;
+
+static void load_root(void) {
+    if (root_loaded) return;
+    root_loaded = 1;
+    const char* env = getenv("NEONOVA_PROCFS_ROOT");
+    if (env && *env) procfs_set_root(env);
+}
+
+void procfs_set_root(const char* dir) {
+    root_loaded = 1;
+    snprintf(root, sizeof(root), "%s", dir ? dir : "");
+    root_gen++;
+    printf("[Procfs] Root set to '%s'\n", root[0] ? root : "/");
+}
+
+const char* procfs_root(void) {
+    load_root();
+    return root;
+}
+
+static int build_path(char* out, size_t len, const char* rel) {
+    int n = snprintf(out, len, "%s%s", procfs_root(), rel);
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+void procfs_close(procfs_file_t* f) {
+    if (f->fd >= 0) close(f->fd);
+    f->fd = -1;
+}
+
+static int procfs_open(procfs_file_t* f) {
+    char path[PROCFS_PATH_MAX];
+    procfs_close(f);
+    if (build_path(path, sizeof(path), f->rel) != 0) return -1;
+    f->fd = open(path, O_RDONLY | O_CLOEXEC);
+    f->root_gen = root_gen;
+    return f->fd >= 0 ? 0 : -1;
+}
+
+// pread from offset 0 regenerates the whole file without another open().
+// procfs may hand it back in several short reads, so keep reading to EOF.
+// Returns the byte count, or -1 if a read fails.
+static ssize_t read_all(procfs_file_t* f, char* buf, size_t len) {
+    size_t total = 0;
+    while (total < len - 1) {
+        ssize_t n = pread(f->fd, buf + total, len - 1 - total, (off_t)total);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        total += (size_t)n;
+    }
+    buf[total] = '\0';
+    if (total == len - 1) {
+        char probe;
+        f->truncated = pread(f->fd, &probe, 1, (off_t)total) > 0;
+    }
+    return (ssize_t)total;
+}
+
+// The descriptor is reopened once if the read fails (e.g. the device went away)
+int procfs_read(procfs_file_t* f, char* buf, size_t len) {
+    if (!f || !buf || len < 2) return -1;
+    procfs_root();
+    f->truncated = 0;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if ((f->fd < 0 || f->root_gen != root_gen || attempt) && procfs_open(f) != 0) return -1;
+        ssize_t n = read_all(f, buf, len);
+        if (n >= 0) return (int)n;
+    }
+    return -1;
+}
+
+int procfs_exists(const char* rel) {
+    char path[PROCFS_PATH_MAX];
+    if (build_path(path, sizeof(path), rel) != 0) return 0;
+    return access(path, F_OK) == 0;
+}
+
+uint64_t procfs_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void procfs_skip_spaces(const char** p) {
+    while (**p == ' ' || **p == '\t') (*p)++;
+}
+
+void procfs_skip_line(const char** p) {
+    while (**p && **p != '\n') (*p)++;
+    if (**p == '\n') (*p)++;
+}
+
+int procfs_parse_u64(const char** p, uint64_t* out) {
+    procfs_skip_spaces(p);
+    if (**p < '0' || **p > '9') return -1;
+    uint64_t v = 0;
+    while (**p >= '0' && **p <= '9') v = v * 10 + (uint64_t)(*(*p)++ - '0');
+    *out = v;
+    return 0;
+}
+
+// Consume word if the text at *p starts with it
+int procfs_match(const char** p, const char* word) {
+    size_t n = strlen(word);
+    if (strncmp(*p, word, n) != 0) return 0;
+    *p += n;
+    return 1;
+}
+
+int procfs_parse_word(const char** p, char* out, size_t len) {
+    procfs_skip_spaces(p);
+    size_t n = 0;
+    while (**p && **p != ' ' && **p != '\t' && **p != '\n') {
+        if (n + 1 < len) out[n++] = **p;
+        (*p)++;
+    }
+    out[n] = '\0';
+    return n ? 0 : -1;
+}
+
+int procfs_find_key(const char* buf, const char* key, uint64_t* out) {
+    const char* p = buf;
+    size_t n = strlen(key);
+    while (*p) {
+        if (strncmp(p, key, n) == 0 && p[n] == ':') {
+            p += n + 1;
+            return procfs_parse_u64(&p, out);
+        }
+        procfs_skip_line(&p);
+    }
+    return -1;
+}
+
+// "some avg10=12.34 avg60=... total=..." -> 0.1234
+int procfs_pressure_avg10(const char* buf, float* out) {
+    const char* p = buf;
+    while (*p) {
+        if (procfs_match(&p, "some ")) {
+            procfs_skip_spaces(&p);
+            if (!procfs_match(&p, "avg10=")) return -1;
+            uint64_t whole = 0, frac = 0, scale = 1;
+            if (procfs_parse_u64(&p, &whole) != 0) return -1;
+            if (*p == '.') {
+                ++p;
+                while (*p >= '0' && *p <= '9') { frac = frac * 10 + (uint64_t)(*p++ - '0'); scale *= 10; }
+            }
+            *out = ((float)whole + (float)frac / (float)scale) / 100.0f;
+            return 0;
+        }
+        procfs_skip_line(&p);
+    }
+    return -1;
+}
+#endif // _WIN32
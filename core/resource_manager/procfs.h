@@ -0,0 +1,40 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Persistent procfs/sysfs readers for the Linux backends. Files are opened
+// once and re-read with pread at offset 0; parsing never allocates.
+// The root prefix defaults to "" (real /proc and /sys) and can be pointed at
+// a fake tree for tests, either here or via NEONOVA_PROCFS_ROOT.
+#define PROCFS_PATH_MAX 256
+
+typedef struct {
+    int fd;                 // -1 until first use
+    unsigned root_gen;      // Reopened when the root changes
+    const char* rel;        // e.g. "/proc/stat"
+    int truncated;          // Last read filled the buffer with more left
+} procfs_file_t;
+
+#define PROCFS_FILE(rel) { -1, 0, rel, 0 }
+
+void procfs_set_root(const char* root);
+const char* procfs_root(void);
+// Bytes read (NUL-terminated), -1 on error. Reads until EOF; if the file
+// does not fit, f->truncated is set and buf holds the first len - 1 bytes.
+int procfs_read(procfs_file_t* f, char* buf, size_t len);
+void procfs_close(procfs_file_t* f);
+int procfs_exists(const char* rel);
+uint64_t procfs_now_ns(void);
+
+// Parser helpers; each advances *p past what it consumed
+void procfs_skip_spaces(const char** p);
+void procfs_skip_line(const char** p);
+int procfs_parse_u64(const char** p, uint64_t* out);
+int procfs_match(const char** p, const char* word);
+int procfs_parse_word(const char** p, char* out, size_t len);
+int procfs_find_key(const char* buf, const char* key, uint64_t* out); // "Key: value" lines
+int procfs_pressure_avg10(const char* buf, float* out); // PSI "some avg10=" as 0.0-1.0
+
+#endif // PROCFS_H
@@ -1,6 +1,11 @@
 #include "ram_manager.h"
-#include <windows.h>
 #include <stdio.h>
+#include "../../kernel64/include/zswap.h"
+#include "../../kernel64/include/shrinker.h"
+#include "../../kernel64/include/page_alloc.h"
+
+#ifdef _WIN32
+#include <windows.h>
 #include <psapi.h>
 
 float ram_manager_get_usage(void) {
@@ -12,24 +17,61 @@ float ram_manager_get_usage(void) {
     return 0.0f;
 }
 
+float ram_manager_get_pressure(void) { return 0.0f; }
+#else
+#include "procfs.h"
+
+static procfs_file_t meminfo_file = PROCFS_FILE("/proc/meminfo");
+static procfs_file_t psi_file = PROCFS_FILE("/proc/pressure/memory");
+
+// MemAvailable already accounts for reclaimable cache, unlike MemFree
+float ram_manager_get_usage(void) {
+    char buf[4096];
+    uint64_t total = 0, avail = 0;
+    if (procfs_read(&meminfo_file, buf, sizeof(buf)) < 0) return 0.0f;
+    if (procfs_find_key(buf, "MemTotal", &total) != 0 || total == 0) return 0.0f;
+    if (procfs_find_key(buf, "MemAvailable", &avail) != 0) procfs_find_key(buf, "MemFree", &avail);
+    if (avail > total) avail = total;
+    return (float)(total - avail) / (float)total;
+}
+
+// PSI: share of the last 10 s in which some task stalled on memory
+float ram_manager_get_pressure(void) {
+    char buf[256];
+    float v = 0.0f;
+    if (procfs_read(&psi_file, buf, sizeof(buf)) < 0) return 0.0f;
+    procfs_pressure_avg10(buf, &v);
+    return v;
+}
+#endif
+
 void ram_manager_update(void) { float u = ram_manager_get_usage(); printf("[RAMManager] RAM usage: %.2f\n", u); }
 void ram_manager_scale(void) {
-    MEMORYSTATUSEX memInfo;
-    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-    GlobalMemoryStatusEx(&memInfo);
-    DWORDLONG totalPhys = memInfo.ullTotalPhys;
-    DWORDLONG availPhys = memInfo.ullAvailPhys;
-    double usage = 1.0 - ((double)availPhys / (double)totalPhys);
+    double usage = ram_manager_get_usage();
     if (usage > 0.9) {
-        // Throttle RAM-intensive tasks (integrate with process manager)
+        // Aim back under 85%: caches give memory back first, then cold
+        // anonymous pages go to compressed swap
+        page_alloc_stats_t st;
+        page_alloc_stats(&st);
+        unsigned long want = (unsigned long)((usage - 0.85) * (double)st.total_pages);
+        unsigned long freed = shrink_memory(want);
+        unsigned swapped = 0;
+        if (freed < want) {
+            zswap_params_t zp;
+            zswap_get_params(&zp);
+            swapped = zswap_reclaim(zp.batch);
+        }
+        if (freed || swapped) printf("[RAMManager] Shrank caches by %lu pages, swapped out %u\n", freed, swapped);
     }
 }
 void ram_manager_prioritize(void) {
     // Prioritize critical RAM tasks (integrate with scheduler)
 }
 void ram_manager_power_adjust(void) {
+#ifdef _WIN32
     SYSTEM_POWER_STATUS ps;
     if (GetSystemPowerStatus(&ps) && ps.ACLineStatus == 0) {
         // On battery: reduce RAM usage (e.g., trim working sets)
     }
+#endif
 } 
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef RAM_MANAGER_H
 #define RAM_MANAGER_H
 
+float ram_manager_get_usage(void); // 0.0-1.0, queries the OS directly
+float ram_manager_get_pressure(void); // PSI some avg10, 0.0-1.0 (Linux only)
 void ram_manager_update(void);
 void ram_manager_scale(void);
 void ram_manager_prioritize(void);
@@ -0,0 +1,440 @@
+// hierarchical resource groups: per-CPU charging, limits, shares and pressure
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sched_getcpu
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "resource_group.h"
+#include "../../kernel64/include/slot_map.h"
+#include "../../kernel64/include/spinlock.h"
+#include "../../kernel64/include/ktime.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    uint64_t pending[RG_RESOURCES]; // Charged here but not yet pushed up the tree
+} __attribute__((aligned(64))) rg_pcpu_t;
+
+typedef struct resource_group {
+    char name[RG_NAME_LEN];
+    int id;
+    struct resource_group* parent;
+    int nr_children;
+    int depth;
+    uint32_t weight;
+    uint32_t share_ppm;
+    uint64_t usage[RG_RESOURCES];       // Pushed-up totals, descendants included
+    uint64_t limit[RG_RESOURCES];
+    uint64_t period_base[RG_RESOURCES]; // usage at the start of the current period
+    uint32_t throttled;                 // Bit per resource; set on push, cleared per period
+    uint32_t stalled_ms[RG_RESOURCES];  // Reported by callers this period
+    bool over_share;
+    float avg10[RG_RESOURCES];
+    float avg60[RG_RESOURCES];
+    uint64_t nr_throttled;
+    rg_pcpu_t pcpu[RG_MAX_CPUS];
+} resource_group_t;
+
+// Groups live at pool[slot] for their whole life so charging CPUs can hold
+// pointers; the slot map only hands out generation-checked ids. Lock-free
+// callers pin the slot in group_refs (kept outside the group, which is reset
+// on reuse) and destroy waits for the pins to drain.
+static resource_group_t pool[RG_MAX_GROUPS];
+static uint32_t group_refs[RG_MAX_GROUPS];
+static resource_group_t* group_ptrs[RG_MAX_GROUPS];
+static uint32_t group_dense_slot[RG_MAX_GROUPS];
+static slot_entry_t group_slots[RG_MAX_GROUPS];
+static slot_map_t groups;
+static resource_group_t* root = NULL;
+static spinlock_t rg_lock = SPINLOCK_INIT; // Structure changes and rgroup_tick
+static int rg_nr_cpus = 1;
+static uint32_t unthrottle_seq = 0;
+static uint64_t last_tick_ms = 0;
+
+static const uint64_t rg_batch[RG_RESOURCES] = { RG_CPU_BATCH_US, 0, RG_BYTES_BATCH, RG_BYTES_BATCH };
+static const char* rg_names[RG_RESOURCES] = { "cpu", "mem", "io", "net" };
+
+static int rg_this_cpu(void) {
+#if defined(_WIN32)
+    int cpu = (int)GetCurrentProcessorNumber();
+#elif defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu < 0) cpu = 0;
+#else
+    int cpu = 0;
+#endif
+    return cpu % rg_nr_cpus;
+}
+
+// Caller holds rg_lock
+static resource_group_t* resolve(int id) {
+    if (id == RG_ROOT) return root;
+    resource_group_t** g = (resource_group_t**)slot_map_get(&groups, id);
+    return g ? *g : NULL;
+}
+
+// Lock-free lookup for the charge paths; pair with group_put(). The pin is
+// taken before the id is checked, so once destroy has cleared the id and
+// seen no pins, nobody can still be using the group.
+static resource_group_t* group_get(int id) {
+    if (id == RG_ROOT) return root;
+    uint32_t slot = (uint32_t)id & SLOT_INDEX_MASK;
+    if (id <= 0 || slot >= RG_MAX_GROUPS) return NULL;
+    __atomic_add_fetch(&group_refs[slot], 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool[slot].id, __ATOMIC_SEQ_CST) != id) {
+        __atomic_sub_fetch(&group_refs[slot], 1, __ATOMIC_RELEASE);
+        return NULL;
+    }
+    if (&pool[slot] == root) __atomic_sub_fetch(&group_refs[slot], 1, __ATOMIC_RELEASE); // Never destroyed
+    return &pool[slot];
+}
+
+// For uncharging: the caller holds a memory charge, so the group cannot be
+// destroyed and is taken without the id check, which destroy clears while
+// it makes sure no charge is outstanding
+static resource_group_t* group_get_charged(int id) {
+    if (id == RG_ROOT) return root;
+    uint32_t slot = (uint32_t)id & SLOT_INDEX_MASK;
+    if (id <= 0 || slot >= RG_MAX_GROUPS) return NULL;
+    if (&pool[slot] == root) return root;
+    __atomic_add_fetch(&group_refs[slot], 1, __ATOMIC_SEQ_CST);
+    return &pool[slot];
+}
+
+static void group_put(resource_group_t* g) {
+    if (g && g != root) __atomic_sub_fetch(&group_refs[g - pool], 1, __ATOMIC_RELEASE);
+}
+
+// Add to every level; any level that goes over its limit is throttled
+static void push_up(resource_group_t* g, rg_resource_t res, uint64_t amount) {
+    for (resource_group_t* x = g; x; x = x->parent) {
+        uint64_t u = __atomic_add_fetch(&x->usage[res], amount, __ATOMIC_RELAXED);
+        uint64_t lim = x->limit[res];
+        if (lim != RG_NO_LIMIT && u - __atomic_load_n(&x->period_base[res], __ATOMIC_RELAXED) > lim) {
+            __atomic_fetch_or(&x->throttled, 1u << res, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void drain(resource_group_t* g) {
+    for (int c = 0; c < rg_nr_cpus; ++c) {
+        for (int r = 0; r < RG_RESOURCES; ++r) {
+            if (r == RG_MEM || !g->pcpu[c].pending[r]) continue;
+            uint64_t v = __atomic_exchange_n(&g->pcpu[c].pending[r], 0, __ATOMIC_RELAXED);
+            if (v) push_up(g, (rg_resource_t)r, v);
+        }
+    }
+}
+
+static void group_reset(resource_group_t* g, const char* name, resource_group_t* parent) {
+    memset(g, 0, sizeof(*g));
+    strncpy(g->name, name, sizeof(g->name) - 1);
+    g->parent = parent;
+    g->depth = parent ? parent->depth + 1 : 0;
+    g->weight = RG_WEIGHT_DEFAULT;
+    g->share_ppm = 1000000;
+    for (int r = 0; r < RG_RESOURCES; ++r) g->limit[r] = RG_NO_LIMIT;
+}
+
+int rgroup_init(int nr_cpus) {
+    if (nr_cpus <= 0) {
+#if defined(_WIN32)
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        nr_cpus = (int)si.dwNumberOfProcessors;
+#elif defined(__linux__)
+        nr_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+        nr_cpus = 1;
+#endif
+    }
+    if (nr_cpus < 1) nr_cpus = 1;
+    if (nr_cpus > RG_MAX_CPUS) nr_cpus = RG_MAX_CPUS;
+    rg_nr_cpus = nr_cpus;
+    slot_map_init(&groups, group_ptrs, sizeof(resource_group_t*), group_dense_slot, group_slots, RG_MAX_GROUPS);
+    resource_group_t** slot;
+    int id = slot_map_insert(&groups, (void**)&slot);
+    root = &pool[id & SLOT_INDEX_MASK];
+    group_reset(root, "root", NULL);
+    root->id = id;
+    *slot = root;
+    last_tick_ms = ktime_ms();
+    printf("[ResourceGroup] Initialized (%d CPUs, %d groups max)\n", rg_nr_cpus, RG_MAX_GROUPS);
+    return 0;
+}
+
+int rgroup_create(const char* name, int parent) {
+    if (!name || !root) return -1;
+    spin_lock(&rg_lock);
+    resource_group_t* p = resolve(parent);
+    if (!p || p->depth + 1 >= RG_MAX_DEPTH) {
+        spin_unlock(&rg_lock);
+        return -1;
+    }
+    resource_group_t** slot;
+    int id = slot_map_insert(&groups, (void**)&slot);
+    if (id < 0) {
+        spin_unlock(&rg_lock);
+        printf("[ResourceGroup] Out of groups creating '%s'\n", name);
+        return -1;
+    }
+    resource_group_t* g = &pool[id & SLOT_INDEX_MASK];
+    group_reset(g, name, p);
+    *slot = g;
+    __atomic_store_n(&g->id, id, __ATOMIC_RELEASE); // Visible to group_get() from here
+    p->nr_children++;
+    spin_unlock(&rg_lock);
+    printf("[ResourceGroup] Created '%s' (%d) under '%s'\n", g->name, id, p->name);
+    return id;
+}
+
+int rgroup_destroy(int id) {
+    spin_lock(&rg_lock);
+    resource_group_t* g = resolve(id);
+    if (!g || g == root || g->nr_children > 0) {
+        spin_unlock(&rg_lock);
+        return -1;
+    }
+    // Unpublish, then wait out chargers that already resolved it; a memory
+    // charge that landed meanwhile keeps the group alive
+    __atomic_store_n(&g->id, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&group_refs[g - pool], __ATOMIC_SEQ_CST)) cpu_relax();
+    if (__atomic_load_n(&g->usage[RG_MEM], __ATOMIC_RELAXED) != 0) {
+        __atomic_store_n(&g->id, id, __ATOMIC_RELEASE);
+        spin_unlock(&rg_lock);
+        return -1;
+    }
+    drain(g); // Ancestors keep what it used
+    g->parent->nr_children--;
+    slot_map_remove(&groups, id);
+    spin_unlock(&rg_lock);
+    printf("[ResourceGroup] Destroyed '%s'\n", g->name);
+    return 0;
+}
+
+int rgroup_find(const char* name) {
+    int id = -1;
+    spin_lock(&rg_lock);
+    for (uint32_t i = 0; i < groups.count && id < 0; ++i) {
+        if (strcmp(group_ptrs[i]->name, name) == 0) id = group_ptrs[i]->id;
+    }
+    spin_unlock(&rg_lock);
+    return id;
+}
+
+int rgroup_set_limit(int id, rg_resource_t res, uint64_t limit) {
+    resource_group_t* g = group_get(id);
+    if (!g || res >= RG_RESOURCES) { group_put(g); return -1; }
+    g->limit[res] = limit;
+    group_put(g);
+    return 0;
+}
+
+int rgroup_set_weight(int id, uint32_t weight) {
+    resource_group_t* g = group_get(id);
+    if (!g || weight == 0 || weight > RG_WEIGHT_MAX) { group_put(g); return -1; }
+    g->weight = weight;
+    group_put(g);
+    return 0;
+}
+
+void rgroup_charge(int id, rg_resource_t res, uint64_t amount) {
+    if (res >= RG_RESOURCES || amount == 0) return;
+    resource_group_t* g = group_get(id);
+    if (!g) return;
+    if (res == RG_MEM) {
+        push_up(g, res, amount); // Forced charge: may exceed the limit
+    } else {
+        uint64_t* p = &g->pcpu[rg_this_cpu()].pending[res];
+        if (__atomic_add_fetch(p, amount, __ATOMIC_RELAXED) >= rg_batch[res]) {
+            push_up(g, res, __atomic_exchange_n(p, 0, __ATOMIC_RELAXED));
+        }
+    }
+    group_put(g);
+}
+
+int rgroup_try_charge_mem(int id, uint64_t bytes) {
+    resource_group_t* g = group_get(id);
+    if (!g) return -1;
+    int rc = 0;
+    for (resource_group_t* x = g; x; x = x->parent) {
+        uint64_t u = __atomic_add_fetch(&x->usage[RG_MEM], bytes, __ATOMIC_RELAXED);
+        if (x->limit[RG_MEM] != RG_NO_LIMIT && u > x->limit[RG_MEM]) {
+            // Undo this level and everything below it
+            for (resource_group_t* y = g; ; y = y->parent) {
+                __atomic_sub_fetch(&y->usage[RG_MEM], bytes, __ATOMIC_RELAXED);
+                if (y == x) break;
+            }
+            __atomic_fetch_or(&x->throttled, 1u << RG_MEM, __ATOMIC_RELEASE);
+            rc = -1;
+            break;
+        }
+    }
+    group_put(g);
+    return rc;
+}
+
+void rgroup_uncharge_mem(int id, uint64_t bytes) {
+    resource_group_t* g = group_get_charged(id);
+    for (resource_group_t* x = g; x; x = x->parent) {
+        __atomic_sub_fetch(&x->usage[RG_MEM], bytes, __ATOMIC_RELAXED);
+    }
+    group_put(g);
+}
+
+void rgroup_note_stall(int id, rg_resource_t res, uint32_t ms) {
+    if (res >= RG_RESOURCES) return;
+    resource_group_t* g = group_get(id);
+    if (g) __atomic_add_fetch(&g->stalled_ms[res], ms, __ATOMIC_RELAXED);
+    group_put(g);
+}
+
+// Ancestors cannot go away while the pinned group is their child
+bool rgroup_throttled(int id, rg_resource_t res) {
+    resource_group_t* g = group_get(id);
+    bool throttled = false;
+    for (resource_group_t* x = g; x && !throttled; x = x->parent) {
+        throttled = (__atomic_load_n(&x->throttled, __ATOMIC_ACQUIRE) & (1u << res)) != 0;
+    }
+    group_put(g);
+    return throttled;
+}
+
+bool rgroup_over_share(int id) {
+    resource_group_t* g = group_get(id);
+    bool over = g && g->over_share;
+    group_put(g);
+    return over;
+}
+
+uint32_t rgroup_unthrottle_seq(void) {
+    return __atomic_load_n(&unthrottle_seq, __ATOMIC_ACQUIRE);
+}
+
+// Shares: a group's fraction of its parent is weight / sum of sibling weights
+static void compute_shares(void) {
+    static uint64_t child_weight[RG_MAX_GROUPS];
+    for (uint32_t i = 0; i < groups.count; ++i) child_weight[group_ptrs[i] - pool] = 0;
+    for (uint32_t i = 0; i < groups.count; ++i) {
+        resource_group_t* g = group_ptrs[i];
+        if (g->parent) child_weight[g->parent - pool] += g->weight;
+    }
+    for (int depth = 1; depth < RG_MAX_DEPTH; ++depth) {
+        for (uint32_t i = 0; i < groups.count; ++i) {
+            resource_group_t* g = group_ptrs[i];
+            if (g->depth != depth) continue;
+            uint64_t sum = child_weight[g->parent - pool];
+            g->share_ppm = (uint32_t)((uint64_t)g->parent->share_ppm * g->weight / (sum ? sum : 1));
+        }
+    }
+}
+
+// Per-period work, proportional to the number of groups: fold per-CPU
+// counters, update pressure, decide shares and re-arm quotas
+void rgroup_tick(uint64_t now_ms) {
+    if (!root) return;
+    uint64_t elapsed = now_ms - last_tick_ms;
+    if (elapsed == 0) return;
+    last_tick_ms = now_ms;
+    spin_lock(&rg_lock);
+    for (uint32_t i = 0; i < groups.count; ++i) drain(group_ptrs[i]);
+    compute_shares();
+    uint64_t capacity_us = (uint64_t)rg_nr_cpus * elapsed * 1000;
+    bool contended = (root->usage[RG_CPU] - root->period_base[RG_CPU]) * 100 >= capacity_us * RG_CONTENDED_PCT;
+    float a10 = elapsed >= 10000 ? 1.0f : (float)elapsed / 10000.0f;
+    float a60 = elapsed >= 60000 ? 1.0f : (float)elapsed / 60000.0f;
+    bool released = false;
+    for (uint32_t i = 0; i < groups.count; ++i) {
+        resource_group_t* g = group_ptrs[i];
+        uint32_t was = __atomic_load_n(&g->throttled, __ATOMIC_ACQUIRE);
+        for (int r = 0; r < RG_RESOURCES; ++r) {
+            uint64_t stalled = __atomic_exchange_n(&g->stalled_ms[r], 0, __ATOMIC_RELAXED);
+            if (was & (1u << r)) stalled = elapsed;
+            if (stalled > elapsed) stalled = elapsed;
+            float pct = 100.0f * (float)stalled / (float)elapsed;
+            g->avg10[r] += (pct - g->avg10[r]) * a10;
+            g->avg60[r] += (pct - g->avg60[r]) * a60;
+        }
+        uint64_t cpu_used = g->usage[RG_CPU] - g->period_base[RG_CPU];
+        g->over_share = contended && g != root &&
+            cpu_used * 1000000 > (uint64_t)g->share_ppm * capacity_us;
+        if (was) {
+            g->nr_throttled++;
+            released = true;
+        }
+        for (int r = 0; r < RG_RESOURCES; ++r) {
+            if (r != RG_MEM) __atomic_store_n(&g->period_base[r], g->usage[r], __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&g->throttled, 0, __ATOMIC_RELEASE);
+    }
+    if (released) __atomic_add_fetch(&unthrottle_seq, 1, __ATOMIC_RELEASE);
+    spin_unlock(&rg_lock);
+}
+
+static bool is_within(const resource_group_t* g, const resource_group_t* top) {
+    for (; g; g = g->parent) if (g == top) return true;
+    return false;
+}
+
+// Caller holds rg_lock: the subtree walk reads the group array
+static void stats_locked(resource_group_t* g, rg_stats_t* out) {
+    memset(out, 0, sizeof(*out));
+    for (int r = 0; r < RG_RESOURCES; ++r) {
+        out->usage[r] = __atomic_load_n(&g->usage[r], __ATOMIC_RELAXED);
+        out->limit[r] = g->limit[r];
+        out->pressure_avg10[r] = g->avg10[r];
+        out->pressure_avg60[r] = g->avg60[r];
+    }
+    // Lazy fold: add what is still parked in per-CPU counters of the subtree
+    for (uint32_t i = 0; i < groups.count; ++i) {
+        resource_group_t* d = group_ptrs[i];
+        if (!is_within(d, g)) continue;
+        for (int c = 0; c < rg_nr_cpus; ++c) {
+            for (int r = 0; r < RG_RESOURCES; ++r) {
+                out->usage[r] += __atomic_load_n(&d->pcpu[c].pending[r], __ATOMIC_RELAXED);
+            }
+        }
+    }
+    out->weight = g->weight;
+    out->share_ppm = g->share_ppm;
+    out->throttled = __atomic_load_n(&g->throttled, __ATOMIC_ACQUIRE);
+    out->nr_throttled = g->nr_throttled;
+}
+
+int rgroup_stats(int id, rg_stats_t* out) {
+    if (!out) return -1;
+    spin_lock(&rg_lock);
+    resource_group_t* g = resolve(id);
+    if (g) stats_locked(g, out);
+    spin_unlock(&rg_lock);
+    return g ? 0 : -1;
+}
+
+// Printed under the lock so groups cannot be destroyed mid-walk; dumps are rare
+void rgroup_dump(void) {
+    spin_lock(&rg_lock);
+    printf("[ResourceGroup] %u groups:\n", groups.count);
+    for (uint32_t i = 0; i < groups.count; ++i) {
+        rg_stats_t st;
+        resource_group_t* g = group_ptrs[i];
+        stats_locked(g, &st);
+        printf("  %*s%s: cpu %llu us, mem %llu B, io %llu B, net %llu B, share %u.%u%%",
+            g->depth * 2, "", g->name,
+            (unsigned long long)st.usage[RG_CPU], (unsigned long long)st.usage[RG_MEM],
+            (unsigned long long)st.usage[RG_IO], (unsigned long long)st.usage[RG_NET],
+            st.share_ppm / 10000, st.share_ppm / 1000 % 10);
+        for (int r = 0; r < RG_RESOURCES; ++r) {
+            if (st.pressure_avg10[r] >= 0.1f) printf(", %s pressure %.1f%%", rg_names[r], st.pressure_avg10[r]);
+        }
+        printf("%s\n", st.throttled ? " [THROTTLED]" : "");
+    }
+    spin_unlock(&rg_lock);
+}
@@ -0,0 +1,66 @@
+#ifndef RESOURCE_GROUP_H
+#define RESOURCE_GROUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Resource groups: a hierarchy that processes, apps, VMs, sockets and I/O
+// contexts are charged to. Charges land in per-CPU counters and are pushed up
+// the tree in batches; reads fold the outstanding per-CPU deltas lazily.
+// Limits are checked when a batch is pushed and re-armed once per period by
+// rgroup_tick(), so enforcement never scans processes.
+typedef enum {
+    RG_CPU,     // Microseconds of run time
+    RG_MEM,     // Bytes currently charged (a gauge; see rgroup_try_charge_mem)
+    RG_IO,      // Bytes read/written
+    RG_NET,     // Bytes sent/received
+    RG_RESOURCES
+} rg_resource_t;
+
+#define RG_MAX_GROUPS 128
+#define RG_MAX_DEPTH 8
+#define RG_MAX_CPUS 64
+#define RG_NAME_LEN 32
+#define RG_ROOT 0                   // Also where zero-initialized owners are charged
+#define RG_WEIGHT_DEFAULT 100
+#define RG_WEIGHT_MAX 10000
+#define RG_NO_LIMIT UINT64_MAX
+#define RG_PERIOD_MS 100            // Quota period for CPU, IO and NET limits
+#define RG_CONTENDED_PCT 90         // CPU busier than this enforces weighted shares
+#define RG_CPU_BATCH_US 1000        // Per-CPU slack before a charge is pushed up
+#define RG_BYTES_BATCH (64 * 1024)
+
+typedef struct rg_stats {
+    uint64_t usage[RG_RESOURCES];   // Totals including descendants (MEM: current)
+    uint64_t limit[RG_RESOURCES];   // CPU/IO/NET per RG_PERIOD_MS, MEM absolute
+    uint32_t weight;
+    uint32_t share_ppm;             // Guaranteed fraction of the CPU under contention
+    uint32_t throttled;             // Bit per resource
+    float pressure_avg10[RG_RESOURCES]; // % of time throttled or stalled, last ~10 s
+    float pressure_avg60[RG_RESOURCES];
+    uint64_t nr_throttled;          // Periods spent throttled
+} rg_stats_t;
+
+int rgroup_init(int nr_cpus);
+int rgroup_create(const char* name, int parent);   // Group id, or -1
+int rgroup_destroy(int id);                         // Fails while it has children
+int rgroup_find(const char* name);
+int rgroup_set_limit(int id, rg_resource_t res, uint64_t limit);
+int rgroup_set_weight(int id, uint32_t weight);
+
+// Hot path: per-CPU add, no locks
+void rgroup_charge(int id, rg_resource_t res, uint64_t amount);
+// Memory is checked exactly against every ancestor's limit before it is taken
+int rgroup_try_charge_mem(int id, uint64_t bytes);
+void rgroup_uncharge_mem(int id, uint64_t bytes);
+void rgroup_note_stall(int id, rg_resource_t res, uint32_t ms); // Caller waited on a limit
+
+bool rgroup_throttled(int id, rg_resource_t res);   // Group or any ancestor over its limit
+bool rgroup_over_share(int id);                     // Used more CPU than its weight allows
+uint32_t rgroup_unthrottle_seq(void);               // Changes whenever a group is released
+
+void rgroup_tick(uint64_t now_ms);                  // Every RG_PERIOD_MS
+int rgroup_stats(int id, rg_stats_t* out);
+void rgroup_dump(void);
+
+#endif // RESOURCE_GROUP_H
@@ -3,25 +3,27 @@
 #include "ram_manager.h"
 #include "gpu_manager.h"
 #include "io_manager.h"
+#include "resource_sampler.h"
+#include "resource_group.h"
 #include <stdio.h>
 
 static resource_usage_t usage = {0};
 
 void resource_manager_init(void) {
+    rgroup_init(0);
+    resource_sampler_start();
     printf("[ResourceManager] Initialized.\n");
 }
 
+// Pull the sampler's latest snapshot; no OS calls happen here
 void resource_manager_update(void) {
-    usage.cpu_usage = cpu_manager_get_usage();
-    usage.ram_usage = ram_manager_get_usage();
-    usage.gpu_usage = gpu_manager_get_usage();
-    usage.io_usage = io_manager_get_usage();
-    printf("[ResourceManager] Usage updated.\n");
+    resource_sampler_read(&usage);
 }
 
 resource_usage_t resource_manager_get_usage(void) {
-    printf("[ResourceManager] Returning usage snapshot.\n");
-    return usage;
+    resource_usage_t u;
+    resource_sampler_read(&u);
+    return u;
 }
 
 void resource_manager_scale(void) {
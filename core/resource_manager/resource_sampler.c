@@ -0,0 +1,148 @@
+#include "resource_sampler.h"
+#include "cpu_manager.h"
+#include "ram_manager.h"
+#include "gpu_manager.h"
+#include "io_manager.h"
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+#include "../../kernel64/include/ktime.h"
+
+// Seqlock: odd sequence while the sampler is writing. One writer (the
+// sampler thread), any number of readers, who retry on a torn copy.
+static struct {
+    volatile uint64_t seq;
+    resource_usage_t snap;
+} published = {0};
+
+static float (*const samplers[RESOURCE_METRICS])(void) = {
+    cpu_manager_get_usage, ram_manager_get_usage, gpu_manager_get_usage, io_manager_get_usage
+};
+static uint32_t periods[RESOURCE_METRICS] = {
+    RESOURCE_CPU_PERIOD_MS, RESOURCE_RAM_PERIOD_MS, RESOURCE_GPU_PERIOD_MS, RESOURCE_IO_PERIOD_MS
+};
+static resource_usage_t staged = {0}; // Sampler-private working copy
+static volatile int sampler_stop = 0;
+#ifdef _WIN32
+static HANDLE sampler_thread = NULL;
+#else
+static pthread_t sampler_thread;
+static int sampler_running = 0;
+#endif
+
+static void sampler_sleep_ms(uint32_t ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void publish(const resource_usage_t* u) {
+    uint64_t seq = published.seq;
+    __atomic_store_n(&published.seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    published.snap = *u;
+    __atomic_store_n(&published.seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void resource_sampler_read(resource_usage_t* out) {
+    uint64_t start;
+    do {
+        while ((start = __atomic_load_n(&published.seq, __ATOMIC_ACQUIRE)) & 1) {}
+        *out = published.snap;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&published.seq, __ATOMIC_RELAXED) != start);
+}
+
+uint64_t resource_sampler_generation(void) {
+    return __atomic_load_n(&published.seq, __ATOMIC_ACQUIRE) >> 1;
+}
+
+static void store_metric(resource_usage_t* u, int m, float v) {
+    switch (m) {
+        case RESOURCE_CPU: u->cpu_usage = v; break;
+        case RESOURCE_RAM: u->ram_usage = v; break;
+        case RESOURCE_GPU: u->gpu_usage = v; break;
+        case RESOURCE_IO: u->io_usage = v; break;
+    }
+}
+
+// Sample whatever is due, publish once, then sleep until the next metric is due
+#ifdef _WIN32
+static DWORD WINAPI sampler_main(LPVOID arg) {
+#else
+static void* sampler_main(void* arg) {
+#endif
+    (void)arg;
+    uint64_t due[RESOURCE_METRICS] = {0};
+    while (!sampler_stop) {
+        uint64_t now = ktime_ms();
+        uint64_t wait = UINT64_MAX;
+        int changed = 0;
+        for (int m = 0; m < RESOURCE_METRICS; ++m) {
+            if (now >= due[m]) {
+                store_metric(&staged, m, samplers[m]());
+                due[m] = now + __atomic_load_n(&periods[m], __ATOMIC_RELAXED);
+                changed = 1;
+            }
+            if (due[m] - now < wait) wait = due[m] - now;
+        }
+        if (changed) publish(&staged);
+        sampler_sleep_ms((uint32_t)wait);
+    }
+    return 0;
+}
+
+int resource_sampler_start(void) {
+#ifdef _WIN32
+    if (sampler_thread) return 0;
+#else
+    if (sampler_running) return 0;
+#endif
+    // Prime the snapshot so the first readers see real values
+    for (int m = 0; m < RESOURCE_METRICS; ++m) store_metric(&staged, m, samplers[m]());
+    publish(&staged);
+    sampler_stop = 0;
+#ifdef _WIN32
+    sampler_thread = CreateThread(NULL, 0, sampler_main, NULL, 0, NULL);
+    int failed = sampler_thread == NULL;
+#else
+    int failed = pthread_create(&sampler_thread, NULL, sampler_main, NULL) != 0;
+    sampler_running = !failed;
+#endif
+    if (failed) {
+        printf("[ResourceSampler] Failed to start sampler thread\n");
+        return -1;
+    }
+    printf("[ResourceSampler] Sampling CPU/RAM/GPU/IO every %u/%u/%u/%u ms\n",
+        periods[RESOURCE_CPU], periods[RESOURCE_RAM], periods[RESOURCE_GPU], periods[RESOURCE_IO]);
+    return 0;
+}
+
+void resource_sampler_stop(void) {
+#ifdef _WIN32
+    if (!sampler_thread) return;
+    sampler_stop = 1;
+    WaitForSingleObject(sampler_thread, INFINITE);
+    CloseHandle(sampler_thread);
+    sampler_thread = NULL;
+#else
+    if (!sampler_running) return;
+    sampler_stop = 1;
+    pthread_join(sampler_thread, NULL);
+    sampler_running = 0;
+#endif
+}
+
+// Takes effect after the metric's current period expires
+int resource_sampler_set_period(resource_metric_t metric, uint32_t period_ms) {
+    if ((int)metric < 0 || metric >= RESOURCE_METRICS || period_ms == 0) return -1;
+    __atomic_store_n(&periods[metric], period_ms, __ATOMIC_RELAXED);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef RESOURCE_SAMPLER_H
+#define RESOURCE_SAMPLER_H
+
+#include <stdint.h>
+#include "resource_manager.h"
+
+// Background sampler: a dedicated thread queries the OS for each metric on
+// its own period and publishes a resource_usage_t through a seqlock. Readers
+// never block and never trigger OS calls.
+typedef enum {
+    RESOURCE_CPU,
+    RESOURCE_RAM,
+    RESOURCE_GPU,
+    RESOURCE_IO,
+    RESOURCE_METRICS
+} resource_metric_t;
+
+#define RESOURCE_CPU_PERIOD_MS 100
+#define RESOURCE_RAM_PERIOD_MS 500
+#define RESOURCE_GPU_PERIOD_MS 2000
+#define RESOURCE_IO_PERIOD_MS 250
+
+int resource_sampler_start(void);
+void resource_sampler_stop(void);
+int resource_sampler_set_period(resource_metric_t metric, uint32_t period_ms);
+void resource_sampler_read(resource_usage_t* out); // Latest snapshot, lock-free
+uint64_t resource_sampler_generation(void); // Bumped on every publish
+
+#endif // RESOURCE_SAMPLER_H
@@ -9,9 +9,17 @@
 #include <stdlib.h>
 #include "driver_framework.h"
 #include "../../kernel64/include/modular.h"
+#include "../../kernel64/include/slab.h"
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__linux__) && defined(COWFS_IO_URING)
+#include <liburing.h>
+#endif
 
 // Internal COWFS state (real, minimal)
 typedef struct cowfs_file {
@@ -27,6 +35,7 @@ typedef struct {
 } cowfs_state_t;
 
 static cowfs_state_t g_cowfs = {0};
+static kmem_cache_t* file_cache;
 
 // Block-level deduplication using SHA-256 hashes
 #include <openssl/sha.h>
@@ -35,9 +44,277 @@ static cowfs_state_t g_cowfs = {0};
 static unsigned char block_hashes[MAX_BLOCKS][SHA256_DIGEST_LENGTH];
 static int block_count = 0;
 
+// Async I/O: adjacent requests are merged into vectored jobs and run on a
+// worker pool, or on io_uring when built with COWFS_IO_URING on Linux.
+#define COWFS_AIO_WORKERS 4
+#define COWFS_AIO_MAX_MERGE 64
+
+typedef struct cowfs_aio_job {
+    fs_io_ctx_t* ctx;
+    fs_io_op_t op;
+    char path[256];
+    uint64_t offset;
+    int fd;
+    int nreq;
+    struct iovec iov[COWFS_AIO_MAX_MERGE];
+    uint64_t user_data[COWFS_AIO_MAX_MERGE];
+    struct cowfs_aio_job* next;
+} cowfs_aio_job_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    cowfs_aio_job_t* head;
+    cowfs_aio_job_t* tail;
+    pthread_t workers[COWFS_AIO_WORKERS];
+    int started;
+    int shutdown;
+#if defined(__linux__) && defined(COWFS_IO_URING)
+    struct io_uring ring;
+    pthread_mutex_t ring_lock;
+    pthread_t reaper;
+    int uring_ready;
+    int uring_inflight;     // Jobs handed to the ring and not yet finished
+#endif
+} g_aio = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+// Jobs are freed on worker and reaper threads; the cache's per-CPU
+// magazines keep that off the submitter's lock
+static kmem_cache_t* job_cache;
+
+// Hand each merged request its share of the transferred bytes
+static void cowfs_aio_finish(cowfs_aio_job_t* job, long res) {
+    if (res < 0 || job->op == FS_IO_FSYNC) {
+        for (int i = 0; i < job->nreq; ++i) fs_io_complete(job->ctx, job->user_data[i], (int)res);
+    } else {
+        size_t remaining = (size_t)res;
+        for (int i = 0; i < job->nreq; ++i) {
+            size_t give = job->iov[i].iov_len < remaining ? job->iov[i].iov_len : remaining;
+            fs_io_complete(job->ctx, job->user_data[i], (int)give);
+            remaining -= give;
+        }
+    }
+    if (job->fd >= 0) close(job->fd);
+    kmem_cache_free(job_cache, job);
+}
+
+static int cowfs_aio_open(cowfs_aio_job_t* job) {
+    int flags = job->op == FS_IO_READ ? O_RDONLY : (job->op == FS_IO_WRITE ? O_RDWR | O_CREAT : O_RDWR);
+    job->fd = open(job->path, flags, 0644);
+    return job->fd;
+}
+
+static void cowfs_aio_run(cowfs_aio_job_t* job) {
+    long res = -1;
+    if (cowfs_aio_open(job) >= 0) {
+        switch (job->op) {
+            case FS_IO_READ: res = preadv(job->fd, job->iov, job->nreq, (off_t)job->offset); break;
+            case FS_IO_WRITE: res = pwritev(job->fd, job->iov, job->nreq, (off_t)job->offset); break;
+            case FS_IO_FSYNC: res = fsync(job->fd); break;
+        }
+    }
+    cowfs_aio_finish(job, res);
+}
+
+static void* cowfs_aio_worker(void* arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&g_aio.lock);
+        while (!g_aio.head && !g_aio.shutdown) pthread_cond_wait(&g_aio.cond, &g_aio.lock);
+        cowfs_aio_job_t* job = g_aio.head;
+        if (job) {
+            g_aio.head = job->next;
+            if (!g_aio.head) g_aio.tail = NULL;
+        }
+        pthread_mutex_unlock(&g_aio.lock);
+        if (!job) return NULL; // Shutdown with an empty queue
+        cowfs_aio_run(job);
+    }
+}
+
+#if defined(__linux__) && defined(COWFS_IO_URING)
+// Completions can arrive out of order, so the shutdown NOP may overtake
+// jobs still in flight; the reaper only exits once those are finished too
+static void* cowfs_aio_reaper(void* arg) {
+    (void)arg;
+    int stopping = 0;
+    for (;;) {
+        if (stopping && __atomic_load_n(&g_aio.uring_inflight, __ATOMIC_ACQUIRE) == 0) return NULL;
+        struct io_uring_cqe* cqe;
+        if (io_uring_wait_cqe(&g_aio.ring, &cqe) != 0) continue;
+        cowfs_aio_job_t* job = (cowfs_aio_job_t*)io_uring_cqe_get_data(cqe);
+        long res = cqe->res;
+        io_uring_cqe_seen(&g_aio.ring, cqe);
+        if (!job) { stopping = 1; continue; } // Shutdown marker (NOP with NULL data)
+        cowfs_aio_finish(job, res);
+        __atomic_sub_fetch(&g_aio.uring_inflight, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static int cowfs_aio_uring_push(cowfs_aio_job_t* job) {
+    if (cowfs_aio_open(job) < 0) { cowfs_aio_finish(job, -1); return 0; }
+    pthread_mutex_lock(&g_aio.ring_lock);
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&g_aio.ring);
+    if (!sqe) {
+        io_uring_submit(&g_aio.ring);
+        sqe = io_uring_get_sqe(&g_aio.ring);
+    }
+    if (!sqe) {
+        // Ring full: the job goes to the workers, which open the file themselves
+        pthread_mutex_unlock(&g_aio.ring_lock);
+        close(job->fd);
+        job->fd = -1;
+        return -1;
+    }
+    switch (job->op) {
+        case FS_IO_READ: io_uring_prep_readv(sqe, job->fd, job->iov, job->nreq, job->offset); break;
+        case FS_IO_WRITE: io_uring_prep_writev(sqe, job->fd, job->iov, job->nreq, job->offset); break;
+        case FS_IO_FSYNC: io_uring_prep_fsync(sqe, job->fd, 0); break;
+    }
+    io_uring_sqe_set_data(sqe, job);
+    __atomic_add_fetch(&g_aio.uring_inflight, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_aio.ring_lock);
+    return 0;
+}
+#endif
+
+static void cowfs_aio_start(void) {
+    pthread_mutex_lock(&g_aio.lock);
+    if (g_aio.started) { pthread_mutex_unlock(&g_aio.lock); return; }
+    g_aio.shutdown = 0;
+    if (!job_cache) job_cache = kmem_cache_create("cowfs_aio_job", sizeof(cowfs_aio_job_t), 0, NULL);
+#if defined(__linux__) && defined(COWFS_IO_URING)
+    // io_uring may be missing or disabled on the host kernel; fall back to workers then
+    if (io_uring_queue_init(FS_IO_MAX_DEPTH, &g_aio.ring, 0) == 0) {
+        pthread_mutex_init(&g_aio.ring_lock, NULL);
+        g_aio.uring_ready = pthread_create(&g_aio.reaper, NULL, cowfs_aio_reaper, NULL) == 0;
+        if (!g_aio.uring_ready) io_uring_queue_exit(&g_aio.ring);
+    }
+#endif
+    for (int i = 0; i < COWFS_AIO_WORKERS; ++i) pthread_create(&g_aio.workers[i], NULL, cowfs_aio_worker, NULL);
+    g_aio.started = 1;
+    pthread_mutex_unlock(&g_aio.lock);
+    printf("[COWFS] Async I/O started (%d workers%s)\n", COWFS_AIO_WORKERS,
+#if defined(__linux__) && defined(COWFS_IO_URING)
+        g_aio.uring_ready ? ", io_uring" : ""
+#else
+        ""
+#endif
+    );
+}
+
+static void cowfs_aio_stop(void) {
+    pthread_mutex_lock(&g_aio.lock);
+    if (!g_aio.started) { pthread_mutex_unlock(&g_aio.lock); return; }
+    g_aio.shutdown = 1;
+    pthread_cond_broadcast(&g_aio.cond);
+    pthread_mutex_unlock(&g_aio.lock);
+    for (int i = 0; i < COWFS_AIO_WORKERS; ++i) pthread_join(g_aio.workers[i], NULL);
+#if defined(__linux__) && defined(COWFS_IO_URING)
+    if (g_aio.uring_ready) {
+        pthread_mutex_lock(&g_aio.ring_lock);
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&g_aio.ring);
+        if (!sqe) {
+            io_uring_submit(&g_aio.ring);
+            sqe = io_uring_get_sqe(&g_aio.ring);
+        }
+        if (sqe) { io_uring_prep_nop(sqe); io_uring_sqe_set_data(sqe, NULL); }
+        io_uring_submit(&g_aio.ring);
+        pthread_mutex_unlock(&g_aio.ring_lock);
+        pthread_join(g_aio.reaper, NULL);
+        io_uring_queue_exit(&g_aio.ring);
+        g_aio.uring_ready = 0;
+    }
+#endif
+    g_aio.started = 0;
+}
+
+static int cowfs_aio_cmp(const void* a, const void* b) {
+    const fs_io_request_t* x = *(const fs_io_request_t* const*)a;
+    const fs_io_request_t* y = *(const fs_io_request_t* const*)b;
+    int c = strcmp(x->path, y->path);
+    if (c) return c;
+    if (x->op != y->op) return (int)x->op - (int)y->op;
+    return x->offset < y->offset ? -1 : (x->offset > y->offset);
+}
+
+static void cowfs_aio_dispatch(cowfs_aio_job_t* job) {
+#if defined(__linux__) && defined(COWFS_IO_URING)
+    if (g_aio.uring_ready && cowfs_aio_uring_push(job) == 0) return;
+#endif
+    pthread_mutex_lock(&g_aio.lock);
+    job->next = NULL;
+    if (g_aio.tail) g_aio.tail->next = job; else g_aio.head = job;
+    g_aio.tail = job;
+    pthread_cond_signal(&g_aio.cond);
+    pthread_mutex_unlock(&g_aio.lock);
+}
+
+// Sort the batch by (path, op, offset) and merge back-to-back reads/writes
+// into single preadv/pwritev jobs
+static int cowfs_submit(fs_io_ctx_t* ctx, const fs_io_request_t* reqs, int count) {
+    if (!ctx || !reqs || count <= 0) return -1;
+    cowfs_aio_start();
+    const fs_io_request_t** order = (const fs_io_request_t**)malloc(count * sizeof(*order));
+    if (!order) return -1;
+    for (int i = 0; i < count; ++i) order[i] = &reqs[i];
+    qsort(order, count, sizeof(*order), cowfs_aio_cmp);
+    cowfs_aio_job_t* job = NULL;
+    for (int i = 0; i < count; ++i) {
+        const fs_io_request_t* r = order[i];
+        if (!r->path || strlen(r->path) >= sizeof(job->path)) {
+            fs_io_complete(ctx, r->user_data, -1);
+            continue;
+        }
+        int mergeable = job && r->op != FS_IO_FSYNC && job->op == r->op &&
+            job->nreq < COWFS_AIO_MAX_MERGE && strcmp(job->path, r->path) == 0;
+        if (mergeable) {
+            uint64_t end = job->offset;
+            for (int k = 0; k < job->nreq; ++k) end += job->iov[k].iov_len;
+            mergeable = end == r->offset;
+        }
+        if (!mergeable) {
+            if (job) cowfs_aio_dispatch(job);
+            job = (cowfs_aio_job_t*)kmem_cache_zalloc(job_cache);
+            if (!job) {
+                for (int k = i; k < count; ++k) fs_io_complete(ctx, order[k]->user_data, -1);
+                break;
+            }
+            job->ctx = ctx;
+            job->op = r->op;
+            job->fd = -1;
+            job->offset = r->offset;
+            strcpy(job->path, r->path);
+        }
+        job->iov[job->nreq].iov_base = r->buf;
+        job->iov[job->nreq].iov_len = r->op == FS_IO_FSYNC ? 0 : r->len;
+        job->user_data[job->nreq] = r->user_data;
+        job->nreq++;
+    }
+    if (job) cowfs_aio_dispatch(job);
+#if defined(__linux__) && defined(COWFS_IO_URING)
+    if (g_aio.uring_ready) {
+        pthread_mutex_lock(&g_aio.ring_lock);
+        io_uring_submit(&g_aio.ring);
+        pthread_mutex_unlock(&g_aio.ring_lock);
+    }
+#endif
+    free(order);
+    return 0;
+}
+
+static int cowfs_fsync(const char* path) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return -1;
+    int r = fsync(fd);
+    close(fd);
+    return r;
+}
+
 static int cowfs_mount(const char* device, const char* mountpoint) {
     g_cowfs.mountpoint = mountpoint;
     g_cowfs.files = NULL;
+    if (!file_cache) file_cache = kmem_cache_create("cowfs_file", sizeof(cowfs_file_t), 0, NULL);
     printf("[COWFS] Mounted at %s (device: %s)\n", mountpoint, device);
     return 0;
 }
@@ -47,10 +324,11 @@ static int cowfs_unmount(const char* mountpoint) {
     while (f) {
         if (f->fp) fclose(f->fp);
         cowfs_file_t* next = f->next;
-        free(f);
+        kmem_cache_free(file_cache, f);
         f = next;
     }
     g_cowfs.files = NULL;
+    cowfs_aio_stop();
     printf("[COWFS] Unmounted from %s\n", mountpoint);
     return 0;
 }
@@ -197,7 +475,9 @@ static fs_ops_t cowfs_ops = {
     .encrypt = cowfs_encrypt,
     .decrypt = cowfs_decrypt,
     .backup = cowfs_backup,
-    .restore_backup = cowfs_restore_backup
+    .restore_backup = cowfs_restore_backup,
+    .fsync = cowfs_fsync,
+    .submit = cowfs_submit
 };
 
 static fs_module_t cowfs_module = {
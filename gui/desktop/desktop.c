@@ -3,12 +3,15 @@
 #include "../widgets/ai_orb.h"
 #include "../widgets/dna_link.h"
 #include "../widgets/quantum_timeline.h"
+#include "../widgets/collab_bubble.h"
 #include "../widgets/agent.h"
 #include "../widgets/spatial.h"
 #include "../widgets/swarm_collab.h"
 #include "../widgets/self_heal.h"
 #include "../widgets/dna_market.h"
+#include "../../kernel64/include/arena.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 void desktop_demo_orbs() {
     orb_widget_t* launcher_orb = orb_create(100, 600, 40, 0x00BFFF, "Launcher");
@@ -25,7 +28,7 @@ void desktop_demo_orbs() {
     orb_set_label(ai_orb, "Companion");
     orb_render(ai_orb);
     // Free orbs
-    free(launcher_orb); free(notify_orb); free(ai_orb);
+    orb_destroy(launcher_orb); orb_destroy(notify_orb); orb_destroy(ai_orb);
 }
 
 void desktop_demo_orbs_and_streams() {
@@ -43,10 +46,11 @@ void desktop_demo_orbs_and_streams() {
     orb_render(notify_orb);
     orb_set_label(ai_orb, "Companion");
     orb_render(ai_orb);
-    // Info Streams
-    infostream_widget_t* cpu_stream = infostream_create(0, 0, 400, 6, INFOSTREAM_ORIENT_TOP, 0x00FF00, "CPU");
-    infostream_widget_t* net_stream = infostream_create(0, 794, 400, 6, INFOSTREAM_ORIENT_BOTTOM, 0x00BFFF, "NET");
-    infostream_widget_t* notif_stream = infostream_create(1274, 0, 6, 800, INFOSTREAM_ORIENT_RIGHT, 0xFF8800, "NOTIF");
+    // Info Streams, released together with their arena
+    arena_t* stream_arena = arena_create(0);
+    infostream_widget_t* cpu_stream = infostream_create_in(stream_arena, 0, 0, 400, 6, INFOSTREAM_ORIENT_TOP, 0x00FF00, "CPU");
+    infostream_widget_t* net_stream = infostream_create_in(stream_arena, 0, 794, 400, 6, INFOSTREAM_ORIENT_BOTTOM, 0x00BFFF, "NET");
+    infostream_widget_t* notif_stream = infostream_create_in(stream_arena, 1274, 0, 6, 800, INFOSTREAM_ORIENT_RIGHT, 0xFF8800, "NOTIF");
     infostream_set_data(cpu_stream, "CPU: 12% | Temp: 42C");
     infostream_set_data(net_stream, "NET: 1.2MB/s up | 3.4MB/s down");
     infostream_set_data(notif_stream, "3 new notifications");
@@ -57,8 +61,8 @@ void desktop_demo_orbs_and_streams() {
     infostream_render(net_stream);
     infostream_render(notif_stream);
     // Free
-    free(launcher_orb); free(notify_orb); free(ai_orb);
-    free(cpu_stream); free(net_stream); free(notif_stream);
+    orb_destroy(launcher_orb); orb_destroy(notify_orb); orb_destroy(ai_orb);
+    arena_release(stream_arena);
 }
 
 void desktop_demo_futuristic_suite() {
@@ -76,10 +80,11 @@ void desktop_demo_futuristic_suite() {
     orb_render(notify_orb);
     orb_set_label(ai_orb_legacy, "Companion");
     orb_render(ai_orb_legacy);
-    // Info Streams
-    infostream_widget_t* cpu_stream = infostream_create(0, 0, 400, 6, INFOSTREAM_ORIENT_TOP, 0x00FF00, "CPU");
-    infostream_widget_t* net_stream = infostream_create(0, 794, 400, 6, INFOSTREAM_ORIENT_BOTTOM, 0x00BFFF, "NET");
-    infostream_widget_t* notif_stream = infostream_create(1274, 0, 6, 800, INFOSTREAM_ORIENT_RIGHT, 0xFF8800, "NOTIF");
+    // Info Streams, released together with their arena
+    arena_t* stream_arena = arena_create(0);
+    infostream_widget_t* cpu_stream = infostream_create_in(stream_arena, 0, 0, 400, 6, INFOSTREAM_ORIENT_TOP, 0x00FF00, "CPU");
+    infostream_widget_t* net_stream = infostream_create_in(stream_arena, 0, 794, 400, 6, INFOSTREAM_ORIENT_BOTTOM, 0x00BFFF, "NET");
+    infostream_widget_t* notif_stream = infostream_create_in(stream_arena, 1274, 0, 6, 800, INFOSTREAM_ORIENT_RIGHT, 0xFF8800, "NOTIF");
     infostream_set_data(cpu_stream, "CPU: 12% | Temp: 42C");
     infostream_set_data(net_stream, "NET: 1.2MB/s up | 3.4MB/s down");
     infostream_set_data(notif_stream, "3 new notifications");
@@ -196,10 +201,11 @@ void desktop_demo_futuristic_suite() {
     int id4 = dna_market_merge(&market, id1, id3, "Editor+Cloud Hybrid");
     dna_market_render(&market);
     // Free
-    free(launcher_orb); free(notify_orb); free(ai_orb_legacy);
-    free(cpu_stream); free(net_stream); free(notif_stream);
-    free((void*)ai_orb->label); free((void*)ai_orb->suggestion); free(ai_orb);
-    free((void*)link->label); free(link);
-    free(bubble);
-    free(timeline);
+    orb_destroy(launcher_orb); orb_destroy(notify_orb); orb_destroy(ai_orb_legacy);
+    arena_release(stream_arena);
+    ai_orb_destroy(ai_orb);
+    dna_link_destroy(link);
+    agent_manager_destroy(&agent_mgr);
+    collab_bubble_destroy(bubble);
+    quantum_timeline_destroy(timeline);
 } 
\ No newline at end of file
@@ -8,6 +8,11 @@ void agent_manager_init(agent_manager_t* mgr) {
     memset(mgr->agents, 0, sizeof(mgr->agents));
 }
 
+void agent_manager_destroy(agent_manager_t* mgr) {
+    for (int i = 0; i < mgr->agent_count; ++i) free((void*)mgr->agents[i].goal);
+    agent_manager_init(mgr);
+}
+
 agent_t* agent_create(agent_manager_t* mgr, agent_type_t type, const char* goal, int x, int y, unsigned int color) {
     if (mgr->agent_count < MAX_AGENTS) {
         agent_t* a = &mgr->agents[mgr->agent_count];
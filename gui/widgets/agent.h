@@ -35,6 +35,7 @@ typedef struct agent_manager {
 } agent_manager_t;
 
 void agent_manager_init(agent_manager_t* mgr);
+void agent_manager_destroy(agent_manager_t* mgr); // Frees the agents' goals
 agent_t* agent_create(agent_manager_t* mgr, agent_type_t type, const char* goal, int x, int y, unsigned int color);
 void agent_manager_tick(agent_manager_t* mgr);
 void agent_render(const agent_t* agent); 
\ No newline at end of file
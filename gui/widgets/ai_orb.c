@@ -5,6 +5,7 @@
 
 ai_orb_widget_t* ai_orb_create(int x, int y, int radius, unsigned int color, const char* label) {
     ai_orb_widget_t* orb = (ai_orb_widget_t*)malloc(sizeof(ai_orb_widget_t));
+    if (!orb) return NULL;
     orb->x = x; orb->y = y; orb->radius = radius;
     orb->color = color;
     orb->state = AI_ORB_STATE_IDLE;
@@ -18,6 +19,13 @@ ai_orb_widget_t* ai_orb_create(int x, int y, int radius, unsigned int color, con
     return orb;
 }
 
+void ai_orb_destroy(ai_orb_widget_t* orb) {
+    if (!orb) return;
+    free((void*)orb->label);
+    free((void*)orb->suggestion);
+    free(orb);
+}
+
 void ai_orb_render(const ai_orb_widget_t* orb) {
     const char* state_str = "?";
     switch (orb->state) {
@@ -24,6 +24,7 @@ typedef struct ai_orb_widget {
 } ai_orb_widget_t;
 
 ai_orb_widget_t* ai_orb_create(int x, int y, int radius, unsigned int color, const char* label);
+void ai_orb_destroy(ai_orb_widget_t* orb);
 void ai_orb_render(const ai_orb_widget_t* orb);
 void ai_orb_set_state(ai_orb_widget_t* orb, ai_orb_state_t state);
 void ai_orb_listen(ai_orb_widget_t* orb, bool enable);
@@ -9,6 +9,7 @@ button_widget_t* button_create(int x, int y, int w, int h, const char* label, vo
 
 button_widget_t* button_create_a11y(int x, int y, int w, int h, const char* label, void (*on_click)(void*), void* user_data, const char* a11y) {
     button_widget_t* btn = (button_widget_t*)malloc(sizeof(button_widget_t));
+    if (!btn) return NULL;
     btn->x = x; btn->y = y; btn->width = w; btn->height = h;
     btn->label = strdup(label);
     btn->on_click = on_click;
@@ -19,6 +20,13 @@ button_widget_t* button_create_a11y(int x, int y, int w, int h, const char* labe
     return btn;
 }
 
+void button_destroy(button_widget_t* btn) {
+    if (!btn) return;
+    free((void*)btn->label);
+    free((void*)btn->accessibility_label);
+    free(btn);
+}
+
 static int high_contrast_mode = 0;
 void button_set_high_contrast(int enabled) { high_contrast_mode = enabled; }
 
@@ -13,6 +13,7 @@ typedef struct button_widget {
 
 button_widget_t* button_create(int x, int y, int w, int h, const char* label, void (*on_click)(void*), void* user_data);
 button_widget_t* button_create_a11y(int x, int y, int w, int h, const char* label, void (*on_click)(void*), void* user_data, const char* a11y);
+void button_destroy(button_widget_t* btn);
 void button_render(const button_widget_t* btn);
 void button_handle_click(button_widget_t* btn, int mouse_x, int mouse_y);
 void button_set_high_contrast(int enabled); 
\ No newline at end of file
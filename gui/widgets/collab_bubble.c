@@ -2,17 +2,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../kernel64/include/slab.h"
+
+static kmem_cache_t* bubble_cache;
 
 collab_bubble_t* collab_bubble_create(int window_id) {
-    collab_bubble_t* b = (collab_bubble_t*)malloc(sizeof(collab_bubble_t));
+    if (!bubble_cache) bubble_cache = kmem_cache_create("collab_bubble", sizeof(collab_bubble_t), 0, NULL);
+    collab_bubble_t* b = (collab_bubble_t*)kmem_cache_zalloc(bubble_cache);
+    if (!b) return NULL;
     b->window_id = window_id;
     b->state = COLLAB_BUBBLE_STATE_IDLE;
-    b->user_count = 0;
-    b->annotation[0] = '\0';
-    memset(b->users, 0, sizeof(b->users));
     return b;
 }
 
+void collab_bubble_destroy(collab_bubble_t* bubble) {
+    kmem_cache_free(bubble_cache, bubble);
+}
+
 void collab_bubble_render(const collab_bubble_t* bubble) {
     const char* state_str = "?";
     switch (bubble->state) {
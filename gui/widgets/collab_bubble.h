@@ -25,6 +25,7 @@ typedef struct collab_bubble {
 } collab_bubble_t;
 
 collab_bubble_t* collab_bubble_create(int window_id);
+void collab_bubble_destroy(collab_bubble_t* bubble);
 void collab_bubble_render(const collab_bubble_t* bubble);
 void collab_bubble_add_user(collab_bubble_t* bubble, int user_id, const char* name);
 void collab_bubble_remove_user(collab_bubble_t* bubble, int user_id);
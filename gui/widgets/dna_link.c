@@ -5,6 +5,7 @@
 
 dna_link_t* dna_link_create(int source_id, int target_id, dna_link_type_t type, const char* label) {
     dna_link_t* link = (dna_link_t*)malloc(sizeof(dna_link_t));
+    if (!link) return NULL;
     link->source_window_id = source_id;
     link->target_window_id = target_id;
     link->type = type;
@@ -15,6 +16,12 @@ dna_link_t* dna_link_create(int source_id, int target_id, dna_link_type_t type,
     return link;
 }
 
+void dna_link_destroy(dna_link_t* link) {
+    if (!link) return;
+    free((void*)link->label);
+    free(link);
+}
+
 void dna_link_render(const dna_link_t* link) {
     const char* type_str = "?";
     switch (link->type) {
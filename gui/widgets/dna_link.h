@@ -24,6 +24,7 @@ typedef struct dna_link {
 } dna_link_t;
 
 dna_link_t* dna_link_create(int source_id, int target_id, dna_link_type_t type, const char* label);
+void dna_link_destroy(dna_link_t* link);
 void dna_link_render(const dna_link_t* link);
 void dna_link_attach(dna_link_t* link);
 void dna_link_detach(dna_link_t* link);
@@ -2,14 +2,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../kernel64/include/arena.h"
 
 infostream_widget_t* infostream_create(int x, int y, int length, int thickness, infostream_orientation_t orientation, unsigned int color, const char* label) {
-    infostream_widget_t* s = (infostream_widget_t*)malloc(sizeof(infostream_widget_t));
+    return infostream_create_in(NULL, x, y, length, thickness, orientation, color, label);
+}
+
+// With an arena the widget itself lives there too and goes away with it
+infostream_widget_t* infostream_create_in(arena_t* arena, int x, int y, int length, int thickness, infostream_orientation_t orientation, unsigned int color, const char* label) {
+    infostream_widget_t* s = (infostream_widget_t*)arena_alloc(arena, sizeof(infostream_widget_t));
+    if (!s) return NULL;
+    s->arena = arena;
     s->x = x; s->y = y; s->length = length; s->thickness = thickness;
     s->orientation = orientation;
     s->color = color;
-    s->label = label ? strdup(label) : NULL;
+    s->label = arena_strdup(arena, label);
     s->data = NULL;
+    s->data_cap = 0;
     s->animating = false;
     s->anim_phase = 0.0f;
     return s;
@@ -28,9 +37,29 @@ void infostream_render(const infostream_widget_t* stream) {
         stream->label ? stream->label : "", stream->data ? stream->data : "");
 }
 
+void infostream_destroy(infostream_widget_t* stream) {
+    if (!stream || stream->arena) return;
+    free((void*)stream->label);
+    free((void*)stream->data);
+    free(stream);
+}
+
 void infostream_set_data(infostream_widget_t* stream, const char* data) {
-    if (stream->data) free((void*)stream->data);
-    stream->data = data ? strdup(data) : NULL;
+    if (!data) {
+        if (stream->data) ((char*)stream->data)[0] = '\0';
+        return;
+    }
+    size_t len = strlen(data) + 1;
+    if (len > stream->data_cap) {
+        // Grow geometrically so a live stream settles on one buffer
+        size_t cap = stream->data_cap * 2 > len ? stream->data_cap * 2 : len;
+        char* buf = (char*)arena_alloc(stream->arena, cap);
+        if (!buf) return;
+        if (!stream->arena) free((void*)stream->data);
+        stream->data = buf;
+        stream->data_cap = cap;
+    }
+    memcpy((char*)stream->data, data, len);
 }
 
 void infostream_animate(infostream_widget_t* stream, float phase) {
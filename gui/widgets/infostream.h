@@ -1,5 +1,7 @@
 #pragma once
 #include <stdbool.h>
+#include <stddef.h>
+#include "../../kernel64/include/arena.h"
 
 typedef enum {
     INFOSTREAM_ORIENT_TOP,
@@ -14,11 +16,15 @@ typedef struct infostream_widget {
     unsigned int color;
     const char* label;
     const char* data;
+    size_t data_cap;      // Bytes available at data; updates that fit are copied in place
+    arena_t* arena;       // Owns label and data; NULL when they are on the heap
     bool animating;
     float anim_phase;
 } infostream_widget_t;
 
 infostream_widget_t* infostream_create(int x, int y, int length, int thickness, infostream_orientation_t orientation, unsigned int color, const char* label);
+infostream_widget_t* infostream_create_in(arena_t* arena, int x, int y, int length, int thickness, infostream_orientation_t orientation, unsigned int color, const char* label);
+void infostream_destroy(infostream_widget_t* stream);
 void infostream_render(const infostream_widget_t* stream);
 void infostream_set_data(infostream_widget_t* stream, const char* data);
 void infostream_animate(infostream_widget_t* stream, float phase); 
\ No newline at end of file
@@ -2,20 +2,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../kernel64/include/slab.h"
+#include "../../kernel64/include/arena.h"
+
+static kmem_cache_t* label_cache;
 
 label_widget_t* label_create(int x, int y, const char* text) {
     return label_create_a11y(x, y, text, text);
 }
 
 label_widget_t* label_create_a11y(int x, int y, const char* text, const char* a11y) {
-    label_widget_t* lbl = (label_widget_t*)malloc(sizeof(label_widget_t));
+    return label_create_in(NULL, x, y, text, a11y);
+}
+
+label_widget_t* label_create_in(arena_t* arena, int x, int y, const char* text, const char* a11y) {
+    if (!label_cache) label_cache = kmem_cache_create("label_widget", sizeof(label_widget_t), 0, NULL);
+    label_widget_t* lbl = (label_widget_t*)kmem_cache_alloc(label_cache);
+    if (!lbl) return NULL;
     lbl->x = x; lbl->y = y;
-    lbl->text = strdup(text);
+    lbl->arena = arena;
+    lbl->text = arena_strdup(arena, text);
     lbl->focused = 0;
-    lbl->accessibility_label = a11y ? strdup(a11y) : NULL;
+    // Arena strings are never freed one by one, so an identical a11y label can share
+    if (!a11y) lbl->accessibility_label = NULL;
+    else if (arena && a11y == text) lbl->accessibility_label = lbl->text;
+    else lbl->accessibility_label = arena_strdup(arena, a11y);
     return lbl;
 }
 
+void label_destroy(label_widget_t* lbl) {
+    if (!lbl) return;
+    if (!lbl->arena) {
+        free((void*)lbl->text);
+        free((void*)lbl->accessibility_label);
+    }
+    kmem_cache_free(label_cache, lbl);
+}
+
 static int high_contrast_mode = 0;
 void label_set_high_contrast(int enabled) { high_contrast_mode = enabled; }
 
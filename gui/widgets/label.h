@@ -1,13 +1,17 @@
 #pragma once
+#include "../../kernel64/include/arena.h"
 
 typedef struct label_widget {
     int x, y;
     const char* text;
     int focused;
     const char* accessibility_label;
+    arena_t* arena; // Owns the strings; NULL when they are on the heap
 } label_widget_t;
 
 label_widget_t* label_create(int x, int y, const char* text);
 label_widget_t* label_create_a11y(int x, int y, const char* text, const char* a11y);
+label_widget_t* label_create_in(arena_t* arena, int x, int y, const char* text, const char* a11y);
+void label_destroy(label_widget_t* lbl);
 void label_render(const label_widget_t* lbl);
 void label_set_high_contrast(int enabled); 
\ No newline at end of file
@@ -2,32 +2,69 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../kernel64/include/slab.h"
+#include "../../kernel64/include/arena.h"
 
 static int high_contrast_mode = 0;
+static kmem_cache_t* list_cache;
 void list_set_high_contrast(int enabled) { high_contrast_mode = enabled; }
 
+// Cached lists keep their item arrays cleared; list_destroy puts them back that way
+static void list_ctor(void* obj) {
+    list_widget_t* list = (list_widget_t*)obj;
+    memset(list->items, 0, sizeof(list->items));
+    memset(list->icons, 0, sizeof(list->icons));
+    memset(list->colors, 0, sizeof(list->colors));
+}
+
 list_widget_t* list_create(int x, int y, int w, int h) {
     return list_create_a11y(x, y, w, h, "List");
 }
 
 list_widget_t* list_create_a11y(int x, int y, int w, int h, const char* a11y) {
-    list_widget_t* list = (list_widget_t*)malloc(sizeof(list_widget_t));
+    return list_create_in(NULL, x, y, w, h, a11y);
+}
+
+list_widget_t* list_create_in(arena_t* arena, int x, int y, int w, int h, const char* a11y) {
+    if (!list_cache) list_cache = kmem_cache_create("list_widget", sizeof(list_widget_t), 0, list_ctor);
+    list_widget_t* list = (list_widget_t*)kmem_cache_alloc(list_cache);
+    if (!list) return NULL;
     list->x = x; list->y = y; list->width = w; list->height = h;
     list->item_count = 0;
     list->selected_index = -1;
     list->focused = 0;
-    list->accessibility_label = a11y ? strdup(a11y) : NULL;
-    memset(list->items, 0, sizeof(list->items));
-    memset(list->icons, 0, sizeof(list->icons));
-    memset(list->colors, 0, sizeof(list->colors));
+    list->arena = arena;
+    list->item_arena = arena ? arena_create_child(arena, 0) : NULL;
+    list->accessibility_label = arena_strdup(arena, a11y);
     return list;
 }
 
+void list_clear(list_widget_t* list) {
+    for (int i = 0; i < list->item_count; ++i) {
+        if (!list->item_arena) {
+            free((void*)list->items[i]);
+            free((void*)list->icons[i]);
+            free((void*)list->colors[i]);
+        }
+        list->items[i] = list->icons[i] = list->colors[i] = NULL;
+    }
+    arena_reset(list->item_arena);
+    list->item_count = 0;
+    list->selected_index = -1;
+}
+
+void list_destroy(list_widget_t* list) {
+    if (!list) return;
+    list_clear(list);
+    if (!list->arena) free((void*)list->accessibility_label);
+    kmem_cache_free(list_cache, list);
+}
+
 void list_add_item(list_widget_t* list, const char* item, const char* icon, const char* color) {
     if (list->item_count < MAX_LIST_ITEMS) {
-        list->items[list->item_count] = strdup(item);
-        list->icons[list->item_count] = icon ? strdup(icon) : NULL;
-        list->colors[list->item_count] = color ? strdup(color) : NULL;
+        list->items[list->item_count] = arena_strdup(list->item_arena, item);
+        list->icons[list->item_count] = arena_strdup(list->item_arena, icon);
+        list->colors[list->item_count] = arena_strdup(list->item_arena, color);
         list->item_count++;
     }
 }
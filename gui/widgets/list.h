@@ -1,4 +1,5 @@
 #pragma once
+#include "../../kernel64/include/arena.h"
 
 #define MAX_LIST_ITEMS 64
 
@@ -11,9 +12,14 @@ typedef struct list_widget {
     int selected_index;
     int focused;
     const char* accessibility_label;
+    arena_t* arena;       // Owns the label; NULL when strings are on the heap
+    arena_t* item_arena;  // Child of arena holding the items, reset by list_clear
 } list_widget_t;
 
 list_widget_t* list_create(int x, int y, int w, int h);
+void list_destroy(list_widget_t* list);
+list_widget_t* list_create_in(arena_t* arena, int x, int y, int w, int h, const char* a11y);
+void list_clear(list_widget_t* list);
 void list_add_item(list_widget_t* list, const char* item, const char* icon, const char* color);
 void list_render(const list_widget_t* list);
 void list_select_next(list_widget_t* list);
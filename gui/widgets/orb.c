@@ -2,9 +2,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../kernel64/include/slab.h"
+
+static kmem_cache_t* orb_cache;
 
 orb_widget_t* orb_create(int x, int y, int radius, unsigned int color, const char* label) {
-    orb_widget_t* orb = (orb_widget_t*)malloc(sizeof(orb_widget_t));
+    if (!orb_cache) orb_cache = kmem_cache_create("orb_widget", sizeof(orb_widget_t), 0, NULL);
+    orb_widget_t* orb = (orb_widget_t*)kmem_cache_alloc(orb_cache);
+    if (!orb) return NULL;
     orb->x = x; orb->y = y; orb->radius = radius;
     orb->color = color;
     orb->state = ORB_STATE_IDLE;
@@ -17,6 +22,12 @@ orb_widget_t* orb_create(int x, int y, int radius, unsigned int color, const cha
     return orb;
 }
 
+void orb_destroy(orb_widget_t* orb) {
+    if (!orb) return;
+    free((void*)orb->label);
+    kmem_cache_free(orb_cache, orb);
+}
+
 void orb_render(const orb_widget_t* orb) {
     const char* state_str = "?";
     switch (orb->state) {
@@ -23,6 +23,7 @@ typedef struct orb_widget {
 } orb_widget_t;
 
 orb_widget_t* orb_create(int x, int y, int radius, unsigned int color, const char* label);
+void orb_destroy(orb_widget_t* orb);
 void orb_render(const orb_widget_t* orb);
 void orb_set_state(orb_widget_t* orb, orb_state_t state);
 void orb_set_action(orb_widget_t* orb, void (*on_action)(orb_widget_t*, void*), void* user_data);
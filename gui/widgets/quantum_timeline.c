@@ -2,18 +2,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../../kernel64/include/slab.h"
+
+static kmem_cache_t* timeline_cache;
 
 quantum_timeline_t* quantum_timeline_create(int window_id) {
-    quantum_timeline_t* t = (quantum_timeline_t*)malloc(sizeof(quantum_timeline_t));
+    if (!timeline_cache) timeline_cache = kmem_cache_create("quantum_timeline", sizeof(quantum_timeline_t), 0, NULL);
+    quantum_timeline_t* t = (quantum_timeline_t*)kmem_cache_zalloc(timeline_cache);
+    if (!t) return NULL;
     t->window_id = window_id;
-    t->state_count = 0;
     t->current_state = -1;
-    t->branch_count = 0;
-    memset(t->states, 0, sizeof(t->states));
-    memset(t->branches, 0, sizeof(t->branches));
     return t;
 }
 
+// Also destroys every branch taken from it
+void quantum_timeline_destroy(quantum_timeline_t* timeline) {
+    if (!timeline) return;
+    for (int b = 0; b < timeline->branch_count; ++b) quantum_timeline_destroy(timeline->branches[b]);
+    kmem_cache_free(timeline_cache, timeline);
+}
+
 void quantum_timeline_save(quantum_timeline_t* timeline, const char* label, const char* snapshot) {
     if (timeline->state_count < MAX_TIMELINE_STATES) {
         timeline_state_t* s = &timeline->states[timeline->state_count];
@@ -38,6 +46,7 @@ void quantum_timeline_rewind(quantum_timeline_t* timeline, int state_id) {
 quantum_timeline_t* quantum_timeline_branch(quantum_timeline_t* timeline, const char* label) {
     if (timeline->branch_count < MAX_TIMELINE_BRANCHES) {
         quantum_timeline_t* branch = quantum_timeline_create(timeline->window_id);
+        if (!branch) return NULL;
         char branch_label[64];
         snprintf(branch_label, sizeof(branch_label), "Branch: %s", label);
         quantum_timeline_save(branch, branch_label, "Initial branch state");
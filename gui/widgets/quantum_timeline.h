@@ -20,6 +20,7 @@ typedef struct quantum_timeline {
 } quantum_timeline_t;
 
 quantum_timeline_t* quantum_timeline_create(int window_id);
+void quantum_timeline_destroy(quantum_timeline_t* timeline);
 void quantum_timeline_save(quantum_timeline_t* timeline, const char* label, const char* snapshot);
 void quantum_timeline_rewind(quantum_timeline_t* timeline, int state_id);
 quantum_timeline_t* quantum_timeline_branch(quantum_timeline_t* timeline, const char* label);
@@ -8,6 +8,7 @@
 #include "widgets/button.h"
 #include <ctype.h>
 #include "../network/net_stack.h"
+#include "../kernel64/include/slab.h"
 #include "../security/mac.c"
 #include "../security/sandbox.c"
 
@@ -32,15 +33,21 @@ void render_notification_history(int x, int y) {
     }
 }
 
-// Helper: find window by ID
+static kmem_cache_t* window_cache;
+
+// Helper: find window by ID on the current desktop
 static window_t* find_window(window_manager_t* wm, int window_id) {
-    desktop_t* d = &wm->desktops[wm->current_desktop];
-    window_t* w = d->windows;
-    while (w) {
-        if (w->id == window_id) return w;
-        w = w->next;
-    }
-    return NULL;
+    window_t** slot = (window_t**)slot_map_get(&wm->window_map, window_id);
+    if (!slot || (*slot)->desktop != wm->current_desktop) return NULL;
+    return *slot;
+}
+
+window_t* wm_get_window(window_manager_t* wm, int window_id) {
+    return find_window(wm, window_id);
+}
+
+window_t* wm_get_focused_window(window_manager_t* wm) {
+    return find_window(wm, wm->desktops[wm->current_desktop].focused_id);
 }
 
 void wm_init(window_manager_t* wm) {
@@ -49,17 +56,26 @@ void wm_init(window_manager_t* wm) {
         wm->desktops[i].id = i;
         wm->desktops[i].windows = NULL;
         wm->desktops[i].window_count = 0;
+        wm->desktops[i].focused_id = -1;
     }
     wm->current_desktop = 0;
-    wm->next_window_id = 1;
+    slot_map_init(&wm->window_map, wm->window_ptrs, sizeof(window_t*), wm->window_dense_slot, wm->window_slots, MAX_WINDOWS);
+    if (!window_cache) window_cache = kmem_cache_create("window", sizeof(window_t), 0, NULL);
     printf("[WindowManager] Initialized with %d desktops.\n", MAX_DESKTOPS);
 }
 
 window_t* wm_create_window(window_manager_t* wm, const char* title, int x, int y, int w, int h) {
     desktop_t* d = &wm->desktops[wm->current_desktop];
     if (d->window_count >= MAX_WINDOWS_PER_DESKTOP) return NULL;
-    window_t* win = (window_t*)malloc(sizeof(window_t));
-    win->id = wm->next_window_id++;
+    window_t* win = (window_t*)kmem_cache_alloc(window_cache);
+    if (!win) return NULL;
+    win->arena = arena_create(0);
+    window_t** slot;
+    int id = win->arena ? slot_map_insert(&wm->window_map, (void**)&slot) : -1;
+    if (id < 0) { arena_release(win->arena); kmem_cache_free(window_cache, win); return NULL; }
+    *slot = win;
+    win->id = id;
+    win->desktop = wm->current_desktop;
     win->x = x; win->y = y; win->width = w; win->height = h;
     win->z_order = d->window_count;
     win->z_depth = 1.0f + 0.1f * d->window_count;
@@ -68,7 +84,9 @@ window_t* wm_create_window(window_manager_t* wm, const char* title, int x, int y
     win->visible = true;
     strncpy(win->title, title, sizeof(win->title)-1);
     win->title[sizeof(win->title)-1] = '\0';
+    win->prev = NULL;
     win->next = d->windows;
+    if (d->windows) d->windows->prev = win;
     d->windows = win;
     d->window_count++;
     printf("[WindowManager] Created window %d: '%s'\n", win->id, win->title);
@@ -76,19 +94,18 @@ window_t* wm_create_window(window_manager_t* wm, const char* title, int x, int y
 }
 
 void wm_destroy_window(window_manager_t* wm, int window_id) {
-    desktop_t* d = &wm->desktops[wm->current_desktop];
-    window_t **prev = &d->windows, *cur = d->windows;
-    while (cur) {
-        if (cur->id == window_id) {
-            *prev = cur->next;
-            free(cur);
-            d->window_count--;
-            printf("[WindowManager] Destroyed window %d\n", window_id);
-            return;
-        }
-        prev = &cur->next;
-        cur = cur->next;
-    }
+    window_t* win = find_window(wm, window_id);
+    if (!win) return;
+    desktop_t* d = &wm->desktops[win->desktop];
+    if (win->prev) win->prev->next = win->next;
+    else d->windows = win->next;
+    if (win->next) win->next->prev = win->prev;
+    if (d->focused_id == window_id) d->focused_id = -1;
+    d->window_count--;
+    slot_map_remove(&wm->window_map, window_id);
+    arena_release(win->arena);
+    kmem_cache_free(window_cache, win);
+    printf("[WindowManager] Destroyed window %d\n", window_id);
 }
 
 void wm_move_window(window_manager_t* wm, int window_id, int new_x, int new_y) {
@@ -109,9 +126,10 @@ void wm_resize_window(window_manager_t* wm, int window_id, int new_w, int new_h)
 
 void wm_focus_window(window_manager_t* wm, int window_id) {
     desktop_t* d = &wm->desktops[wm->current_desktop];
-    window_t* w = d->windows;
-    while (w) { w->focused = false; w = w->next; }
+    window_t* prev = find_window(wm, d->focused_id);
+    if (prev) prev->focused = false;
     window_t* win = find_window(wm, window_id);
+    d->focused_id = win ? window_id : -1;
     if (win) {
         win->focused = true;
         printf("[WindowManager] Focused window %d\n", window_id);
@@ -216,10 +234,11 @@ void wm_device_manager_details_action(window_manager_t* wm, list_widget_t* dev_l
 
 void wm_create_device_manager_window(window_manager_t* wm) {
     add_notification("Device Manager opened");
-    int win_id = wm_create_window(wm, "Device Manager", 150, 150, 500, 400);
+    window_t* win = wm_create_window(wm, "Device Manager", 150, 150, 500, 400);
+    arena_t* arena = win ? win->arena : NULL;
     // Widgets
-    label_widget_t* title = label_create(160, 160, "Device Manager");
-    list_widget_t* dev_list = list_create(160, 180, 480, 200);
+    label_widget_t* title = label_create_in(arena, 160, 160, "Device Manager", "Device Manager");
+    list_widget_t* dev_list = list_create_in(arena, 160, 180, 480, 200, "List");
     button_widget_t* rescan_btn = button_create(160, 390, 100, 30, "Rescan", (void (*)(void*))wm_device_manager_rescan_action, wm);
     button_widget_t* details_btn = button_create(270, 390, 100, 30, "Details", (void (*)(void*))wm_device_manager_details_action, dev_list);
     // Fill device list
@@ -265,7 +284,7 @@ void wm_create_device_manager_window(window_manager_t* wm) {
     } else {
         snprintf(details, sizeof(details), "No device selected.");
     }
-    label_widget_t* details_label = label_create(160, 390 - 40, details);
+    label_widget_t* details_label = label_create_in(arena, 160, 390 - 40, details, details);
     // Render widgets
     label_render(title);
     list_render(dev_list);
@@ -274,12 +293,15 @@ void wm_create_device_manager_window(window_manager_t* wm) {
     button_render(details_btn);
     render_notification_history(160, 430);
     // In a real UI, handle up/down key events to call list_select_next/prev and update details_label
+    label_destroy(title); list_destroy(dev_list); label_destroy(details_label);
+    button_destroy(rescan_btn); button_destroy(details_btn);
 }
 
 void wm_device_manager_event_loop(window_manager_t* wm) {
-    // Setup widgets
-    label_widget_t* title = label_create_a11y(160, 160, "Device Manager", "Device Manager Window");
-    list_widget_t* dev_list = list_create_a11y(160, 180, 480, 200, "Device List");
+    // Setup widgets; their strings live until the loop ends
+    arena_t* arena = arena_create(0);
+    label_widget_t* title = label_create_in(arena, 160, 160, "Device Manager", "Device Manager Window");
+    list_widget_t* dev_list = list_create_in(arena, 160, 180, 480, 200, "Device List");
     button_widget_t* rescan_btn = button_create_a11y(160, 390, 100, 30, "Rescan", (void (*)(void*))wm_device_manager_rescan_action, wm, "Rescan Devices (Alt+R)");
     button_widget_t* details_btn = button_create_a11y(270, 390, 100, 30, "Details", (void (*)(void*))wm_device_manager_details_action, dev_list, "Show Device Details (Alt+D)");
     void* widgets[3] = {dev_list, rescan_btn, details_btn};
@@ -324,6 +346,7 @@ void wm_device_manager_event_loop(window_manager_t* wm) {
     char details[256] = "";
     int running = 1;
     while (running) {
+        arena_mark_t frame = arena_save(arena); // Per-frame widgets are dropped at the end of the pass
         // Render
         label_render(title);
         list_render(dev_list);
@@ -333,7 +356,7 @@ void wm_device_manager_event_loop(window_manager_t* wm) {
         } else {
             snprintf(details, sizeof(details), "No device selected.");
         }
-        label_widget_t* details_label = label_create_a11y(160, 390 - 40, details, "Device Details");
+        label_widget_t* details_label = label_create_in(arena, 160, 390 - 40, details, "Device Details");
         label_render(details_label);
         button_render(rescan_btn);
         button_render(details_btn);
@@ -388,16 +411,19 @@ void wm_device_manager_event_loop(window_manager_t* wm) {
             if (details_btn->accessibility_label)
                 printf("[ScreenReader] Activated: %s\n", details_btn->accessibility_label);
         }
-        free(details_label);
+        label_destroy(details_label);
+        arena_restore(arena, frame);
     }
-    free(title); free(dev_list); free(rescan_btn); free(details_btn);
+    label_destroy(title); list_destroy(dev_list); button_destroy(rescan_btn); button_destroy(details_btn);
+    arena_release(arena);
 }
 
 void wm_create_network_manager_window(window_manager_t* wm) {
     add_notification("Network Manager opened");
-    int win_id = wm_create_window(wm, "Network Manager", 200, 200, 520, 420);
-    label_widget_t* title = label_create(210, 210, "Network Manager");
-    list_widget_t* if_list = list_create(210, 230, 480, 180);
+    window_t* win = wm_create_window(wm, "Network Manager", 200, 200, 520, 420);
+    arena_t* arena = win ? win->arena : NULL;
+    label_widget_t* title = label_create_in(arena, 210, 210, "Network Manager", "Network Manager");
+    list_widget_t* if_list = list_create_in(arena, 210, 230, 480, 180, "List");
     button_widget_t* up_btn = button_create(210, 420, 80, 30, "Up", NULL, NULL);
     button_widget_t* down_btn = button_create(300, 420, 80, 30, "Down", NULL, NULL);
     button_widget_t* config_btn = button_create(390, 420, 100, 30, "Configure", NULL, NULL);
@@ -427,11 +453,14 @@ void wm_create_network_manager_window(window_manager_t* wm) {
     button_render(dns_btn);
     render_notification_history(210, 500);
     // In a real UI, wire up button actions and handle events
+    label_destroy(title); list_destroy(if_list);
+    button_destroy(up_btn); button_destroy(down_btn); button_destroy(config_btn); button_destroy(ping_btn); button_destroy(dns_btn);
 }
 
 void wm_network_manager_event_loop(window_manager_t* wm) {
-    label_widget_t* title = label_create_a11y(210, 210, "Network Manager", "Network Manager Window");
-    list_widget_t* if_list = list_create_a11y(210, 230, 480, 180, "Network Interface List");
+    arena_t* arena = arena_create(0);
+    label_widget_t* title = label_create_in(arena, 210, 210, "Network Manager", "Network Manager Window");
+    list_widget_t* if_list = list_create_in(arena, 210, 230, 480, 180, "Network Interface List");
     button_widget_t* up_btn = button_create_a11y(210, 420, 80, 30, "Up", NULL, NULL, "Bring Interface Up (Alt+U)");
     button_widget_t* down_btn = button_create_a11y(300, 420, 80, 30, "Down", NULL, NULL, "Bring Interface Down (Alt+W)");
     button_widget_t* config_btn = button_create_a11y(390, 420, 100, 30, "Configure", NULL, NULL, "Configure Interface (Alt+C)");
@@ -466,9 +495,11 @@ void wm_network_manager_event_loop(window_manager_t* wm) {
         button_render(config_btn);
         button_render(ping_btn);
         button_render(dns_btn);
-        label_widget_t* notif_label = label_create_a11y(210, 500, notification, "Notification Banner");
+        arena_mark_t frame = arena_save(arena);
+        label_widget_t* notif_label = label_create_in(arena, 210, 500, notification, "Notification Banner");
         label_render(notif_label);
-        free(notif_label);
+        label_destroy(notif_label);
+        arena_restore(arena, frame);
         // Focus navigation: Tab/Shift+Tab, arrows, Enter/Space, shortcuts
         printf("[NetMgr UI] Tab/Shift+Tab=focus, j/k=up/down, Enter=activate, U=Up, W=Down, C=Config, P=Ping, N=DNS, q=quit: ");
         int ch = getchar();
@@ -570,14 +601,16 @@ void wm_network_manager_event_loop(window_manager_t* wm) {
                 printf("[ScreenReader] Activated: %s\n", dns_btn->accessibility_label);
         }
     }
-    free(title); free(if_list); free(up_btn); free(down_btn); free(config_btn); free(ping_btn); free(dns_btn);
+    label_destroy(title); list_destroy(if_list); button_destroy(up_btn); button_destroy(down_btn); button_destroy(config_btn); button_destroy(ping_btn); button_destroy(dns_btn);
+    arena_release(arena);
 }
 
 void wm_create_security_center_window(window_manager_t* wm) {
-    int win_id = wm_create_window(wm, "Security Center", 250, 250, 520, 420);
-    label_widget_t* title = label_create(260, 260, "Security Center");
-    list_widget_t* policy_list = list_create(260, 280, 480, 80);
-    list_widget_t* sandbox_list = list_create(260, 370, 480, 80);
+    window_t* win = wm_create_window(wm, "Security Center", 250, 250, 520, 420);
+    arena_t* arena = win ? win->arena : NULL;
+    label_widget_t* title = label_create_in(arena, 260, 260, "Security Center", "Security Center");
+    list_widget_t* policy_list = list_create_in(arena, 260, 280, 480, 80, "List");
+    list_widget_t* sandbox_list = list_create_in(arena, 260, 370, 480, 80, "List");
     // List MAC policies
     extern mac_policy_t mac_policies[];
     extern size_t mac_policy_count;
@@ -594,19 +627,24 @@ void wm_create_security_center_window(window_manager_t* wm) {
         list_add_item(sandbox_list, buf, "\xF0\x9F\x94\x91", "\033[35m");
     }
     // Render widgets
+    label_widget_t* policy_label = label_create_in(arena, 260, 275, "MAC Policies:", "MAC Policies:");
+    label_widget_t* sandbox_label = label_create_in(arena, 260, 365, "Active Sandboxes:", "Active Sandboxes:");
     label_render(title);
-    label_render(label_create(260, 275, "MAC Policies:"));
+    label_render(policy_label);
     list_render(policy_list);
-    label_render(label_create(260, 365, "Active Sandboxes:"));
+    label_render(sandbox_label);
     list_render(sandbox_list);
     render_notification_history(260, 460);
     // In a real UI, add event log, buttons for policy load/audit, and manage sandboxes
+    label_destroy(title); label_destroy(policy_label); label_destroy(sandbox_label);
+    list_destroy(policy_list); list_destroy(sandbox_list);
 }
 
 void wm_security_center_event_loop(window_manager_t* wm) {
-    label_widget_t* title = label_create_a11y(260, 260, "Security Center", "Security Center Window");
-    list_widget_t* policy_list = list_create_a11y(260, 280, 480, 80, "MAC Policy List");
-    list_widget_t* sandbox_list = list_create_a11y(260, 370, 480, 80, "Sandbox List");
+    arena_t* arena = arena_create(0);
+    label_widget_t* title = label_create_in(arena, 260, 260, "Security Center", "Security Center Window");
+    list_widget_t* policy_list = list_create_in(arena, 260, 280, 480, 80, "MAC Policy List");
+    list_widget_t* sandbox_list = list_create_in(arena, 260, 370, 480, 80, "Sandbox List");
     void* widgets[2] = {policy_list, sandbox_list};
     int widget_types[2] = {1,1};
     int focus_idx = 0;
@@ -628,12 +666,14 @@ void wm_security_center_event_loop(window_manager_t* wm) {
     }
     list_select_at(policy_list, 0);
     list_select_at(sandbox_list, 0);
+    label_widget_t* policy_label = label_create_in(arena, 260, 275, "MAC Policies:", "MAC Policies Label");
+    label_widget_t* sandbox_label = label_create_in(arena, 260, 365, "Active Sandboxes:", "Active Sandboxes Label");
     int running = 1;
     while (running) {
         label_render(title);
-        label_render(label_create_a11y(260, 275, "MAC Policies:", "MAC Policies Label"));
+        label_render(policy_label);
         list_render(policy_list);
-        label_render(label_create_a11y(260, 365, "Active Sandboxes:", "Active Sandboxes Label"));
+        label_render(sandbox_label);
         list_render(sandbox_list);
         render_notification_history(260, 460);
         printf("[SecurityCenter UI] Tab/Shift+Tab=focus, j/k=up/down, Enter=select, P=select policy, S=select sandbox, q=quit: ");
@@ -671,7 +711,9 @@ void wm_security_center_event_loop(window_manager_t* wm) {
             printf("[ScreenReader] Activated: %s\n", sandbox_list->accessibility_label);
         }
     }
-    free(title); free(policy_list); free(sandbox_list);
+    label_destroy(title); label_destroy(policy_label); label_destroy(sandbox_label);
+    list_destroy(policy_list); list_destroy(sandbox_list);
+    arena_release(arena);
 }
 
 void wm_set_high_contrast_mode(int enabled) {
@@ -1,11 +1,15 @@
 #ifndef WINDOW_MANAGER_H
 #define WINDOW_MANAGER_H
 #include <stdbool.h>
+#include "../kernel64/include/slot_map.h"
+#include "../kernel64/include/arena.h"
 #define MAX_WINDOWS_PER_DESKTOP 32
 #define MAX_DESKTOPS 8
+#define MAX_WINDOWS (MAX_WINDOWS_PER_DESKTOP * MAX_DESKTOPS)
 
 typedef struct window {
-    int id;
+    int id; // Slot map handle
+    int desktop;
     int x, y, width, height;
     int z_order;
     float z_depth;
@@ -13,24 +17,34 @@ typedef struct window {
     bool focused;
     bool visible;
     char title[64];
+    arena_t* arena; // Strings and children of the window's widgets; reset on close
     struct window* next;
+    struct window* prev;
 } window_t;
 
 typedef struct desktop {
     int id;
     window_t* windows;
     int window_count;
+    int focused_id; // -1 if none
 } desktop_t;
 
 typedef struct window_manager {
     desktop_t desktops[MAX_DESKTOPS];
     int current_desktop;
-    int next_window_id;
+    // Handle -> window for every desktop; windows stay heap-allocated so
+    // window_t pointers and the per-desktop stacking lists remain stable
+    window_t* window_ptrs[MAX_WINDOWS];
+    uint32_t window_dense_slot[MAX_WINDOWS];
+    slot_entry_t window_slots[MAX_WINDOWS];
+    slot_map_t window_map;
 } window_manager_t;
 
 void wm_init(window_manager_t* wm);
 window_t* wm_create_window(window_manager_t* wm, const char* title, int x, int y, int w, int h);
 void wm_destroy_window(window_manager_t* wm, int window_id);
+window_t* wm_get_window(window_manager_t* wm, int window_id); // Current desktop only
+window_t* wm_get_focused_window(window_manager_t* wm);
 void wm_move_window(window_manager_t* wm, int window_id, int new_x, int new_y);
 void wm_resize_window(window_manager_t* wm, int window_id, int new_w, int new_h);
 void wm_focus_window(window_manager_t* wm, int window_id);
@@ -0,0 +1,212 @@
+// allocation profiler: per-call-site and per-subsystem attribution
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "alloc_prof.h"
+#include "spinlock.h"
+#include "ktime.h"
+
+// Record keys; anything above KEY_BUSY is a live address
+#define KEY_EMPTY 0
+#define KEY_TOMB 1                  // Freed; reusable, but lookups probe past it
+#define KEY_BUSY 2                  // Claimed by an insert still filling it in
+
+#define REPORT_MAX 32
+
+typedef struct {
+    volatile uintptr_t key;
+    uint64_t size;
+    uint64_t when_ms;
+    uint32_t weight;                // Sampling factor when recorded
+    uint16_t site;
+} prof_rec_t;
+
+typedef struct {
+    void* volatile site;            // NULL until claimed
+    const char* tag;
+    uint64_t allocs, bytes;
+} prof_site_t;
+
+typedef struct {
+    uint64_t live, bytes, oldest;
+} prof_agg_t;
+
+static prof_rec_t recs[ALLOC_PROF_SLOTS];
+static prof_site_t sites[ALLOC_PROF_SITES];
+static volatile uint32_t sample_every;
+static uint64_t seq, recorded, live, dropped;
+static prof_agg_t agg[ALLOC_PROF_SITES];
+static spinlock_t report_lock = SPINLOCK_INIT;
+
+static uint32_t ptr_hash(const void* p, uint32_t mask) {
+    uint64_t h = ((uint64_t)(uintptr_t)p >> 4) * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(h >> 32) & mask;
+}
+
+int alloc_prof_start(uint32_t n) {
+    if (!n) return -1;
+    __atomic_store_n(&sample_every, n, __ATOMIC_RELEASE);
+    printf("[AllocProf] Tracking 1 in %u allocations\n", n);
+    return 0;
+}
+
+void alloc_prof_stop(void) {
+    __atomic_store_n(&sample_every, 0, __ATOMIC_RELEASE);
+    printf("[AllocProf] Stopped (%llu records still live)\n", (unsigned long long)__atomic_load_n(&live, __ATOMIC_RELAXED));
+}
+
+void alloc_prof_stats(alloc_prof_stats_t* out) {
+    if (!out) return;
+    out->sample_every = __atomic_load_n(&sample_every, __ATOMIC_RELAXED);
+    out->recorded = __atomic_load_n(&recorded, __ATOMIC_RELAXED);
+    out->live = __atomic_load_n(&live, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+// Slot for a call site, claimed on first use; -1 when the probe runs out
+static int site_slot(void* site, const char* tag) {
+    uint32_t h = ptr_hash(site, ALLOC_PROF_SITES - 1);
+    for (uint32_t i = 0; i < ALLOC_PROF_MAX_PROBE; ++i) {
+        prof_site_t* s = &sites[(h + i) & (ALLOC_PROF_SITES - 1)];
+        void* cur = __atomic_load_n(&s->site, __ATOMIC_ACQUIRE);
+        if (!cur) {
+            void* expected = NULL;
+            if (__atomic_compare_exchange_n(&s->site, &expected, site, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&s->tag, tag, __ATOMIC_RELEASE);
+                return (int)(s - sites);
+            }
+            cur = expected;
+        }
+        if (cur == site) return (int)(s - sites);
+    }
+    return -1;
+}
+
+int alloc_prof_record(const void* ptr, size_t size, const char* tag, void* site) {
+    uint32_t n = __atomic_load_n(&sample_every, __ATOMIC_RELAXED);
+    if (!n || !ptr) return 0;
+    if (n > 1 && __atomic_add_fetch(&seq, 1, __ATOMIC_RELAXED) % n) return 0;
+    int si = site_slot(site, tag);
+    if (si >= 0) {
+        uint32_t h = ptr_hash(ptr, ALLOC_PROF_SLOTS - 1);
+        for (uint32_t i = 0; i < ALLOC_PROF_MAX_PROBE; ++i) {
+            prof_rec_t* r = &recs[(h + i) & (ALLOC_PROF_SLOTS - 1)];
+            uintptr_t k = __atomic_load_n(&r->key, __ATOMIC_RELAXED);
+            if (k > KEY_TOMB) continue;
+            if (!__atomic_compare_exchange_n(&r->key, &k, KEY_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) continue;
+            r->size = size;
+            r->when_ms = ktime_ms();
+            r->weight = n;
+            r->site = (uint16_t)si;
+            __atomic_add_fetch(&live, 1, __ATOMIC_RELAXED); // Before the key, or forget could return early
+            __atomic_store_n(&r->key, (uintptr_t)ptr, __ATOMIC_RELEASE);
+            __atomic_add_fetch(&sites[si].allocs, n, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&sites[si].bytes, (uint64_t)size * n, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&recorded, 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+    }
+    __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void alloc_prof_forget(const void* ptr) {
+    if (!ptr || !__atomic_load_n(&live, __ATOMIC_RELAXED)) return;
+    uint32_t h = ptr_hash(ptr, ALLOC_PROF_SLOTS - 1);
+    for (uint32_t i = 0; i < ALLOC_PROF_MAX_PROBE; ++i) {
+        prof_rec_t* r = &recs[(h + i) & (ALLOC_PROF_SLOTS - 1)];
+        uintptr_t k = __atomic_load_n(&r->key, __ATOMIC_ACQUIRE);
+        // An insert in progress may be this pointer's; wait for its key
+        while (k == KEY_BUSY) {
+            cpu_relax();
+            k = __atomic_load_n(&r->key, __ATOMIC_ACQUIRE);
+        }
+        if (k == KEY_EMPTY) return; // Slots never go back to empty, so the chain ends here
+        if (k != (uintptr_t)ptr) continue;
+        if (__atomic_compare_exchange_n(&r->key, &k, KEY_TOMB, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            __atomic_sub_fetch(&live, 1, __ATOMIC_RELAXED);
+        return;
+    }
+}
+
+// Report lock held. Sums live records per site, skipping younger ones.
+static void aggregate(uint64_t min_age_ms) {
+    uint64_t now = ktime_ms();
+    memset(agg, 0, sizeof(agg));
+    for (uint32_t i = 0; i < ALLOC_PROF_SLOTS; ++i) {
+        prof_rec_t* r = &recs[i];
+        if (__atomic_load_n(&r->key, __ATOMIC_ACQUIRE) <= KEY_BUSY) continue;
+        uint64_t age = now > r->when_ms ? now - r->when_ms : 0;
+        if (age < min_age_ms) continue;
+        prof_agg_t* a = &agg[r->site];
+        a->live += r->weight;
+        a->bytes += r->size * r->weight;
+        if (age > a->oldest) a->oldest = age;
+    }
+}
+
+// Report lock held. Keeps the max largest sites in out, sorted descending.
+static int select_top(alloc_prof_site_stats_t* out, int max, int by_live) {
+    int n = 0;
+    for (int i = 0; i < ALLOC_PROF_SITES; ++i) {
+        void* site = __atomic_load_n(&sites[i].site, __ATOMIC_ACQUIRE);
+        if (!site || (by_live && !agg[i].live)) continue;
+        alloc_prof_site_stats_t s = {
+            site, __atomic_load_n(&sites[i].tag, __ATOMIC_ACQUIRE),
+            __atomic_load_n(&sites[i].allocs, __ATOMIC_RELAXED), __atomic_load_n(&sites[i].bytes, __ATOMIC_RELAXED),
+            agg[i].live, agg[i].bytes, agg[i].oldest
+        };
+        uint64_t key = by_live ? s.live_bytes : s.bytes;
+        int pos = n;
+        while (pos > 0 && key > (by_live ? out[pos - 1].live_bytes : out[pos - 1].bytes)) pos--;
+        if (pos >= max) continue;
+        int last = n < max ? n : max - 1;
+        memmove(&out[pos + 1], &out[pos], (size_t)(last - pos) * sizeof(*out));
+        out[pos] = s;
+        if (n < max) n++;
+    }
+    return n;
+}
+
+int alloc_prof_top(alloc_prof_site_stats_t* out, int max, int by_live) {
+    if (!out || max <= 0) return 0;
+    spin_lock(&report_lock);
+    aggregate(0);
+    int n = select_top(out, max, by_live);
+    spin_unlock(&report_lock);
+    return n;
+}
+
+static void print_sites(const alloc_prof_site_stats_t* s, int n) {
+    for (int i = 0; i < n; ++i) {
+        printf("[AllocProf]   %p %-16s allocs=%llu bytes=%lluK live=%llu/%lluK oldest=%llums\n",
+            s[i].site, s[i].tag ? s[i].tag : "?", (unsigned long long)s[i].allocs,
+            (unsigned long long)(s[i].bytes / 1024), (unsigned long long)s[i].live,
+            (unsigned long long)(s[i].live_bytes / 1024), (unsigned long long)s[i].oldest_ms);
+    }
+}
+
+void alloc_prof_report_top(int n) {
+    alloc_prof_site_stats_t top[REPORT_MAX];
+    if (n > REPORT_MAX) n = REPORT_MAX;
+    n = alloc_prof_top(top, n, 0);
+    printf("[AllocProf] Top %d call sites by bytes allocated (1 in %u sampled):\n", n, sample_every);
+    print_sites(top, n);
+}
+
+void alloc_prof_report_live(int n, uint64_t min_age_ms) {
+    alloc_prof_site_stats_t top[REPORT_MAX];
+    if (n > REPORT_MAX) n = REPORT_MAX;
+    if (n <= 0) return;
+    spin_lock(&report_lock);
+    aggregate(min_age_ms);
+    n = select_top(top, n, 1);
+    spin_unlock(&report_lock);
+    uint64_t bytes = 0;
+    for (int i = 0; i < n; ++i) bytes += top[i].live_bytes;
+    printf("[AllocProf] Live heap older than %llums: %lluK in the top %d sites\n",
+        (unsigned long long)min_age_ms, (unsigned long long)(bytes / 1024), n);
+    print_sites(top, n);
+}
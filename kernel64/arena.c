@@ -0,0 +1,166 @@
+// region/arena allocator
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "spinlock.h"
+#include "kheap.h"
+#include "../core/resource_manager/resource_group.h"
+
+struct arena_chunk {
+    arena_chunk_t* next;
+    size_t size;                    // Usable bytes in data[]
+    size_t off;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static arena_t* spares;
+static int nr_spares;
+static spinlock_t spare_lock = SPINLOCK_INIT;
+static int arena_tag = -1;
+
+static size_t align_up(size_t v, size_t a) { return (v + a - 1) & ~(a - 1); }
+
+static void arena_free_chunks(arena_t* a) {
+    arena_chunk_t* c = a->first;
+    while (c) {
+        arena_chunk_t* next = c->next;
+        kheap_free(c);
+        c = next;
+    }
+    if (a->rgroup != RG_ROOT) rgroup_uncharge_mem(a->rgroup, a->reserved);
+    a->first = a->cur = NULL;
+    a->reserved = 0;
+}
+
+arena_t* arena_create(size_t chunk_size) {
+    if (!chunk_size) chunk_size = ARENA_CHUNK_DEFAULT;
+    arena_t* a = NULL;
+    spin_lock(&spare_lock);
+    for (arena_t** p = &spares; *p; p = &(*p)->next_spare) {
+        if ((*p)->chunk_size == chunk_size) {
+            a = *p;
+            *p = a->next_spare;
+            nr_spares--;
+            break;
+        }
+    }
+    spin_unlock(&spare_lock);
+    if (a) return a;
+    if (arena_tag < 0) arena_tag = kheap_tag("arena");
+    a = (arena_t*)kheap_zalloc(KHEAP_NORMAL, sizeof(arena_t), arena_tag);
+    if (a) a->chunk_size = chunk_size;
+    return a;
+}
+
+arena_t* arena_create_child(arena_t* parent, size_t chunk_size) {
+    if (!parent) return NULL;
+    arena_t* a = (arena_t*)arena_zalloc(parent, sizeof(arena_t));
+    if (!a) return NULL;
+    a->parent = parent;
+    a->chunk_size = chunk_size ? chunk_size : parent->chunk_size / 4;
+    return a;
+}
+
+void arena_reset(arena_t* a) {
+    if (!a) return;
+    a->cur = a->first;
+    if (a->cur) a->cur->off = 0;
+    a->used = 0;
+}
+
+void arena_release(arena_t* a) {
+    if (!a) return;
+    arena_reset(a);
+    if (a->parent) return; // Its memory belongs to the parent
+    if (a->rgroup != RG_ROOT) {
+        // A recycled arena starts uncharged, so the group's memory goes now
+        arena_free_chunks(a);
+        a->rgroup = RG_ROOT;
+    }
+    spin_lock(&spare_lock);
+    if (nr_spares < ARENA_MAX_SPARE) {
+        a->next_spare = spares;
+        spares = a;
+        nr_spares++;
+        a = NULL;
+    }
+    spin_unlock(&spare_lock);
+    if (a) {
+        arena_free_chunks(a);
+        kheap_free(a);
+    }
+}
+
+int arena_set_rgroup(arena_t* a, int rgroup) {
+    if (!a || a->parent) return -1;
+    if (rgroup == a->rgroup) return 0;
+    if (rgroup != RG_ROOT && a->reserved && rgroup_try_charge_mem(rgroup, a->reserved) != 0) return -1;
+    if (a->rgroup != RG_ROOT) rgroup_uncharge_mem(a->rgroup, a->reserved);
+    a->rgroup = rgroup;
+    return 0;
+}
+
+void* arena_alloc(arena_t* a, size_t size) {
+    if (!a) return malloc(size);
+    size = align_up(size ? size : 1, ARENA_ALIGN);
+    // Chunks after the current one are left over from before a reset
+    arena_chunk_t* c = a->cur;
+    while (c && c->off + size > c->size) {
+        c = c->next;
+        if (c) c->off = 0;
+    }
+    if (!c) {
+        size_t bytes = size > a->chunk_size ? size : a->chunk_size;
+        size_t total = sizeof(arena_chunk_t) + bytes;
+        if (a->rgroup != RG_ROOT && rgroup_try_charge_mem(a->rgroup, bytes) != 0) return NULL; // Over the group's limit
+        c = (arena_chunk_t*)(a->parent ? arena_alloc(a->parent, total) : kheap_alloc(KHEAP_NORMAL, total, arena_tag));
+        if (!c) {
+            if (a->rgroup != RG_ROOT) rgroup_uncharge_mem(a->rgroup, bytes);
+            return NULL;
+        }
+        c->size = bytes;
+        c->off = 0;
+        if (a->cur) {
+            c->next = a->cur->next;
+            a->cur->next = c;
+        } else {
+            c->next = a->first;
+            a->first = c;
+        }
+        a->reserved += bytes;
+    }
+    a->cur = c;
+    void* p = c->data + c->off;
+    c->off += size;
+    a->used += size;
+    return p;
+}
+
+void* arena_zalloc(arena_t* a, size_t size) {
+    void* p = arena_alloc(a, size);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+char* arena_strdup(arena_t* a, const char* s) {
+    if (!s) return NULL;
+    size_t len = strlen(s) + 1;
+    char* d = (char*)arena_alloc(a, len);
+    if (d) memcpy(d, s, len);
+    return d;
+}
+
+arena_mark_t arena_save(const arena_t* a) {
+    arena_mark_t m = { a->cur, a->cur ? a->cur->off : 0, a->used };
+    return m;
+}
+
+void arena_restore(arena_t* a, arena_mark_t m) {
+    if (!m.chunk) { arena_reset(a); return; }
+    a->cur = m.chunk;
+    a->cur->off = m.offset;
+    a->used = m.used;
+}
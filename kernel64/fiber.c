@@ -0,0 +1,404 @@
+// stackful fibers: cooperative, run from the main loop
+//
+// A fiber that blocks (sleep, wait queue, fd readiness) saves its callee-saved
+// registers on its own stack and switches back to the scheduler context in
+// fiber_run(); timeouts ride on the timer wheel and fd readiness on one poll()
+// per loop iteration, so a thousand parked fibers cost no threads.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "fiber.h"
+#include "ktime.h"
+#include "spinlock.h"
+#include "kheap.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <windows.h>
+#define FIBER_HOSTED 1
+typedef WSAPOLLFD fiber_pollfd_t;
+#define fiber_poll(p, n, ms) WSAPoll((p), (ULONG)(n), (INT)(ms))
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define FIBER_HOSTED 1
+typedef struct pollfd fiber_pollfd_t;
+#define fiber_poll(p, n, ms) poll((p), (nfds_t)(n), (int)(ms))
+#else
+#define FIBER_HOSTED 0
+#endif
+
+#define FIBER_GUARD_SIZE 4096
+#define FIBER_CANARY 0xF1BE5CA1AB1E5AFEull
+
+// fiber_switch_ctx(void** save_sp, void* load_sp): push the callee-saved
+// registers, store rsp, load the other stack, pop and return into it.
+// Win64 also treats rdi, rsi and xmm6-xmm15 as callee-saved.
+void fiber_switch_ctx(void** save_sp, void* load_sp);
+
+#if defined(_WIN32)
+#define FIBER_FRAME_SIZE (8 * 8 + 160)
+__asm__(
+    ".text\n"
+    ".globl fiber_switch_ctx\n"
+    "fiber_switch_ctx:\n"
+    "    pushq %rbp\n    pushq %rbx\n    pushq %rdi\n    pushq %rsi\n"
+    "    pushq %r12\n    pushq %r13\n    pushq %r14\n    pushq %r15\n"
+    "    subq $160, %rsp\n"
+    "    movdqu %xmm6, 0(%rsp)\n    movdqu %xmm7, 16(%rsp)\n"
+    "    movdqu %xmm8, 32(%rsp)\n   movdqu %xmm9, 48(%rsp)\n"
+    "    movdqu %xmm10, 64(%rsp)\n  movdqu %xmm11, 80(%rsp)\n"
+    "    movdqu %xmm12, 96(%rsp)\n  movdqu %xmm13, 112(%rsp)\n"
+    "    movdqu %xmm14, 128(%rsp)\n movdqu %xmm15, 144(%rsp)\n"
+    "    movq %rsp, (%rcx)\n"
+    "    movq %rdx, %rsp\n"
+    "    movdqu 0(%rsp), %xmm6\n    movdqu 16(%rsp), %xmm7\n"
+    "    movdqu 32(%rsp), %xmm8\n   movdqu 48(%rsp), %xmm9\n"
+    "    movdqu 64(%rsp), %xmm10\n  movdqu 80(%rsp), %xmm11\n"
+    "    movdqu 96(%rsp), %xmm12\n  movdqu 112(%rsp), %xmm13\n"
+    "    movdqu 128(%rsp), %xmm14\n movdqu 144(%rsp), %xmm15\n"
+    "    addq $160, %rsp\n"
+    "    popq %r15\n    popq %r14\n    popq %r13\n    popq %r12\n"
+    "    popq %rsi\n    popq %rdi\n    popq %rbx\n    popq %rbp\n"
+    "    ret\n"
+);
+#else
+#define FIBER_FRAME_SIZE (6 * 8)
+__asm__(
+    ".text\n"
+    ".globl fiber_switch_ctx\n"
+    "fiber_switch_ctx:\n"
+    "    pushq %rbp\n    pushq %rbx\n"
+    "    pushq %r12\n    pushq %r13\n    pushq %r14\n    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n    popq %r14\n    popq %r13\n    popq %r12\n"
+    "    popq %rbx\n    popq %rbp\n"
+    "    ret\n"
+);
+#endif
+
+static void* sched_sp = NULL;       // Main loop context while a fiber runs
+static fiber_t* current = NULL;
+static fiber_waitq_t ready = { NULL, NULL };
+static fiber_t* pool = NULL;        // Dead fibers with their stacks, for reuse
+static int pool_count = 0;
+static int live_count = 0;
+static uint32_t next_id = 1;
+static int fiber_tag = KHEAP_TAG_NONE;
+
+#if FIBER_HOSTED
+static fiber_pollfd_t fd_waits[FIBER_MAX_FD_WAITERS];
+static fiber_t* fd_owners[FIBER_MAX_FD_WAITERS];
+static int fd_events[FIBER_MAX_FD_WAITERS];    // Requested FIBER_POLL* bits
+static int fd_wait_count = 0;
+#endif
+
+static void q_push(fiber_waitq_t* q, fiber_t* f) {
+    f->next = NULL;
+    f->prev = q->tail;
+    if (q->tail) q->tail->next = f;
+    else q->head = f;
+    q->tail = f;
+    f->waitq = q;
+}
+
+static void q_remove(fiber_waitq_t* q, fiber_t* f) {
+    if (f->prev) f->prev->next = f->next;
+    else q->head = f->next;
+    if (f->next) f->next->prev = f->prev;
+    else q->tail = f->prev;
+    f->next = f->prev = NULL;
+    f->waitq = NULL;
+}
+
+static void make_ready(fiber_t* f, int result) {
+    if (f->waitq) q_remove(f->waitq, f);
+    ktimer_del(&f->timer);
+    f->wait_result = result;
+    f->state = FIBER_READY;
+    q_push(&ready, f);
+}
+
+#if FIBER_HOSTED
+static void fd_slot_release(fiber_t* f) {
+    int i = f->fd_slot;
+    if (i < 0) return;
+    int last = --fd_wait_count;
+    if (i != last) {
+        fd_waits[i] = fd_waits[last];
+        fd_owners[i] = fd_owners[last];
+        fd_events[i] = fd_events[last];
+        fd_owners[i]->fd_slot = i;
+    }
+    f->fd_slot = -1;
+}
+#endif
+
+// Timer expiry: the sleep is over, or a wait timed out
+static void fiber_timeout(ktimer_t* t, void* arg) {
+    (void)t;
+    fiber_t* f = (fiber_t*)arg;
+    if (f->state != FIBER_WAITING) return;
+    int result = f->waitq ? -1 : 0;
+#if FIBER_HOSTED
+    fd_slot_release(f);
+#endif
+    make_ready(f, result);
+}
+
+// Park the running fiber until make_ready(); returns its wait_result
+static int park(void) {
+    fiber_t* f = current;
+    f->state = FIBER_WAITING;
+    fiber_switch_ctx(&f->sp, sched_sp);
+    return f->wait_result;
+}
+
+static void fiber_entry(void) {
+    fiber_t* f = current;
+    f->fn(f->arg);
+    f->state = FIBER_DEAD;
+    fiber_switch_ctx(&f->sp, sched_sp);
+    __builtin_unreachable();
+}
+
+static void* stack_alloc(size_t size) {
+#if defined(_WIN32)
+    void* base = VirtualAlloc(NULL, size + FIBER_GUARD_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    DWORD old;
+    if (base) VirtualProtect(base, FIBER_GUARD_SIZE, PAGE_NOACCESS, &old);
+    return base;
+#elif defined(__linux__)
+    void* base = mmap(NULL, size + FIBER_GUARD_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    mprotect(base, FIBER_GUARD_SIZE, PROT_NONE);
+    return base;
+#else
+    // No MMU guard here: a canary at the low end is checked after every switch
+    uint64_t* base = (uint64_t*)kheap_alloc_aligned(KHEAP_NORMAL, size + FIBER_GUARD_SIZE, 64, fiber_tag);
+    if (base) *base = FIBER_CANARY;
+    return base;
+#endif
+}
+
+static void stack_free(void* base, size_t size) {
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(base, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(base, size + FIBER_GUARD_SIZE);
+#else
+    (void)size;
+    kheap_free(base);
+#endif
+}
+
+static void release(fiber_t* f) {
+    live_count--;
+    if (pool_count < FIBER_POOL_MAX) {
+        f->next = pool;
+        pool = f;
+        pool_count++;
+        return;
+    }
+    stack_free(f->stack, f->stack_size);
+    kheap_free(f);
+}
+
+int fiber_runtime_init(void) {
+    ready.head = ready.tail = NULL;
+    current = NULL;
+    fiber_tag = kheap_tag("fiber");
+    printf("[Fiber] Runtime ready (%d KiB stacks, pool of %d)\n", FIBER_STACK_SIZE / 1024, FIBER_POOL_MAX);
+    return 0;
+}
+
+fiber_t* fiber_spawn(fiber_fn_t fn, void* arg) {
+    if (!fn) return NULL;
+    fiber_t* f = pool;
+    if (f) {
+        pool = f->next;
+        pool_count--;
+    } else {
+        f = (fiber_t*)kheap_alloc(KHEAP_NORMAL, sizeof(fiber_t), fiber_tag);
+        if (!f) return NULL;
+        f->stack_size = FIBER_STACK_SIZE;
+        f->stack = stack_alloc(f->stack_size);
+        if (!f->stack) {
+            kheap_free(f);
+            printf("[Fiber] Failed to allocate stack\n");
+            return NULL;
+        }
+    }
+    f->next = f->prev = NULL;
+    f->waitq = NULL;
+    f->fd_slot = -1;
+    f->wait_result = 0;
+    f->id = next_id++;
+    f->fn = fn;
+    f->arg = arg;
+    ktimer_init(&f->timer, "fiber", fiber_timeout, f);
+
+    // Initial frame: zeroed callee-saved registers, then fiber_entry as the
+    // return address, laid out so fiber_entry starts with a call-aligned rsp
+    uintptr_t top = ((uintptr_t)f->stack + FIBER_GUARD_SIZE + f->stack_size) & ~(uintptr_t)15;
+#if defined(_WIN32)
+    uintptr_t ret = top - 48; // Leaves the 32-byte shadow space above the return slot
+#else
+    uintptr_t ret = top - 16;
+#endif
+    ((uintptr_t*)ret)[0] = (uintptr_t)fiber_entry;
+    ((uintptr_t*)ret)[1] = 0;
+    uint8_t* sp = (uint8_t*)(ret - FIBER_FRAME_SIZE);
+    for (int i = 0; i < FIBER_FRAME_SIZE; ++i) sp[i] = 0;
+    f->sp = sp;
+
+    live_count++;
+    f->state = FIBER_READY;
+    q_push(&ready, f);
+    return f;
+}
+
+fiber_t* fiber_current(void) {
+    return current;
+}
+
+int fiber_count(void) {
+    return live_count;
+}
+
+void fiber_yield(void) {
+    fiber_t* f = current;
+    if (!f) return;
+    f->state = FIBER_READY;
+    q_push(&ready, f);
+    fiber_switch_ctx(&f->sp, sched_sp);
+}
+
+void fiber_sleep(uint32_t ms) {
+    if (!current) {
+        uint64_t until = ktime_ms() + ms;
+        while (ktime_ms() < until) cpu_relax();
+        return;
+    }
+    ktimer_add(&current->timer, ktime_ms() + ms);
+    park();
+}
+
+int fiber_wait(fiber_waitq_t* q, uint32_t timeout_ms) {
+    if (!current || !q) return -1; // Only fibers can block
+    if (timeout_ms == 0) return -1;
+    q_push(q, current);
+    if (timeout_ms != FIBER_NO_TIMEOUT) ktimer_add(&current->timer, ktime_ms() + timeout_ms);
+    return park();
+}
+
+int fiber_wake_one(fiber_waitq_t* q) {
+    if (!q || !q->head) return 0;
+    make_ready(q->head, 0);
+    return 1;
+}
+
+int fiber_wake_all(fiber_waitq_t* q) {
+    int n = 0;
+    while (q && q->head) {
+        make_ready(q->head, 0);
+        n++;
+    }
+    return n;
+}
+
+// Run each fiber that is ready now once; fibers readied meanwhile (yields,
+// wakes from other fibers) wait for the next call. Returns how many are ready.
+int fiber_run(void) {
+    fiber_t* last = ready.tail;
+    while (ready.head) {
+        fiber_t* f = ready.head;
+        q_remove(&ready, f);
+        current = f;
+        f->state = FIBER_RUNNING;
+        fiber_switch_ctx(&sched_sp, f->sp);
+        current = NULL;
+#if !FIBER_HOSTED
+        if (*(uint64_t*)f->stack != FIBER_CANARY) {
+            printf("[Fiber] Stack overflow in fiber %u\n", f->id);
+            *(uint64_t*)f->stack = FIBER_CANARY;
+        }
+#endif
+        if (f->state == FIBER_DEAD) release(f);
+        if (f == last) break;
+    }
+    int n = 0;
+    for (fiber_t* f = ready.head; f; f = f->next) n++;
+    return n;
+}
+
+#if FIBER_HOSTED
+static short to_poll_events(int events) {
+    short ev = 0;
+    if (events & FIBER_POLLIN) ev |= POLLIN;
+    if (events & FIBER_POLLOUT) ev |= POLLOUT;
+    return ev;
+}
+
+// Errors and hangups count as ready so the caller's next call reports them
+static int from_poll_events(short revents, int events) {
+    int ready_ev = 0;
+    if (revents & (POLLIN | POLLERR | POLLHUP)) ready_ev |= FIBER_POLLIN;
+    if (revents & (POLLOUT | POLLERR | POLLHUP)) ready_ev |= FIBER_POLLOUT;
+    return ready_ev & events;
+}
+
+int fiber_wait_fd(intptr_t fd, int events, uint32_t timeout_ms) {
+    if (!current) {
+        fiber_pollfd_t p;
+        p.fd = fd;
+        p.events = to_poll_events(events);
+        p.revents = 0;
+        int r = fiber_poll(&p, 1, timeout_ms == FIBER_NO_TIMEOUT ? -1 : (int)timeout_ms);
+        if (r < 0) return -1;
+        return r ? from_poll_events(p.revents, events) : 0;
+    }
+    if (fd_wait_count >= FIBER_MAX_FD_WAITERS) return -1;
+    int i = fd_wait_count++;
+    fd_waits[i].fd = fd;
+    fd_waits[i].events = to_poll_events(events);
+    fd_waits[i].revents = 0;
+    fd_owners[i] = current;
+    fd_events[i] = events;
+    current->fd_slot = i;
+    if (timeout_ms != FIBER_NO_TIMEOUT) ktimer_add(&current->timer, ktime_ms() + timeout_ms);
+    return park();
+}
+
+int fiber_poll_io(uint32_t timeout_ms) {
+    if (fd_wait_count == 0) return -1;
+    int r = fiber_poll(fd_waits, fd_wait_count, timeout_ms == FIBER_NO_TIMEOUT ? -1 : (int)timeout_ms);
+    if (r <= 0) return 0;
+    int woken = 0;
+    for (int i = fd_wait_count - 1; i >= 0; --i) {
+        if (!fd_waits[i].revents) continue;
+        fiber_t* f = fd_owners[i];
+        int ev = from_poll_events(fd_waits[i].revents, fd_events[i]);
+        fd_slot_release(f); // Moves the last slot into i, which was already visited
+        make_ready(f, ev ? ev : -1);
+        woken++;
+    }
+    return woken;
+}
+#else
+int fiber_wait_fd(intptr_t fd, int events, uint32_t timeout_ms) {
+    (void)fd; (void)events; (void)timeout_ms;
+    return -1; // No host descriptors on bare metal
+}
+
+int fiber_poll_io(uint32_t timeout_ms) {
+    (void)timeout_ms;
+    return -1;
+}
+#endif
@@ -0,0 +1,234 @@
+// async filesystem I/O: submission/completion queues layered over fs_ops_t
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "modular.h"
+#include "page_cache.h"
+#include "spinlock.h"
+#include "kheap.h"
+#include "fiber.h"
+#include "../core/resource_manager/resource_group.h"
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#define FS_IO_NOTIFY 1
+#else
+#define FS_IO_NOTIFY 0
+#endif
+#define FS_IO_WAIT_MS 100           // Re-check bound in case a wakeup is missed
+
+struct fs_io_ctx {
+    fs_module_t* fs;
+    unsigned depth;             // Ring size (power of two)
+    fs_io_request_t* sq;        // Submission ring, owned by the caller
+    unsigned sq_head, sq_tail;
+    fs_io_completion_t* cq;     // Completion ring, filled by modules/workers
+    unsigned cq_head, cq_tail;
+    spinlock_t cq_lock;
+    int outstanding;            // Submitted but not yet reaped
+    int rgroup;                 // Charged for read/write bytes
+    int notify_fd;              // eventfd kicked on completion while someone waits, -1 if none
+    int waiting;
+};
+
+static int fs_io_tag = KHEAP_TAG_NONE;
+
+static unsigned round_up_pow2(unsigned v) {
+    unsigned p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+fs_io_ctx_t* fs_io_setup(fs_module_t* fs, unsigned depth) {
+    if (!fs || !fs->ops || depth == 0 || depth > FS_IO_MAX_DEPTH) return NULL;
+    if (fs_io_tag == KHEAP_TAG_NONE) fs_io_tag = kheap_tag("fs_io");
+    fs_io_ctx_t* ctx = (fs_io_ctx_t*)kheap_zalloc(KHEAP_NORMAL, sizeof(fs_io_ctx_t), fs_io_tag);
+    if (!ctx) return NULL;
+    ctx->fs = fs;
+    ctx->depth = round_up_pow2(depth);
+    // Rings are what a device would read and write, so they come from the DMA pool
+    ctx->sq = (fs_io_request_t*)kheap_zalloc(KHEAP_DMA, ctx->depth * sizeof(fs_io_request_t), fs_io_tag);
+    ctx->cq = (fs_io_completion_t*)kheap_zalloc(KHEAP_DMA, ctx->depth * sizeof(fs_io_completion_t), fs_io_tag);
+    if (!ctx->sq || !ctx->cq) {
+        kheap_free(ctx->sq); kheap_free(ctx->cq); kheap_free(ctx);
+        return NULL;
+    }
+    spin_init(&ctx->cq_lock);
+#if FS_IO_NOTIFY
+    ctx->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    ctx->notify_fd = -1;
+#endif
+    printf("[FSIO] Context for %s ready (depth %u, %s)\n", fs->name, ctx->depth,
+        fs->ops->submit ? "async" : "sync fallback");
+    return ctx;
+}
+
+void fs_io_destroy(fs_io_ctx_t* ctx) {
+    if (!ctx) return;
+    // Drain everything still owned by the module before freeing the rings
+    fs_io_completion_t c[16];
+    while (__atomic_load_n(&ctx->outstanding, __ATOMIC_ACQUIRE) > 0) fs_io_wait(ctx, c, 1, 16);
+#if FS_IO_NOTIFY
+    if (ctx->notify_fd >= 0) close(ctx->notify_fd);
+#endif
+    kheap_free(ctx->sq);
+    kheap_free(ctx->cq);
+    kheap_free(ctx);
+}
+
+// Queue requests without handing them to the module yet; returns how many fit
+int fs_io_queue(fs_io_ctx_t* ctx, const fs_io_request_t* reqs, int count) {
+    if (!ctx || !reqs || count <= 0) return 0;
+    unsigned queued = ctx->sq_tail - ctx->sq_head;
+    int outstanding = __atomic_load_n(&ctx->outstanding, __ATOMIC_ACQUIRE);
+    int room = (int)ctx->depth - (int)queued - outstanding;
+    int n = count < room ? count : room;
+    for (int i = 0; i < n; ++i) {
+        // Async I/O is direct: keep the page cache coherent with it
+        const fs_io_request_t* r = &reqs[i];
+        if (r->op == FS_IO_WRITE) page_cache_invalidate(ctx->fs, r->path, r->offset, r->len);
+        else if (r->op == FS_IO_READ) page_cache_flush(ctx->fs, r->path, r->offset, r->len);
+        else page_cache_flush(ctx->fs, r->path, 0, 0);
+        ctx->sq[ctx->sq_tail & (ctx->depth - 1)] = reqs[i];
+        ctx->sq_tail++;
+    }
+    return n;
+}
+
+static void fs_io_submit_sync(fs_io_ctx_t* ctx, const fs_io_request_t* reqs, int count) {
+    fs_ops_t* ops = ctx->fs->ops;
+    for (int i = 0; i < count; ++i) {
+        const fs_io_request_t* r = &reqs[i];
+        int res = -1;
+        switch (r->op) {
+            case FS_IO_READ:
+                if (ops->read) res = ops->read(r->path, r->buf, r->len, r->offset);
+                break;
+            case FS_IO_WRITE:
+                if (ops->write) res = ops->write(r->path, r->buf, r->len, r->offset);
+                break;
+            case FS_IO_FSYNC:
+                res = ops->fsync ? ops->fsync(r->path) : 0;
+                break;
+        }
+        fs_io_complete(ctx, r->user_data, res);
+    }
+}
+
+static void fs_io_submit_chunk(fs_io_ctx_t* ctx, const fs_io_request_t* reqs, int count) {
+    fs_ops_t* ops = ctx->fs->ops;
+    if (!ops->submit) {
+        fs_io_submit_sync(ctx, reqs, count);
+        return;
+    }
+    if (ops->submit(ctx, reqs, count) != 0) {
+        // Module refused the batch: fail each request so callers never hang
+        for (int i = 0; i < count; ++i) fs_io_complete(ctx, reqs[i].user_data, -1);
+    }
+}
+
+// Hand every queued request to the module in (at most two) contiguous batches
+void fs_io_set_rgroup(fs_io_ctx_t* ctx, int rgroup) {
+    if (ctx) ctx->rgroup = rgroup;
+}
+
+int fs_io_submit(fs_io_ctx_t* ctx) {
+    if (!ctx) return -1;
+    int n = (int)(ctx->sq_tail - ctx->sq_head);
+    if (n == 0) return 0;
+    // Over the group's IO quota: leave the batch queued until the next period
+    if (rgroup_throttled(ctx->rgroup, RG_IO)) return 0;
+    uint64_t bytes = 0;
+    for (unsigned i = ctx->sq_head; i != ctx->sq_tail; ++i) {
+        const fs_io_request_t* r = &ctx->sq[i & (ctx->depth - 1)];
+        if (r->op != FS_IO_FSYNC) bytes += r->len;
+    }
+    rgroup_charge(ctx->rgroup, RG_IO, bytes);
+    __atomic_add_fetch(&ctx->outstanding, n, __ATOMIC_ACQ_REL);
+    unsigned start = ctx->sq_head & (ctx->depth - 1);
+    int first = (int)(ctx->depth - start);
+    if (first > n) first = n;
+    // The module copies what it needs, so the ring slots can be reused afterwards
+    fs_io_submit_chunk(ctx, &ctx->sq[start], first);
+    if (n > first) fs_io_submit_chunk(ctx, &ctx->sq[0], n - first);
+    ctx->sq_head = ctx->sq_tail;
+    return n;
+}
+
+// Called by modules (possibly from worker threads) once a request finishes
+void fs_io_complete(fs_io_ctx_t* ctx, uint64_t user_data, int result) {
+    spin_lock(&ctx->cq_lock);
+    fs_io_completion_t* c = &ctx->cq[ctx->cq_tail & (ctx->depth - 1)];
+    c->user_data = user_data;
+    c->result = result;
+    ctx->cq_tail++;
+    spin_unlock(&ctx->cq_lock);
+#if FS_IO_NOTIFY
+    if (ctx->notify_fd >= 0 && __atomic_load_n(&ctx->waiting, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        (void)!write(ctx->notify_fd, &one, sizeof(one));
+    }
+#endif
+}
+
+// Non-blocking: copy out up to max completions
+int fs_io_reap(fs_io_ctx_t* ctx, fs_io_completion_t* out, int max) {
+    if (!ctx || !out || max <= 0) return 0;
+    spin_lock(&ctx->cq_lock);
+    int n = (int)(ctx->cq_tail - ctx->cq_head);
+    if (n > max) n = max;
+    for (int i = 0; i < n; ++i) {
+        out[i] = ctx->cq[ctx->cq_head & (ctx->depth - 1)];
+        ctx->cq_head++;
+    }
+    spin_unlock(&ctx->cq_lock);
+    if (n) __atomic_sub_fetch(&ctx->outstanding, n, __ATOMIC_ACQ_REL);
+    return n;
+}
+
+// Block until a completion may have been posted: on the eventfd where there
+// is one (a fiber parks in the main loop's poll, a thread sleeps in poll),
+// otherwise by yielding the fiber or the CPU
+static void fs_io_block(fs_io_ctx_t* ctx) {
+#if FS_IO_NOTIFY
+    if (ctx->notify_fd >= 0) {
+        __atomic_store_n(&ctx->waiting, 1, __ATOMIC_SEQ_CST);
+        // Checked after publishing waiting, so a completion cannot slip in unnoticed
+        if (__atomic_load_n(&ctx->cq_tail, __ATOMIC_SEQ_CST) == ctx->cq_head) {
+            fiber_wait_fd(ctx->notify_fd, FIBER_POLLIN, FS_IO_WAIT_MS);
+        }
+        __atomic_store_n(&ctx->waiting, 0, __ATOMIC_RELAXED);
+        uint64_t v;
+        (void)!read(ctx->notify_fd, &v, sizeof(v)); // Reset the counter
+        return;
+    }
+#endif
+    (void)ctx;
+    if (fiber_current()) fiber_yield();
+    else cpu_relax();
+}
+
+// Wait until at least min completions are available (bounded by what is outstanding)
+int fs_io_wait(fs_io_ctx_t* ctx, fs_io_completion_t* out, int min, int max) {
+    if (!ctx || !out || max <= 0) return 0;
+    int outstanding = __atomic_load_n(&ctx->outstanding, __ATOMIC_ACQUIRE);
+    if (min > outstanding) min = outstanding;
+    if (min > max) min = max;
+    int got = 0;
+    for (;;) {
+        got += fs_io_reap(ctx, out + got, max - got);
+        if (got >= min) return got;
+        fs_io_block(ctx);
+    }
+}
+
+int fs_io_inflight(const fs_io_ctx_t* ctx) {
+    if (!ctx) return 0;
+    int outstanding = __atomic_load_n(&ctx->outstanding, __ATOMIC_ACQUIRE);
+    int ready = (int)(__atomic_load_n(&ctx->cq_tail, __ATOMIC_ACQUIRE) - ctx->cq_head);
+    return outstanding - ready;
+}
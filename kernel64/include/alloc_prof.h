@@ -0,0 +1,56 @@
+#ifndef ALLOC_PROF_H
+#define ALLOC_PROF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Allocation profiler. When started, kheap, slab and page allocations are
+// recorded with their call site (the caller's return address), size,
+// subsystem tag and time, and forgotten again when freed. Live records sit
+// in a lock-free open-addressed table keyed by address; per-site totals sit
+// in a second one keyed by call site. Both are fixed size: once full, new
+// records are counted as dropped.
+//
+// Each allocation is recorded once, by the allocator the caller asked:
+// memory one allocator takes from another to carve up (slabs and magazines
+// from the heap, heap growth from the page allocator) is not recorded.
+//
+// sample_every = N records one allocation in N, which keeps the cost low
+// enough to leave on in production; reports scale sampled numbers by N.
+#define ALLOC_PROF_SLOTS 16384          // Live records, power of two
+#define ALLOC_PROF_SITES 1024           // Call sites, power of two
+#define ALLOC_PROF_MAX_PROBE 32
+#ifndef ALLOC_PROF_BOOT_SAMPLE
+#define ALLOC_PROF_BOOT_SAMPLE 0        // 1-in-N sampling from boot; 0 leaves it off
+#endif
+
+typedef struct alloc_prof_site_stats {
+    void* site;
+    const char* tag;
+    uint64_t allocs, bytes;             // Cumulative, estimated from samples
+    uint64_t live, live_bytes;
+    uint64_t oldest_ms;                 // Age of the oldest live record
+} alloc_prof_site_stats_t;
+
+typedef struct alloc_prof_stats {
+    uint32_t sample_every;              // 0 when stopped
+    uint64_t recorded;
+    uint64_t live;
+    uint64_t dropped;                   // Table full or too many probes
+} alloc_prof_stats_t;
+
+int alloc_prof_start(uint32_t sample_every);
+void alloc_prof_stop(void);             // Live records stay until freed
+void alloc_prof_stats(alloc_prof_stats_t* out);
+
+// Allocator hooks; alloc_prof_record returns 1 when the allocation was recorded
+int alloc_prof_record(const void* ptr, size_t size, const char* tag, void* site);
+void alloc_prof_forget(const void* ptr);
+
+// Sites sorted by cumulative bytes, or by live bytes; returns the count
+int alloc_prof_top(alloc_prof_site_stats_t* out, int max, int by_live);
+void alloc_prof_report_top(int n);
+// Live heap by site, counting only records at least min_age_ms old
+void alloc_prof_report_live(int n, uint64_t min_age_ms);
+
+#endif // ALLOC_PROF_H
@@ -0,0 +1,54 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Region allocator: bump-pointer allocation out of chunks, freed all at once.
+// Reset is O(1) and keeps the chunks for reuse; save/restore rewinds to a
+// mark for scoped temporaries. A child arena takes its chunks from a parent,
+// so it can be reset on its own and disappears when the parent is reset.
+// An arena has one owner at a time; it does no locking of its own.
+//
+// The allocation helpers accept a NULL arena and fall back to the heap,
+// which lets objects that may or may not live in an arena share one path.
+//
+// A top-level arena can be charged to a resource group: its chunks count
+// against the group's memory limit, and growing past it fails the allocation.
+#define ARENA_CHUNK_DEFAULT (8 * 1024)
+#define ARENA_ALIGN 16
+#define ARENA_MAX_SPARE 16          // Released arenas kept for reuse
+
+typedef struct arena_chunk arena_chunk_t;
+
+typedef struct arena {
+    arena_chunk_t* first;
+    arena_chunk_t* cur;
+    struct arena* parent;           // NULL for a top-level arena
+    size_t chunk_size;
+    size_t used;                    // Bytes handed out since the last reset
+    size_t reserved;                // Bytes in chunks
+    int rgroup;                     // Charged for reserved (RG_ROOT: not charged)
+    struct arena* next_spare;
+} arena_t;
+
+typedef struct arena_mark {
+    arena_chunk_t* chunk;
+    size_t offset;
+    size_t used;
+} arena_mark_t;
+
+arena_t* arena_create(size_t chunk_size);               // 0 for the default
+arena_t* arena_create_child(arena_t* parent, size_t chunk_size);
+void arena_release(arena_t* a);     // Reset; top-level arenas are recycled
+int arena_set_rgroup(arena_t* a, int rgroup);         // Charges what it already holds
+void arena_reset(arena_t* a);
+
+void* arena_alloc(arena_t* a, size_t size);
+void* arena_zalloc(arena_t* a, size_t size);
+char* arena_strdup(arena_t* a, const char* s);
+
+arena_mark_t arena_save(const arena_t* a);
+void arena_restore(arena_t* a, arena_mark_t m);
+
+#endif // ARENA_H
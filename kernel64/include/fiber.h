@@ -0,0 +1,70 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "timer_wheel.h"
+
+// Stackful fibers for kernel services that block. Fibers are cooperative and
+// run from the main loop (fiber_run); a blocking call inside a fiber parks
+// it and switches back to the loop instead of stalling it. Stacks are pooled
+// and have a guard page below them where the host can provide one.
+#define FIBER_STACK_SIZE (16 * 1024)
+#define FIBER_POOL_MAX 1024         // Idle fibers (with stacks) kept for reuse
+#define FIBER_MAX_FD_WAITERS 4096
+#define FIBER_NO_TIMEOUT 0xFFFFFFFFu
+
+#define FIBER_POLLIN 0x1
+#define FIBER_POLLOUT 0x4
+
+typedef enum {
+    FIBER_READY,
+    FIBER_RUNNING,
+    FIBER_WAITING,
+    FIBER_DEAD
+} fiber_state_t;
+
+typedef struct fiber fiber_t;
+typedef void (*fiber_fn_t)(void* arg);
+
+typedef struct fiber_waitq {
+    fiber_t* head;
+    fiber_t* tail;
+} fiber_waitq_t;
+
+struct fiber {
+    void* sp;                   // Saved stack pointer; first member, used by fiber_switch
+    fiber_t* next;              // Run queue or wait queue link
+    fiber_t* prev;
+    fiber_waitq_t* waitq;       // Queue the fiber is parked on, if any
+    fiber_state_t state;
+    int wait_result;            // Set by whoever wakes the fiber
+    int fd_slot;                // Index in the fd wait table, -1 if none
+    uint32_t id;
+    fiber_fn_t fn;
+    void* arg;
+    void* stack;                // Mapping base (guard page included)
+    size_t stack_size;
+    ktimer_t timer;             // Sleep / wait timeout
+};
+
+int fiber_runtime_init(void);
+fiber_t* fiber_spawn(fiber_fn_t fn, void* arg);
+fiber_t* fiber_current(void);   // NULL outside fibers
+void fiber_yield(void);
+void fiber_sleep(uint32_t ms);
+int fiber_run(void);            // Run each ready fiber once; returns how many are ready again
+int fiber_count(void);
+
+// Wait queues: 0 when woken, -1 on timeout
+static inline void fiber_waitq_init(fiber_waitq_t* q) { q->head = q->tail = NULL; }
+int fiber_wait(fiber_waitq_t* q, uint32_t timeout_ms);
+int fiber_wake_one(fiber_waitq_t* q);
+int fiber_wake_all(fiber_waitq_t* q);
+
+// Readiness on a socket or fd: ready events (> 0), 0 on timeout, -1 on error.
+// Outside a fiber this is a plain blocking poll with a timeout.
+int fiber_wait_fd(intptr_t fd, int events, uint32_t timeout_ms);
+int fiber_poll_io(uint32_t timeout_ms); // -1 if no fiber waits on I/O (caller sleeps instead)
+
+#endif // FIBER_H
@@ -0,0 +1,70 @@
+#ifndef KHEAP_H
+#define KHEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Kernel heap: Two-Level Segregated Fit. Free blocks are binned by a first
+// level (power of two) and 32 linear second-level ranges; two bitmaps find
+// a fitting bin with a couple of bit scans, so alloc and free are O(1) with
+// a bounded worst case. Neighbours are coalesced on free.
+//
+// Each pool is a separate heap with its own lock. KHEAP_RT is reserved for
+// real-time paths: it is carved out at boot and never grows, so nothing
+// else can fragment it or make an allocation there wait on a refill.
+typedef enum {
+    KHEAP_NORMAL,
+    KHEAP_DMA,      // Physically contiguous buffers handed to devices
+    KHEAP_RT,
+    KHEAP_POOLS
+} kheap_pool_t;
+
+#define KHEAP_NORMAL_BOOT (8 * 1024 * 1024)  // Boot regions built into the image
+#define KHEAP_DMA_BOOT (1024 * 1024)
+#define KHEAP_RT_BOOT (1024 * 1024)
+#define KHEAP_GROW_SIZE (4 * 1024 * 1024)    // NORMAL/DMA refill step, one top-order page block
+#define KHEAP_MAX_ALLOC ((size_t)1 << 29)
+#define KHEAP_MAX_TAGS 32
+#define KHEAP_MAX_GROWN 64                   // Grown regions per pool that can be handed back
+#define KHEAP_TAG_NONE 0
+
+typedef struct kheap_pool_stats {
+    uint64_t size;              // Bytes in regions
+    uint64_t used;              // Allocated bytes including block headers
+    uint64_t peak;
+    uint64_t allocs, frees;
+    uint64_t failures;
+    uint32_t regions;
+} kheap_pool_stats_t;
+
+typedef struct kheap_tag_stats {
+    const char* name;
+    uint64_t bytes;             // Currently allocated under the tag
+    uint64_t peak;
+    uint64_t allocs;            // Currently live allocations
+} kheap_tag_stats_t;
+
+int kheap_init(void);           // Safe to call more than once
+int kheap_add_region(kheap_pool_t pool, void* mem, size_t size);
+int kheap_tag(const char* name); // Id for a subsystem name, registered on first use
+
+void* kheap_alloc(kheap_pool_t pool, size_t size, int tag);
+void* kheap_alloc_aligned(kheap_pool_t pool, size_t size, size_t align, int tag);
+void* kheap_zalloc(kheap_pool_t pool, size_t size, int tag);
+// For allocators layered on the heap (slab): tag-accounted as usual but not
+// reported to alloc_prof, which records the objects carved out of it instead
+void* kheap_alloc_backing(kheap_pool_t pool, size_t size, size_t align, int tag);
+void kheap_free(void* p);
+size_t kheap_usable_size(const void* p);
+// Returns grown regions with nothing allocated in them to the page allocator
+// (the host when hosted). Pages released; boot regions are never released.
+unsigned long kheap_trim(void);
+
+int kheap_pool_stats(kheap_pool_t pool, kheap_pool_stats_t* out);
+int kheap_tag_stats(int tag, kheap_tag_stats_t* out);
+void kheap_dump(void);
+
+static inline void* kmalloc(size_t size) { return kheap_alloc(KHEAP_NORMAL, size, KHEAP_TAG_NONE); }
+static inline void kfree(void* p) { kheap_free(p); }
+
+#endif // KHEAP_H
@@ -0,0 +1,74 @@
+#ifndef KTIME_H
+#define KTIME_H
+
+#include <stdint.h>
+
+// Kernel timekeeping. The clocksource (invariant TSC when available) is
+// described by a page-aligned clock page that only ktime.c writes; the rest
+// of the kernel sees it through a const pointer, and VM guests and apps can
+// map it read-only. ktime_ns() is a seqcount read plus rdtsc, a multiply and
+// a shift.
+//   ns = ns_base + ((tsc - cycle_last) * mult) >> shift
+typedef enum {
+    KTIME_SRC_NONE,
+    KTIME_SRC_TSC,      // Invariant TSC, calibrated at boot
+    KTIME_SRC_FALLBACK  // Host monotonic clock, or polled PIT on bare metal
+} ktime_source_t;
+
+#define KTIME_SHIFT 24
+#define KTIME_CALIBRATE_MS 10
+#define KTIME_CALIBRATE_ROUNDS 3
+#define KTIME_SYNC_MS 1000      // Re-base and drift check period
+#define KTIME_MAX_SLEW_PPM 500  // Largest frequency correction
+// Drift loop gains as right shifts: phase error is corrected by half per sync
+// and folded into the frequency estimate at 1/16, which is critically damped
+#define KTIME_PHASE_SHIFT 1
+#define KTIME_FREQ_SHIFT 4
+
+typedef struct {
+    volatile uint32_t seq;      // Odd while the kernel updates the page
+    uint32_t source;
+    uint64_t cycle_last;
+    uint64_t ns_base;
+    uint32_t mult;
+    uint32_t shift;
+    uint64_t tsc_hz;
+    int64_t realtime_offset_ns; // Wall clock = monotonic + offset
+} __attribute__((aligned(4096))) ktime_vdata_t;
+
+extern const ktime_vdata_t* const ktime_vdp; // The clock page, read-only outside ktime.c
+
+int ktime_init(void);
+void ktime_sync(void);          // Call every KTIME_SYNC_MS; corrects drift
+uint64_t ktime_fallback_ns(void);
+const ktime_vdata_t* ktime_clock_page(void);
+
+static inline uint64_t ktime_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t ktime_ns(void) {
+    const ktime_vdata_t* vd = ktime_vdp;
+    uint32_t seq;
+    uint64_t ns;
+    do {
+        seq = __atomic_load_n(&vd->seq, __ATOMIC_ACQUIRE);
+        if (vd->source != KTIME_SRC_TSC) return ktime_fallback_ns();
+        ns = vd->ns_base + (((ktime_rdtsc() - vd->cycle_last) * vd->mult) >> vd->shift);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&vd->seq, __ATOMIC_RELAXED));
+    return ns;
+}
+
+static inline uint64_t ktime_us(void) { return ktime_ns() / 1000; }
+static inline uint64_t ktime_ms(void) { return ktime_ns() / 1000000; }
+
+static inline uint64_t ktime_real_ns(void) {
+    return ktime_ns() + (uint64_t)__atomic_load_n(&ktime_vdp->realtime_offset_ns, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t ktime_real_seconds(void) { return ktime_real_ns() / 1000000000ull; }
+
+#endif // KTIME_H
@@ -0,0 +1,18 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+
+// LZ4 block format (no frame header), for page-sized buffers. The
+// compressor is the fast greedy single-probe variant; it needs a caller
+// workspace so it can run on any stack.
+#define LZ4_MAX_INPUT 65535
+#define LZ4_HASH_LOG 12
+#define LZ4_WORKSPACE_SIZE ((1u << LZ4_HASH_LOG) * sizeof(uint16_t))
+
+// Compressed size, or 0 if the result would not fit in dst_cap
+int lz4_compress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap, void* workspace);
+// Decompressed size, or -1 for corrupt input or a short dst
+int lz4_decompress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap);
+
+#endif // LZ4_H
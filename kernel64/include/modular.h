@@ -105,6 +105,9 @@ static int receive_ipc_message(ipc_message_t* msg) {
     return 0;
 }
 
+// Fiber-blocking receive on the kernel IPC channel (kernel64/modular.c)
+int receive_ipc_message_wait(ipc_message_t* msg, uint32_t timeout_ms);
+
 // Modular Filesystem Interface
 
 typedef struct fs_snapshot_info {
@@ -113,6 +116,32 @@ typedef struct fs_snapshot_info {
     uint64_t timestamp;
 } fs_snapshot_info_t;
 
+// Asynchronous filesystem I/O: callers queue requests on a submission queue
+// and later reap completions; modules may run them in parallel or merge them.
+// Requests within a batch are unordered: reap writes before submitting the
+// fsync that must cover them.
+typedef enum {
+    FS_IO_READ,
+    FS_IO_WRITE,
+    FS_IO_FSYNC
+} fs_io_op_t;
+
+typedef struct fs_io_request {
+    fs_io_op_t op;
+    const char* path;
+    void* buf;
+    size_t len;
+    uint64_t offset;
+    uint64_t user_data; // Returned unchanged in the completion
+} fs_io_request_t;
+
+typedef struct fs_io_completion {
+    uint64_t user_data;
+    int result; // Bytes transferred (0 for fsync), negative on error
+} fs_io_completion_t;
+
+typedef struct fs_io_ctx fs_io_ctx_t;
+
 typedef struct fs_ops {
     int (*mount)(const char* device, const char* mountpoint);
     int (*unmount)(const char* mountpoint);
@@ -125,6 +154,9 @@ typedef struct fs_ops {
     int (*decrypt)(const char* path, const void* key, size_t key_len);
     int (*backup)(const char* path, const char* dest);
     int (*restore_backup)(const char* backup_path, const char* dest);
+    int (*fsync)(const char* path);
+    // Optional async entry point: take a batch and post each result with fs_io_complete()
+    int (*submit)(fs_io_ctx_t* ctx, const fs_io_request_t* reqs, int count);
     // Add more as needed
 } fs_ops_t;
 
@@ -138,4 +170,24 @@ int register_fs_module(fs_module_t* fs);
 int unregister_fs_module(const char* name);
 fs_module_t* find_fs_module(const char* name);
 
+// Buffered file access: goes through the page cache (kernel64/page_cache.c)
+// unless FS_IO_DIRECT is set, in which case the module is called directly.
+#define FS_IO_DIRECT 0x1
+int fs_read(fs_module_t* fs, const char* path, void* buf, size_t len, uint64_t offset, int flags);
+int fs_write(fs_module_t* fs, const char* path, const void* buf, size_t len, uint64_t offset, int flags);
+int fs_fsync(fs_module_t* fs, const char* path);
+
+// Async I/O API (kernel64/fs_io.c). Modules without .submit are served
+// synchronously through their read/write/fsync ops.
+#define FS_IO_MAX_DEPTH 4096
+fs_io_ctx_t* fs_io_setup(fs_module_t* fs, unsigned depth);
+void fs_io_destroy(fs_io_ctx_t* ctx);
+int fs_io_queue(fs_io_ctx_t* ctx, const fs_io_request_t* reqs, int count);
+int fs_io_submit(fs_io_ctx_t* ctx);
+int fs_io_reap(fs_io_ctx_t* ctx, fs_io_completion_t* out, int max);
+int fs_io_wait(fs_io_ctx_t* ctx, fs_io_completion_t* out, int min, int max);
+int fs_io_inflight(const fs_io_ctx_t* ctx);
+void fs_io_complete(fs_io_ctx_t* ctx, uint64_t user_data, int result);
+void fs_io_set_rgroup(fs_io_ctx_t* ctx, int rgroup); // Charge transfers; submit waits while over quota
+
 #endif // MODULAR_H 
\ No newline at end of file
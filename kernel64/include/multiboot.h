@@ -1,5 +1,78 @@
 #ifndef MULTIBOOT_H
 #define MULTIBOOT_H
 #include <stdint.h>
-... (header contents)
-#endif
+
+// Multiboot (v1) boot information, as handed over by the boot stub in EBX
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+#define MULTIBOOT_INFO_MEMORY 0x00000001
+#define MULTIBOOT_INFO_BOOTDEV 0x00000002
+#define MULTIBOOT_INFO_CMDLINE 0x00000004
+#define MULTIBOOT_INFO_MODS 0x00000008
+#define MULTIBOOT_INFO_MEM_MAP 0x00000040
+#define MULTIBOOT_INFO_FRAMEBUFFER 0x00001000
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+#define MULTIBOOT_MEMORY_RESERVED 2
+#define MULTIBOOT_MEMORY_ACPI_RECLAIMABLE 3
+#define MULTIBOOT_MEMORY_NVS 4
+#define MULTIBOOT_MEMORY_BADRAM 5
+
+typedef struct __attribute__((packed)) {
+    uint32_t flags;
+    uint32_t mem_lower;         // KiB below 1 MiB
+    uint32_t mem_upper;         // KiB above 1 MiB
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+    uint32_t vbe_control_info;
+    uint32_t vbe_mode_info;
+    uint16_t vbe_mode;
+    uint16_t vbe_interface_seg;
+    uint16_t vbe_interface_off;
+    uint16_t vbe_interface_len;
+    uint64_t framebuffer_addr;
+    uint32_t framebuffer_pitch;
+    uint32_t framebuffer_width;
+    uint32_t framebuffer_height;
+    uint8_t framebuffer_bpp;
+    uint8_t framebuffer_type;
+} multiboot_info_t;
+
+// Memory map entry; size does not count the size field itself
+typedef struct __attribute__((packed)) {
+    uint32_t size;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} multiboot_mmap_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t cmdline;
+    uint32_t pad;
+} multiboot_module_t;
+
+// Filled in by the boot stub before the kernel runs
+extern uint32_t multiboot_magic;
+extern uint32_t multiboot_info_addr;
+
+typedef void (*multiboot_mmap_fn)(uint64_t addr, uint64_t len, uint32_t type, void* arg);
+
+void parse_multiboot_info(const void* mb_addr, multiboot_info_t* out);
+// Info passed by the bootloader, NULL on hosted builds or a non-Multiboot boot
+const multiboot_info_t* multiboot_boot_info(void);
+// Calls fn for every memory map entry (or a mem_lower/mem_upper fallback); returns the count, -1 without one
+int multiboot_for_each_mmap(const multiboot_info_t* mb, multiboot_mmap_fn fn, void* arg);
+
+#endif // MULTIBOOT_H
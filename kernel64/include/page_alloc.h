@@ -0,0 +1,70 @@
+#ifndef PAGE_ALLOC_H
+#define PAGE_ALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "multiboot.h"
+
+// Physical page allocator: a binary buddy system over the usable RAM ranges
+// from the Multiboot memory map. Blocks of 2^order pages (orders 0 to
+// PAGE_MAX_ORDER) are naturally aligned, so an order HUGE_PAGE_ORDER block
+// can be mapped with a single 2 MiB page table entry.
+//
+// Order-0 allocations go through small per-CPU lists first. Freed pages are
+// pushed at the hot end (still in this CPU's cache); PA_COLD takes and
+// returns pages at the other end, for buffers the CPU will not touch soon
+// (DMA targets, readahead). The lists refill and drain in batches, so the
+// zone lock is taken once per PAGE_PCP_BATCH pages.
+//
+// Each region keeps its page descriptors at its own start. Hosted builds
+// manage a single buffer borrowed from the host.
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1u << PAGE_SHIFT)
+#define PAGE_MAX_ORDER 10               // 4 MiB blocks
+#define PAGE_ORDERS (PAGE_MAX_ORDER + 1)
+#define HUGE_PAGE_ORDER 9
+#define HUGE_PAGE_SIZE ((size_t)PAGE_SIZE << HUGE_PAGE_ORDER)
+#define PAGE_MAX_REGIONS 32
+#define PAGE_MAX_CPUS 64
+#define PAGE_PCP_HIGH 64                // Per-CPU list length that triggers a drain
+#define PAGE_PCP_BATCH 16
+#define PAGE_HOSTED_MEM (64u * 1024 * 1024)
+
+// Allocation flags
+#define PA_ZERO 0x1
+#define PA_COLD 0x2
+#define PA_NOPROF 0x4                   // Backing for another allocator: not reported to alloc_prof
+
+typedef struct page_alloc_stats {
+    uint64_t total_pages;
+    uint64_t free_pages;                // In buddy lists, per-CPU lists and the huge reserve
+    uint64_t free_blocks[PAGE_ORDERS];
+    uint64_t pcp_pages;
+    uint64_t huge_reserved, huge_free;
+    uint64_t allocs, frees;
+    uint64_t pcp_hits;                  // Order-0 requests served without the zone lock
+    uint64_t failures;
+    uint32_t regions;
+} page_alloc_stats_t;
+
+// Adds the Multiboot RAM ranges (or the hosted buffer); mb may be NULL
+int page_alloc_init(const multiboot_info_t* mb);
+int page_alloc_add_region(uintptr_t start, size_t len);
+
+void* page_alloc(unsigned flags);
+void* page_alloc_pages(unsigned order, unsigned flags);
+void page_free(void* addr);             // Any block from this allocator; the order is remembered
+void page_free_cold(void* addr);
+unsigned page_order_of(size_t bytes);   // Smallest order holding bytes
+
+// 2 MiB pages for large long-lived buffers. A reserve set aside while memory
+// is still unfragmented is used first and refilled by page_free().
+void* page_alloc_huge(unsigned flags);
+int page_huge_reserve(unsigned count);
+
+// Returns per-CPU list pages to the buddy lists
+void page_alloc_drain(void);
+int page_alloc_stats(page_alloc_stats_t* out);
+void page_alloc_dump(void);
+
+#endif // PAGE_ALLOC_H
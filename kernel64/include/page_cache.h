@@ -0,0 +1,44 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "modular.h"
+
+// Unified page cache for fs modules, keyed by (inode, page index).
+// Clean pages are reclaimed with CLOCK; dirty pages are written back
+// once they age past PAGE_CACHE_WRITEBACK_MS or under memory pressure.
+// Frames come in huge-page chunks; the shrinker gives whole chunks back
+// to the page allocator and they are refilled once pressure is gone.
+#define PAGE_CACHE_PAGE_SIZE 4096
+#define PAGE_CACHE_DEFAULT_PAGES 4096   // 16 MiB
+#define PAGE_CACHE_MAX_INODES 1024
+#define PAGE_CACHE_RA_MAX_PAGES 32      // Largest sequential read-ahead window
+#define PAGE_CACHE_WRITEBACK_MS 5000
+#define PAGE_CACHE_DIRTY_RATIO 20       // % dirty pages before forced write-back
+#define PAGE_CACHE_REGROW_MS 1000       // Quiet time after a shrink before refilling
+
+typedef struct page_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t readahead_pages;
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint32_t pages_total;           // In chunks that currently have frames
+    uint32_t pages_used;
+    uint32_t pages_dirty;
+} page_cache_stats_t;
+
+int page_cache_init(uint32_t max_pages);
+void page_cache_shutdown(void);
+int page_cache_read(fs_module_t* fs, const char* path, void* buf, size_t len, uint64_t offset);
+int page_cache_write(fs_module_t* fs, const char* path, const void* buf, size_t len, uint64_t offset);
+// Write back dirty pages in a range (len 0 = whole file)
+int page_cache_flush(fs_module_t* fs, const char* path, uint64_t offset, size_t len);
+// Write back and drop cached pages in a range (len 0 = whole file)
+int page_cache_invalidate(fs_module_t* fs, const char* path, uint64_t offset, size_t len);
+void page_cache_tick(uint64_t now_ms);
+uint32_t page_cache_shrink(uint32_t nr_pages);
+void page_cache_get_stats(page_cache_stats_t* out);
+
+#endif // PAGE_CACHE_H
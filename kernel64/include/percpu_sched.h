@@ -0,0 +1,51 @@
+#ifndef PERCPU_SCHED_H
+#define PERCPU_SCHED_H
+
+#include <stdint.h>
+#include "prio_sched.h"
+#include "spinlock.h"
+
+// Per-CPU priority run queues with idle work stealing and periodic
+// rebalancing. Each queue has its own lock; no path holds two at once.
+#define SCHED_MAX_CPUS 64
+#define SCHED_CACHE_HOT_MS 5        // Tasks that ran this recently are not stolen first
+#define SCHED_WARM_SLACK 1          // Extra tasks tolerated to stay on the last CPU
+#define SCHED_IMBALANCE_PCT 25      // Load gap required before rebalancing moves tasks
+
+typedef uint64_t cpu_mask_t;
+#define CPU_MASK_ALL (~(cpu_mask_t)0)
+
+typedef struct sched_task {
+    prio_entity_t rq;
+    int pid;
+    cpu_mask_t affinity;
+    int cpu;                // Queue currently holding the task, -1 if not queued
+    int last_cpu;           // Where it last ran, for cache-warm placement
+    uint64_t last_ran_ms;
+    uint64_t sum_exec_ms;
+} sched_task_t;
+
+typedef struct cpu_rq {
+    spinlock_t lock;
+    prio_rq_t rq;
+    sched_task_t* curr;
+    uint64_t curr_start_ms;
+    uint32_t load_avg;      // EWMA of nr_running, scaled by 1024
+    uint64_t nr_switches;
+    uint64_t nr_steals;
+    uint64_t nr_migrations;
+} __attribute__((aligned(64))) cpu_rq_t;
+
+void percpu_sched_init(int nr_cpus);
+int percpu_sched_nr_cpus(void);
+void sched_task_init(sched_task_t* t, int pid, int priority, cpu_mask_t affinity);
+int sched_wake_task(sched_task_t* t);
+void sched_dequeue_task(sched_task_t* t);
+int sched_set_task_priority(sched_task_t* t, int priority);
+int sched_set_affinity(sched_task_t* t, cpu_mask_t mask);
+void sched_put_prev(int cpu, uint64_t now_ms);
+sched_task_t* sched_schedule(int cpu, uint64_t now_ms);
+void sched_rebalance(uint64_t now_ms);
+const cpu_rq_t* sched_cpu_rq(int cpu);
+
+#endif // PERCPU_SCHED_H
@@ -0,0 +1,107 @@
+#ifndef PRIO_SCHED_H
+#define PRIO_SCHED_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// O(1) priority run queue: one FIFO per priority level plus a 32-bit ready
+// bitmap. Pick-next is a single find-first-set; enqueue/dequeue are O(1).
+#define PRIO_LEVELS 32
+#define PRIO_DEFAULT 16
+#define PRIO_MIN_SLICE_MS 5
+#define PRIO_SLICE_STEP_MS 6   // Priority 0 gets 191 ms, priority 31 gets 5 ms
+
+typedef struct prio_entity {
+    struct prio_entity* next;
+    struct prio_entity* prev;
+    int priority;           // 0 (highest) to 31 (lowest)
+    uint32_t timeslice_ms;  // Left in the current slice
+    int queued;
+} prio_entity_t;
+
+typedef struct prio_rq {
+    uint32_t bitmap;        // Bit p set while level p has runnable entities
+    prio_entity_t* head[PRIO_LEVELS];
+    prio_entity_t* tail[PRIO_LEVELS];
+    int nr_running;
+} prio_rq_t;
+
+static inline uint32_t prio_timeslice_ms(int priority) {
+    return PRIO_MIN_SLICE_MS + (uint32_t)(PRIO_LEVELS - 1 - priority) * PRIO_SLICE_STEP_MS;
+}
+
+static inline void prio_rq_init(prio_rq_t* rq) {
+    rq->bitmap = 0;
+    rq->nr_running = 0;
+    for (int i = 0; i < PRIO_LEVELS; ++i) rq->head[i] = rq->tail[i] = NULL;
+}
+
+static inline void prio_entity_init(prio_entity_t* e, int priority) {
+    if (priority < 0) priority = 0;
+    if (priority >= PRIO_LEVELS) priority = PRIO_LEVELS - 1;
+    e->next = e->prev = NULL;
+    e->priority = priority;
+    e->timeslice_ms = prio_timeslice_ms(priority);
+    e->queued = 0;
+}
+
+static inline void prio_rq_enqueue(prio_rq_t* rq, prio_entity_t* e) {
+    if (e->queued) return;
+    int p = e->priority;
+    e->next = NULL;
+    e->prev = rq->tail[p];
+    if (rq->tail[p]) rq->tail[p]->next = e; else rq->head[p] = e;
+    rq->tail[p] = e;
+    rq->bitmap |= 1u << p;
+    rq->nr_running++;
+    e->queued = 1;
+}
+
+static inline void prio_rq_dequeue(prio_rq_t* rq, prio_entity_t* e) {
+    if (!e->queued) return;
+    int p = e->priority;
+    if (e->prev) e->prev->next = e->next; else rq->head[p] = e->next;
+    if (e->next) e->next->prev = e->prev; else rq->tail[p] = e->prev;
+    if (!rq->head[p]) rq->bitmap &= ~(1u << p);
+    e->next = e->prev = NULL;
+    rq->nr_running--;
+    e->queued = 0;
+}
+
+// Highest-priority runnable entity (left queued)
+static inline prio_entity_t* prio_rq_peek(const prio_rq_t* rq) {
+    if (!rq->bitmap) return NULL;
+    return rq->head[__builtin_ctz(rq->bitmap)];
+}
+
+static inline void prio_rq_set_priority(prio_rq_t* rq, prio_entity_t* e, int priority) {
+    int was_queued = e->queued;
+    prio_rq_dequeue(rq, e);
+    prio_entity_init(e, priority);
+    if (was_queued) prio_rq_enqueue(rq, e);
+}
+
+// Charge run time; when the slice is used up, refill it and rotate to the
+// tail of the level. Returns 1 if the entity was rotated.
+static inline int prio_rq_charge(prio_rq_t* rq, prio_entity_t* e, uint32_t ran_ms) {
+    if (e->timeslice_ms > ran_ms) {
+        e->timeslice_ms -= ran_ms;
+        return 0;
+    }
+    e->timeslice_ms = prio_timeslice_ms(e->priority);
+    if (e->queued) {
+        prio_rq_dequeue(rq, e);
+        prio_rq_enqueue(rq, e);
+    }
+    return 1;
+}
+
+// Fix neighbour links after an entity has been copied to a new address
+static inline void prio_rq_relocate(prio_rq_t* rq, prio_entity_t* e) {
+    if (!e->queued) return;
+    int p = e->priority;
+    if (e->prev) e->prev->next = e; else rq->head[p] = e;
+    if (e->next) e->next->prev = e; else rq->tail[p] = e;
+}
+
+#endif // PRIO_SCHED_H
@@ -13,7 +13,40 @@ typedef struct {
     // Add more fields as needed
 } resource_stats_t;
 
+// Per-task (and global) EDF statistics
+typedef struct {
+    uint64_t jobs;
+    uint64_t misses;
+    uint64_t throttled; // Jobs stopped for exhausting their WCET budget
+    uint64_t max_lateness_ms;
+    uint64_t total_lateness_ms;
+} rt_task_stats_t;
+
+// Admission test for periodic tasks. Dispatch is always EDF; RM applies the
+// stricter rate-monotonic analysis (hyperbolic bound, then response time).
+typedef enum {
+    RT_ADMIT_EDF,
+    RT_ADMIT_RM
+} rt_admit_policy_t;
+
+#define RT_UTIL_CAP_PPM 950000 // Leave 5% of the RT CPU for everything else
+
 // API
+void scheduler_init(int nr_cpus); // 0 = one run queue per host CPU
+int scheduler_add_process(int pid, void* hProcess, int priority, int is_realtime, uint64_t deadline, int is_foreground);
+int scheduler_add_periodic(int pid, void* hProcess, int priority, uint64_t period_ms, uint64_t wcet_ms, int is_foreground);
+void scheduler_job_complete(int pid);
+int scheduler_set_priority(int pid, int priority);
+int scheduler_set_affinity(int pid, uint64_t cpu_mask);
+int scheduler_pick_next(int cpu);
+void scheduler_set_admission_policy(rt_admit_policy_t policy);
+uint64_t scheduler_rt_utilization_ppm(void);
+int scheduler_get_rt_stats(int pid, rt_task_stats_t* out); // pid < 0 = totals
+void scheduler_tick(void);
+uint64_t scheduler_next_event_ms(uint64_t now_ms);
+// Memory for real-time tasks, from the reserved RT heap pool (bounded O(1))
+void* scheduler_rt_alloc(size_t size);
+void scheduler_rt_free(void* p);
 void update_resource_stats(void);
 void scale_resources(void);
 void prioritize_processes(void);
@@ -0,0 +1,55 @@
+#ifndef SCHED_TRACE_H
+#define SCHED_TRACE_H
+
+#include <stdint.h>
+
+// Scheduler latency tracing: tracepoints feed per-task and global log-linear
+// (HDR-style) histograms. Values are in microseconds; each bucket is within
+// 12.5% of its lower bound. Recording is a few adds, so it stays on by default.
+#define SCHED_TRACE_MAX_TASKS 128
+#define SCHED_TRACE_SUB_BITS 4
+#define SCHED_TRACE_MAX_BITS 40 // Values >= 2^40 us land in the last bucket
+#define SCHED_TRACE_BUCKETS ((SCHED_TRACE_MAX_BITS - SCHED_TRACE_SUB_BITS + 2) << (SCHED_TRACE_SUB_BITS - 1))
+
+typedef enum {
+    SCHED_LAT_WAKEUP,   // Runnable (wakeup or preemption) until picked
+    SCHED_LAT_RUN,      // Picked until switched out
+    SCHED_LAT_SLACK,    // Time left before the deadline when a job completed
+    SCHED_LAT_METRICS
+} sched_lat_metric_t;
+
+typedef struct {
+    uint32_t counts[SCHED_TRACE_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max;
+} sched_hist_t;
+
+typedef struct {
+    int pid; // -1 = global
+    sched_hist_t hist[SCHED_LAT_METRICS];
+    uint64_t wakeups;
+    uint64_t enqueues;
+    uint64_t switches;
+    uint64_t misses; // Deadline passed before the job completed
+    uint64_t runnable_since_us; // 0 = not waiting
+    uint64_t run_start_us;      // 0 = not running
+} sched_trace_task_t;
+
+void sched_trace_init(uint64_t (*clock_us)(void));
+void sched_trace_enable(int on);
+void sched_trace_reset(void);
+
+// Tracepoints
+void sched_trace_wakeup(int pid, int cpu);
+void sched_trace_enqueue(int pid, int cpu);
+void sched_trace_pick_next(int pid, int cpu);
+void sched_trace_switch_out(int pid, int cpu, int still_runnable);
+void sched_trace_deadline(int pid, uint64_t deadline_us);
+
+// Queries (pid < 0 = global)
+const sched_trace_task_t* sched_trace_get(int pid);
+uint64_t sched_hist_percentile(const sched_hist_t* h, uint32_t per_10000);
+void sched_trace_dump(int pid);
+
+#endif // SCHED_TRACE_H
@@ -0,0 +1,41 @@
+#ifndef SHRINKER_H
+#define SHRINKER_H
+
+#include <stdint.h>
+
+// Shrinkers let caches give memory back under pressure. A cache registers
+// a count callback (pages it could free right now) and a scan callback
+// (free up to nr pages). shrink_memory() asks every shrinker for a share
+// of its freeable pages: freeable >> priority, scaled down by seeks, the
+// cost of rebuilding a page. It starts at SHRINK_DEF_PRIORITY and lowers
+// the priority (asks for more) until enough is freed; priority 0 asks for
+// everything. Work too small to be worth a scan carries over to the next call.
+#define SHRINK_DEF_PRIORITY 6
+#define SHRINK_BATCH 32                 // Pages per scan call
+#define SHRINKER_DEFAULT_SEEKS 2
+#define SHRINK_STOP ((unsigned long)-1) // From scan: cannot make progress now
+
+typedef struct shrinker shrinker_t;
+typedef unsigned long (*shrink_count_fn)(shrinker_t* s);
+typedef unsigned long (*shrink_scan_fn)(shrinker_t* s, unsigned long nr, int priority);
+
+struct shrinker {
+    const char* name;
+    shrink_count_fn count;
+    shrink_scan_fn scan;                // Pages freed, or SHRINK_STOP
+    uint32_t seeks;                     // 0 means SHRINKER_DEFAULT_SEEKS
+    void* priv;
+    // Owned by the registry
+    struct shrinker* next;
+    uint32_t busy;
+    uint64_t deferred;
+    uint64_t scanned, freed;
+};
+
+int shrinker_register(shrinker_t* s);   // Registering twice is a no-op
+void shrinker_unregister(shrinker_t* s); // Waits for a running scan to finish
+unsigned long shrink_caches(int priority); // One pass; returns pages freed
+unsigned long shrink_memory(unsigned long nr_pages);
+void shrinker_dump(void);
+
+#endif // SHRINKER_H
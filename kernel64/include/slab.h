@@ -0,0 +1,48 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Slab allocator: one cache per object type. Objects are carved out of
+// slab-aligned blocks, so a free finds its slab by masking the address.
+// Each CPU keeps two magazines of free objects that it allocates from and
+// frees into without taking the cache lock; full and empty magazines are
+// swapped with a per-cache depot, and only a depot miss touches the slabs.
+#define KMEM_MAX_CACHES 64
+#define KMEM_MAX_CPUS 64
+#define KMEM_NAME_LEN 32
+#define KMEM_MAG_SIZE 16            // Objects per magazine
+#define KMEM_SLAB_SIZE (16 * 1024)  // Smallest slab; grows for large objects
+#define KMEM_MIN_OBJS 8             // Objects a slab must hold at least
+
+typedef struct kmem_cache kmem_cache_t;
+
+// Runs once per object when its slab is created. Objects freed back to a
+// cache with a constructor must be returned in their constructed state.
+typedef void (*kmem_ctor_t)(void* obj);
+
+typedef struct kmem_stats {
+    const char* name;
+    size_t obj_size;                // Including alignment padding
+    size_t slab_size;
+    uint32_t objs_per_slab;
+    uint64_t slabs;
+    uint64_t total;                 // Objects across all slabs
+    uint64_t live;                  // Allocated and not yet freed
+    uint64_t cached;                // Free but parked in magazines
+    uint32_t util_pct;              // live / total
+    uint64_t allocs, frees;
+    uint64_t mag_hits;              // Allocations served from a CPU magazine
+} kmem_stats_t;
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor);
+void kmem_cache_destroy(kmem_cache_t* c);
+void* kmem_cache_alloc(kmem_cache_t* c);
+void* kmem_cache_zalloc(kmem_cache_t* c);  // Zeroed, then constructed
+void kmem_cache_free(kmem_cache_t* c, void* obj);
+size_t kmem_cache_shrink(kmem_cache_t* c); // Returns bytes given back
+int kmem_cache_stats(const kmem_cache_t* c, kmem_stats_t* out);
+void kmem_cache_dump(void);
+
+#endif // SLAB_H
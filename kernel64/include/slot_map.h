@@ -0,0 +1,68 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Slot map: elements live packed in a caller-provided dense array, so
+// iteration is a plain loop over [0, count). A handle names a slot that
+// records where its element currently is; insert, lookup and remove are O(1).
+// Handles are positive ints (slot index in the low 16 bits, 15-bit
+// generation above), so they drop into APIs that use -1 for errors, and a
+// handle to a removed element never matches the element that reuses its slot.
+#define SLOT_INDEX_BITS 16
+#define SLOT_INDEX_MASK ((1u << SLOT_INDEX_BITS) - 1)
+#define SLOT_GEN_MASK 0x7FFFu
+#define SLOT_MAX_CAPACITY (1u << SLOT_INDEX_BITS)
+
+typedef struct slot_entry {
+    uint16_t gen;           // Generation of the current (or next) occupant, never 0
+    uint32_t index;         // Dense index while live, next free slot otherwise
+} slot_entry_t;
+
+typedef struct slot_map {
+    void* dense;            // capacity * elem_size bytes
+    size_t elem_size;
+    uint32_t* dense_slot;   // Dense index -> slot
+    slot_entry_t* slots;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t free_head;
+} slot_map_t;
+
+int slot_map_init(slot_map_t* sm, void* dense, size_t elem_size,
+    uint32_t* dense_slot, slot_entry_t* slots, uint32_t capacity);
+void slot_map_clear(slot_map_t* sm);
+int slot_map_insert(slot_map_t* sm, void** elem_out); // Handle, or -1 when full
+// Removes by moving the last element into the hole. Returns the hole's dense
+// index (-1 for a stale handle); if it is < count afterwards, the element
+// now there was moved and intrusive links to it must be fixed up.
+int slot_map_remove(slot_map_t* sm, int handle);
+
+static inline void* slot_map_at(const slot_map_t* sm, uint32_t i) {
+    return (char*)sm->dense + (size_t)i * sm->elem_size;
+}
+
+static inline int slot_map_handle_at(const slot_map_t* sm, uint32_t i) {
+    uint32_t slot = sm->dense_slot[i];
+    return (int)(((uint32_t)sm->slots[slot].gen << SLOT_INDEX_BITS) | slot);
+}
+
+static inline int slot_map_index(const slot_map_t* sm, int handle) {
+    if (handle <= 0) return -1;
+    uint32_t slot = (uint32_t)handle & SLOT_INDEX_MASK;
+    if (slot >= sm->capacity) return -1;
+    const slot_entry_t* e = &sm->slots[slot];
+    if (e->gen != ((uint32_t)handle >> SLOT_INDEX_BITS)) return -1;
+    // A free slot keeps its next generation and a free-list link in index,
+    // so a stale or forged handle can match gen; it must also own its element
+    if (e->index >= sm->count || sm->dense_slot[e->index] != slot) return -1;
+    return (int)e->index;
+}
+
+static inline void* slot_map_get(const slot_map_t* sm, int handle) {
+    int i = slot_map_index(sm, handle);
+    return i < 0 ? NULL : slot_map_at(sm, (uint32_t)i);
+}
+
+#endif // SLOT_MAP_H
@@ -0,0 +1,40 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+
+// Minimal test-and-test-and-set spinlock for short kernel critical sections.
+// Safe to use from the freestanding kernel and from hosted worker threads.
+typedef struct spinlock {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile ("pause");
+#else
+    __asm__ volatile ("" ::: "memory");
+#endif
+}
+
+static inline void spin_init(spinlock_t* l) {
+    __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline void spin_lock(spinlock_t* l) {
+    while (__atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&l->locked, __ATOMIC_RELAXED)) cpu_relax();
+    }
+}
+
+static inline int spin_trylock(spinlock_t* l) {
+    return __atomic_exchange_n(&l->locked, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+static inline void spin_unlock(spinlock_t* l) {
+    __atomic_store_n(&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+#endif // SPINLOCK_H
@@ -0,0 +1,37 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+// Hierarchical timing wheel on a millisecond monotonic clock: 4 levels of
+// 64 slots cover 1 ms .. ~4.6 h (later timers are parked in the last slot
+// and re-filed). Add/delete are O(1); expiry cascades a slot at a time.
+#define TW_LEVELS 4
+#define TW_SLOT_BITS 6
+#define TW_SLOTS (1u << TW_SLOT_BITS)
+#define TW_NO_TIMER UINT64_MAX
+
+typedef struct ktimer ktimer_t;
+typedef void (*ktimer_fn_t)(ktimer_t* t, void* arg);
+
+struct ktimer {
+    ktimer_t* next;
+    ktimer_t** pprev;       // NULL when not pending
+    uint64_t expires;       // Absolute ms
+    uint32_t period_ms;     // 0 = one-shot
+    uint32_t overruns;      // Periods skipped because the loop fell behind
+    ktimer_fn_t fn;
+    void* arg;
+    const char* name;
+};
+
+void timer_wheel_init(uint64_t now_ms);
+void ktimer_init(ktimer_t* t, const char* name, ktimer_fn_t fn, void* arg);
+void ktimer_add(ktimer_t* t, uint64_t expires_ms);
+void ktimer_add_periodic(ktimer_t* t, uint64_t now_ms, uint32_t period_ms);
+void ktimer_del(ktimer_t* t);
+int ktimer_pending(const ktimer_t* t);
+int timer_wheel_run(uint64_t now_ms);           // Fires everything due, returns count
+uint64_t timer_wheel_next_expiry(void);         // Absolute ms, TW_NO_TIMER if idle
+
+#endif // TIMER_WHEEL_H
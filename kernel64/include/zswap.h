@@ -0,0 +1,75 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "modular.h"
+
+// Compressed RAM swap. A page given to zswap_store() is kept in one of three forms:
+// - a single word, when the page repeats that word (zero pages and the like)
+// - LZ4-compressed in a pool on the kernel heap
+// - in a swap file on a filesystem module
+// When the pool reaches its cap, the oldest compressed entries are written
+// back to the swap file. Pages that do not compress well go straight to the
+// file, or are rejected when there is none.
+//
+// Anonymous pages are the swappable unit. Their owner maps one to use it
+// and unmaps it when done. zswap_reclaim() moves cold unmapped pages into
+// zswap and frees their frames; the next anon_page_map() brings the page
+// back, the way a fault would.
+#define ZSWAP_MAX_ENTRIES 16384         // Swapped-out pages, 64 MiB
+#define ZSWAP_FILE_SLOTS 16384          // Page-sized slots in the swap file
+#define ZSWAP_WORKSPACES 8              // Concurrent compressions
+#define ZSWAP_SWAPFILE "neonova.swap"
+#define ZSWAP_NONE 0
+
+typedef struct zswap_params {
+    uint32_t pool_pct;                  // Pool cap, % of managed RAM
+    uint32_t max_ratio_pct;             // Worse compression than this goes to the file
+    uint32_t cold_ms;                   // Anon pages idle this long may be reclaimed
+    uint32_t batch;                     // Pages per reclaim from the RAM manager
+} zswap_params_t;
+
+#define ZSWAP_DEFAULT_PARAMS { 20, 75, 2000, 64 }
+
+typedef struct zswap_stats {
+    uint64_t stored;                    // Entries currently held, in any form
+    uint64_t same_filled;
+    uint64_t compressed;
+    uint64_t file_pages;
+    uint64_t pool_bytes, pool_limit;
+    uint64_t stores, loads;
+    uint64_t written_back;
+    uint64_t rejected;
+    uint64_t swapouts, swapins;         // Anon page traffic
+} zswap_stats_t;
+
+// backing may be NULL: full pools and incompressible pages are then rejected
+int zswap_init(fs_module_t* backing, const char* path);
+void zswap_get_params(zswap_params_t* out);
+int zswap_set_params(const zswap_params_t* p);
+
+uint32_t zswap_store(const void* page);     // Entry, or ZSWAP_NONE
+int zswap_load(uint32_t entry, void* page); // Frees the entry on success
+void zswap_invalidate(uint32_t entry);
+int zswap_writeback(unsigned nr);           // Oldest compressed entries to the file
+void zswap_stats(zswap_stats_t* out);
+void zswap_dump(void);
+
+typedef struct anon_page {
+    void* page;                         // NULL while swapped out
+    uint32_t entry;
+    uint16_t state;
+    uint16_t pins;
+    uint64_t last_ms;
+    struct anon_page* lru_prev;
+    struct anon_page* lru_next;
+} anon_page_t;
+
+int anon_page_alloc(anon_page_t* ap);   // Zeroed and resident, not mapped
+void* anon_page_map(anon_page_t* ap);   // Swaps in if needed; stays resident until unmapped
+void anon_page_unmap(anon_page_t* ap);
+void anon_page_free(anon_page_t* ap);
+unsigned zswap_reclaim(unsigned nr);    // Returns frames freed
+
+#endif // ZSWAP_H
@@ -0,0 +1,438 @@
+// TLSF kernel heap with per-pool locks and per-tag accounting
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kheap.h"
+#include "spinlock.h"
+#include "page_alloc.h"
+#include "alloc_prof.h"
+
+#define ALIGN_LOG2 4
+#define ALIGN (1u << ALIGN_LOG2)
+#define SL_LOG2 5
+#define SL_COUNT (1u << SL_LOG2)
+#define FL_SHIFT (SL_LOG2 + ALIGN_LOG2)
+#define FL_MAX 30
+#define FL_COUNT (FL_MAX - FL_SHIFT + 1)
+#define SMALL_BLOCK (1u << FL_SHIFT)
+
+#define BLOCK_FREE 0x1
+#define BLOCK_TRACKED 0x2        // Recorded by the allocation profiler
+#define BLOCK_MAGIC 0xA0        // High bits of flags; catches frees of foreign pointers
+
+// Block header. The free-list links overlay the payload, so a used block
+// costs BLOCK_HDR bytes and the smallest block holds two pointers.
+typedef struct kblock {
+    struct kblock* prev_phys;   // Neighbour at the lower address, NULL at a region start
+    uint32_t size;              // Payload bytes
+    uint16_t tag;
+    uint8_t pool;
+    uint8_t flags;
+    struct kblock* next_free;
+    struct kblock* prev_free;
+} kblock_t;
+
+#define BLOCK_HDR offsetof(kblock_t, next_free)
+#define BLOCK_MIN (sizeof(kblock_t) - BLOCK_HDR)
+
+// A region taken from the page allocator, handed back once it is all free
+typedef struct {
+    void* mem;
+    size_t bytes;
+    kblock_t* first;
+} kheap_grown_t;
+
+typedef struct {
+    spinlock_t lock;
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[FL_COUNT];
+    kblock_t* blocks[FL_COUNT][SL_COUNT];
+    kheap_pool_stats_t stats;
+    kheap_grown_t grown[KHEAP_MAX_GROWN];
+    int nr_grown;
+} kheap_ctl_t;
+
+typedef struct {
+    char name[16];
+    uint64_t bytes, peak, allocs;
+} kheap_tag_t;
+
+static const char* pool_names[KHEAP_POOLS] = { "normal", "dma", "rt" };
+static kheap_ctl_t pools[KHEAP_POOLS];
+static kheap_tag_t tags[KHEAP_MAX_TAGS] = { { "untagged", 0, 0, 0 } };
+static int nr_tags = 1;
+static spinlock_t tag_lock = SPINLOCK_INIT;
+static spinlock_t init_lock = SPINLOCK_INIT;
+static volatile int initialized;
+
+static uint8_t boot_normal[KHEAP_NORMAL_BOOT] __attribute__((aligned(4096)));
+static uint8_t boot_dma[KHEAP_DMA_BOOT] __attribute__((aligned(4096)));
+static uint8_t boot_rt[KHEAP_RT_BOOT] __attribute__((aligned(4096)));
+
+static int fls_size(size_t x) { return 63 - __builtin_clzll((unsigned long long)x); }
+
+static size_t align_up(size_t v, size_t a) { return (v + a - 1) & ~(a - 1); }
+
+static kblock_t* next_phys(const kblock_t* b) {
+    return (kblock_t*)((char*)b + BLOCK_HDR + b->size);
+}
+
+static void* block_payload(const kblock_t* b) { return (char*)b + BLOCK_HDR; }
+
+static kblock_t* payload_block(const void* p) { return (kblock_t*)((char*)p - BLOCK_HDR); }
+
+static void mapping_insert(size_t size, int* fl, int* sl) {
+    if (size < SMALL_BLOCK) {
+        *fl = 0;
+        *sl = (int)(size / (SMALL_BLOCK / SL_COUNT));
+    } else {
+        int f = fls_size(size);
+        *sl = (int)((size >> (f - SL_LOG2)) ^ SL_COUNT);
+        *fl = f - (FL_SHIFT - 1);
+    }
+}
+
+// Rounds up to the next bin boundary so any block found there is big enough
+static void mapping_search(size_t size, int* fl, int* sl) {
+    if (size >= SMALL_BLOCK) size += ((size_t)1 << (fls_size(size) - SL_LOG2)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+static void insert_free(kheap_ctl_t* c, kblock_t* b) {
+    int fl, sl;
+    mapping_insert(b->size, &fl, &sl);
+    b->flags = BLOCK_MAGIC | BLOCK_FREE;
+    b->prev_free = NULL;
+    b->next_free = c->blocks[fl][sl];
+    if (b->next_free) b->next_free->prev_free = b;
+    c->blocks[fl][sl] = b;
+    c->fl_bitmap |= 1u << fl;
+    c->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void remove_free(kheap_ctl_t* c, kblock_t* b) {
+    int fl, sl;
+    mapping_insert(b->size, &fl, &sl);
+    if (b->prev_free) b->prev_free->next_free = b->next_free;
+    else c->blocks[fl][sl] = b->next_free;
+    if (b->next_free) b->next_free->prev_free = b->prev_free;
+    if (!c->blocks[fl][sl]) {
+        c->sl_bitmap[fl] &= ~(1u << sl);
+        if (!c->sl_bitmap[fl]) c->fl_bitmap &= ~(1u << fl);
+    }
+    b->flags = BLOCK_MAGIC;
+}
+
+// Pool lock held. Unlinks a free block of at least size bytes, or NULL.
+static kblock_t* take_block(kheap_ctl_t* c, size_t size) {
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= (int)FL_COUNT) return NULL;
+    uint32_t sl_map = c->sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint32_t fl_map = c->fl_bitmap & (~0u << (fl + 1));
+        if (!fl_map) return NULL;
+        fl = __builtin_ctz(fl_map);
+        sl_map = c->sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    kblock_t* b = c->blocks[fl][sl];
+    remove_free(c, b);
+    return b;
+}
+
+// Pool lock held. Returns the tail beyond size to the free lists.
+static void trim_tail(kheap_ctl_t* c, kblock_t* b, size_t size) {
+    if (b->size < size + BLOCK_HDR + BLOCK_MIN) return;
+    kblock_t* rest = (kblock_t*)((char*)block_payload(b) + size);
+    rest->prev_phys = b;
+    rest->size = (uint32_t)(b->size - size - BLOCK_HDR);
+    rest->pool = b->pool;
+    rest->tag = 0;
+    b->size = (uint32_t)size;
+    next_phys(rest)->prev_phys = rest;
+    // The block after b was used, so rest has no free neighbour to merge with
+    insert_free(c, rest);
+}
+
+// Pool lock held. Splits off the bytes before at as a free block; returns
+// the block that now starts at at.
+static kblock_t* trim_head(kheap_ctl_t* c, kblock_t* b, kblock_t* at) {
+    size_t gap = (size_t)((char*)at - (char*)b);
+    at->prev_phys = b;
+    at->size = (uint32_t)(b->size - gap);
+    at->pool = b->pool;
+    at->flags = BLOCK_MAGIC;
+    next_phys(at)->prev_phys = at;
+    b->size = (uint32_t)(gap - BLOCK_HDR);
+    insert_free(c, b);
+    return at;
+}
+
+static void account(kheap_ctl_t* c, kblock_t* b, int tag) {
+    b->tag = (uint16_t)tag;
+    c->stats.used += b->size + BLOCK_HDR;
+    if (c->stats.used > c->stats.peak) c->stats.peak = c->stats.used;
+    c->stats.allocs++;
+    kheap_tag_t* t = &tags[tag];
+    uint64_t now = __atomic_add_fetch(&t->bytes, b->size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&t->allocs, 1, __ATOMIC_RELAXED);
+    if (now > t->peak) t->peak = now; // Racy high-water mark is fine for stats
+}
+
+static int add_region(kheap_pool_t pool, void* mem, size_t size, int grown) {
+    if (pool >= KHEAP_POOLS || !mem) return -1;
+    uintptr_t start = align_up((uintptr_t)mem, ALIGN);
+    size_t usable = size - (size_t)(start - (uintptr_t)mem);
+    if (size < (size_t)(start - (uintptr_t)mem) + 2 * BLOCK_HDR + BLOCK_MIN) return -1;
+    usable &= ~(size_t)(ALIGN - 1);
+    if (usable - 2 * BLOCK_HDR > KHEAP_MAX_ALLOC) usable = KHEAP_MAX_ALLOC + 2 * BLOCK_HDR;
+    kheap_ctl_t* c = &pools[pool];
+    kblock_t* b = (kblock_t*)start;
+    b->prev_phys = NULL;
+    b->size = (uint32_t)(usable - 2 * BLOCK_HDR);
+    b->pool = (uint8_t)pool;
+    b->tag = 0;
+    // Zero-sized used sentinel at the end stops coalescing past the region
+    kblock_t* end = next_phys(b);
+    end->prev_phys = b;
+    end->size = 0;
+    end->pool = (uint8_t)pool;
+    end->tag = 0;
+    end->flags = BLOCK_MAGIC;
+    spin_lock(&c->lock);
+    insert_free(c, b);
+    c->stats.size += usable;
+    c->stats.regions++;
+    // Past the table a grown region simply stays for good
+    if (grown && c->nr_grown < KHEAP_MAX_GROWN) {
+        c->grown[c->nr_grown].mem = mem;
+        c->grown[c->nr_grown].bytes = size;
+        c->grown[c->nr_grown].first = b;
+        c->nr_grown++;
+    }
+    spin_unlock(&c->lock);
+    return 0;
+}
+
+int kheap_add_region(kheap_pool_t pool, void* mem, size_t size) {
+    return add_region(pool, mem, size, 0);
+}
+
+int kheap_init(void) {
+    if (__atomic_load_n(&initialized, __ATOMIC_ACQUIRE)) return 0;
+    spin_lock(&init_lock);
+    if (!initialized) {
+        for (int p = 0; p < KHEAP_POOLS; ++p) spin_init(&pools[p].lock);
+        kheap_add_region(KHEAP_NORMAL, boot_normal, sizeof(boot_normal));
+        kheap_add_region(KHEAP_DMA, boot_dma, sizeof(boot_dma));
+        kheap_add_region(KHEAP_RT, boot_rt, sizeof(boot_rt));
+        __atomic_store_n(&initialized, 1, __ATOMIC_RELEASE);
+        printf("[KHeap] TLSF pools ready: normal %u KiB, dma %u KiB, rt %u KiB\n",
+            KHEAP_NORMAL_BOOT / 1024, KHEAP_DMA_BOOT / 1024, KHEAP_RT_BOOT / 1024);
+    }
+    spin_unlock(&init_lock);
+    return 0;
+}
+
+int kheap_tag(const char* name) {
+    if (!name) return KHEAP_TAG_NONE;
+    spin_lock(&tag_lock);
+    int id = -1;
+    for (int i = 0; i < nr_tags; ++i) {
+        if (strncmp(tags[i].name, name, sizeof(tags[i].name) - 1) == 0) { id = i; break; }
+    }
+    if (id < 0 && nr_tags < KHEAP_MAX_TAGS) {
+        id = nr_tags++;
+        strncpy(tags[id].name, name, sizeof(tags[id].name) - 1);
+    }
+    spin_unlock(&tag_lock);
+    return id < 0 ? KHEAP_TAG_NONE : id;
+}
+
+static void release_mem(void* mem) {
+#if defined(_WIN32) || defined(__linux__)
+    free(mem);
+#else
+    page_free(mem);
+#endif
+}
+
+// NORMAL and DMA grow from the page allocator (hosted builds borrow from the
+// host). The RT pool never grows: its allocations must not wait on a refill.
+static int grow(kheap_pool_t pool, size_t need) {
+    if (pool == KHEAP_RT) return -1;
+    size_t bytes = need + 4 * BLOCK_HDR + ALIGN;
+    if (bytes < KHEAP_GROW_SIZE) bytes = KHEAP_GROW_SIZE;
+#if defined(_WIN32) || defined(__linux__)
+    void* mem = malloc(bytes);
+#else
+    unsigned order = page_order_of(bytes);
+    if (order > PAGE_MAX_ORDER) return -1;
+    bytes = (size_t)PAGE_SIZE << order;
+    void* mem = page_alloc_pages(order, PA_NOPROF); // Profiled block by block instead
+#endif
+    if (!mem) return -1;
+    if (add_region(pool, mem, bytes, 1) < 0) {
+        release_mem(mem);
+        return -1;
+    }
+    return 0;
+}
+
+// Hands grown regions that are entirely free back to where they came from.
+// Returns the pages released.
+unsigned long kheap_trim(void) {
+    unsigned long pages = 0;
+    for (int p = 0; p < KHEAP_POOLS; ++p) {
+        kheap_ctl_t* c = &pools[p];
+        void* done[KHEAP_MAX_GROWN];
+        int nr_done = 0;
+        spin_lock(&c->lock);
+        for (int i = 0; i < c->nr_grown; ) {
+            kheap_grown_t* g = &c->grown[i];
+            kblock_t* b = g->first;
+            // One free block running up to the end sentinel: nothing left in it
+            if (!(b->flags & BLOCK_FREE) || next_phys(b)->size != 0) { ++i; continue; }
+            remove_free(c, b);
+            c->stats.size -= b->size + 2 * BLOCK_HDR;
+            c->stats.regions--;
+            pages += (unsigned long)(g->bytes / PAGE_SIZE);
+            done[nr_done++] = g->mem;
+            *g = c->grown[--c->nr_grown];
+        }
+        spin_unlock(&c->lock);
+        for (int i = 0; i < nr_done; ++i) release_mem(done[i]);
+    }
+    return pages;
+}
+
+static void* heap_alloc(kheap_pool_t pool, size_t size, size_t align, int tag, void* site) {
+    if (pool >= KHEAP_POOLS || size > KHEAP_MAX_ALLOC) return NULL;
+    if (align < ALIGN) align = ALIGN;
+    if (align & (align - 1)) return NULL;
+    if (tag < 0 || tag >= KHEAP_MAX_TAGS) tag = KHEAP_TAG_NONE;
+    if (!initialized) kheap_init();
+    size_t adj = align_up(size < BLOCK_MIN ? BLOCK_MIN : size, ALIGN);
+    // Over-ask so a leading remainder big enough to be its own block fits
+    size_t want = align > ALIGN ? adj + align + BLOCK_HDR + BLOCK_MIN : adj;
+    kheap_ctl_t* c = &pools[pool];
+    for (int attempt = 0; ; ++attempt) {
+        spin_lock(&c->lock);
+        kblock_t* b = take_block(c, want);
+        if (b) {
+            uintptr_t p = (uintptr_t)block_payload(b);
+            uintptr_t aligned = align_up(p, align);
+            if (aligned != p) {
+                while (aligned - p < BLOCK_HDR + BLOCK_MIN) aligned += align;
+                b = trim_head(c, b, payload_block((void*)aligned));
+            }
+            trim_tail(c, b, adj);
+            account(c, b, tag);
+            spin_unlock(&c->lock);
+            if (site && alloc_prof_record(block_payload(b), size, tags[tag].name, site))
+                __atomic_or_fetch(&b->flags, BLOCK_TRACKED, __ATOMIC_RELAXED);
+            return block_payload(b);
+        }
+        spin_unlock(&c->lock);
+        if (attempt || grow(pool, want) < 0) break;
+    }
+    spin_lock(&c->lock);
+    c->stats.failures++;
+    spin_unlock(&c->lock);
+    return NULL;
+}
+
+// The public entry points pass their caller on as the profiler's call site
+void* kheap_alloc_aligned(kheap_pool_t pool, size_t size, size_t align, int tag) {
+    return heap_alloc(pool, size, align, tag, __builtin_return_address(0));
+}
+
+void* kheap_alloc(kheap_pool_t pool, size_t size, int tag) {
+    return heap_alloc(pool, size, ALIGN, tag, __builtin_return_address(0));
+}
+
+void* kheap_alloc_backing(kheap_pool_t pool, size_t size, size_t align, int tag) {
+    return heap_alloc(pool, size, align, tag, NULL);
+}
+
+void* kheap_zalloc(kheap_pool_t pool, size_t size, int tag) {
+    void* p = heap_alloc(pool, size, ALIGN, tag, __builtin_return_address(0));
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+void kheap_free(void* p) {
+    if (!p) return;
+    kblock_t* b = payload_block(p);
+    if ((b->flags & ~(BLOCK_FREE | BLOCK_TRACKED)) != BLOCK_MAGIC || (b->flags & BLOCK_FREE) || b->pool >= KHEAP_POOLS) {
+        printf("[KHeap] Bad or double free of %p\n", p);
+        return;
+    }
+    if (b->flags & BLOCK_TRACKED) alloc_prof_forget(p);
+    kheap_ctl_t* c = &pools[b->pool];
+    kheap_tag_t* t = &tags[b->tag];
+    __atomic_sub_fetch(&t->bytes, b->size, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&t->allocs, 1, __ATOMIC_RELAXED);
+    spin_lock(&c->lock);
+    c->stats.used -= b->size + BLOCK_HDR;
+    c->stats.frees++;
+    kblock_t* prev = b->prev_phys;
+    if (prev && (prev->flags & BLOCK_FREE)) {
+        remove_free(c, prev);
+        prev->size += (uint32_t)(BLOCK_HDR + b->size);
+        b->flags = 0;
+        b = prev;
+        next_phys(b)->prev_phys = b;
+    }
+    kblock_t* next = next_phys(b);
+    if (next->flags & BLOCK_FREE) {
+        remove_free(c, next);
+        next->flags = 0;
+        b->size += (uint32_t)(BLOCK_HDR + next->size);
+        next_phys(b)->prev_phys = b;
+    }
+    insert_free(c, b);
+    spin_unlock(&c->lock);
+}
+
+size_t kheap_usable_size(const void* p) {
+    return p ? payload_block(p)->size : 0;
+}
+
+int kheap_pool_stats(kheap_pool_t pool, kheap_pool_stats_t* out) {
+    if (pool >= KHEAP_POOLS || !out) return -1;
+    kheap_ctl_t* c = &pools[pool];
+    spin_lock(&c->lock);
+    *out = c->stats;
+    spin_unlock(&c->lock);
+    return 0;
+}
+
+int kheap_tag_stats(int tag, kheap_tag_stats_t* out) {
+    if (tag < 0 || tag >= nr_tags || !out) return -1;
+    out->name = tags[tag].name;
+    out->bytes = __atomic_load_n(&tags[tag].bytes, __ATOMIC_RELAXED);
+    out->peak = tags[tag].peak;
+    out->allocs = __atomic_load_n(&tags[tag].allocs, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void kheap_dump(void) {
+    for (int p = 0; p < KHEAP_POOLS; ++p) {
+        kheap_pool_stats_t st;
+        kheap_pool_stats((kheap_pool_t)p, &st);
+        printf("[KHeap] pool %-7s size=%lluK used=%lluK peak=%lluK regions=%u failures=%llu\n", pool_names[p],
+            (unsigned long long)(st.size / 1024), (unsigned long long)(st.used / 1024),
+            (unsigned long long)(st.peak / 1024), st.regions, (unsigned long long)st.failures);
+    }
+    for (int i = 0; i < nr_tags; ++i) {
+        kheap_tag_stats_t st;
+        if (kheap_tag_stats(i, &st) < 0 || (!st.bytes && !st.peak)) continue;
+        printf("[KHeap] tag %-12s bytes=%llu peak=%llu live=%llu\n", st.name,
+            (unsigned long long)st.bytes, (unsigned long long)st.peak, (unsigned long long)st.allocs);
+    }
+}
@@ -0,0 +1,263 @@
+// clocksource: calibrated TSC with a host/PIT fallback and drift correction
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <cpuid.h>
+#include "ktime.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#define KTIME_HOSTED 1
+#elif defined(__linux__)
+#include <time.h>
+#define KTIME_HOSTED 1
+#else
+#define KTIME_HOSTED 0
+#endif
+
+#define NSEC_PER_SEC 1000000000ull
+#define PIT_HZ 1193182ull
+
+static ktime_vdata_t ktime_vdata = { .seq = 0, .source = KTIME_SRC_NONE, .shift = KTIME_SHIFT };
+const ktime_vdata_t* const ktime_vdp = &ktime_vdata;
+
+static uint64_t ref_base_ns = 0;   // Reference clock reading at init
+static uint64_t mono_base_ns = 0;  // ktime_ns() at init (always 0)
+// Drift loop state
+static uint32_t mult_base = 0;     // Calibrated at init
+static int64_t freq_ppb = 0;       // Integral term: learned rate error
+static uint64_t last_sync_ref = 0; // Reference reading at the previous sync
+
+#if KTIME_HOSTED
+// Reference: the host's monotonic clock; wall clock from the host too
+static uint64_t ref_ns(void) {
+#if defined(_WIN32)
+    static LARGE_INTEGER freq = {0};
+    LARGE_INTEGER c;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&c);
+    return (uint64_t)(c.QuadPart / freq.QuadPart) * NSEC_PER_SEC +
+        (uint64_t)(c.QuadPart % freq.QuadPart) * NSEC_PER_SEC / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t wall_ns(void) {
+#if defined(_WIN32)
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return (t - 116444736000000000ull) * 100; // 1601 -> 1970, 100 ns units
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void ref_init(void) {}
+
+// Busy-wait KTIME_CALIBRATE_MS on the host clock; returns elapsed ns and TSC cycles
+static uint64_t calibrate_round(uint64_t* cycles) {
+    uint64_t r0 = ref_ns(), t0 = ktime_rdtsc(), r1;
+    while ((r1 = ref_ns()) - r0 < KTIME_CALIBRATE_MS * 1000000ull) {}
+    *cycles = ktime_rdtsc() - t0;
+    return r1 - r0;
+}
+#else
+static inline uint8_t inb(uint16_t port) {
+    uint8_t v;
+    __asm__ volatile("inb %1, %0" : "=a"(v) : "Nd"(port));
+    return v;
+}
+
+static inline void outb(uint16_t port, uint8_t v) {
+    __asm__ volatile("outb %0, %1" : : "a"(v), "Nd"(port));
+}
+
+// Polled PIT channel 0, reload 65536. Must be read at least every ~55 ms;
+// the PIT interrupt waking hlt guarantees that.
+static uint64_t pit_ticks = 0;
+static uint16_t pit_last = 0;
+
+// The BIOS leaves channel 0 in mode 3, where the count drops by 2 per input
+// clock and the reference would run at twice the real rate. Mode 2 counts
+// one per clock and keeps the same 18.2 Hz interrupt.
+static void ref_init(void) {
+    outb(0x43, 0x34); // Channel 0, lobyte/hibyte, mode 2
+    outb(0x40, 0x00);
+    outb(0x40, 0x00);
+}
+
+static uint64_t ref_ns(void) {
+    outb(0x43, 0x00); // Latch channel 0
+    uint16_t count = inb(0x40);
+    count |= (uint16_t)inb(0x40) << 8;
+    pit_ticks += (uint16_t)(pit_last - count);
+    pit_last = count;
+    return pit_ticks * NSEC_PER_SEC / PIT_HZ;
+}
+
+// CMOS RTC (BCD unless status B says binary), read twice until stable
+static uint8_t cmos(uint8_t reg) {
+    outb(0x70, reg);
+    return inb(0x71);
+}
+
+static uint64_t wall_ns(void) {
+    uint8_t s, m, h, d, mo, y, s2;
+    do {
+        while (cmos(0x0A) & 0x80) {} // Update in progress
+        s = cmos(0x00); m = cmos(0x02); h = cmos(0x04);
+        d = cmos(0x07); mo = cmos(0x08); y = cmos(0x09);
+        s2 = cmos(0x00);
+    } while (s != s2);
+    if (!(cmos(0x0B) & 0x04)) {
+#define BCD(v) (uint8_t)(((v) & 0x0F) + ((v) >> 4) * 10)
+        s = BCD(s); m = BCD(m); h = BCD(h & 0x7F) | (h & 0x80); d = BCD(d); mo = BCD(mo); y = BCD(y);
+#undef BCD
+    }
+    // Days from civil (proleptic Gregorian), year 2000-based RTC
+    int64_t yr = 2000 + y - (mo <= 2);
+    int64_t era = yr / 400;
+    int64_t yoe = yr - era * 400;
+    int64_t doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = era * 146097 + doe - 719468;
+    uint64_t secs = (uint64_t)days * 86400 + (uint64_t)(h & 0x7F) * 3600 + (uint64_t)m * 60 + s;
+    return secs * NSEC_PER_SEC;
+}
+
+// PIT channel 2 one-shot (speaker gate, output on port 0x61 bit 5)
+static uint64_t calibrate_round(uint64_t* cycles) {
+    const uint16_t latch = (uint16_t)(PIT_HZ * KTIME_CALIBRATE_MS / 1000);
+    outb(0x61, (uint8_t)((inb(0x61) & ~0x02) | 0x01));
+    outb(0x43, 0xB0); // Channel 2, lobyte/hibyte, mode 0
+    outb(0x42, latch & 0xFF);
+    outb(0x42, latch >> 8);
+    uint64_t t0 = ktime_rdtsc();
+    while (!(inb(0x61) & 0x20)) {}
+    *cycles = ktime_rdtsc() - t0;
+    return (uint64_t)latch * NSEC_PER_SEC / PIT_HZ;
+}
+#endif
+
+uint64_t ktime_fallback_ns(void) {
+    return ref_ns() - ref_base_ns + mono_base_ns;
+}
+
+const ktime_vdata_t* ktime_clock_page(void) {
+    return &ktime_vdata;
+}
+
+static int tsc_invariant(void) {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007) return 0;
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    return (d >> 8) & 1;
+}
+
+static void vdata_begin(void) {
+    __atomic_store_n(&ktime_vdata.seq, ktime_vdata.seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void vdata_end(void) {
+    __atomic_store_n(&ktime_vdata.seq, ktime_vdata.seq + 1, __ATOMIC_RELEASE);
+}
+
+int ktime_init(void) {
+    ref_init();
+    ref_base_ns = ref_ns();
+    mono_base_ns = 0;
+    int64_t offset = (int64_t)wall_ns();
+    if (!tsc_invariant()) {
+        vdata_begin();
+        ktime_vdata.source = KTIME_SRC_FALLBACK;
+        ktime_vdata.realtime_offset_ns = offset;
+        vdata_end();
+        printf("[Ktime] TSC not invariant, using %s clock\n", KTIME_HOSTED ? "host monotonic" : "PIT");
+        return -1;
+    }
+    // Median of a few rounds rejects one disturbed by an interrupt or SMI
+    uint64_t hz[KTIME_CALIBRATE_ROUNDS];
+    for (int i = 0; i < KTIME_CALIBRATE_ROUNDS; ++i) {
+        uint64_t cycles, ns = calibrate_round(&cycles);
+        hz[i] = ns ? cycles * 1000000ull / (ns / 1000) : 0;
+        for (int j = i; j > 0 && hz[j] < hz[j - 1]; --j) {
+            uint64_t t = hz[j]; hz[j] = hz[j - 1]; hz[j - 1] = t;
+        }
+    }
+    uint64_t tsc_hz = hz[KTIME_CALIBRATE_ROUNDS / 2];
+    if (tsc_hz == 0) {
+        vdata_begin();
+        ktime_vdata.source = KTIME_SRC_FALLBACK;
+        ktime_vdata.realtime_offset_ns = offset;
+        vdata_end();
+        printf("[Ktime] TSC calibration failed, using fallback clock\n");
+        return -1;
+    }
+    uint64_t now_ref = ref_ns();
+    vdata_begin();
+    ktime_vdata.tsc_hz = tsc_hz;
+    ktime_vdata.shift = KTIME_SHIFT;
+    ktime_vdata.mult = (uint32_t)((NSEC_PER_SEC << KTIME_SHIFT) / tsc_hz);
+    ktime_vdata.cycle_last = ktime_rdtsc();
+    ktime_vdata.ns_base = now_ref - ref_base_ns; // Continue from the fallback timeline
+    ktime_vdata.realtime_offset_ns = offset;
+    ktime_vdata.source = KTIME_SRC_TSC;
+    vdata_end();
+    mult_base = ktime_vdata.mult;
+    freq_ppb = 0;
+    last_sync_ref = now_ref;
+    printf("[Ktime] Clocksource: invariant TSC at %llu.%03llu MHz\n",
+        (unsigned long long)(tsc_hz / 1000000), (unsigned long long)(tsc_hz / 1000 % 1000));
+    return 0;
+}
+
+// Re-base the clock page (keeps (tsc - cycle_last) * mult from overflowing)
+// and steer the TSC rate towards the reference with a PI loop: the phase
+// error measured since the last sync is corrected by a fraction over the next
+// interval, and a smaller fraction is kept as a standing frequency correction.
+// The rate never moves more than KTIME_MAX_SLEW_PPM from the calibrated one,
+// so ktime_ns() stays continuous and never goes backwards.
+void ktime_sync(void) {
+    if (ktime_vdata.source != KTIME_SRC_TSC) return;
+    uint64_t tsc = ktime_rdtsc();
+    uint64_t ref = ref_ns();
+    uint64_t now = ktime_vdata.ns_base + (((tsc - ktime_vdata.cycle_last) * ktime_vdata.mult) >> ktime_vdata.shift);
+    int64_t error = (int64_t)(ref - ref_base_ns) - (int64_t)now;
+    int64_t interval_ms = (int64_t)(ref - last_sync_ref) / 1000000;
+    last_sync_ref = ref;
+    const int64_t max_ppb = KTIME_MAX_SLEW_PPM * 1000;
+    if (error > (int64_t)(KTIME_SYNC_MS * 1000000ull)) {
+        // Far behind (e.g. the host was suspended): step forward instead of slewing
+        now += (uint64_t)error;
+        error = 0;
+    }
+    int64_t err_ppb = interval_ms > 0 ? error * 1000 / interval_ms : 0; // ns per ms is 1e-6, in ppb
+    if (err_ppb > max_ppb) err_ppb = max_ppb;
+    if (err_ppb < -max_ppb) err_ppb = -max_ppb;
+    freq_ppb += err_ppb >> KTIME_FREQ_SHIFT;
+    if (freq_ppb > max_ppb) freq_ppb = max_ppb;
+    if (freq_ppb < -max_ppb) freq_ppb = -max_ppb;
+    int64_t adj_ppb = freq_ppb + (err_ppb >> KTIME_PHASE_SHIFT);
+    if (adj_ppb > max_ppb) adj_ppb = max_ppb;
+    if (adj_ppb < -max_ppb) adj_ppb = -max_ppb;
+    uint32_t mult = (uint32_t)((int64_t)mult_base + (int64_t)mult_base * adj_ppb / 1000000000);
+#if KTIME_HOSTED
+    int64_t offset = (int64_t)wall_ns() - (int64_t)now; // Follow host wall-clock adjustments
+#else
+    int64_t offset = ktime_vdata.realtime_offset_ns;
+#endif
+    vdata_begin();
+    ktime_vdata.cycle_last = tsc;
+    ktime_vdata.ns_base = now;
+    ktime_vdata.mult = mult;
+    ktime_vdata.realtime_offset_ns = offset;
+    vdata_end();
+}
@@ -0,0 +1,115 @@
+// LZ4 block compressor/decompressor
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "lz4.h"
+
+#define MINMATCH 4
+#define LASTLITERALS 5          // The block always ends in at least this many literals
+#define MFLIMIT 12              // No match may start closer than this to the end
+#define MAX_OFFSET 65535
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t v) { return (v * 2654435761u) >> (32 - LZ4_HASH_LOG); }
+
+// Writes one sequence: literals, then a match unless mlen is 0 (the last one)
+static int emit(uint8_t* dst, int op, int cap, const uint8_t* lit, int litlen, int offset, int mlen) {
+    int need = 1 + litlen + litlen / 255 + 1 + (mlen ? 2 + (mlen - MINMATCH) / 255 + 1 : 0);
+    if (op + need > cap) return -1;
+    uint8_t* token = &dst[op++];
+    int ml = mlen ? mlen - MINMATCH : 0;
+    *token = (uint8_t)(((litlen < 15 ? litlen : 15) << 4) | (ml < 15 ? ml : 15));
+    if (litlen >= 15) {
+        int n = litlen - 15;
+        for (; n >= 255; n -= 255) dst[op++] = 255;
+        dst[op++] = (uint8_t)n;
+    }
+    memcpy(dst + op, lit, (size_t)litlen);
+    op += litlen;
+    if (!mlen) return op;
+    dst[op++] = (uint8_t)offset;
+    dst[op++] = (uint8_t)(offset >> 8);
+    if (ml >= 15) {
+        int n = ml - 15;
+        for (; n >= 255; n -= 255) dst[op++] = 255;
+        dst[op++] = (uint8_t)n;
+    }
+    return op;
+}
+
+int lz4_compress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap, void* workspace) {
+    if (src_len < 0 || src_len > LZ4_MAX_INPUT || !workspace) return 0;
+    uint16_t* table = (uint16_t*)workspace;
+    memset(table, 0, LZ4_WORKSPACE_SIZE);
+    int ip = 1, anchor = 0, op = 0;
+    const int mflimit = src_len - MFLIMIT;
+    const int matchlimit = src_len - LASTLITERALS;
+    if (src_len > MFLIMIT) table[hash4(read32(src))] = 0;
+    while (ip < mflimit) {
+        uint32_t seq = read32(src + ip);
+        uint32_t h = hash4(seq);
+        int ref = table[h];
+        table[h] = (uint16_t)ip;
+        if (ref >= ip || ip - ref > MAX_OFFSET || read32(src + ref) != seq) {
+            ip++;
+            continue;
+        }
+        while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) { ip--; ref--; }
+        int len = MINMATCH;
+        while (ip + len < matchlimit && src[ip + len] == src[ref + len]) len++;
+        op = emit(dst, op, dst_cap, src + anchor, ip - anchor, ip - ref, len);
+        if (op < 0) return 0;
+        ip += len;
+        anchor = ip;
+        if (ip < mflimit) table[hash4(read32(src + ip - 2))] = (uint16_t)(ip - 2);
+    }
+    op = emit(dst, op, dst_cap, src + anchor, src_len - anchor, 0, 0);
+    return op < 0 ? 0 : op;
+}
+
+int lz4_decompress(const uint8_t* src, int src_len, uint8_t* dst, int dst_cap) {
+    int ip = 0, op = 0;
+    while (ip < src_len) {
+        uint8_t token = src[ip++];
+        int litlen = token >> 4;
+        if (litlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= src_len) return -1;
+                b = src[ip++];
+                litlen += b;
+            } while (b == 255);
+        }
+        if (litlen > src_len - ip || litlen > dst_cap - op) return -1;
+        memcpy(dst + op, src + ip, (size_t)litlen);
+        ip += litlen;
+        op += litlen;
+        if (ip == src_len) break; // The last sequence has no match
+        if (src_len - ip < 2) return -1;
+        int offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return -1;
+        int mlen = token & 15;
+        if (mlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= src_len) return -1;
+                b = src[ip++];
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += MINMATCH;
+        if (mlen > dst_cap - op) return -1;
+        // Byte by byte: the match may overlap the bytes it produces
+        const uint8_t* m = dst + op - offset;
+        for (int i = 0; i < mlen; ++i) dst[op + i] = m[i];
+        op += mlen;
+    }
+    return op;
+}
@@ -3,9 +3,22 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <time.h>
+#endif
 #include "include/modular.h"
 #include "../drivers/unified_driver_framework/driver_framework.h"
 #include "include/real_time.h"
+#include "include/page_cache.h"
+#include "include/timer_wheel.h"
+#include "include/ktime.h"
+#include "include/fiber.h"
+#include "include/kheap.h"
+#include "include/page_alloc.h"
+#include "include/alloc_prof.h"
+#include "include/zswap.h"
 #include "../core/bytecode_vm.h"
 #include "../security/secure_boot.c"
 #include "../security/tpm.c"
@@ -13,6 +26,7 @@
 #include "../security/sandbox.c"
 #include "../security/encryption.c"
 #include "../core/resource_manager/resource_manager.h"
+#include "../core/resource_manager/resource_group.h"
 #include "../network/net_stack.h"
 #include "../core/power_manager/power_manager.h"
 #include "../gui/window_manager.h"
@@ -97,10 +111,7 @@ static int drag_last_mouse_x = 0, drag_last_mouse_y = 0;
 
 // Helper: get focused window
 static window_t* get_focused_window(window_manager_t* wm) {
-    desktop_t* d = &wm->desktops[wm->current_desktop];
-    window_t* w = d->windows;
-    while (w) { if (w->focused) return w; w = w->next; }
-    return NULL;
+    return wm_get_focused_window(wm);
 }
 
 // Keyboard event handler
@@ -164,7 +175,73 @@ void on_mouse_event(const mouse_event_t* ev) {
     }
 }
 
+// Main loop timer periods (ms)
+#define NET_TICK_MS 1000
+#define POWER_TICK_MS 1000
+#define PCACHE_TICK_MS 500
+#define UI_FRAME_MS 16
+#define APP_TICK_MS 100
+#define GAMING_TICK_MS 16
+#define DEVTOOLS_TICK_MS 1000
+#define AI_TICK_MS 1000
+#define INPUT_POLL_MS 10
+#define HOTPLUG_SCAN_MS 2000
+#define IDLE_MAX_SLEEP_MS 1000
+
+// Sleep until the next timer is due; an interrupt may end it early
+static void idle_wait(uint64_t ms) {
+#if defined(_WIN32)
+    Sleep((DWORD)ms);
+#elif defined(__linux__)
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#else
+    (void)ms;
+    __asm__ volatile("sti; hlt"); // The PIT or any device interrupt wakes us
+#endif
+}
+
+// The scheduler re-arms itself for its next event instead of running at a fixed rate
+static void on_sched_timer(ktimer_t* t, void* arg) {
+    (void)arg;
+    scheduler_tick();
+    ktimer_add(t, scheduler_next_event_ms(ktime_ms()));
+}
+static void on_net_timer(ktimer_t* t, void* arg) { (void)t; (void)arg; net_stack_tick(ktime_ms()); }
+static void on_power_timer(ktimer_t* t, void* arg) { (void)t; (void)arg; power_manager_tick(); }
+static void on_pcache_timer(ktimer_t* t, void* arg) { (void)t; (void)arg; page_cache_tick(ktime_ms()); }
+static void on_ui_timer(ktimer_t* t, void* arg) { (void)t; (void)arg; ui_framework_tick(); }
+static void on_app_timer(ktimer_t* t, void* arg) { (void)t; app_runtime_tick((app_runtime_t*)arg); }
+static void on_proc_timer(ktimer_t* t, void* arg) { (void)t; process_schedule((process_table_t*)arg); }
+static void on_gaming_timer(ktimer_t* t, void* arg) { (void)t; gaming_mode_tick((gaming_mode_manager_t*)arg); }
+static void on_devtools_timer(ktimer_t* t, void* arg) { (void)t; dev_tools_tick((dev_tools_manager_t*)arg); }
+static void on_ai_timer(ktimer_t* t, void* arg) { (void)t; ai_assistant_tick((ai_assistant_manager_t*)arg); }
+static void on_ktime_timer(ktimer_t* t, void* arg) { (void)t; (void)arg; ktime_sync(); }
+static void on_rgroup_timer(ktimer_t* t, void* arg) { (void)t; (void)arg; rgroup_tick(ktime_ms()); }
+static void on_input_timer(ktimer_t* t, void* arg) { (void)t; (void)arg; input_manager_poll(); }
+
+static void on_hotplug_timer(ktimer_t* t, void* arg) {
+    static int last_dev_count = 0;
+    (void)t; (void)arg;
+    int dev_count = 0;
+    device_manager_rescan();
+    device_manager_list(&dev_count);
+    if (dev_count != last_dev_count) {
+        printf("[Hotplug] Device count changed: %d -> %d\n", last_dev_count, dev_count);
+        wm_create_device_manager_window(g_wm); // Update window
+        last_dev_count = dev_count;
+    }
+}
+
 void kernel_main(void) {
+    // Timekeeping first: everything after this timestamps with ktime_ns()
+    ktime_init();
+    // Physical pages from the bootloader's memory map, then the kernel heap
+    // pools before anything allocates from them
+    page_alloc_init(multiboot_boot_info());
+    kheap_init();
+    if (ALLOC_PROF_BOOT_SAMPLE) alloc_prof_start(ALLOC_PROF_BOOT_SAMPLE);
+
     // Initialize modular kernel loader (implicit via static init)
     // Register example driver
     if (register_driver(&example_driver) != 0) {
@@ -195,6 +272,18 @@ void kernel_main(void) {
     // Security system initialization
     security_init();
 
+    // Page cache shared by all filesystem modules
+    page_cache_init(PAGE_CACHE_DEFAULT_PAGES);
+
+    // Compressed swap for cold anonymous pages, spilling to a cowfs file
+    zswap_init(find_fs_module("cowfs"), ZSWAP_SWAPFILE);
+
+    // Per-CPU run queues (one per host CPU)
+    scheduler_init(0);
+
+    // Fibers for services that block (DHCP/DNS, fs I/O, IPC receive)
+    fiber_runtime_init();
+
     // Initialize networking stack
     net_stack_init();
 
@@ -233,6 +322,11 @@ void kernel_main(void) {
     int proc2 = process_create(&proc_table, "Calculator", app2);
     int proc3 = process_create(&proc_table, "IDE", app3);
     int proc4 = process_create(&proc_table, "Chat", app4);
+    // Each app's processes are charged to the app's resource group
+    process_set_rgroup(&proc_table, proc1, app_runtime_get_rgroup(&app_rt, app1));
+    process_set_rgroup(&proc_table, proc2, app_runtime_get_rgroup(&app_rt, app2));
+    process_set_rgroup(&proc_table, proc3, app_runtime_get_rgroup(&app_rt, app3));
+    process_set_rgroup(&proc_table, proc4, app_runtime_get_rgroup(&app_rt, app4));
     app_runtime_set_process_id(&app_rt, app1, proc1);
     app_runtime_set_process_id(&app_rt, app2, proc2);
     app_runtime_set_process_id(&app_rt, app3, proc3);
@@ -299,42 +393,45 @@ void kernel_main(void) {
 
     g_wm = &wm;
 
-    int last_dev_count = 0;
-    int hotplug_tick = 0;
-    // Main kernel loop (stub)
+    // Every subsystem tick is a timer on the wheel with its real period; the
+    // loop sleeps until the earliest one (or an interrupt) is due
+    uint64_t now = ktime_ms();
+    timer_wheel_init(now);
+    static ktimer_t sched_timer, net_timer, power_timer, pcache_timer, ui_timer, app_timer;
+    static ktimer_t proc_timer, gaming_timer, devtools_timer, ai_timer, input_timer, hotplug_timer, ktime_timer, rgroup_timer;
+    ktimer_init(&sched_timer, "scheduler", on_sched_timer, NULL);
+    ktimer_add(&sched_timer, now);
+    ktimer_init(&net_timer, "net", on_net_timer, NULL);
+    ktimer_add_periodic(&net_timer, now, NET_TICK_MS);
+    ktimer_init(&power_timer, "power", on_power_timer, NULL);
+    ktimer_add_periodic(&power_timer, now, POWER_TICK_MS);
+    ktimer_init(&pcache_timer, "page_cache", on_pcache_timer, NULL);
+    ktimer_add_periodic(&pcache_timer, now, PCACHE_TICK_MS);
+    ktimer_init(&ui_timer, "ui", on_ui_timer, NULL);
+    ktimer_add_periodic(&ui_timer, now, UI_FRAME_MS);
+    ktimer_init(&app_timer, "apps", on_app_timer, &app_rt);
+    ktimer_add_periodic(&app_timer, now, APP_TICK_MS);
+    ktimer_init(&proc_timer, "processes", on_proc_timer, &proc_table);
+    ktimer_add_periodic(&proc_timer, now, PROCESS_TICK_MS);
+    ktimer_init(&gaming_timer, "gaming", on_gaming_timer, &gm);
+    ktimer_add_periodic(&gaming_timer, now, GAMING_TICK_MS);
+    ktimer_init(&devtools_timer, "dev_tools", on_devtools_timer, &dt);
+    ktimer_add_periodic(&devtools_timer, now, DEVTOOLS_TICK_MS);
+    ktimer_init(&ai_timer, "ai", on_ai_timer, &ai);
+    ktimer_add_periodic(&ai_timer, now, AI_TICK_MS);
+    ktimer_init(&input_timer, "input", on_input_timer, NULL);
+    ktimer_add_periodic(&input_timer, now, INPUT_POLL_MS);
+    ktimer_init(&hotplug_timer, "hotplug", on_hotplug_timer, NULL);
+    ktimer_add_periodic(&hotplug_timer, now, HOTPLUG_SCAN_MS);
+    ktimer_init(&ktime_timer, "ktime", on_ktime_timer, NULL);
+    ktimer_add_periodic(&ktime_timer, now, KTIME_SYNC_MS);
+    ktimer_init(&rgroup_timer, "rgroup", on_rgroup_timer, NULL);
+    ktimer_add_periodic(&rgroup_timer, now, RG_PERIOD_MS);
+
+    // Main kernel loop
     while (1) {
-        // Periodically update resource stats and scale
-        scheduler_tick();
-        // Networking stack tick
-        net_stack_tick();
-        // Power manager tick
-        power_manager_tick();
-        // UI framework tick (renders windows)
-        ui_framework_tick();
-        // App runtime tick
-        app_runtime_tick(&app_rt);
-        // Process scheduling
-        process_schedule(&proc_table);
-        // Gaming mode tick
-        gaming_mode_tick(&gm);
-        // Developer tools tick
-        dev_tools_tick(&dt);
-        // AI assistant tick
-        ai_assistant_tick(&ai);
-        // Poll input events
-        input_manager_poll();
-        // Simulate hotplug every 1000 ticks
-        if (++hotplug_tick >= 1000) {
-            hotplug_tick = 0;
-            int dev_count = 0;
-            device_manager_rescan();
-            const device_info_t* devs = device_manager_list(&dev_count);
-            if (dev_count != last_dev_count) {
-                printf("[Hotplug] Device count changed: %d -> %d\n", last_dev_count, dev_count);
-                wm_create_device_manager_window(g_wm); // Update window
-                last_dev_count = dev_count;
-            }
-        }
+        timer_wheel_run(ktime_ms());
+        int runnable = fiber_run();
         // IPC: handle incoming messages (example)
         ipc_message_t msg;
         while (receive_ipc_message(&msg) == 0) {
@@ -342,6 +439,12 @@ void kernel_main(void) {
             // ...
         }
         // ... handle interrupts, scheduling, etc. ...
+        uint64_t next = timer_wheel_next_expiry();
+        now = ktime_ms();
+        uint64_t wait = next > now ? (next == TW_NO_TIMER ? IDLE_MAX_SLEEP_MS : next - now) : 0;
+        if (runnable) wait = 0;
+        // Fibers parked on sockets are woken by the same wait
+        if (fiber_poll_io((uint32_t)wait) < 0 && wait) idle_wait(wait);
     }
 }
 
@@ -9,6 +9,9 @@
 #include <process.h>
 #include <assert.h>
 #include "modular.h"
+#include "page_cache.h"
+#include "fiber.h"
+#include "ktime.h"
 #include <openssl/sha.h>
 
 // Module types
@@ -38,6 +41,7 @@ static fs_module_t* fs_list = NULL;
 // IPC: Multiple named channels and message queues
 #define MAX_IPC_CHANNELS 16
 #define MAX_IPC_QUEUE 64
+#define IPC_WAIT_SLICE_MS 10 // Receivers re-check this often for sends from other threads
 
 typedef struct {
     char name[64];
@@ -45,6 +49,7 @@ typedef struct {
     ipc_message_t queue[MAX_IPC_QUEUE];
     int queue_head, queue_tail;
     CRITICAL_SECTION lock;
+    fiber_waitq_t readers;  // Fibers blocked in receive_ipc_message_wait
 } ipc_channel_t;
 
 static ipc_channel_t ipc_channels[MAX_IPC_CHANNELS] = {0};
@@ -194,7 +199,8 @@ int send_ipc_message(const ipc_message_t* msg) {
     ch->queue[ch->queue_tail] = *msg;
     ch->queue_tail = next;
     LeaveCriticalSection(&ch->lock);
-    // Optionally, signal waiting receivers
+    // Fibers all run on the loop thread, so a sending fiber can wake a reader directly
+    if (fiber_current()) fiber_wake_one(&ch->readers);
     return 0;
 }
 
@@ -213,6 +219,23 @@ int receive_ipc_message(ipc_message_t* msg) {
     return 0;
 }
 
+// Blocking receive for fibers: parks until a message arrives or timeout_ms
+// passes (-3, as for an empty queue). Outside a fiber it does not block.
+int receive_ipc_message_wait(ipc_message_t* msg, uint32_t timeout_ms) {
+    ipc_channel_t* ch = find_or_create_channel("neonova_ipc");
+    if (!ch) return -2;
+    uint64_t deadline = ktime_ms() + timeout_ms;
+    for (;;) {
+        int r = receive_ipc_message(msg);
+        if (r != -3 || !fiber_current()) return r;
+        uint64_t now = ktime_ms();
+        if (timeout_ms != FIBER_NO_TIMEOUT && now >= deadline) return -3;
+        uint64_t slice = timeout_ms == FIBER_NO_TIMEOUT ? IPC_WAIT_SLICE_MS : deadline - now;
+        if (slice > IPC_WAIT_SLICE_MS) slice = IPC_WAIT_SLICE_MS;
+        fiber_wait(&ch->readers, (uint32_t)slice);
+    }
+}
+
 int register_fs_module(fs_module_t* fs) {
     if (!fs || !fs->ops) return -1;
     fs->next = fs_list;
@@ -240,3 +263,29 @@ fs_module_t* find_fs_module(const char* name) {
     }
     return NULL;
 }
+
+// Buffered reads/writes go through the page cache; FS_IO_DIRECT bypasses it
+// after making the cached range coherent with the module.
+int fs_read(fs_module_t* fs, const char* path, void* buf, size_t len, uint64_t offset, int flags) {
+    if (!fs || !fs->ops || !fs->ops->read) return -1;
+    if (flags & FS_IO_DIRECT) {
+        page_cache_flush(fs, path, offset, len);
+        return fs->ops->read(path, buf, len, offset);
+    }
+    return page_cache_read(fs, path, buf, len, offset);
+}
+
+int fs_write(fs_module_t* fs, const char* path, const void* buf, size_t len, uint64_t offset, int flags) {
+    if (!fs || !fs->ops || !fs->ops->write) return -1;
+    if (flags & FS_IO_DIRECT) {
+        page_cache_invalidate(fs, path, offset, len);
+        return fs->ops->write(path, buf, len, offset);
+    }
+    return page_cache_write(fs, path, buf, len, offset);
+}
+
+int fs_fsync(fs_module_t* fs, const char* path) {
+    if (!fs || !fs->ops) return -1;
+    if (page_cache_flush(fs, path, 0, 0) != 0) return -1;
+    return fs->ops->fsync ? fs->ops->fsync(path) : 0;
+}
@@ -1,16 +1,43 @@
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include "multiboot.h"
 
-typedef struct {
-    uint32_t mem_lower;
-    uint32_t mem_upper;
-    uint32_t boot_device;
-} multiboot_info_t;
+uint32_t multiboot_magic;
+uint32_t multiboot_info_addr;
 
 void parse_multiboot_info(const void* mb_addr, multiboot_info_t* out) {
-    const uint32_t* mb = (const uint32_t*)mb_addr;
-    out->mem_lower = mb[1];
-    out->mem_upper = mb[2];
-    out->boot_device = mb[3];
+    memcpy(out, mb_addr, sizeof(*out));
     printf("[Multiboot] mem_lower=%uKB, mem_upper=%uKB, boot_device=0x%08X\n", out->mem_lower, out->mem_upper, out->boot_device);
 }
+
+const multiboot_info_t* multiboot_boot_info(void) {
+#if defined(_WIN32) || defined(__linux__)
+    return NULL;
+#else
+    if (multiboot_magic != MULTIBOOT_BOOTLOADER_MAGIC || !multiboot_info_addr) return NULL;
+    return (const multiboot_info_t*)(uintptr_t)multiboot_info_addr;
+#endif
+}
+
+int multiboot_for_each_mmap(const multiboot_info_t* mb, multiboot_mmap_fn fn, void* arg) {
+    if (!mb || !fn) return -1;
+    if (mb->flags & MULTIBOOT_INFO_MEM_MAP) {
+        int n = 0;
+        uintptr_t p = mb->mmap_addr, end = (uintptr_t)mb->mmap_addr + mb->mmap_length;
+        while (p + sizeof(multiboot_mmap_entry_t) <= end) {
+            const multiboot_mmap_entry_t* e = (const multiboot_mmap_entry_t*)p;
+            fn(e->addr, e->len, e->type, arg);
+            n++;
+            p += e->size + sizeof(e->size);
+        }
+        return n;
+    }
+    // Old loaders only report the two conventional ranges
+    if (mb->flags & MULTIBOOT_INFO_MEMORY) {
+        fn(0, (uint64_t)mb->mem_lower * 1024, MULTIBOOT_MEMORY_AVAILABLE, arg);
+        fn(0x100000, (uint64_t)mb->mem_upper * 1024, MULTIBOOT_MEMORY_AVAILABLE, arg);
+        return 2;
+    }
+    return -1;
+}
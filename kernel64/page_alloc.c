@@ -0,0 +1,508 @@
+// buddy physical page allocator with per-CPU order-0 lists
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sched_getcpu
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "page_alloc.h"
+#include "spinlock.h"
+#include "alloc_prof.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#else
+extern char _kernel_end[];
+#endif
+
+#define PG_BUDDY 0x1            // Head of a free block in a buddy list
+#define PG_HEAD 0x2             // Head of an allocated block
+#define PG_PCP 0x4              // On a per-CPU list
+#define PG_HUGE 0x8             // Huge page, allocated or in the reserve
+#define PG_TRACKED 0x10         // Recorded by the allocation profiler
+
+#define LOW_MEM_END 0x100000    // Real-mode area, BIOS data and the boot stack
+
+typedef struct page {
+    struct page* next;
+    struct page* prev;
+    uint16_t flags;
+    uint8_t order;
+    uint8_t region;
+} page_t;
+
+typedef struct {
+    uintptr_t base;             // Address of the first managed page
+    uintptr_t base_pfn;
+    size_t nr_pages;
+    page_t* map;
+} page_region_t;
+
+typedef struct {
+    spinlock_t lock;            // Only ever trylocked on the fast path
+    uint32_t count;
+    page_t list;                // Hot pages at the head, cold at the tail
+    uint64_t hits;
+} __attribute__((aligned(64))) page_pcp_t;
+
+static struct {
+    spinlock_t lock;
+    page_region_t regions[PAGE_MAX_REGIONS];
+    uint32_t nr_regions;
+    page_t free_area[PAGE_ORDERS];
+    uint64_t nr_free[PAGE_ORDERS];
+    uint64_t total_pages;
+    uint64_t free_pages;        // In the buddy lists only
+    page_t* huge_pool;
+    uint64_t huge_reserved, huge_free;
+    uint64_t allocs, frees, failures;
+} zone = { .lock = SPINLOCK_INIT };
+
+static page_pcp_t pcp[PAGE_MAX_CPUS];
+static spinlock_t init_lock = SPINLOCK_INIT;
+static volatile int initialized;
+static int lists_ready;
+
+static uintptr_t align_up(uintptr_t v, uintptr_t a) { return (v + a - 1) & ~(a - 1); }
+
+static int page_this_cpu(void) {
+#if defined(_WIN32)
+    int cpu = (int)GetCurrentProcessorNumber();
+#elif defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu < 0) cpu = 0;
+#else
+    int cpu = 0;
+#endif
+    return cpu % PAGE_MAX_CPUS;
+}
+
+static void list_init(page_t* h) { h->next = h->prev = h; }
+static int list_empty(const page_t* h) { return h->next == h; }
+
+static void list_add(page_t* h, page_t* p) {
+    p->next = h->next;
+    p->prev = h;
+    h->next->prev = p;
+    h->next = p;
+}
+
+static void list_add_tail(page_t* h, page_t* p) { list_add(h->prev, p); }
+
+static void list_del(page_t* p) {
+    p->prev->next = p->next;
+    p->next->prev = p->prev;
+    p->next = p->prev = NULL;
+}
+
+static void* page_addr(const page_t* p) {
+    const page_region_t* r = &zone.regions[p->region];
+    return (void*)(r->base + (uintptr_t)(p - r->map) * PAGE_SIZE);
+}
+
+static page_t* addr_page(const void* addr) {
+    uintptr_t a = (uintptr_t)addr;
+    if (a & (PAGE_SIZE - 1)) return NULL;
+    for (uint32_t i = 0; i < zone.nr_regions; ++i) {
+        page_region_t* r = &zone.regions[i];
+        if (a >= r->base && a < r->base + r->nr_pages * PAGE_SIZE) return &r->map[(a - r->base) / PAGE_SIZE];
+    }
+    return NULL;
+}
+
+static void setup_lists(void) {
+    if (lists_ready) return;
+    for (int o = 0; o < PAGE_ORDERS; ++o) list_init(&zone.free_area[o]);
+    for (int c = 0; c < PAGE_MAX_CPUS; ++c) list_init(&pcp[c].list);
+    lists_ready = 1;
+}
+
+// Zone lock held
+static void free_area_add(page_t* p, unsigned order) {
+    p->flags = PG_BUDDY;
+    p->order = (uint8_t)order;
+    list_add(&zone.free_area[order], p);
+    zone.nr_free[order]++;
+}
+
+// Zone lock held. Merges with the buddy for as long as it is free and whole.
+static void buddy_free(page_t* p, unsigned order) {
+    page_region_t* r = &zone.regions[p->region];
+    uintptr_t pfn = r->base_pfn + (uintptr_t)(p - r->map);
+    zone.free_pages += (uint64_t)1 << order;
+    while (order < PAGE_MAX_ORDER) {
+        uintptr_t bpfn = pfn ^ ((uintptr_t)1 << order);
+        if (bpfn < r->base_pfn || bpfn - r->base_pfn + ((uintptr_t)1 << order) > r->nr_pages) break;
+        page_t* b = &r->map[bpfn - r->base_pfn];
+        if (!(b->flags & PG_BUDDY) || b->order != order) break;
+        list_del(b);
+        zone.nr_free[order]--;
+        b->flags = 0;
+        pfn &= bpfn;
+        order++;
+    }
+    free_area_add(&r->map[pfn - r->base_pfn], order);
+}
+
+// Zone lock held. Splits the smallest large-enough block; the halves go back on the lists.
+static page_t* buddy_alloc(unsigned order) {
+    unsigned o = order;
+    while (o <= PAGE_MAX_ORDER && list_empty(&zone.free_area[o])) o++;
+    if (o > PAGE_MAX_ORDER) return NULL;
+    page_t* p = zone.free_area[o].next;
+    list_del(p);
+    zone.nr_free[o]--;
+    while (o > order) {
+        o--;
+        free_area_add(p + ((size_t)1 << o), o);
+    }
+    p->flags = PG_HEAD;
+    p->order = (uint8_t)order;
+    zone.free_pages -= (uint64_t)1 << order;
+    return p;
+}
+
+int page_alloc_add_region(uintptr_t start, size_t len) {
+    uintptr_t first = align_up(start, PAGE_SIZE);
+    uintptr_t end = (start + len) & ~(uintptr_t)(PAGE_SIZE - 1);
+    if (end <= first) return -1;
+    size_t total = (end - first) / PAGE_SIZE;
+    // Descriptors live at the start of the region they describe
+    size_t map_pages = (total * sizeof(page_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (total <= map_pages) return -1;
+    spin_lock(&zone.lock);
+    if (zone.nr_regions >= PAGE_MAX_REGIONS) {
+        spin_unlock(&zone.lock);
+        printf("[PageAlloc] Too many regions, dropping %p-%p\n", (void*)first, (void*)end);
+        return -1;
+    }
+    setup_lists();
+    uint32_t ri = zone.nr_regions;
+    page_region_t* r = &zone.regions[ri];
+    r->map = (page_t*)first;
+    r->nr_pages = total - map_pages;
+    r->base = first + map_pages * PAGE_SIZE;
+    r->base_pfn = r->base / PAGE_SIZE;
+    memset(r->map, 0, r->nr_pages * sizeof(page_t));
+    for (size_t i = 0; i < r->nr_pages; ++i) r->map[i].region = (uint8_t)ri;
+    zone.nr_regions++;
+    // Largest naturally aligned blocks that fit
+    uintptr_t pfn = r->base_pfn, end_pfn = r->base_pfn + r->nr_pages;
+    while (pfn < end_pfn) {
+        unsigned order = PAGE_MAX_ORDER;
+        while (order && ((pfn & (((uintptr_t)1 << order) - 1)) || pfn + ((uintptr_t)1 << order) > end_pfn)) order--;
+        free_area_add(&r->map[pfn - r->base_pfn], order);
+        pfn += (uintptr_t)1 << order;
+    }
+    zone.total_pages += r->nr_pages;
+    zone.free_pages += r->nr_pages;
+    spin_unlock(&zone.lock);
+    return 0;
+}
+
+#if !defined(_WIN32) && !defined(__linux__)
+typedef struct {
+    uint64_t start[PAGE_MAX_REGIONS], end[PAGE_MAX_REGIONS];
+    int n;
+} boot_ranges_t;
+
+static void collect_range(uint64_t addr, uint64_t len, uint32_t type, void* arg) {
+    boot_ranges_t* br = (boot_ranges_t*)arg;
+    uint64_t start = addr, end = addr + len;
+    uint64_t limit = (uint64_t)(uintptr_t)-1;   // Only what the kernel can address
+    if (type != MULTIBOOT_MEMORY_AVAILABLE || br->n >= PAGE_MAX_REGIONS) return;
+    if (start < LOW_MEM_END) start = LOW_MEM_END;
+    if (end > limit) end = limit;
+    if (end > start) { br->start[br->n] = start; br->end[br->n] = end; br->n++; }
+}
+
+// Cuts [lo, hi) out of the collected ranges
+static void exclude_range(boot_ranges_t* br, uint64_t lo, uint64_t hi) {
+    for (int i = 0; i < br->n; ++i) {
+        if (hi <= br->start[i] || lo >= br->end[i]) continue;
+        if (lo > br->start[i] && hi < br->end[i] && br->n < PAGE_MAX_REGIONS) {
+            br->start[br->n] = hi;
+            br->end[br->n] = br->end[i];
+            br->n++;
+            br->end[i] = lo;
+        } else if (lo <= br->start[i]) {
+            br->start[i] = hi < br->end[i] ? hi : br->end[i];
+        } else {
+            br->end[i] = lo;
+        }
+    }
+}
+#endif
+
+// Memory the allocator manages: the host buffer, or every usable RAM range
+// except the kernel image and boot modules
+static int add_boot_memory(const multiboot_info_t* mb) {
+#if defined(_WIN32) || defined(__linux__)
+    (void)mb;
+    // Over-allocate so the huge pages inside are really 2 MiB aligned
+    void* mem = malloc(PAGE_HOSTED_MEM + HUGE_PAGE_SIZE);
+    if (!mem) return -1;
+    return page_alloc_add_region(align_up((uintptr_t)mem, HUGE_PAGE_SIZE), PAGE_HOSTED_MEM);
+#else
+    static boot_ranges_t br;
+    if (!mb) mb = multiboot_boot_info();
+    if (multiboot_for_each_mmap(mb, collect_range, &br) < 0) {
+        printf("[PageAlloc] No memory map from the bootloader\n");
+        return -1;
+    }
+    exclude_range(&br, LOW_MEM_END, (uintptr_t)_kernel_end);
+    if (mb->flags & MULTIBOOT_INFO_MODS) {
+        const multiboot_module_t* mods = (const multiboot_module_t*)(uintptr_t)mb->mods_addr;
+        for (uint32_t i = 0; i < mb->mods_count; ++i) exclude_range(&br, mods[i].mod_start, mods[i].mod_end);
+    }
+    int added = 0;
+    for (int i = 0; i < br.n; ++i) {
+        if (page_alloc_add_region((uintptr_t)br.start[i], (size_t)(br.end[i] - br.start[i])) == 0) added++;
+    }
+    return added ? 0 : -1;
+#endif
+}
+
+int page_alloc_init(const multiboot_info_t* mb) {
+    if (__atomic_load_n(&initialized, __ATOMIC_ACQUIRE)) return 0;
+    spin_lock(&init_lock);
+    int rc = 0;
+    if (!initialized) {
+        spin_lock(&zone.lock);
+        setup_lists();
+        spin_unlock(&zone.lock);
+        rc = add_boot_memory(mb);
+        __atomic_store_n(&initialized, 1, __ATOMIC_RELEASE);
+        printf("[PageAlloc] %u regions, %llu MiB in %u KiB pages\n", zone.nr_regions,
+            (unsigned long long)(zone.total_pages * PAGE_SIZE >> 20), PAGE_SIZE / 1024);
+    }
+    spin_unlock(&init_lock);
+    return rc;
+}
+
+unsigned page_order_of(size_t bytes) {
+    unsigned order = 0;
+    while (((size_t)PAGE_SIZE << order) < bytes) order++;
+    return order;
+}
+
+// pcp locked; moves up to n pages from the cold end back to the buddy lists
+static void pcp_drain(page_pcp_t* c, uint32_t n) {
+    spin_lock(&zone.lock);
+    while (n-- && c->count) {
+        page_t* p = c->list.prev;
+        list_del(p);
+        c->count--;
+        buddy_free(p, 0);
+    }
+    spin_unlock(&zone.lock);
+}
+
+static page_t* pcp_alloc(unsigned flags) {
+    page_pcp_t* c = &pcp[page_this_cpu()];
+    if (!spin_trylock(&c->lock)) return NULL;
+    if (c->count) {
+        c->hits++;
+    } else {
+        spin_lock(&zone.lock);
+        for (int i = 0; i < PAGE_PCP_BATCH; ++i) {
+            page_t* p = buddy_alloc(0);
+            if (!p) break;
+            p->flags = PG_PCP;
+            list_add_tail(&c->list, p);
+            c->count++;
+        }
+        spin_unlock(&zone.lock);
+    }
+    page_t* p = NULL;
+    if (c->count) {
+        p = (flags & PA_COLD) ? c->list.prev : c->list.next;
+        list_del(p);
+        c->count--;
+        p->flags = PG_HEAD;
+        p->order = 0;
+    }
+    spin_unlock(&c->lock);
+    return p;
+}
+
+static int pcp_free(page_t* p, int cold) {
+    page_pcp_t* c = &pcp[page_this_cpu()];
+    if (!spin_trylock(&c->lock)) return -1;
+    p->flags = PG_PCP;
+    if (cold) list_add_tail(&c->list, p);
+    else list_add(&c->list, p);
+    if (++c->count > PAGE_PCP_HIGH) pcp_drain(c, PAGE_PCP_BATCH);
+    spin_unlock(&c->lock);
+    return 0;
+}
+
+void page_alloc_drain(void) {
+    for (int i = 0; i < PAGE_MAX_CPUS; ++i) {
+        if (!__atomic_load_n(&pcp[i].count, __ATOMIC_RELAXED)) continue;
+        spin_lock(&pcp[i].lock);
+        pcp_drain(&pcp[i], pcp[i].count);
+        spin_unlock(&pcp[i].lock);
+    }
+}
+
+static page_t* zone_alloc(unsigned order) {
+    spin_lock(&zone.lock);
+    page_t* p = buddy_alloc(order);
+    spin_unlock(&zone.lock);
+    if (!p && order) {
+        // Pages parked on per-CPU lists may be what keeps a buddy from merging
+        page_alloc_drain();
+        spin_lock(&zone.lock);
+        p = buddy_alloc(order);
+        spin_unlock(&zone.lock);
+    }
+    return p;
+}
+
+static void* finish_alloc(page_t* p, unsigned order, unsigned flags, void* site) {
+    if (!p) {
+        __atomic_add_fetch(&zone.failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    __atomic_add_fetch(&zone.allocs, 1, __ATOMIC_RELAXED);
+    void* addr = page_addr(p);
+    if (flags & PA_ZERO) memset(addr, 0, (size_t)PAGE_SIZE << order);
+    if (!(flags & PA_NOPROF) &&
+        alloc_prof_record(addr, (size_t)PAGE_SIZE << order, (p->flags & PG_HUGE) ? "huge_pages" : "pages", site))
+        p->flags |= PG_TRACKED;
+    return addr;
+}
+
+static void* alloc_pages(unsigned order, unsigned flags, void* site) {
+    if (order > PAGE_MAX_ORDER) return NULL;
+    if (!initialized) page_alloc_init(NULL);
+    page_t* p = order == 0 ? pcp_alloc(flags) : NULL;
+    if (!p) p = zone_alloc(order);
+    return finish_alloc(p, order, flags, site);
+}
+
+void* page_alloc_pages(unsigned order, unsigned flags) {
+    return alloc_pages(order, flags, __builtin_return_address(0));
+}
+
+void* page_alloc(unsigned flags) {
+    return alloc_pages(0, flags, __builtin_return_address(0));
+}
+
+void* page_alloc_huge(unsigned flags) {
+    if (!initialized) page_alloc_init(NULL);
+    spin_lock(&zone.lock);
+    page_t* p = zone.huge_pool;
+    if (p) {
+        zone.huge_pool = p->next;
+        zone.huge_free--;
+    }
+    spin_unlock(&zone.lock);
+    if (!p) p = zone_alloc(HUGE_PAGE_ORDER);
+    if (p) {
+        p->flags = PG_HEAD | PG_HUGE;
+        p->order = HUGE_PAGE_ORDER;
+    }
+    return finish_alloc(p, HUGE_PAGE_ORDER, flags, __builtin_return_address(0));
+}
+
+int page_huge_reserve(unsigned count) {
+    if (!initialized) page_alloc_init(NULL);
+    spin_lock(&zone.lock);
+    zone.huge_reserved = count;
+    while (zone.huge_free < count) {
+        page_t* p = buddy_alloc(HUGE_PAGE_ORDER);
+        if (!p) break;
+        p->flags = PG_HUGE;
+        p->next = zone.huge_pool;
+        zone.huge_pool = p;
+        zone.huge_free++;
+    }
+    // Give back whatever is above a lowered target
+    while (zone.huge_free > count) {
+        page_t* p = zone.huge_pool;
+        zone.huge_pool = p->next;
+        zone.huge_free--;
+        buddy_free(p, HUGE_PAGE_ORDER);
+    }
+    int got = (int)zone.huge_free;
+    spin_unlock(&zone.lock);
+    if ((unsigned)got < count) {
+        printf("[PageAlloc] Huge page reserve short: %d of %u\n", got, count);
+        return -1;
+    }
+    return got;
+}
+
+static void free_block(void* addr, int cold) {
+    if (!addr) return;
+    page_t* p = addr_page(addr);
+    if (!p || !(p->flags & PG_HEAD)) {
+        printf("[PageAlloc] Bad or double free of %p\n", addr);
+        return;
+    }
+    __atomic_add_fetch(&zone.frees, 1, __ATOMIC_RELAXED);
+    if (p->flags & PG_TRACKED) alloc_prof_forget(addr);
+    unsigned order = p->order;
+    if (order == 0 && pcp_free(p, cold) == 0) return;
+    spin_lock(&zone.lock);
+    if ((p->flags & PG_HUGE) && zone.huge_free < zone.huge_reserved) {
+        p->flags = PG_HUGE;
+        p->next = zone.huge_pool;
+        zone.huge_pool = p;
+        zone.huge_free++;
+    } else {
+        p->flags = 0;
+        buddy_free(p, order);
+    }
+    spin_unlock(&zone.lock);
+}
+
+void page_free(void* addr) {
+    free_block(addr, 0);
+}
+
+void page_free_cold(void* addr) {
+    free_block(addr, 1);
+}
+
+int page_alloc_stats(page_alloc_stats_t* out) {
+    if (!out) return -1;
+    memset(out, 0, sizeof(*out));
+    spin_lock(&zone.lock);
+    out->total_pages = zone.total_pages;
+    out->free_pages = zone.free_pages;
+    for (int o = 0; o < PAGE_ORDERS; ++o) out->free_blocks[o] = zone.nr_free[o];
+    out->huge_reserved = zone.huge_reserved;
+    out->huge_free = zone.huge_free;
+    out->failures = zone.failures;
+    out->regions = zone.nr_regions;
+    spin_unlock(&zone.lock);
+    for (int c = 0; c < PAGE_MAX_CPUS; ++c) {
+        out->pcp_pages += __atomic_load_n(&pcp[c].count, __ATOMIC_RELAXED);
+        out->pcp_hits += __atomic_load_n(&pcp[c].hits, __ATOMIC_RELAXED);
+    }
+    out->free_pages += out->pcp_pages + (out->huge_free << HUGE_PAGE_ORDER);
+    out->allocs = __atomic_load_n(&zone.allocs, __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&zone.frees, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void page_alloc_dump(void) {
+    page_alloc_stats_t st;
+    page_alloc_stats(&st);
+    printf("[PageAlloc] total=%lluK free=%lluK pcp=%llu huge=%llu/%llu allocs=%llu frees=%llu pcp_hits=%llu failures=%llu\n",
+        (unsigned long long)(st.total_pages * PAGE_SIZE / 1024), (unsigned long long)(st.free_pages * PAGE_SIZE / 1024),
+        (unsigned long long)st.pcp_pages, (unsigned long long)st.huge_free, (unsigned long long)st.huge_reserved,
+        (unsigned long long)st.allocs, (unsigned long long)st.frees, (unsigned long long)st.pcp_hits,
+        (unsigned long long)st.failures);
+    printf("[PageAlloc] free blocks by order:");
+    for (int o = 0; o < PAGE_ORDERS; ++o) printf(" %llu", (unsigned long long)st.free_blocks[o]);
+    printf("\n");
+}
@@ -0,0 +1,674 @@
+// unified page cache for filesystem modules
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "page_cache.h"
+#include "spinlock.h"
+#include "page_alloc.h"
+#include "shrinker.h"
+#include "ktime.h"
+
+#define PC_NONE (-1)
+#define PS PAGE_CACHE_PAGE_SIZE
+#define PC_CHUNK_SHIFT HUGE_PAGE_ORDER       // PS is PAGE_SIZE
+#define PC_CHUNK_PAGES (1u << PC_CHUNK_SHIFT) // Cache pages per huge page
+
+typedef struct pc_inode {
+    uint64_t id;
+    fs_module_t* fs;
+    char path[256];
+    uint32_t nr_pages;
+    uint32_t pins;          // Callers currently operating on this inode
+    int32_t hnext;
+    uint64_t ra_next;       // Page index a sequential reader would touch next
+    uint32_t ra_window;     // Current read-ahead window in pages (0 = random access)
+} pc_inode_t;
+
+typedef struct pc_page {
+    uint64_t index;
+    int32_t inode;          // Owning inode slot, PC_NONE when free
+    int32_t hnext;          // Hash chain, or free list link
+    uint32_t valid;         // Bytes of the page backed by file data
+    uint8_t referenced;
+    uint8_t dirty;
+    uint8_t writeback;      // Being written with pc.lock dropped: not evictable
+    uint8_t filling;        // Being read in with pc.lock dropped: contents not valid yet
+    uint64_t dirtied_ms;
+    int32_t dprev, dnext;   // Dirty list, while dirty
+} pc_page_t;
+
+static struct {
+    spinlock_t lock;
+    uint8_t** frames;       // Huge pages holding the page frames, NULL once released
+    uint32_t nr_chunks;
+    uint32_t populated;     // Chunks with frames
+    uint64_t shrunk_ms;     // Last time a chunk was released
+    pc_page_t* pages;
+    int32_t* buckets;
+    uint32_t nr_buckets;
+    uint32_t nr_pages;
+    uint32_t used;
+    uint32_t dirty;
+    int32_t dirty_head;     // Oldest dirty page; the list is in dirtying order
+    int32_t dirty_tail;
+    int32_t free_list;
+    uint32_t clock_hand;
+    pc_inode_t inodes[PAGE_CACHE_MAX_INODES];
+    int32_t inode_buckets[PAGE_CACHE_MAX_INODES];
+    int32_t inode_free[PAGE_CACHE_MAX_INODES];
+    int inode_free_top;
+    uint64_t now_ms;
+    page_cache_stats_t stats;
+} pc;
+
+static inline uint8_t* pc_frame(int32_t pg) {
+    return pc.frames[(uint32_t)pg >> PC_CHUNK_SHIFT] + (size_t)((uint32_t)pg & (PC_CHUNK_PAGES - 1)) * PS;
+}
+
+static void pc_free_frames(void) {
+    for (uint32_t i = 0; pc.frames && i < pc.nr_chunks; ++i) page_free(pc.frames[i]);
+    free(pc.frames);
+    pc.frames = NULL;
+    pc.nr_chunks = 0;
+    pc.populated = 0;
+}
+
+// ---- inodes ----
+
+static uint64_t pc_inode_id(fs_module_t* fs, const char* path) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    while (*path) { h ^= (uint8_t)*path++; h *= 1099511628211ULL; }
+    h ^= (uint64_t)(uintptr_t)fs * 0x9E3779B97F4A7C15ULL;
+    return h;
+}
+
+static int32_t pc_inode_get(fs_module_t* fs, const char* path) {
+    uint64_t id = pc_inode_id(fs, path);
+    uint32_t b = (uint32_t)id & (PAGE_CACHE_MAX_INODES - 1);
+    for (int32_t i = pc.inode_buckets[b]; i != PC_NONE; i = pc.inodes[i].hnext) {
+        if (pc.inodes[i].id == id && pc.inodes[i].fs == fs && strcmp(pc.inodes[i].path, path) == 0) {
+            pc.inodes[i].pins++;
+            return i;
+        }
+    }
+    if (pc.inode_free_top == 0 || strlen(path) >= sizeof(pc.inodes[0].path)) return PC_NONE;
+    int32_t i = pc.inode_free[--pc.inode_free_top];
+    pc_inode_t* in = &pc.inodes[i];
+    memset(in, 0, sizeof(*in));
+    in->id = id;
+    in->fs = fs;
+    strcpy(in->path, path);
+    in->pins = 1;
+    in->hnext = pc.inode_buckets[b];
+    pc.inode_buckets[b] = i;
+    return i;
+}
+
+static void pc_inode_put(int32_t i) {
+    pc_inode_t* in = &pc.inodes[i];
+    if (in->pins > 0) in->pins--;
+    if (in->pins || in->nr_pages) return;
+    uint32_t b = (uint32_t)in->id & (PAGE_CACHE_MAX_INODES - 1);
+    int32_t* link = &pc.inode_buckets[b];
+    while (*link != i) link = &pc.inodes[*link].hnext;
+    *link = in->hnext;
+    in->id = 0;
+    pc.inode_free[pc.inode_free_top++] = i;
+}
+
+// ---- pages ----
+
+static inline uint32_t pc_hash(int32_t inode, uint64_t index) {
+    uint64_t k = ((uint64_t)(uint32_t)inode << 40) ^ index;
+    k *= 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(k >> 32) & (pc.nr_buckets - 1);
+}
+
+static int32_t pc_find(int32_t inode, uint64_t index) {
+    for (int32_t p = pc.buckets[pc_hash(inode, index)]; p != PC_NONE; p = pc.pages[p].hnext) {
+        if (pc.pages[p].inode == inode && pc.pages[p].index == index) return p;
+    }
+    return PC_NONE;
+}
+
+static void pc_set_dirty(int32_t pg) {
+    pc_page_t* p = &pc.pages[pg];
+    if (p->dirty) return;
+    p->dirty = 1;
+    p->dirtied_ms = pc.now_ms;
+    p->dprev = pc.dirty_tail;
+    p->dnext = PC_NONE;
+    if (pc.dirty_tail != PC_NONE) pc.pages[pc.dirty_tail].dnext = pg;
+    else pc.dirty_head = pg;
+    pc.dirty_tail = pg;
+    pc.dirty++;
+}
+
+static void pc_clear_dirty(int32_t pg) {
+    pc_page_t* p = &pc.pages[pg];
+    if (!p->dirty) return;
+    if (p->dprev != PC_NONE) pc.pages[p->dprev].dnext = p->dnext;
+    else pc.dirty_head = p->dnext;
+    if (p->dnext != PC_NONE) pc.pages[p->dnext].dprev = p->dprev;
+    else pc.dirty_tail = p->dprev;
+    p->dirty = 0;
+    pc.dirty--;
+}
+
+static void pc_insert(int32_t pg, int32_t inode, uint64_t index) {
+    pc_page_t* p = &pc.pages[pg];
+    uint32_t b = pc_hash(inode, index);
+    p->inode = inode;
+    p->index = index;
+    p->referenced = 1;
+    p->dirty = 0;
+    p->hnext = pc.buckets[b];
+    pc.buckets[b] = pg;
+    pc.inodes[inode].nr_pages++;
+    pc.used++;
+}
+
+// Writes a dirty page back with pc.lock (held on entry and on return) dropped
+// around the module write. The page is marked under writeback and its inode
+// pinned so neither the page nor its chunk goes away meanwhile; a write
+// landing during the I/O just dirties it again. A failed page stays dirty.
+static int pc_writeback_page(int32_t pg) {
+    pc_page_t* p = &pc.pages[pg];
+    if (!p->dirty) return 0;
+    if (p->writeback) return -1;
+    int32_t inode = p->inode;
+    pc_inode_t* in = &pc.inodes[inode];
+    if (!in->fs->ops->write) return -1;
+    uint32_t valid = p->valid;
+    pc_clear_dirty(pg);
+    p->writeback = 1;
+    in->pins++;
+    spin_unlock(&pc.lock);
+    int w = in->fs->ops->write(in->path, pc_frame(pg), valid, p->index * PS);
+    spin_lock(&pc.lock);
+    p->writeback = 0;
+    int rc = 0;
+    if (w < 0 || (uint32_t)w < valid) {
+        pc_set_dirty(pg); // Retried after another PAGE_CACHE_WRITEBACK_MS
+        rc = -1;
+    } else {
+        pc.stats.writebacks++;
+    }
+    pc_inode_put(inode);
+    return rc;
+}
+
+static void pc_remove(int32_t pg) {
+    pc_page_t* p = &pc.pages[pg];
+    int32_t inode = p->inode;
+    int32_t* link = &pc.buckets[pc_hash(inode, p->index)];
+    while (*link != pg) link = &pc.pages[*link].hnext;
+    *link = p->hnext;
+    pc_clear_dirty(pg);
+    p->inode = PC_NONE;
+    p->filling = 0;
+    p->hnext = pc.free_list;
+    pc.free_list = pg;
+    pc.used--;
+    pc.inodes[inode].nr_pages--;
+    if (pc.inodes[inode].nr_pages == 0) {
+        pc.inodes[inode].pins++;
+        pc_inode_put(inode);
+    }
+}
+
+static void pc_evict(int32_t pg) {
+    pc_remove(pg);
+    pc.stats.evictions++;
+}
+
+// Let another caller finish its I/O on a page; pc.lock is held on return
+static void pc_wait(void) {
+    spin_unlock(&pc.lock);
+    cpu_relax();
+    spin_lock(&pc.lock);
+}
+
+// CLOCK second-chance sweep over clean pages. Dirty pages are left to the
+// timer and the dirty-ratio flush: callers here are mid-operation under
+// pc.lock, and with nothing clean they go to the module uncached.
+static int32_t pc_reclaim_one(void) {
+    for (uint32_t scanned = 0; scanned < 2 * pc.nr_pages; ++scanned) {
+        int32_t pg = (int32_t)pc.clock_hand;
+        pc.clock_hand = (pc.clock_hand + 1) % pc.nr_pages;
+        pc_page_t* p = &pc.pages[pg];
+        if (p->inode == PC_NONE || p->dirty || p->writeback || p->filling) continue;
+        if (p->referenced) { p->referenced = 0; continue; }
+        pc_evict(pg);
+        return pg;
+    }
+    return PC_NONE;
+}
+
+// Re-populate a released chunk once pressure has been gone for a while
+static int pc_grow(void) {
+    if (pc.populated == pc.nr_chunks || ktime_ms() - pc.shrunk_ms < PAGE_CACHE_REGROW_MS) return -1;
+    uint32_t c = 0;
+    while (pc.frames[c]) c++;
+    pc.frames[c] = (uint8_t*)page_alloc_huge(0);
+    if (!pc.frames[c]) return -1;
+    pc.populated++;
+    for (uint32_t i = PC_CHUNK_PAGES; i-- > 0;) {
+        int32_t pg = (int32_t)(c * PC_CHUNK_PAGES + i);
+        pc.pages[pg].hnext = pc.free_list;
+        pc.free_list = pg;
+    }
+    return 0;
+}
+
+// Empty a chunk and hand its huge page back to the page allocator. Dirty
+// pages are written back with the lock dropped; if one is dirtied again,
+// still under writeback or being read in by then, the chunk stays.
+static int pc_release_chunk(uint32_t c) {
+    int32_t base = (int32_t)(c * PC_CHUNK_PAGES);
+    int32_t end = base + (int32_t)PC_CHUNK_PAGES;
+    for (int32_t pg = base; pg < end; ++pg) {
+        if (pc.pages[pg].inode == PC_NONE) continue;
+        if (pc_writeback_page(pg) != 0) return -1;
+    }
+    for (int32_t pg = base; pg < end; ++pg) {
+        pc_page_t* p = &pc.pages[pg];
+        if (p->inode != PC_NONE && (p->dirty || p->writeback || p->filling)) return -1;
+    }
+    for (int32_t pg = base; pg < end; ++pg) {
+        if (pc.pages[pg].inode != PC_NONE) pc_evict(pg);
+    }
+    for (int32_t* link = &pc.free_list; *link != PC_NONE;) {
+        if (*link >= base && *link < end) *link = pc.pages[*link].hnext;
+        else link = &pc.pages[*link].hnext;
+    }
+    page_free(pc.frames[c]);
+    pc.frames[c] = NULL;
+    pc.populated--;
+    pc.shrunk_ms = ktime_ms();
+    return 0;
+}
+
+static int32_t pc_alloc(void) {
+    if (pc.free_list == PC_NONE && pc_grow() < 0 && pc_reclaim_one() == PC_NONE) return PC_NONE;
+    int32_t pg = pc.free_list;
+    pc.free_list = pc.pages[pg].hnext;
+    pc.pages[pg].valid = 0;
+    return pg;
+}
+
+// Fill up to n missing pages starting at index with a single module read,
+// made with pc.lock dropped. The pages are hashed first and marked filling,
+// so other callers wait for them rather than reading them in again, and
+// reclaim and invalidation leave them alone. Pages past last_wanted are
+// counted as read-ahead. Returns the pages set up (0 if none could be
+// allocated), or -1 if the read failed.
+static int pc_fill_range(int32_t inode, uint64_t index, uint32_t n, uint64_t last_wanted) {
+    pc_inode_t* in = &pc.inodes[inode];
+    if (n > PAGE_CACHE_RA_MAX_PAGES) n = PAGE_CACHE_RA_MAX_PAGES;
+    int32_t pgs[PAGE_CACHE_RA_MAX_PAGES];
+    uint32_t count = 0;
+    while (count < n && pc_find(inode, index + count) == PC_NONE) {
+        int32_t pg = pc_alloc();
+        if (pg == PC_NONE) break;
+        pc_insert(pg, inode, index + count);
+        pc.pages[pg].filling = 1;
+        pgs[count++] = pg;
+    }
+    if (count == 0) return 0;
+    // Several callers may be filling at once: read-ahead gets its own buffer
+    uint8_t* buf = count > 1 ? (uint8_t*)malloc((size_t)count * PS) : NULL;
+    if (!buf) {
+        for (uint32_t k = 1; k < count; ++k) pc_remove(pgs[k]);
+        count = 1;
+    }
+    uint8_t* dst = buf ? buf : pc_frame(pgs[0]);
+    spin_unlock(&pc.lock);
+    int r = in->fs->ops->read(in->path, dst, (size_t)count * PS, index * PS);
+    spin_lock(&pc.lock);
+    for (uint32_t k = 0; k < count; ++k) {
+        int32_t pg = pgs[k];
+        int64_t bytes = (int64_t)r - (int64_t)k * PS;
+        // Nothing is kept from a failed read, nor beyond EOF
+        if (r < 0 || (k > 0 && bytes <= 0)) {
+            pc_remove(pg);
+            continue;
+        }
+        if (bytes > PS) bytes = PS;
+        if (buf) memcpy(pc_frame(pg), buf + (size_t)k * PS, (size_t)bytes);
+        pc.pages[pg].valid = (uint32_t)bytes;
+        pc.pages[pg].filling = 0;
+        if (index + k > last_wanted) pc.stats.readahead_pages++;
+    }
+    free(buf);
+    return r < 0 ? -1 : (int)count;
+}
+
+// After a write that bypassed the cache, drop any copy of the page read in
+// meanwhile; it may predate the write. A dirty copy is newer and stays.
+static void pc_drop_stale(int32_t inode, uint64_t index) {
+    for (;;) {
+        int32_t pg = pc_find(inode, index);
+        if (pg == PC_NONE) return;
+        if (pc.pages[pg].filling || pc.pages[pg].writeback) {
+            pc_wait();
+            continue;
+        }
+        if (!pc.pages[pg].dirty) pc_evict(pg);
+        return;
+    }
+}
+
+static unsigned long pc_shrink_count(shrinker_t* s) {
+    (void)s;
+    uint32_t populated = __atomic_load_n(&pc.populated, __ATOMIC_RELAXED);
+    return populated > 1 ? (unsigned long)(populated - 1) * PC_CHUNK_PAGES : 0;
+}
+
+static unsigned long pc_shrink_scan(shrinker_t* s, unsigned long nr, int priority) {
+    (void)s; (void)priority;
+    return page_cache_shrink((uint32_t)nr);
+}
+
+static shrinker_t pc_shrinker = {
+    .name = "page_cache",
+    .count = pc_shrink_count,
+    .scan = pc_shrink_scan,
+    .seeks = SHRINKER_DEFAULT_SEEKS,
+};
+
+int page_cache_init(uint32_t max_pages) {
+    if (pc.pages) return 0;
+    if (max_pages < 4 * PAGE_CACHE_RA_MAX_PAGES) max_pages = 4 * PAGE_CACHE_RA_MAX_PAGES;
+    // Frames come in whole huge pages: one TLB entry covers 512 cached pages
+    max_pages = (max_pages + PC_CHUNK_PAGES - 1) & ~(PC_CHUNK_PAGES - 1);
+    uint32_t nb = 1;
+    while (nb < max_pages) nb <<= 1;
+    uint32_t chunks = max_pages / PC_CHUNK_PAGES;
+    pc.frames = (uint8_t**)calloc(chunks, sizeof(uint8_t*));
+    for (uint32_t i = 0; pc.frames && i < chunks; ++i) {
+        pc.frames[i] = (uint8_t*)page_alloc_huge(0);
+        if (!pc.frames[i]) break;
+        pc.nr_chunks++;
+    }
+    pc.populated = pc.nr_chunks;
+    pc.pages = (pc_page_t*)calloc(max_pages, sizeof(pc_page_t));
+    pc.buckets = (int32_t*)malloc(nb * sizeof(int32_t));
+    if (pc.nr_chunks < chunks || !pc.pages || !pc.buckets) {
+        pc_free_frames(); free(pc.pages); free(pc.buckets);
+        pc.pages = NULL; pc.buckets = NULL;
+        printf("[PageCache] Out of memory, running uncached\n");
+        return -1;
+    }
+    spin_init(&pc.lock);
+    pc.nr_pages = max_pages;
+    pc.nr_buckets = nb;
+    for (uint32_t i = 0; i < nb; ++i) pc.buckets[i] = PC_NONE;
+    for (uint32_t i = 0; i < max_pages; ++i) {
+        pc.pages[i].inode = PC_NONE;
+        pc.pages[i].hnext = (i + 1 < max_pages) ? (int32_t)(i + 1) : PC_NONE;
+    }
+    pc.free_list = 0;
+    pc.dirty_head = pc.dirty_tail = PC_NONE;
+    for (int i = 0; i < PAGE_CACHE_MAX_INODES; ++i) {
+        pc.inode_buckets[i] = PC_NONE;
+        pc.inode_free[i] = PAGE_CACHE_MAX_INODES - 1 - i;
+    }
+    pc.inode_free_top = PAGE_CACHE_MAX_INODES;
+    shrinker_register(&pc_shrinker);
+    printf("[PageCache] Initialized (%u pages, %u KiB)\n", max_pages, max_pages * (PS / 1024));
+    return 0;
+}
+
+void page_cache_shutdown(void) {
+    if (!pc.pages) return;
+    shrinker_unregister(&pc_shrinker);
+    spin_lock(&pc.lock);
+    uint32_t lost = 0;
+    // A failed page goes to the back of the list: each is tried once
+    for (uint32_t n = pc.dirty; n && pc.dirty_head != PC_NONE; --n) {
+        if (pc_writeback_page(pc.dirty_head) != 0) lost++;
+    }
+    pc_free_frames(); free(pc.pages); free(pc.buckets);
+    pc.pages = NULL; pc.buckets = NULL;
+    spin_unlock(&pc.lock);
+    if (lost) printf("[PageCache] %u dirty pages could not be written back\n", lost);
+    printf("[PageCache] Shutdown.\n");
+}
+
+int page_cache_read(fs_module_t* fs, const char* path, void* buf, size_t len, uint64_t offset) {
+    if (!fs || !fs->ops || !fs->ops->read || !path || !buf) return -1;
+    if (len == 0) return 0;
+    if (!pc.pages) return fs->ops->read(path, buf, len, offset);
+    spin_lock(&pc.lock);
+    int32_t inode = pc_inode_get(fs, path);
+    if (inode == PC_NONE) {
+        spin_unlock(&pc.lock);
+        return fs->ops->read(path, buf, len, offset);
+    }
+    pc_inode_t* in = &pc.inodes[inode];
+    uint64_t first = offset / PS, last = (offset + len - 1) / PS;
+    // Sequential stream: grow the read-ahead window, otherwise drop it
+    if (first == in->ra_next || (in->ra_next && first + 1 == in->ra_next)) {
+        in->ra_window = in->ra_window ? in->ra_window * 2 : 4;
+        if (in->ra_window > PAGE_CACHE_RA_MAX_PAGES) in->ra_window = PAGE_CACHE_RA_MAX_PAGES;
+    } else {
+        in->ra_window = 0;
+    }
+    in->ra_next = last + 1;
+    uint8_t* dst = (uint8_t*)buf;
+    size_t done = 0;
+    uint64_t idx = first;
+    while (idx <= last) {
+        uint32_t pgoff = (idx == first) ? (uint32_t)(offset % PS) : 0;
+        int32_t pg = pc_find(inode, idx);
+        if (pg != PC_NONE && pc.pages[pg].filling) {
+            pc_wait();
+            continue;
+        }
+        if (pg == PC_NONE) {
+            pc.stats.misses++;
+            uint32_t want = (uint32_t)(last - idx + 1);
+            if (want < in->ra_window) want = in->ra_window;
+            int f = pc_fill_range(inode, idx, want, last);
+            if (f < 0) break;
+            if (f == 0) {
+                // Nothing could be allocated: this page alone comes from the
+                // module; later pages may still be cached (and dirty)
+                size_t n = PS - pgoff;
+                if (n > len - done) n = len - done;
+                spin_unlock(&pc.lock);
+                int r = fs->ops->read(path, dst + done, n, offset + done);
+                spin_lock(&pc.lock);
+                if (r > 0) done += (size_t)r;
+                if (r < 0 || (size_t)r < n) break;
+                idx++;
+                continue;
+            }
+            pg = pc_find(inode, idx);
+        } else {
+            pc.stats.hits++;
+        }
+        pc_page_t* p = &pc.pages[pg];
+        p->referenced = 1;
+        if (p->valid <= pgoff) break; // EOF
+        size_t n = p->valid - pgoff;
+        if (n > len - done) n = len - done;
+        memcpy(dst + done, pc_frame(pg) + pgoff, n);
+        done += n;
+        if (p->valid < PS) break; // EOF inside this page
+        idx++;
+    }
+    pc_inode_put(inode);
+    spin_unlock(&pc.lock);
+    return (int)done;
+}
+
+int page_cache_write(fs_module_t* fs, const char* path, const void* buf, size_t len, uint64_t offset) {
+    if (!fs || !fs->ops || !fs->ops->write || !path || !buf) return -1;
+    if (len == 0) return 0;
+    if (!pc.pages) return fs->ops->write(path, buf, len, offset);
+    spin_lock(&pc.lock);
+    int32_t inode = pc_inode_get(fs, path);
+    if (inode == PC_NONE) {
+        spin_unlock(&pc.lock);
+        return fs->ops->write(path, buf, len, offset);
+    }
+    const uint8_t* src = (const uint8_t*)buf;
+    uint64_t first = offset / PS, last = (offset + len - 1) / PS;
+    size_t done = 0;
+    int result = 0;
+    uint64_t idx = first;
+    while (idx <= last) {
+        uint32_t pgoff = (idx == first) ? (uint32_t)(offset % PS) : 0;
+        size_t n = PS - pgoff;
+        if (n > len - done) n = len - done;
+        int32_t pg = pc_find(inode, idx);
+        if (pg != PC_NONE && pc.pages[pg].filling) {
+            pc_wait();
+            continue;
+        }
+        if (pg == PC_NONE) {
+            pg = pc_alloc();
+            if (pg == PC_NONE) {
+                // Nothing could be allocated: this page alone goes to the
+                // module; later pages may still be cached and are updated
+                spin_unlock(&pc.lock);
+                int w = fs->ops->write(path, src + done, n, offset + done);
+                spin_lock(&pc.lock);
+                if (w < 0) { result = -1; break; }
+                done += (size_t)w;
+                pc_drop_stale(inode, idx);
+                if ((size_t)w < n) break;
+                idx++;
+                continue;
+            }
+            pc_insert(pg, inode, idx);
+            // Partial page write: bring in the rest of the page first
+            if (pgoff != 0 || n != PS) {
+                pc.pages[pg].filling = 1;
+                spin_unlock(&pc.lock);
+                int r = fs->ops->read ? fs->ops->read(path, pc_frame(pg), PS, idx * PS) : -1;
+                spin_lock(&pc.lock);
+                pc.pages[pg].filling = 0;
+                pc.pages[pg].valid = r > 0 ? (uint32_t)r : 0;
+            }
+        }
+        pc_page_t* p = &pc.pages[pg];
+        if (pgoff > p->valid) memset(pc_frame(pg) + p->valid, 0, pgoff - p->valid);
+        memcpy(pc_frame(pg) + pgoff, src + done, n);
+        if (pgoff + n > p->valid) p->valid = (uint32_t)(pgoff + n);
+        p->referenced = 1;
+        pc_set_dirty(pg);
+        done += n;
+        idx++;
+    }
+    // Too much dirty data: write it all back now instead of waiting for the
+    // timer, oldest first, stopping at an error or a page already in flight
+    if ((uint64_t)pc.dirty * 100 > (uint64_t)pc.nr_pages * PAGE_CACHE_DIRTY_RATIO) {
+        for (uint32_t n = pc.dirty; n && pc.dirty_head != PC_NONE; --n) {
+            if (pc_writeback_page(pc.dirty_head) != 0) break;
+        }
+    }
+    pc_inode_put(inode);
+    spin_unlock(&pc.lock);
+    return result < 0 && done == 0 ? -1 : (int)done;
+}
+
+// Writes back (and with drop, evicts) one page, first waiting out any
+// writeback or read-in another caller has in flight. A page that fails, or
+// that was dirtied again during the write, stays cached.
+static int pc_sync_page(int32_t inode, uint64_t index, int drop) {
+    for (;;) {
+        int32_t pg = pc_find(inode, index);
+        if (pg == PC_NONE) return 0;
+        if (pc.pages[pg].writeback || pc.pages[pg].filling) {
+            pc_wait();
+            continue;
+        }
+        if (pc_writeback_page(pg) != 0) return -1;
+        if (drop && !pc.pages[pg].dirty) pc_evict(pg);
+        return 0;
+    }
+}
+
+static int pc_sync_range(fs_module_t* fs, const char* path, uint64_t offset, size_t len, int drop) {
+    if (!pc.pages || !fs || !path) return 0;
+    spin_lock(&pc.lock);
+    int32_t inode = pc_inode_get(fs, path);
+    if (inode == PC_NONE) { spin_unlock(&pc.lock); return 0; }
+    int rc = 0;
+    uint64_t first = offset / PS;
+    uint64_t last = len ? (offset + len - 1) / PS : UINT64_MAX;
+    if (len && last - first < pc.nr_pages) {
+        for (uint64_t idx = first; idx <= last; ++idx) {
+            if (pc_sync_page(inode, idx, drop) != 0) rc = -1;
+        }
+    } else {
+        for (uint32_t i = 0; i < pc.nr_pages; ++i) {
+            pc_page_t* p = &pc.pages[i];
+            if (p->inode != inode || p->index < first || p->index > last) continue;
+            if (pc_sync_page(inode, p->index, drop) != 0) rc = -1;
+        }
+    }
+    pc_inode_put(inode);
+    spin_unlock(&pc.lock);
+    return rc;
+}
+
+int page_cache_flush(fs_module_t* fs, const char* path, uint64_t offset, size_t len) {
+    return pc_sync_range(fs, path, offset, len, 0);
+}
+
+int page_cache_invalidate(fs_module_t* fs, const char* path, uint64_t offset, size_t len) {
+    return pc_sync_range(fs, path, offset, len, 1);
+}
+
+// Periodic write-back of pages that have been dirty for too long. The dirty
+// list is oldest first, so the walk ends at the first page still young.
+void page_cache_tick(uint64_t now_ms) {
+    if (!pc.pages) return;
+    spin_lock(&pc.lock);
+    pc.now_ms = now_ms;
+    for (uint32_t n = pc.dirty; n && pc.dirty_head != PC_NONE; --n) {
+        int32_t pg = pc.dirty_head;
+        if (now_ms - pc.pages[pg].dirtied_ms < PAGE_CACHE_WRITEBACK_MS) break;
+        if (pc_writeback_page(pg) != 0 && pc.pages[pg].writeback) break; // Still in flight elsewhere
+    }
+    spin_unlock(&pc.lock);
+}
+
+// Memory pressure: release at least nr_pages back to the page allocator,
+// in whole chunks, starting with the least used. Dirty pages are written
+// back first. One chunk always stays.
+uint32_t page_cache_shrink(uint32_t nr_pages) {
+    if (!pc.pages) return 0;
+    uint32_t freed = 0;
+    spin_lock(&pc.lock);
+    while (freed < nr_pages && pc.populated > 1) {
+        uint32_t best = 0, best_used = UINT32_MAX;
+        for (uint32_t c = 0; c < pc.nr_chunks; ++c) {
+            if (!pc.frames[c]) continue;
+            uint32_t used = 0;
+            for (uint32_t i = 0; i < PC_CHUNK_PAGES; ++i) used += pc.pages[c * PC_CHUNK_PAGES + i].inode != PC_NONE;
+            if (used < best_used) { best = c; best_used = used; }
+        }
+        if (pc_release_chunk(best) < 0) break;
+        freed += PC_CHUNK_PAGES;
+    }
+    spin_unlock(&pc.lock);
+    return freed;
+}
+
+void page_cache_get_stats(page_cache_stats_t* out) {
+    if (!out) return;
+    spin_lock(&pc.lock);
+    *out = pc.stats;
+    out->pages_total = pc.populated * PC_CHUNK_PAGES;
+    out->pages_used = pc.used;
+    out->pages_dirty = pc.dirty;
+    spin_unlock(&pc.lock);
+}
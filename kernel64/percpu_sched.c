@@ -0,0 +1,250 @@
+// per-CPU run queues with work stealing and load balancing
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <stdio.h>
+#include "percpu_sched.h"
+#include "sched_trace.h"
+
+static cpu_rq_t cpu_rqs[SCHED_MAX_CPUS];
+static int nr_cpus = 1;
+
+#define task_of(e) ((sched_task_t*)((char*)(e) - offsetof(sched_task_t, rq)))
+
+static inline cpu_mask_t online_mask(void) {
+    return nr_cpus >= 64 ? CPU_MASK_ALL : (((cpu_mask_t)1 << nr_cpus) - 1);
+}
+
+static inline int rq_nr_running(int cpu) {
+    return __atomic_load_n(&cpu_rqs[cpu].rq.nr_running, __ATOMIC_RELAXED);
+}
+
+void percpu_sched_init(int n) {
+    if (n < 1) n = 1;
+    if (n > SCHED_MAX_CPUS) n = SCHED_MAX_CPUS;
+    nr_cpus = n;
+    for (int c = 0; c < n; ++c) {
+        cpu_rq_t* rq = &cpu_rqs[c];
+        spin_init(&rq->lock);
+        prio_rq_init(&rq->rq);
+        rq->curr = NULL;
+        rq->curr_start_ms = 0;
+        rq->load_avg = 0;
+        rq->nr_switches = rq->nr_steals = rq->nr_migrations = 0;
+    }
+    printf("[Sched] %d per-CPU run queue(s) ready\n", n);
+}
+
+int percpu_sched_nr_cpus(void) { return nr_cpus; }
+
+const cpu_rq_t* sched_cpu_rq(int cpu) {
+    return (cpu >= 0 && cpu < nr_cpus) ? &cpu_rqs[cpu] : NULL;
+}
+
+void sched_task_init(sched_task_t* t, int pid, int priority, cpu_mask_t affinity) {
+    prio_entity_init(&t->rq, priority);
+    t->pid = pid;
+    t->affinity = affinity ? affinity : CPU_MASK_ALL;
+    t->cpu = -1;
+    t->last_cpu = -1;
+    t->last_ran_ms = 0;
+    t->sum_exec_ms = 0;
+}
+
+// Least-loaded allowed CPU, unless the last CPU is within SCHED_WARM_SLACK
+// of it: a warm cache is worth a slightly longer queue
+static int select_cpu(const sched_task_t* t) {
+    cpu_mask_t allowed = t->affinity & online_mask();
+    if (!allowed) allowed = online_mask();
+    int best = 0, best_load = INT_MAX;
+    for (int c = 0; c < nr_cpus; ++c) {
+        if (!(allowed & ((cpu_mask_t)1 << c))) continue;
+        int load = rq_nr_running(c);
+        if (load < best_load) { best = c; best_load = load; }
+    }
+    int last = t->last_cpu;
+    if (last >= 0 && last < nr_cpus && (allowed & ((cpu_mask_t)1 << last)) &&
+        rq_nr_running(last) <= best_load + SCHED_WARM_SLACK) return last;
+    return best;
+}
+
+static void enqueue_on(int cpu, sched_task_t* t) {
+    cpu_rq_t* rq = &cpu_rqs[cpu];
+    spin_lock(&rq->lock);
+    prio_rq_enqueue(&rq->rq, &t->rq);
+    __atomic_store_n(&t->cpu, cpu, __ATOMIC_RELEASE);
+    spin_unlock(&rq->lock);
+    sched_trace_enqueue(t->pid, cpu);
+}
+
+// Queue a detached task on the best CPU (wakeups and forced migrations)
+static int place_task(sched_task_t* t) {
+    int cpu = select_cpu(t);
+    enqueue_on(cpu, t);
+    return cpu;
+}
+
+int sched_wake_task(sched_task_t* t) {
+    int cpu = __atomic_load_n(&t->cpu, __ATOMIC_ACQUIRE);
+    if (cpu >= 0) return cpu;
+    sched_trace_wakeup(t->pid, -1);
+    return place_task(t);
+}
+
+// Lock the queue that currently owns t; retries if t migrates meanwhile.
+// Returns the locked queue, or NULL (nothing locked) if t is not queued.
+static cpu_rq_t* lock_task_rq(sched_task_t* t) {
+    for (;;) {
+        int cpu = __atomic_load_n(&t->cpu, __ATOMIC_ACQUIRE);
+        if (cpu < 0) return NULL;
+        cpu_rq_t* rq = &cpu_rqs[cpu];
+        spin_lock(&rq->lock);
+        if (t->cpu == cpu) return rq;
+        spin_unlock(&rq->lock);
+    }
+}
+
+void sched_dequeue_task(sched_task_t* t) {
+    cpu_rq_t* rq = lock_task_rq(t);
+    if (!rq) return;
+    prio_rq_dequeue(&rq->rq, &t->rq);
+    t->cpu = -1;
+    if (rq->curr == t) rq->curr = NULL;
+    spin_unlock(&rq->lock);
+}
+
+int sched_set_task_priority(sched_task_t* t, int priority) {
+    cpu_rq_t* rq = lock_task_rq(t);
+    if (!rq) {
+        prio_entity_init(&t->rq, priority);
+        return 0;
+    }
+    prio_rq_set_priority(&rq->rq, &t->rq, priority);
+    spin_unlock(&rq->lock);
+    return 0;
+}
+
+int sched_set_affinity(sched_task_t* t, cpu_mask_t mask) {
+    if (!(mask & online_mask())) return -1;
+    t->affinity = mask;
+    cpu_rq_t* rq = lock_task_rq(t);
+    if (!rq) return 0;
+    int cpu = (int)(rq - cpu_rqs);
+    int move = !(mask & ((cpu_mask_t)1 << cpu)) && rq->curr != t;
+    if (move) {
+        prio_rq_dequeue(&rq->rq, &t->rq);
+        t->cpu = -1;
+    }
+    spin_unlock(&rq->lock);
+    // A running task is moved when it is switched out (sched_put_prev)
+    if (move) place_task(t);
+    return 0;
+}
+
+// Switch out the current task: charge its run time and rotate it if its slice is spent
+void sched_put_prev(int cpu, uint64_t now_ms) {
+    cpu_rq_t* rq = &cpu_rqs[cpu];
+    spin_lock(&rq->lock);
+    sched_task_t* t = rq->curr;
+    int migrate = 0;
+    if (t) {
+        uint64_t ran = now_ms > rq->curr_start_ms ? now_ms - rq->curr_start_ms : 0;
+        t->sum_exec_ms += ran;
+        t->last_ran_ms = now_ms;
+        t->last_cpu = cpu;
+        prio_rq_charge(&rq->rq, &t->rq, (uint32_t)ran);
+        rq->curr = NULL;
+        if (!(t->affinity & ((cpu_mask_t)1 << cpu))) {
+            prio_rq_dequeue(&rq->rq, &t->rq);
+            t->cpu = -1;
+            migrate = 1;
+        }
+    }
+    spin_unlock(&rq->lock);
+    if (migrate) place_task(t);
+}
+
+// Best task on a victim queue that may run on dst: not running, allowed,
+// and preferably cache-cold
+static sched_task_t* pick_migratable(cpu_rq_t* v, int dst, uint64_t now_ms) {
+    sched_task_t* fallback = NULL;
+    uint32_t bits = v->rq.bitmap;
+    while (bits) {
+        int p = __builtin_ctz(bits);
+        bits &= bits - 1;
+        for (prio_entity_t* e = v->rq.head[p]; e; e = e->next) {
+            sched_task_t* t = task_of(e);
+            if (t == v->curr || !(t->affinity & ((cpu_mask_t)1 << dst))) continue;
+            if (now_ms - t->last_ran_ms >= SCHED_CACHE_HOT_MS) return t;
+            if (!fallback) fallback = t;
+        }
+    }
+    return fallback;
+}
+
+static sched_task_t* detach_one(int src, int dst, uint64_t now_ms) {
+    cpu_rq_t* v = &cpu_rqs[src];
+    spin_lock(&v->lock);
+    sched_task_t* t = pick_migratable(v, dst, now_ms);
+    if (t) {
+        prio_rq_dequeue(&v->rq, &t->rq);
+        t->cpu = -1;
+    }
+    spin_unlock(&v->lock);
+    return t;
+}
+
+// Idle CPU: pull one task from the busiest queue that can spare one
+static void steal_work(int cpu, uint64_t now_ms) {
+    int victim = -1, most = 1;
+    for (int c = 0; c < nr_cpus; ++c) {
+        if (c == cpu) continue;
+        int load = rq_nr_running(c);
+        if (load > most) { victim = c; most = load; }
+    }
+    if (victim < 0) return;
+    sched_task_t* t = detach_one(victim, cpu, now_ms);
+    if (!t) return;
+    enqueue_on(cpu, t);
+    cpu_rqs[cpu].nr_steals++;
+    cpu_rqs[cpu].nr_migrations++;
+}
+
+sched_task_t* sched_schedule(int cpu, uint64_t now_ms) {
+    if (cpu < 0 || cpu >= nr_cpus) return NULL;
+    sched_put_prev(cpu, now_ms);
+    cpu_rq_t* rq = &cpu_rqs[cpu];
+    if (rq_nr_running(cpu) == 0 && nr_cpus > 1) steal_work(cpu, now_ms);
+    spin_lock(&rq->lock);
+    prio_entity_t* e = prio_rq_peek(&rq->rq);
+    sched_task_t* next = e ? task_of(e) : NULL;
+    rq->curr = next;
+    rq->curr_start_ms = now_ms;
+    if (next) rq->nr_switches++;
+    spin_unlock(&rq->lock);
+    return next;
+}
+
+// Periodic balancing with hysteresis: only move work when the smoothed load
+// gap exceeds SCHED_IMBALANCE_PCT and at least two tasks separate the queues
+void sched_rebalance(uint64_t now_ms) {
+    if (nr_cpus < 2) return;
+    int busiest = 0, idlest = 0;
+    for (int c = 0; c < nr_cpus; ++c) {
+        cpu_rq_t* rq = &cpu_rqs[c];
+        rq->load_avg = (rq->load_avg * 3 + (uint32_t)rq_nr_running(c) * 1024) / 4;
+        if (rq->load_avg > cpu_rqs[busiest].load_avg) busiest = c;
+        if (rq->load_avg < cpu_rqs[idlest].load_avg) idlest = c;
+    }
+    if (busiest == idlest) return;
+    uint64_t hi = cpu_rqs[busiest].load_avg, lo = cpu_rqs[idlest].load_avg;
+    if (hi * 100 <= lo * (100 + SCHED_IMBALANCE_PCT)) return;
+    int diff = rq_nr_running(busiest) - rq_nr_running(idlest);
+    for (int moved = 0; moved < diff / 2; ++moved) {
+        sched_task_t* t = detach_one(busiest, idlest, now_ms);
+        if (!t) break;
+        enqueue_on(idlest, t);
+        cpu_rqs[idlest].nr_migrations++;
+    }
+}
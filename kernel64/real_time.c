@@ -4,6 +4,11 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include "real_time.h"
+#include "percpu_sched.h"
+#include "sched_trace.h"
+#include "ktime.h"
+#include "kheap.h"
+#include "../core/resource_manager/resource_sampler.h"
 #include <windows.h>
 #include <stdio.h>
 #include <math.h>
@@ -20,6 +25,8 @@ typedef struct {
 // Real process structure for scheduling
 #define MAX_PROCESSES 128
 
+struct rt_heap;
+
 typedef struct {
     int pid;
     int priority; // 0 (highest) to 31 (lowest)
@@ -29,29 +36,58 @@ typedef struct {
     int is_foreground;
     int is_running;
     HANDLE hProcess;
+    // Periodic EDF parameters (period 0 = one-shot deadline)
+    uint64_t period_ms;
+    uint64_t wcet_ms; // Budget per period, 0 = not enforced
+    uint64_t budget_ms; // Budget left in the current job
+    uint64_t release_ms; // Release time of the current job
+    struct rt_heap* heap; // EDF heap this task sits in, NULL if none
+    int heap_pos;
+    rt_task_stats_t stats;
+    sched_task_t task; // On a per-CPU run queue while runnable outside EDF
 } sched_process_t;
 
 static sched_process_t proc_table[MAX_PROCESSES] = {0};
 static int proc_count = 0;
 
-// System resource stats (Windows API)
+// EDF: released jobs ordered by absolute deadline, throttled/finished ones by next release
+typedef struct {
+    uint64_t key;
+    int idx; // proc_table index
+} rt_heap_node_t;
+
+typedef struct rt_heap {
+    rt_heap_node_t nodes[MAX_PROCESSES];
+    int size;
+} rt_heap_t;
+
+static rt_heap_t edf_ready = {0};
+static rt_heap_t edf_release = {0};
+// One-shot deadlines, run outside EDF but still checked for misses
+static rt_heap_t deadline_watch = {0};
+static rt_task_stats_t edf_totals = {0};
+// EDF jobs run on the boot CPU; everything else is spread over per-CPU queues
+#define SCHED_RT_CPU 0
+#define SCHED_REBALANCE_MS 100
+#define SCHED_IDLE_TICK_MS 100
+static int current_edf = -1;
+// Admission control: periodic tasks are only accepted if the set stays schedulable
+static rt_admit_policy_t admit_policy = RT_ADMIT_EDF;
+static int current_pid[SCHED_MAX_CPUS];
+static uint64_t last_tick_ms = 0;
+static uint64_t last_rebalance_ms = 0;
+
+// System resource stats, in percent
 static resource_stats_t system_stats = {0};
 
-// Update resource stats
+// Update resource stats from the sampler's snapshot (a few loads, no OS calls)
 void update_resource_stats(void) {
-    MEMORYSTATUSEX memInfo;
-    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-    GlobalMemoryStatusEx(&memInfo);
-    system_stats.ram_usage = (uint32_t)((memInfo.ullTotalPhys - memInfo.ullAvailPhys) / 1024 / 1024);
-    // CPU usage: use GetSystemTimes
-    static FILETIME prevIdle = {0}, prevKernel = {0}, prevUser = {0};
-    FILETIME idle, kernel, user;
-    GetSystemTimes(&idle, &kernel, &user);
-    ULONGLONG sys = (FileTimeToULL(kernel) + FileTimeToULL(user)) - (FileTimeToULL(prevKernel) + FileTimeToULL(prevUser));
-    ULONGLONG idleDiff = FileTimeToULL(idle) - FileTimeToULL(prevIdle);
-    system_stats.cpu_usage = (uint32_t)(100 - (100.0 * idleDiff / sys));
-    prevIdle = idle; prevKernel = kernel; prevUser = user;
-    // TODO: GPU/IO usage (platform-specific)
+    resource_usage_t u;
+    resource_sampler_read(&u);
+    system_stats.cpu_usage = (uint32_t)(u.cpu_usage * 100.0f);
+    system_stats.ram_usage = (uint32_t)(u.ram_usage * 100.0f);
+    system_stats.gpu_usage = (uint32_t)(u.gpu_usage * 100.0f);
+    system_stats.io_usage = (uint32_t)(u.io_usage * 100.0f);
 }
 
 // Dynamic scaling logic
@@ -99,7 +135,8 @@ void recover_from_resource_failure(void) {
     // Try to free memory, restart lowest-priority process, or log and notify
     printf("[Scheduler] Resource failure detected. Attempting recovery...\n");
     for (int i = proc_count-1; i >= 0; --i) {
-        if (!proc_table[i].is_foreground) {
+        // Admitted real-time tasks hold a guarantee and are never reclaimed
+        if (!proc_table[i].is_foreground && !proc_table[i].period_ms) {
             TerminateProcess(proc_table[i].hProcess, 1);
             printf("[Scheduler] Terminated background process %d to recover resources.\n", proc_table[i].pid);
             return;
@@ -108,9 +145,240 @@ void recover_from_resource_failure(void) {
     printf("[Scheduler] No background process to terminate. Notifying admin.\n");
 }
 
-// Helper for FILETIME to ULONGLONG
-static ULONGLONG FileTimeToULL(FILETIME ft) {
-    return (((ULONGLONG)ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+// Binary min-heap helpers; every move keeps sched_process_t.heap_pos in sync
+static void rt_heap_set(rt_heap_t* h, int pos, rt_heap_node_t n) {
+    h->nodes[pos] = n;
+    proc_table[n.idx].heap = h;
+    proc_table[n.idx].heap_pos = pos;
+}
+
+static void rt_heap_sift_up(rt_heap_t* h, int pos) {
+    rt_heap_node_t n = h->nodes[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (h->nodes[parent].key <= n.key) break;
+        rt_heap_set(h, pos, h->nodes[parent]);
+        pos = parent;
+    }
+    rt_heap_set(h, pos, n);
+}
+
+static void rt_heap_sift_down(rt_heap_t* h, int pos) {
+    rt_heap_node_t n = h->nodes[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && h->nodes[child + 1].key < h->nodes[child].key) child++;
+        if (n.key <= h->nodes[child].key) break;
+        rt_heap_set(h, pos, h->nodes[child]);
+        pos = child;
+    }
+    rt_heap_set(h, pos, n);
+}
+
+static void rt_heap_push(rt_heap_t* h, int idx, uint64_t key) {
+    int pos = h->size++;
+    h->nodes[pos] = (rt_heap_node_t){ .key = key, .idx = idx };
+    rt_heap_sift_up(h, pos);
+}
+
+static void rt_heap_remove(int idx) {
+    sched_process_t* p = &proc_table[idx];
+    rt_heap_t* h = p->heap;
+    if (!h) return;
+    int pos = p->heap_pos;
+    p->heap = NULL;
+    if (--h->size == pos) return;
+    h->nodes[pos] = h->nodes[h->size];
+    proc_table[h->nodes[pos].idx].heap_pos = pos;
+    if (pos > 0 && h->nodes[pos].key < h->nodes[(pos - 1) / 2].key) rt_heap_sift_up(h, pos);
+    else rt_heap_sift_down(h, pos);
+}
+
+static int find_proc(int pid) {
+    for (int i = 0; i < proc_count; ++i) {
+        if (proc_table[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+// Release a new job: fresh budget, implicit deadline one period later
+static void edf_release_job(int idx, uint64_t release) {
+    sched_process_t* p = &proc_table[idx];
+    p->release_ms = release;
+    p->deadline = release + p->period_ms;
+    p->budget_ms = p->wcet_ms;
+    p->exec_time = 0;
+    p->stats.jobs++;
+    edf_totals.jobs++;
+    sched_dequeue_task(&p->task); // EDF takes precedence
+    rt_heap_push(&edf_ready, idx, p->deadline);
+    sched_trace_wakeup(p->pid, SCHED_RT_CPU);
+}
+
+// Current job is over (finished, out of budget or abandoned): wait for the
+// next period. Only periodic tasks ever enter the EDF heaps.
+static void edf_park(int idx, uint64_t next_release) {
+    rt_heap_remove(idx);
+    rt_heap_push(&edf_release, idx, next_release);
+}
+
+static void edf_release_due(uint64_t now) {
+    while (edf_release.size > 0 && edf_release.nodes[0].key <= now) {
+        rt_heap_node_t n = edf_release.nodes[0];
+        rt_heap_remove(n.idx);
+        edf_release_job(n.idx, n.key);
+    }
+}
+
+static void rt_record_miss(sched_process_t* p, uint64_t now) {
+    uint64_t lateness = now - p->deadline;
+    p->stats.misses++;
+    p->stats.total_lateness_ms += lateness;
+    if (lateness > p->stats.max_lateness_ms) p->stats.max_lateness_ms = lateness;
+    edf_totals.misses++;
+    sched_trace_deadline(p->pid, p->deadline * 1000);
+    edf_totals.total_lateness_ms += lateness;
+    if (lateness > edf_totals.max_lateness_ms) edf_totals.max_lateness_ms = lateness;
+    printf("[Scheduler] Process %d missed deadline by %llu ms (%llu/%llu jobs missed, max %llu ms)\n",
+        p->pid, (unsigned long long)lateness, (unsigned long long)p->stats.misses,
+        (unsigned long long)p->stats.jobs, (unsigned long long)p->stats.max_lateness_ms);
+}
+
+// Only the earliest deadline needs checking: if it has not passed, none has.
+// A one-shot job that misses is done with; it keeps running best-effort.
+static void edf_check_deadlines(uint64_t now) {
+    while (deadline_watch.size > 0 && deadline_watch.nodes[0].key < now) {
+        int idx = deadline_watch.nodes[0].idx;
+        rt_heap_remove(idx);
+        rt_record_miss(&proc_table[idx], now);
+    }
+    while (edf_ready.size > 0 && edf_ready.nodes[0].key < now) {
+        int idx = edf_ready.nodes[0].idx;
+        sched_process_t* p = &proc_table[idx];
+        rt_record_miss(p, now);
+        // Abandon the overrun job and rejoin at the current period boundary,
+        // which may already have passed: the caller releases it right away
+        uint64_t next = p->release_ms + p->period_ms;
+        while (next + p->period_ms <= now) next += p->period_ms;
+        edf_park(idx, next);
+    }
+}
+
+// Charge CPU time to an EDF job and throttle it once its WCET budget is spent
+static void edf_charge(int idx, uint64_t ran_ms) {
+    sched_process_t* p = &proc_table[idx];
+    p->exec_time += ran_ms;
+    if (p->heap != &edf_ready || p->wcet_ms == 0) return;
+    p->budget_ms = p->budget_ms > ran_ms ? p->budget_ms - ran_ms : 0;
+    if (p->budget_ms == 0) {
+        p->stats.throttled++;
+        edf_totals.throttled++;
+        edf_park(idx, p->release_ms + p->period_ms);
+    }
+}
+
+// Admission tests over the admitted periodic set plus one candidate (C, T).
+// Utilization is in parts per million, rounded up so the sum never comes out
+// below the real one; deadlines are implicit (D = T).
+static uint64_t util_ppm(uint64_t c, uint64_t t) {
+    return (c * 1000000 + t - 1) / t;
+}
+
+static uint64_t rt_utilization_ppm(void) {
+    uint64_t u = 0;
+    for (int i = 0; i < proc_count; ++i) {
+        if (proc_table[i].period_ms) u += util_ppm(proc_table[i].wcet_ms, proc_table[i].period_ms);
+    }
+    return u;
+}
+
+// Exact RM response-time analysis: R = C + sum over higher-priority (shorter
+// period) tasks of ceil(R / Tj) * Cj, iterated to a fixed point
+static int rm_response_time_ok(const uint64_t* c, const uint64_t* t, int n) {
+    for (int i = 0; i < n; ++i) {
+        uint64_t r = c[i], prev = 0;
+        while (r != prev && r <= t[i]) {
+            prev = r;
+            r = c[i];
+            for (int j = 0; j < i; ++j) r += (prev + t[j] - 1) / t[j] * c[j];
+        }
+        if (r > t[i]) return 0;
+    }
+    return 1;
+}
+
+static int rt_admit(uint64_t wcet_ms, uint64_t period_ms) {
+    uint64_t u = rt_utilization_ppm() + util_ppm(wcet_ms, period_ms);
+    if (u > RT_UTIL_CAP_PPM) return 0;
+    if (admit_policy == RT_ADMIT_EDF) return 1; // EDF: U <= 1 is exact for D = T
+    // RM: the hyperbolic bound prod(Ui + 1) <= 2 admits most sets cheaply...
+    uint64_t c[MAX_PROCESSES + 1], t[MAX_PROCESSES + 1];
+    uint64_t prod = 1000000;
+    int n = 0;
+    for (int i = 0; i <= proc_count; ++i) {
+        uint64_t ci = i < proc_count ? proc_table[i].wcet_ms : wcet_ms;
+        uint64_t ti = i < proc_count ? proc_table[i].period_ms : period_ms;
+        if (!ti) continue;
+        // Rounded up too: a set the rounding pushes past 2 gets the exact test
+        prod = (prod * (1000000 + util_ppm(ci, ti)) + 999999) / 1000000;
+        // Keep the set sorted by period (RM priority order) for the exact test
+        int k = n++;
+        while (k > 0 && t[k - 1] > ti) { c[k] = c[k - 1]; t[k] = t[k - 1]; --k; }
+        c[k] = ci; t[k] = ti;
+    }
+    if (prod <= 2000000) return 1;
+    // ...and response-time analysis decides the rest exactly
+    return rm_response_time_ok(c, t, n);
+}
+
+void scheduler_set_admission_policy(rt_admit_policy_t policy) {
+    admit_policy = policy;
+    printf("[Scheduler] Admission control: %s (RT utilization %llu ppm)\n",
+        policy == RT_ADMIT_RM ? "rate-monotonic" : "EDF", (unsigned long long)rt_utilization_ppm());
+}
+
+uint64_t scheduler_rt_utilization_ppm(void) {
+    return rt_utilization_ppm();
+}
+
+static int task_pid(const sched_task_t* t) { return t ? t->pid : -1; }
+
+static uint64_t trace_clock_us(void) { return ktime_us(); }
+
+// Still wants a CPU after being switched out (queued or holding an EDF job)
+static int pid_runnable(int pid) {
+    int idx = find_proc(pid);
+    if (idx < 0) return 0;
+    return proc_table[idx].heap == &edf_ready || proc_table[idx].task.cpu >= 0;
+}
+
+static void trace_switch(int cpu, int prev, int next) {
+    if (prev == next) return;
+    if (prev >= 0) sched_trace_switch_out(prev, cpu, pid_runnable(prev));
+    if (next >= 0) sched_trace_pick_next(next, cpu);
+}
+
+static int rt_heap_tag = KHEAP_TAG_NONE;
+
+void* scheduler_rt_alloc(size_t size) {
+    return kheap_alloc(KHEAP_RT, size, rt_heap_tag);
+}
+
+void scheduler_rt_free(void* p) {
+    kheap_free(p);
+}
+
+void scheduler_init(int nr_cpus) {
+    if (nr_cpus <= 0) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        nr_cpus = (int)si.dwNumberOfProcessors;
+    }
+    percpu_sched_init(nr_cpus);
+    sched_trace_init(trace_clock_us);
+    for (int c = 0; c < SCHED_MAX_CPUS; ++c) current_pid[c] = -1;
+    rt_heap_tag = kheap_tag("rt");
 }
 
 // Add process to scheduler
@@ -126,22 +394,133 @@ int scheduler_add_process(int pid, HANDLE hProcess, int priority, int is_realtim
         .is_running = 1,
         .hProcess = hProcess
     };
-    ++proc_count;
+    // A deadline without a declared period and WCET cannot be analysed, so it
+    // gets no guarantee: it runs at the top priority level outside EDF and
+    // cannot delay admitted tasks. The deadline is still watched, so a miss
+    // shows up in its stats. Use scheduler_add_periodic for guarantees.
+    int idx = proc_count++;
+    if (is_realtime && deadline) {
+        priority = 0;
+        proc_table[idx].stats.jobs = 1;
+        edf_totals.jobs++;
+        rt_heap_push(&deadline_watch, idx, deadline);
+        printf("[Scheduler] Process %d has a deadline but no period/WCET; running best-effort\n", pid);
+    }
+    sched_task_init(&proc_table[idx].task, pid, priority, CPU_MASK_ALL);
+    sched_wake_task(&proc_table[idx].task);
+    return 0;
+}
+
+// Add a periodic real-time task; the first job is released immediately.
+// Rejected if the task set would no longer be schedulable under the policy.
+int scheduler_add_periodic(int pid, HANDLE hProcess, int priority, uint64_t period_ms, uint64_t wcet_ms, int is_foreground) {
+    if (proc_count >= MAX_PROCESSES || period_ms == 0 || wcet_ms == 0 || wcet_ms > period_ms) return -1;
+    if (!rt_admit(wcet_ms, period_ms)) {
+        printf("[Scheduler] Rejected process %d (C=%llu ms, T=%llu ms): task set would be unschedulable\n",
+            pid, (unsigned long long)wcet_ms, (unsigned long long)period_ms);
+        return -1;
+    }
+    int idx = proc_count;
+    if (scheduler_add_process(pid, hProcess, priority, 1, 0, is_foreground) != 0) return -1;
+    proc_table[idx].period_ms = period_ms;
+    proc_table[idx].wcet_ms = wcet_ms;
+    edf_release_job(idx, ktime_ms());
     return 0;
 }
 
+// The task finished its current job early; it sleeps until its next release.
+// A one-shot job that completes in time just stops being watched.
+void scheduler_job_complete(int pid) {
+    int idx = find_proc(pid);
+    if (idx >= 0 && proc_table[idx].heap == &deadline_watch) {
+        sched_trace_deadline(pid, proc_table[idx].deadline * 1000);
+        rt_heap_remove(idx);
+        return;
+    }
+    if (idx < 0 || proc_table[idx].heap != &edf_ready) return;
+    sched_trace_deadline(pid, proc_table[idx].deadline * 1000);
+    edf_park(idx, proc_table[idx].release_ms + proc_table[idx].period_ms);
+}
+
+int scheduler_set_priority(int pid, int priority) {
+    int idx = find_proc(pid);
+    if (idx < 0) return -1;
+    proc_table[idx].priority = priority;
+    return sched_set_task_priority(&proc_table[idx].task, priority);
+}
+
+int scheduler_set_affinity(int pid, uint64_t cpu_mask) {
+    int idx = find_proc(pid);
+    if (idx < 0) return -1;
+    return sched_set_affinity(&proc_table[idx].task, cpu_mask);
+}
+
+// Task chosen for a CPU at the last tick (-1 = idle)
+int scheduler_pick_next(int cpu) {
+    if (cpu < 0 || cpu >= percpu_sched_nr_cpus()) return -1;
+    return current_pid[cpu];
+}
+
+int scheduler_get_rt_stats(int pid, rt_task_stats_t* out) {
+    if (!out) return -1;
+    if (pid < 0) { *out = edf_totals; return 0; }
+    int idx = find_proc(pid);
+    if (idx < 0) return -1;
+    *out = proc_table[idx].stats;
+    return 0;
+}
+
+// When scheduler_tick next has work to do: every ms while an EDF job runs,
+// at the next release or slice end otherwise, and a slow idle tick for
+// statistics and rebalancing when nothing is runnable
+uint64_t scheduler_next_event_ms(uint64_t now_ms) {
+    if (edf_ready.size > 0) return now_ms + 1;
+    uint64_t next = now_ms + SCHED_IDLE_TICK_MS;
+    for (int cpu = 0; cpu < percpu_sched_nr_cpus(); ++cpu) {
+        if (sched_cpu_rq(cpu)->rq.nr_running > 0) {
+            next = now_ms + PRIO_MIN_SLICE_MS;
+            break;
+        }
+    }
+    // Never now_ms itself: the caller would re-arm for a tick that already ran
+    if (edf_release.size > 0 && edf_release.nodes[0].key < next) {
+        next = edf_release.nodes[0].key > now_ms ? edf_release.nodes[0].key : now_ms + 1;
+    }
+    // A one-shot deadline is known missed on the first tick after it
+    if (deadline_watch.size > 0 && deadline_watch.nodes[0].key + 1 < next) {
+        next = deadline_watch.nodes[0].key >= now_ms ? deadline_watch.nodes[0].key + 1 : now_ms + 1;
+    }
+    return next;
+}
+
 // Real-time scheduling tick
 void scheduler_tick(void) {
     update_resource_stats();
     scale_resources();
     prioritize_processes();
     adjust_for_power();
-    // Real-time: check deadlines
-    uint64_t now = GetTickCount64();
-    for (int i = 0; i < proc_count; ++i) {
-        if (proc_table[i].is_realtime && proc_table[i].deadline < now) {
-            printf("[Scheduler] Process %d missed deadline!\n", proc_table[i].pid);
-            recover_from_resource_failure();
+    uint64_t now = ktime_ms();
+    // Charge the EDF job that ran since the last tick, then re-run EDF
+    if (current_edf >= 0 && last_tick_ms) edf_charge(current_edf, now - last_tick_ms);
+    last_tick_ms = now;
+    edf_release_due(now);
+    edf_check_deadlines(now);
+    edf_release_due(now); // Jobs that missed rejoin at a boundary that may be now
+    current_edf = edf_ready.size > 0 ? edf_ready.nodes[0].idx : -1;
+    // Per-CPU dispatch; an EDF job preempts whatever the RT CPU was running
+    for (int cpu = 0; cpu < percpu_sched_nr_cpus(); ++cpu) {
+        int next;
+        if (cpu == SCHED_RT_CPU && current_edf >= 0) {
+            sched_put_prev(cpu, now);
+            next = proc_table[current_edf].pid;
+        } else {
+            next = task_pid(sched_schedule(cpu, now));
         }
+        trace_switch(cpu, current_pid[cpu], next);
+        current_pid[cpu] = next;
+    }
+    if (now - last_rebalance_ms >= SCHED_REBALANCE_MS) {
+        last_rebalance_ms = now;
+        sched_rebalance(now);
     }
 }
@@ -0,0 +1,212 @@
+// scheduler latency tracepoints and HDR-style histograms
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include "sched_trace.h"
+#include "spinlock.h"
+
+#define HALF (1u << (SCHED_TRACE_SUB_BITS - 1))
+
+static sched_trace_task_t trace_tasks[SCHED_TRACE_MAX_TASKS];
+static sched_trace_task_t trace_global;
+static spinlock_t trace_lock = SPINLOCK_INIT; // Only taken to claim a slot
+static uint64_t (*trace_clock)(void) = NULL;
+static int trace_on = 0;
+
+// Log-linear bucket: exact below 2^SUB_BITS, then HALF buckets per power of two
+static inline int hist_bucket(uint64_t v) {
+    if (v < (1u << SCHED_TRACE_SUB_BITS)) return (int)v;
+    if (v >> SCHED_TRACE_MAX_BITS) return SCHED_TRACE_BUCKETS - 1;
+    int e = 63 - __builtin_clzll(v) - SCHED_TRACE_SUB_BITS + 1;
+    return e * (int)HALF + (int)(v >> e);
+}
+
+static inline uint64_t hist_bucket_hi(int idx) {
+    if (idx < (int)(1u << SCHED_TRACE_SUB_BITS)) return (uint64_t)idx;
+    int e = idx / (int)HALF - 1;
+    uint64_t m = HALF + (uint64_t)(idx % (int)HALF);
+    return ((m + 1) << e) - 1;
+}
+
+static inline void hist_record(sched_hist_t* h, uint64_t v) {
+    __atomic_fetch_add(&h->counts[hist_bucket(v)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->total, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, v, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (v > max && !__atomic_compare_exchange_n(&h->max, &max, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+static inline void record(sched_trace_task_t* t, sched_lat_metric_t m, uint64_t v) {
+    if (t) hist_record(&t->hist[m], v);
+    hist_record(&trace_global.hist[m], v);
+}
+
+// Slot for pid, claimed on first sight. NULL when the table is full: the
+// event still counts towards the global histograms.
+static sched_trace_task_t* task_slot(int pid) {
+    unsigned start = (unsigned)pid % SCHED_TRACE_MAX_TASKS;
+    for (unsigned i = 0; i < SCHED_TRACE_MAX_TASKS; ++i) {
+        sched_trace_task_t* t = &trace_tasks[(start + i) % SCHED_TRACE_MAX_TASKS];
+        int owner = __atomic_load_n(&t->pid, __ATOMIC_ACQUIRE);
+        if (owner == pid) return t;
+        if (owner != -1) continue;
+        spin_lock(&trace_lock);
+        if (t->pid == -1) __atomic_store_n(&t->pid, pid, __ATOMIC_RELEASE);
+        spin_unlock(&trace_lock);
+        if (t->pid == pid) return t;
+    }
+    return NULL;
+}
+
+static inline uint64_t trace_now(void) {
+    return trace_clock ? trace_clock() : 0;
+}
+
+void sched_trace_init(uint64_t (*clock_us)(void)) {
+    trace_clock = clock_us;
+    sched_trace_reset();
+    trace_on = 1;
+    printf("[SchedTrace] Latency tracing enabled (%d buckets per histogram)\n", SCHED_TRACE_BUCKETS);
+}
+
+void sched_trace_enable(int on) {
+    __atomic_store_n(&trace_on, on && trace_clock, __ATOMIC_RELAXED);
+}
+
+void sched_trace_reset(void) {
+    spin_lock(&trace_lock);
+    memset(trace_tasks, 0, sizeof(trace_tasks));
+    for (int i = 0; i < SCHED_TRACE_MAX_TASKS; ++i) trace_tasks[i].pid = -1;
+    memset(&trace_global, 0, sizeof(trace_global));
+    trace_global.pid = -1;
+    spin_unlock(&trace_lock);
+}
+
+// Task became runnable from sleep (or a new job was released)
+void sched_trace_wakeup(int pid, int cpu) {
+    (void)cpu;
+    if (!__atomic_load_n(&trace_on, __ATOMIC_RELAXED)) return;
+    sched_trace_task_t* t = task_slot(pid);
+    __atomic_fetch_add(&trace_global.wakeups, 1, __ATOMIC_RELAXED);
+    if (!t) return;
+    t->wakeups++;
+    t->runnable_since_us = trace_now();
+}
+
+// Task placed on a run queue (wakeup, steal or rebalance); keeps the earliest
+// runnable timestamp so migrations do not hide queueing delay
+void sched_trace_enqueue(int pid, int cpu) {
+    (void)cpu;
+    if (!__atomic_load_n(&trace_on, __ATOMIC_RELAXED)) return;
+    sched_trace_task_t* t = task_slot(pid);
+    __atomic_fetch_add(&trace_global.enqueues, 1, __ATOMIC_RELAXED);
+    if (!t) return;
+    t->enqueues++;
+    if (!t->runnable_since_us) t->runnable_since_us = trace_now();
+}
+
+void sched_trace_pick_next(int pid, int cpu) {
+    (void)cpu;
+    if (!__atomic_load_n(&trace_on, __ATOMIC_RELAXED)) return;
+    sched_trace_task_t* t = task_slot(pid);
+    uint64_t now = trace_now();
+    __atomic_fetch_add(&trace_global.switches, 1, __ATOMIC_RELAXED);
+    if (!t) return;
+    t->switches++;
+    if (t->runnable_since_us) record(t, SCHED_LAT_WAKEUP, now - t->runnable_since_us);
+    t->runnable_since_us = 0;
+    t->run_start_us = now;
+}
+
+void sched_trace_switch_out(int pid, int cpu, int still_runnable) {
+    (void)cpu;
+    if (!__atomic_load_n(&trace_on, __ATOMIC_RELAXED)) return;
+    sched_trace_task_t* t = task_slot(pid);
+    if (!t) return;
+    uint64_t now = trace_now();
+    if (t->run_start_us) record(t, SCHED_LAT_RUN, now - t->run_start_us);
+    t->run_start_us = 0;
+    // Preempted: the wait for the CPU starts now
+    t->runnable_since_us = still_runnable ? now : 0;
+}
+
+// Job finished (or was abandoned) relative to its absolute deadline
+void sched_trace_deadline(int pid, uint64_t deadline_us) {
+    if (!__atomic_load_n(&trace_on, __ATOMIC_RELAXED)) return;
+    sched_trace_task_t* t = task_slot(pid);
+    uint64_t now = trace_now();
+    if (now > deadline_us) {
+        __atomic_fetch_add(&trace_global.misses, 1, __ATOMIC_RELAXED);
+        if (t) t->misses++;
+        return;
+    }
+    record(t, SCHED_LAT_SLACK, deadline_us - now);
+}
+
+const sched_trace_task_t* sched_trace_get(int pid) {
+    if (pid < 0) return &trace_global;
+    unsigned start = (unsigned)pid % SCHED_TRACE_MAX_TASKS;
+    for (unsigned i = 0; i < SCHED_TRACE_MAX_TASKS; ++i) {
+        const sched_trace_task_t* t = &trace_tasks[(start + i) % SCHED_TRACE_MAX_TASKS];
+        if (t->pid == pid) return t;
+        if (t->pid == -1) break;
+    }
+    return NULL;
+}
+
+// Upper bound of the bucket holding the given percentile (per_10000 = 9900 for p99)
+uint64_t sched_hist_percentile(const sched_hist_t* h, uint32_t per_10000) {
+    if (!h || h->total == 0) return 0;
+    uint64_t want = (h->total * per_10000 + 9999) / 10000;
+    if (want == 0) want = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < SCHED_TRACE_BUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t hi = hist_bucket_hi(i);
+            return hi < h->max ? hi : h->max;
+        }
+    }
+    return h->max;
+}
+
+static const char* metric_names[SCHED_LAT_METRICS] = { "wakeup->run", "run", "deadline slack" };
+
+static void dump_hist(const char* name, const sched_hist_t* h) {
+    if (h->total == 0) {
+        printf("  %-15s (no samples)\n", name);
+        return;
+    }
+    printf("  %-15s n=%llu mean=%lluus p50=%lluus p90=%lluus p99=%lluus p99.9=%lluus max=%lluus\n",
+        name, (unsigned long long)h->total, (unsigned long long)(h->sum / h->total),
+        (unsigned long long)sched_hist_percentile(h, 5000), (unsigned long long)sched_hist_percentile(h, 9000),
+        (unsigned long long)sched_hist_percentile(h, 9900), (unsigned long long)sched_hist_percentile(h, 9990),
+        (unsigned long long)h->max);
+    uint32_t peak = 0;
+    for (int i = 0; i < SCHED_TRACE_BUCKETS; ++i) if (h->counts[i] > peak) peak = h->counts[i];
+    for (int i = 0; i < SCHED_TRACE_BUCKETS; ++i) {
+        if (!h->counts[i]) continue;
+        char bar[41];
+        int len = (int)((uint64_t)h->counts[i] * 40 / peak);
+        if (len == 0) len = 1;
+        memset(bar, '#', (size_t)len);
+        bar[len] = '\0';
+        printf("    <=%10lluus %10u %s\n", (unsigned long long)hist_bucket_hi(i), h->counts[i], bar);
+    }
+}
+
+void sched_trace_dump(int pid) {
+    const sched_trace_task_t* t = sched_trace_get(pid);
+    if (!t) {
+        printf("[SchedTrace] No trace data for process %d\n", pid);
+        return;
+    }
+    if (pid < 0) printf("[SchedTrace] Global:");
+    else printf("[SchedTrace] Process %d:", pid);
+    printf(" %llu wakeups, %llu enqueues, %llu switches, %llu deadline misses\n",
+        (unsigned long long)t->wakeups, (unsigned long long)t->enqueues,
+        (unsigned long long)t->switches, (unsigned long long)t->misses);
+    for (int m = 0; m < SCHED_LAT_METRICS; ++m) dump_hist(metric_names[m], &t->hist[m]);
+}
@@ -0,0 +1,121 @@
+// shrinker registry: caches give memory back under pressure
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "shrinker.h"
+#include "spinlock.h"
+
+#define SHRINK_SNAPSHOT 32      // Shrinkers visited per pass
+
+static spinlock_t registry_lock = SPINLOCK_INIT;
+static spinlock_t shrink_lock = SPINLOCK_INIT;   // One reclaimer at a time
+static shrinker_t* shrinkers;
+
+int shrinker_register(shrinker_t* s) {
+    if (!s || !s->count || !s->scan) return -1;
+    spin_lock(&registry_lock);
+    for (shrinker_t* it = shrinkers; it; it = it->next) {
+        if (it == s) {
+            spin_unlock(&registry_lock);
+            return 0;
+        }
+    }
+    s->busy = 0;
+    s->deferred = 0;
+    s->next = shrinkers;
+    shrinkers = s;
+    spin_unlock(&registry_lock);
+    return 0;
+}
+
+void shrinker_unregister(shrinker_t* s) {
+    if (!s) return;
+    spin_lock(&registry_lock);
+    for (shrinker_t** link = &shrinkers; *link; link = &(*link)->next) {
+        if (*link == s) {
+            *link = s->next;
+            break;
+        }
+    }
+    spin_unlock(&registry_lock);
+    while (__atomic_load_n(&s->busy, __ATOMIC_ACQUIRE)) cpu_relax();
+}
+
+// Pins the registered shrinkers so they can be called without the lock
+static int snapshot(shrinker_t** out) {
+    int n = 0;
+    spin_lock(&registry_lock);
+    for (shrinker_t* s = shrinkers; s && n < SHRINK_SNAPSHOT; s = s->next) {
+        __atomic_add_fetch(&s->busy, 1, __ATOMIC_RELAXED);
+        out[n++] = s;
+    }
+    spin_unlock(&registry_lock);
+    return n;
+}
+
+static unsigned long shrink_one(shrinker_t* s, int priority) {
+    unsigned long freeable = s->count(s);
+    if (!freeable) return 0;
+    uint32_t seeks = s->seeks ? s->seeks : SHRINKER_DEFAULT_SEEKS;
+    // Cheap-to-rebuild caches give up more per pass
+    uint64_t total = s->deferred + ((uint64_t)freeable >> priority) * 4 / seeks;
+    if (total > 2 * (uint64_t)freeable) total = 2 * (uint64_t)freeable;
+    unsigned long freed = 0;
+    while (total >= SHRINK_BATCH || total >= freeable) {
+        unsigned long nr = total < SHRINK_BATCH ? (unsigned long)total : SHRINK_BATCH;
+        unsigned long got = s->scan(s, nr, priority);
+        if (got == SHRINK_STOP) break;
+        s->scanned += nr;
+        freed += got;
+        // Shrinkers that free in bigger units use up the quota faster
+        uint64_t used = got > nr ? got : nr;
+        total = used < total ? total - used : 0;
+        if (!total) break;
+    }
+    s->deferred = total;
+    s->freed += freed;
+    return freed;
+}
+
+static unsigned long shrink_pass(int priority) {
+    shrinker_t* list[SHRINK_SNAPSHOT];
+    int n = snapshot(list);
+    unsigned long freed = 0;
+    for (int i = 0; i < n; ++i) {
+        freed += shrink_one(list[i], priority);
+        __atomic_sub_fetch(&list[i]->busy, 1, __ATOMIC_RELEASE);
+    }
+    return freed;
+}
+
+unsigned long shrink_caches(int priority) {
+    if (priority < 0) priority = 0;
+    if (!spin_trylock(&shrink_lock)) return 0;
+    unsigned long freed = shrink_pass(priority);
+    spin_unlock(&shrink_lock);
+    return freed;
+}
+
+unsigned long shrink_memory(unsigned long nr_pages) {
+    // Someone else is already reclaiming; their work counts for us too
+    if (!spin_trylock(&shrink_lock)) return 0;
+    unsigned long freed = 0;
+    for (int prio = SHRINK_DEF_PRIORITY; prio >= 0 && freed < nr_pages; --prio) {
+        freed += shrink_pass(prio);
+    }
+    spin_unlock(&shrink_lock);
+    return freed;
+}
+
+void shrinker_dump(void) {
+    shrinker_t* list[SHRINK_SNAPSHOT];
+    int n = snapshot(list);
+    printf("[Shrinker] %-16s %10s %10s %10s %10s\n", "cache", "freeable", "deferred", "scanned", "freed");
+    for (int i = 0; i < n; ++i) {
+        shrinker_t* s = list[i];
+        printf("[Shrinker] %-16s %10lu %10llu %10llu %10llu\n", s->name ? s->name : "?", s->count(s),
+            (unsigned long long)s->deferred, (unsigned long long)s->scanned, (unsigned long long)s->freed);
+        __atomic_sub_fetch(&s->busy, 1, __ATOMIC_RELEASE);
+    }
+}
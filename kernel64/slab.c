@@ -0,0 +1,476 @@
+// slab allocator: per-type object caches with per-CPU magazines
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sched_getcpu
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "slab.h"
+#include "spinlock.h"
+#include "kheap.h"
+#include "alloc_prof.h"
+#include "page_alloc.h"
+#include "shrinker.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#define KMEM_SLAB_MAX (1024 * 1024)
+#define KMEM_MAX_OBJS 0xFFFF        // Free indices are 16-bit
+
+enum { SLAB_EMPTY, SLAB_PARTIAL, SLAB_FULL, SLAB_LISTS };
+
+typedef struct kmem_mag {
+    struct kmem_mag* next;
+    uint32_t rounds;
+    void* objs[KMEM_MAG_SIZE];
+} kmem_mag_t;
+
+typedef struct {
+    volatile uint32_t busy;     // Taken with trylock; a busy CPU slot uses the slab path
+    kmem_mag_t* loaded;
+    kmem_mag_t* prev;
+    uint64_t allocs, frees;     // Served by the magazines
+} __attribute__((aligned(64))) kmem_pcpu_t;
+
+// Lives at the start of every slab. Free objects are tracked by index
+// rather than by a link stored in the object, so constructed state survives.
+typedef struct kmem_slab {
+    kmem_cache_t* cache;
+    struct kmem_slab* next;
+    struct kmem_slab* prev;
+    char* base;
+    uint32_t inuse;
+    uint32_t nfree;
+    uint16_t free_idx[];
+} kmem_slab_t;
+
+struct kmem_cache {
+    char name[KMEM_NAME_LEN];
+    int used;
+    size_t obj_size;
+    size_t slab_size;
+    size_t obj_offset;
+    uint32_t objs_per_slab;
+    kmem_ctor_t ctor;
+    spinlock_t lock;            // Slab lists and depot
+    kmem_slab_t* slabs[SLAB_LISTS];
+    uint64_t nr_slabs;
+    uint64_t slab_inuse;        // Objects out of slabs: live or in magazines
+    kmem_mag_t* depot_full;     // Non-empty magazines
+    kmem_mag_t* depot_empty;
+    uint64_t slow_allocs, slow_frees;
+    kmem_pcpu_t pcpu[KMEM_MAX_CPUS];
+};
+
+static kmem_cache_t caches[KMEM_MAX_CACHES];
+static spinlock_t registry_lock = SPINLOCK_INIT;
+
+static int kmem_this_cpu(void) {
+#if defined(_WIN32)
+    int cpu = (int)GetCurrentProcessorNumber();
+#elif defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu < 0) cpu = 0;
+#else
+    int cpu = 0;
+#endif
+    return cpu % KMEM_MAX_CPUS;
+}
+
+static int slab_tag = KHEAP_TAG_NONE;
+
+static void* slab_pages_alloc(size_t size) {
+    return kheap_alloc_backing(KHEAP_NORMAL, size, size, slab_tag);
+}
+
+static void slab_pages_free(void* p) {
+    kheap_free(p);
+}
+
+static size_t align_up(size_t v, size_t a) { return (v + a - 1) & ~(a - 1); }
+
+// Smallest power-of-two slab that holds KMEM_MIN_OBJS objects after its header
+static int cache_layout(kmem_cache_t* c, size_t align) {
+    for (size_t slab = KMEM_SLAB_SIZE; slab <= KMEM_SLAB_MAX; slab <<= 1) {
+        size_t n = (slab - sizeof(kmem_slab_t)) / (c->obj_size + sizeof(uint16_t));
+        if (n > KMEM_MAX_OBJS) n = KMEM_MAX_OBJS;
+        size_t off = 0;
+        while (n) {
+            off = align_up(sizeof(kmem_slab_t) + n * sizeof(uint16_t), align);
+            if (off + n * c->obj_size <= slab) break;
+            n--;
+        }
+        if (n >= KMEM_MIN_OBJS || (n && slab == KMEM_SLAB_MAX)) {
+            c->slab_size = slab;
+            c->obj_offset = off;
+            c->objs_per_slab = (uint32_t)n;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int slab_state(const kmem_cache_t* c, const kmem_slab_t* s) {
+    if (s->inuse == 0) return SLAB_EMPTY;
+    return s->inuse == c->objs_per_slab ? SLAB_FULL : SLAB_PARTIAL;
+}
+
+static void slab_link(kmem_cache_t* c, kmem_slab_t* s, int list) {
+    s->prev = NULL;
+    s->next = c->slabs[list];
+    if (s->next) s->next->prev = s;
+    c->slabs[list] = s;
+}
+
+static void slab_unlink(kmem_cache_t* c, kmem_slab_t* s, int list) {
+    if (s->prev) s->prev->next = s->next; else c->slabs[list] = s->next;
+    if (s->next) s->next->prev = s->prev;
+}
+
+static kmem_slab_t* slab_create(kmem_cache_t* c) {
+    kmem_slab_t* s = (kmem_slab_t*)slab_pages_alloc(c->slab_size);
+    if (!s) return NULL;
+    s->cache = c;
+    s->next = s->prev = NULL;
+    s->base = (char*)s + c->obj_offset;
+    s->inuse = 0;
+    s->nfree = c->objs_per_slab;
+    for (uint32_t i = 0; i < c->objs_per_slab; ++i) {
+        s->free_idx[i] = (uint16_t)(c->objs_per_slab - 1 - i); // Lowest address first
+        if (c->ctor) c->ctor(s->base + (size_t)i * c->obj_size);
+    }
+    return s;
+}
+
+static kmem_slab_t* obj_slab(const kmem_cache_t* c, const void* obj) {
+    return (kmem_slab_t*)((uintptr_t)obj & ~(uintptr_t)(c->slab_size - 1));
+}
+
+// Cache lock held
+static void* slab_take(kmem_cache_t* c) {
+    kmem_slab_t* s = c->slabs[SLAB_PARTIAL] ? c->slabs[SLAB_PARTIAL] : c->slabs[SLAB_EMPTY];
+    if (!s) return NULL;
+    int before = slab_state(c, s);
+    uint16_t i = s->free_idx[--s->nfree];
+    s->inuse++;
+    int after = slab_state(c, s);
+    if (after != before) { slab_unlink(c, s, before); slab_link(c, s, after); }
+    c->slab_inuse++;
+    return s->base + (size_t)i * c->obj_size;
+}
+
+// Cache lock held
+static void slab_put(kmem_cache_t* c, void* obj) {
+    kmem_slab_t* s = obj_slab(c, obj);
+    int before = slab_state(c, s);
+    s->free_idx[s->nfree++] = (uint16_t)(((char*)obj - s->base) / c->obj_size);
+    s->inuse--;
+    int after = slab_state(c, s);
+    if (after != before) { slab_unlink(c, s, before); slab_link(c, s, after); }
+    c->slab_inuse--;
+}
+
+static int pcpu_trylock(kmem_pcpu_t* p) {
+    return __atomic_exchange_n(&p->busy, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+static void pcpu_unlock(kmem_pcpu_t* p) {
+    __atomic_store_n(&p->busy, 0, __ATOMIC_RELEASE);
+}
+
+// Owner of p; returns NULL when neither magazine nor the depot has an object
+static void* mag_pop(kmem_cache_t* c, kmem_pcpu_t* p) {
+    if (p->loaded && p->loaded->rounds) return p->loaded->objs[--p->loaded->rounds];
+    if (p->prev && p->prev->rounds) {
+        kmem_mag_t* t = p->loaded; p->loaded = p->prev; p->prev = t;
+        return p->loaded->objs[--p->loaded->rounds];
+    }
+    // Both empty: trade one for a full magazine from the depot
+    spin_lock(&c->lock);
+    kmem_mag_t* full = c->depot_full;
+    if (full) {
+        c->depot_full = full->next;
+        if (p->prev) { p->prev->next = c->depot_empty; c->depot_empty = p->prev; }
+        p->prev = p->loaded;
+        p->loaded = full;
+    }
+    spin_unlock(&c->lock);
+    return full ? full->objs[--full->rounds] : NULL;
+}
+
+// Owner of p; returns 0 when no magazine could be found for obj
+static int mag_push(kmem_cache_t* c, kmem_pcpu_t* p, void* obj) {
+    if (p->loaded && p->loaded->rounds < KMEM_MAG_SIZE) {
+        p->loaded->objs[p->loaded->rounds++] = obj;
+        return 1;
+    }
+    if (p->prev && p->prev->rounds == 0) {
+        kmem_mag_t* t = p->loaded; p->loaded = p->prev; p->prev = t;
+        p->loaded->objs[p->loaded->rounds++] = obj;
+        return 1;
+    }
+    // Both in use: park the previous one in the depot and load an empty one
+    spin_lock(&c->lock);
+    kmem_mag_t* empty = c->depot_empty;
+    if (empty) c->depot_empty = empty->next;
+    spin_unlock(&c->lock);
+    if (!empty) {
+        empty = (kmem_mag_t*)kheap_alloc_backing(KHEAP_NORMAL, sizeof(kmem_mag_t), 16, slab_tag);
+        if (!empty) return 0;
+        empty->rounds = 0;
+    }
+    if (p->prev) {
+        spin_lock(&c->lock);
+        p->prev->next = c->depot_full;
+        c->depot_full = p->prev;
+        spin_unlock(&c->lock);
+    }
+    p->prev = p->loaded;
+    p->loaded = empty;
+    empty->objs[empty->rounds++] = obj;
+    return 1;
+}
+
+// ---- shrinker: empty slabs and parked magazine objects across all caches ----
+
+static unsigned long slab_shrink_count(shrinker_t* sh) {
+    (void)sh;
+    uint64_t bytes = 0;
+    for (int i = 0; i < KMEM_MAX_CACHES; ++i) {
+        kmem_cache_t* c = &caches[i];
+        kmem_stats_t st;
+        if (kmem_cache_stats(c, &st) < 0) continue;
+        bytes += st.cached * st.obj_size;
+        spin_lock(&c->lock);
+        for (kmem_slab_t* s = c->slabs[SLAB_EMPTY]; s; s = s->next) bytes += c->slab_size;
+        spin_unlock(&c->lock);
+    }
+    return (unsigned long)(bytes / PAGE_SIZE);
+}
+
+// Slabs go back to the heap, which only gives pages back to the page
+// allocator when a whole grown region empties: only those pages count
+static unsigned long slab_shrink_scan(shrinker_t* sh, unsigned long nr, int priority) {
+    (void)sh; (void)priority;
+    static int cursor;
+    size_t want = nr * PAGE_SIZE, got = 0;
+    for (int n = 0; n < KMEM_MAX_CACHES && got < want; ++n) {
+        int i = __atomic_fetch_add(&cursor, 1, __ATOMIC_RELAXED) % KMEM_MAX_CACHES;
+        if (caches[i].used) got += kmem_cache_shrink(&caches[i]);
+    }
+    return kheap_trim();
+}
+
+static shrinker_t slab_shrinker = {
+    .name = "slab",
+    .count = slab_shrink_count,
+    .scan = slab_shrink_scan,
+    .seeks = SHRINKER_DEFAULT_SEEKS,
+};
+
+kmem_cache_t* kmem_cache_create(const char* name, size_t size, size_t align, kmem_ctor_t ctor) {
+    if (!name || size == 0) return NULL;
+    if (align < sizeof(void*)) align = sizeof(void*);
+    if (align & (align - 1)) return NULL;
+    if (slab_tag == KHEAP_TAG_NONE) slab_tag = kheap_tag("slab");
+    kmem_cache_t* c = NULL;
+    spin_lock(&registry_lock);
+    for (int i = 0; i < KMEM_MAX_CACHES; ++i) {
+        if (!caches[i].used) {
+            c = &caches[i];
+            memset(c, 0, sizeof(*c));
+            c->used = 1;
+            break;
+        }
+    }
+    spin_unlock(&registry_lock);
+    if (!c) {
+        printf("[Slab] No free cache slot for %s\n", name);
+        return NULL;
+    }
+    strncpy(c->name, name, KMEM_NAME_LEN - 1);
+    c->obj_size = align_up(size, align);
+    c->ctor = ctor;
+    spin_init(&c->lock);
+    if (cache_layout(c, align) < 0) {
+        printf("[Slab] %s: objects of %zu bytes are too large\n", name, size);
+        spin_lock(&registry_lock);
+        c->used = 0;
+        spin_unlock(&registry_lock);
+        return NULL;
+    }
+    shrinker_register(&slab_shrinker);
+    return c;
+}
+
+static void* cache_alloc(kmem_cache_t* c) {
+    if (!c) return NULL;
+    kmem_pcpu_t* p = &c->pcpu[kmem_this_cpu()];
+    if (pcpu_trylock(p)) {
+        void* obj = mag_pop(c, p);
+        if (obj) p->allocs++;
+        pcpu_unlock(p);
+        if (obj) return obj;
+    }
+    spin_lock(&c->lock);
+    void* obj = slab_take(c);
+    spin_unlock(&c->lock);
+    if (!obj) {
+        // Build the slab and run constructors outside the lock
+        kmem_slab_t* s = slab_create(c);
+        if (!s) return NULL;
+        spin_lock(&c->lock);
+        slab_link(c, s, SLAB_EMPTY);
+        c->nr_slabs++;
+        obj = slab_take(c);
+        spin_unlock(&c->lock);
+    }
+    __atomic_add_fetch(&c->slow_allocs, 1, __ATOMIC_RELAXED);
+    return obj;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* c) {
+    void* obj = cache_alloc(c);
+    if (obj) alloc_prof_record(obj, c->obj_size, c->name, __builtin_return_address(0));
+    return obj;
+}
+
+void* kmem_cache_zalloc(kmem_cache_t* c) {
+    void* obj = cache_alloc(c);
+    if (obj) {
+        memset(obj, 0, c->obj_size);
+        if (c->ctor) c->ctor(obj);
+        alloc_prof_record(obj, c->obj_size, c->name, __builtin_return_address(0));
+    }
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* c, void* obj) {
+    if (!c || !obj) return;
+    if (obj_slab(c, obj)->cache != c) {
+        printf("[Slab] %s: free of foreign object %p\n", c->name, obj);
+        return;
+    }
+    alloc_prof_forget(obj);
+    kmem_pcpu_t* p = &c->pcpu[kmem_this_cpu()];
+    if (pcpu_trylock(p)) {
+        int ok = mag_push(c, p, obj);
+        if (ok) p->frees++;
+        pcpu_unlock(p);
+        if (ok) return;
+    }
+    spin_lock(&c->lock);
+    slab_put(c, obj);
+    spin_unlock(&c->lock);
+    __atomic_add_fetch(&c->slow_frees, 1, __ATOMIC_RELAXED);
+}
+
+// Returns every cached object to its slab and releases empty slabs and
+// magazines. CPUs busy in the fast path keep their magazines this time.
+size_t kmem_cache_shrink(kmem_cache_t* c) {
+    if (!c) return 0;
+    kmem_mag_t* mags = NULL;
+    for (int i = 0; i < KMEM_MAX_CPUS; ++i) {
+        kmem_pcpu_t* p = &c->pcpu[i];
+        if (!p->loaded && !p->prev) continue;
+        if (!pcpu_trylock(p)) continue;
+        if (p->loaded) { p->loaded->next = mags; mags = p->loaded; }
+        if (p->prev) { p->prev->next = mags; mags = p->prev; }
+        p->loaded = p->prev = NULL;
+        pcpu_unlock(p);
+    }
+    spin_lock(&c->lock);
+    kmem_mag_t** depots[2] = { &c->depot_full, &c->depot_empty };
+    for (int d = 0; d < 2; ++d) {
+        while (*depots[d]) {
+            kmem_mag_t* m = *depots[d];
+            *depots[d] = m->next;
+            m->next = mags;
+            mags = m;
+        }
+    }
+    for (kmem_mag_t* m = mags; m; m = m->next) {
+        while (m->rounds) slab_put(c, m->objs[--m->rounds]);
+    }
+    kmem_slab_t* empty = c->slabs[SLAB_EMPTY];
+    c->slabs[SLAB_EMPTY] = NULL;
+    spin_unlock(&c->lock);
+
+    size_t released = 0;
+    while (mags) {
+        kmem_mag_t* next = mags->next;
+        kheap_free(mags);
+        released += sizeof(kmem_mag_t);
+        mags = next;
+    }
+    uint64_t nr = 0;
+    while (empty) {
+        kmem_slab_t* next = empty->next;
+        slab_pages_free(empty);
+        released += c->slab_size;
+        nr++;
+        empty = next;
+    }
+    if (nr) __atomic_sub_fetch(&c->nr_slabs, nr, __ATOMIC_RELAXED);
+    return released;
+}
+
+void kmem_cache_destroy(kmem_cache_t* c) {
+    if (!c || !c->used) return;
+    kmem_cache_shrink(c);
+    spin_lock(&c->lock);
+    if (c->slab_inuse) {
+        printf("[Slab] %s destroyed with %llu objects still allocated\n", c->name, (unsigned long long)c->slab_inuse);
+    }
+    for (int l = 0; l < SLAB_LISTS; ++l) {
+        while (c->slabs[l]) {
+            kmem_slab_t* s = c->slabs[l];
+            c->slabs[l] = s->next;
+            slab_pages_free(s);
+        }
+    }
+    spin_unlock(&c->lock);
+    spin_lock(&registry_lock);
+    c->used = 0;
+    spin_unlock(&registry_lock);
+}
+
+int kmem_cache_stats(const kmem_cache_t* c, kmem_stats_t* out) {
+    if (!c || !out || !c->used) return -1;
+    memset(out, 0, sizeof(*out));
+    out->name = c->name;
+    out->obj_size = c->obj_size;
+    out->slab_size = c->slab_size;
+    out->objs_per_slab = c->objs_per_slab;
+    out->allocs = __atomic_load_n(&c->slow_allocs, __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&c->slow_frees, __ATOMIC_RELAXED);
+    for (int i = 0; i < KMEM_MAX_CPUS; ++i) {
+        out->mag_hits += c->pcpu[i].allocs;
+        out->frees += c->pcpu[i].frees;
+    }
+    out->allocs += out->mag_hits;
+    out->slabs = __atomic_load_n(&c->nr_slabs, __ATOMIC_RELAXED);
+    out->total = out->slabs * c->objs_per_slab;
+    uint64_t out_of_slabs = __atomic_load_n(&c->slab_inuse, __ATOMIC_RELAXED);
+    out->live = out->allocs > out->frees ? out->allocs - out->frees : 0;
+    out->cached = out_of_slabs > out->live ? out_of_slabs - out->live : 0;
+    out->util_pct = out->total ? (uint32_t)(out->live * 100 / out->total) : 0;
+    return 0;
+}
+
+void kmem_cache_dump(void) {
+    printf("[Slab] %-20s %6s %8s %8s %8s %6s %5s\n", "cache", "size", "live", "cached", "total", "slabs", "util");
+    for (int i = 0; i < KMEM_MAX_CACHES; ++i) {
+        kmem_stats_t st;
+        if (kmem_cache_stats(&caches[i], &st) < 0) continue;
+        printf("[Slab] %-20s %6zu %8llu %8llu %8llu %6llu %4u%%\n", st.name, st.obj_size,
+            (unsigned long long)st.live, (unsigned long long)st.cached, (unsigned long long)st.total,
+            (unsigned long long)st.slabs, st.util_pct);
+    }
+}
@@ -0,0 +1,70 @@
+// generation-indexed slot map
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "slot_map.h"
+
+#define SLOT_NONE 0xFFFFFFFFu
+
+int slot_map_init(slot_map_t* sm, void* dense, size_t elem_size,
+    uint32_t* dense_slot, slot_entry_t* slots, uint32_t capacity) {
+    if (!sm || !dense || !dense_slot || !slots || capacity == 0 || capacity > SLOT_MAX_CAPACITY) return -1;
+    sm->dense = dense;
+    sm->elem_size = elem_size;
+    sm->dense_slot = dense_slot;
+    sm->slots = slots;
+    sm->capacity = capacity;
+    sm->count = 0;
+    for (uint32_t s = 0; s < capacity; ++s) sm->slots[s].gen = 1;
+    slot_map_clear(sm);
+    return 0;
+}
+
+// Drops every element; generations keep counting so old handles stay stale
+void slot_map_clear(slot_map_t* sm) {
+    for (uint32_t i = 0; i < sm->count; ++i) {
+        slot_entry_t* e = &sm->slots[sm->dense_slot[i]];
+        e->gen = (uint16_t)((e->gen + 1) & SLOT_GEN_MASK);
+        if (!e->gen) e->gen = 1;
+    }
+    for (uint32_t s = 0; s < sm->capacity; ++s) {
+        sm->slots[s].index = s + 1 < sm->capacity ? s + 1 : SLOT_NONE;
+    }
+    sm->count = 0;
+    sm->free_head = 0;
+}
+
+int slot_map_insert(slot_map_t* sm, void** elem_out) {
+    if (sm->free_head == SLOT_NONE || sm->count >= sm->capacity) return -1;
+    uint32_t slot = sm->free_head;
+    slot_entry_t* e = &sm->slots[slot];
+    sm->free_head = e->index;
+    uint32_t i = sm->count++;
+    e->index = i;
+    sm->dense_slot[i] = slot;
+    void* elem = slot_map_at(sm, i);
+    memset(elem, 0, sm->elem_size);
+    if (elem_out) *elem_out = elem;
+    return (int)(((uint32_t)e->gen << SLOT_INDEX_BITS) | slot);
+}
+
+int slot_map_remove(slot_map_t* sm, int handle) {
+    int idx = slot_map_index(sm, handle);
+    if (idx < 0) return -1;
+    uint32_t i = (uint32_t)idx;
+    uint32_t slot = (uint32_t)handle & SLOT_INDEX_MASK;
+    uint32_t last = --sm->count;
+    if (i != last) {
+        memcpy(slot_map_at(sm, i), slot_map_at(sm, last), sm->elem_size);
+        uint32_t moved = sm->dense_slot[last];
+        sm->dense_slot[i] = moved;
+        sm->slots[moved].index = i;
+    }
+    slot_entry_t* e = &sm->slots[slot];
+    e->gen = (uint16_t)((e->gen + 1) & SLOT_GEN_MASK);
+    if (!e->gen) e->gen = 1;
+    e->index = sm->free_head;
+    sm->free_head = slot;
+    return idx;
+}
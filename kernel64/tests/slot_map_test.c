@@ -0,0 +1,53 @@
+// Hosted check for slot map handle validation:
+//   gcc -std=gnu11 -Ikernel64/include kernel64/tests/slot_map_test.c kernel64/slot_map.c -o slot_map_test
+
+#include <stdio.h>
+#include <stdint.h>
+#include "slot_map.h"
+
+#define CAP 8
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("[SlotMapTest] FAIL line %d: %s\n", __LINE__, #cond); failures++; } \
+} while (0)
+
+int main(void) {
+    static int dense[CAP];
+    static uint32_t dense_slot[CAP];
+    static slot_entry_t slots[CAP];
+    slot_map_t m;
+    CHECK(slot_map_init(&m, dense, sizeof(int), dense_slot, slots, CAP) == 0);
+
+    int* v;
+    int a = slot_map_insert(&m, (void**)&v); *v = 10;
+    int b = slot_map_insert(&m, (void**)&v); *v = 20;
+    CHECK(a > 0 && b > 0);
+    CHECK(slot_map_remove(&m, a) == 0);
+    CHECK(m.count == 1);
+
+    // Stale: a's slot is free and already carries the generation its next
+    // occupant will get
+    int stale = (int)(((uint32_t)slots[a & SLOT_INDEX_MASK].gen << SLOT_INDEX_BITS) | (a & SLOT_INDEX_MASK));
+    CHECK(slot_map_get(&m, a) == NULL);
+    CHECK(slot_map_get(&m, stale) == NULL);
+    CHECK(slot_map_remove(&m, stale) == -1);
+
+    // Forged: a slot that was never handed out
+    int forged = (1 << SLOT_INDEX_BITS) | 5;
+    CHECK(slot_map_index(&m, forged) == -1);
+    CHECK(slot_map_remove(&m, forged) == -1);
+    CHECK(m.count == 1);
+
+    CHECK(slot_map_get(&m, b) != NULL && *(int*)slot_map_get(&m, b) == 20);
+
+    // The reused slot gets a fresh handle; the old one stays dead
+    int c = slot_map_insert(&m, (void**)&v); *v = 30;
+    CHECK(c == stale && c != a);
+    CHECK(slot_map_get(&m, a) == NULL);
+    CHECK(*(int*)slot_map_get(&m, c) == 30);
+
+    printf("[SlotMapTest] %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+// hierarchical timing wheel
+
+#include <stdint.h>
+#include <stddef.h>
+#include "timer_wheel.h"
+
+#define LVL_SHIFT(l) (TW_SLOT_BITS * (l))
+#define SLOT_MASK (TW_SLOTS - 1)
+#define TW_RANGE (1ull << LVL_SHIFT(TW_LEVELS))
+
+static struct {
+    ktimer_t* slots[TW_LEVELS][TW_SLOTS];
+    uint64_t occupied[TW_LEVELS]; // Bit s set while slots[l][s] is non-empty
+    uint64_t clk;                 // Next millisecond to process
+    int count;
+    int expiring;                 // Inside tw_expire_slot: slot clk is already detached
+} wheel;
+
+static void tw_link(ktimer_t** head, ktimer_t* t) {
+    t->next = *head;
+    if (*head) (*head)->pprev = &t->next;
+    *head = t;
+    t->pprev = head;
+}
+
+static void tw_unlink(ktimer_t* t) {
+    ktimer_t** head = t->pprev;
+    *head = t->next;
+    if (t->next) t->next->pprev = head;
+    t->next = NULL;
+    t->pprev = NULL;
+    // Emptied a wheel slot (as opposed to a detached expiry list): clear its bit
+    ptrdiff_t idx = head - &wheel.slots[0][0];
+    if (idx >= 0 && idx < TW_LEVELS * TW_SLOTS && !*head) {
+        wheel.occupied[idx / TW_SLOTS] &= ~(1ull << (idx % TW_SLOTS));
+    }
+}
+
+// File a timer by distance from clk: level l holds timers due within 64^(l+1) ms
+static void tw_enqueue(ktimer_t* t) {
+    // A past-due timer re-armed by a callback goes to the next slot, not the
+    // one being expired, or it would wait a full lap of level 0
+    uint64_t now = wheel.expiring ? wheel.clk + 1 : wheel.clk;
+    uint64_t exp = t->expires < now ? now : t->expires;
+    if (exp - wheel.clk >= TW_RANGE) exp = wheel.clk + TW_RANGE - 1; // Re-filed on cascade
+    uint64_t delta = exp - wheel.clk;
+    int lvl = 0;
+    while (lvl < TW_LEVELS - 1 && delta >= (1ull << LVL_SHIFT(lvl + 1))) lvl++;
+    unsigned slot = (unsigned)(exp >> LVL_SHIFT(lvl)) & SLOT_MASK;
+    tw_link(&wheel.slots[lvl][slot], t);
+    wheel.occupied[lvl] |= 1ull << slot;
+}
+
+// Move everything in a higher-level slot down now that its range has come up
+static void tw_cascade(int lvl, unsigned slot) {
+    ktimer_t* list = wheel.slots[lvl][slot];
+    wheel.slots[lvl][slot] = NULL;
+    wheel.occupied[lvl] &= ~(1ull << slot);
+    while (list) {
+        ktimer_t* t = list;
+        list = t->next;
+        t->next = NULL;
+        t->pprev = NULL;
+        tw_enqueue(t);
+    }
+}
+
+void timer_wheel_init(uint64_t now_ms) {
+    for (int l = 0; l < TW_LEVELS; ++l) {
+        for (unsigned s = 0; s < TW_SLOTS; ++s) wheel.slots[l][s] = NULL;
+        wheel.occupied[l] = 0;
+    }
+    wheel.clk = now_ms;
+    wheel.count = 0;
+    wheel.expiring = 0;
+}
+
+void ktimer_init(ktimer_t* t, const char* name, ktimer_fn_t fn, void* arg) {
+    t->next = NULL;
+    t->pprev = NULL;
+    t->expires = 0;
+    t->period_ms = 0;
+    t->overruns = 0;
+    t->fn = fn;
+    t->arg = arg;
+    t->name = name;
+}
+
+int ktimer_pending(const ktimer_t* t) {
+    return t->pprev != NULL;
+}
+
+void ktimer_del(ktimer_t* t) {
+    if (!t->pprev) return;
+    tw_unlink(t);
+    wheel.count--;
+}
+
+void ktimer_add(ktimer_t* t, uint64_t expires_ms) {
+    ktimer_del(t);
+    t->expires = expires_ms;
+    tw_enqueue(t);
+    wheel.count++;
+}
+
+// Periodic timers re-arm from their previous expiry, not from when they ran,
+// so slow callbacks elsewhere in the loop do not make them drift
+void ktimer_add_periodic(ktimer_t* t, uint64_t now_ms, uint32_t period_ms) {
+    t->period_ms = period_ms;
+    ktimer_add(t, now_ms + period_ms);
+}
+
+static int tw_expire_slot(unsigned slot) {
+    int fired = 0;
+    ktimer_t* pending = wheel.slots[0][slot];
+    wheel.slots[0][slot] = NULL;
+    wheel.occupied[0] &= ~(1ull << slot);
+    if (pending) pending->pprev = &pending;
+    wheel.expiring = 1;
+    while (pending) {
+        ktimer_t* t = pending;
+        tw_unlink(t);
+        if (t->expires > wheel.clk) {
+            tw_enqueue(t); // Clamped long timer: not due yet
+            continue;
+        }
+        wheel.count--;
+        if (t->period_ms) {
+            uint64_t next = t->expires + t->period_ms;
+            if (next <= wheel.clk) {
+                uint64_t missed = (wheel.clk - t->expires) / t->period_ms;
+                t->overruns += (uint32_t)missed;
+                next = t->expires + (missed + 1) * t->period_ms;
+            }
+            ktimer_add(t, next); // Before the callback, so it may delete or re-arm
+        }
+        t->fn(t, t->arg);
+        fired++;
+    }
+    wheel.expiring = 0;
+    return fired;
+}
+
+int timer_wheel_run(uint64_t now_ms) {
+    int fired = 0;
+    while (wheel.clk <= now_ms) {
+        unsigned idx = (unsigned)wheel.clk & SLOT_MASK;
+        if (idx == 0) {
+            // Crossing a level-0 block: cascade the highest level whose block also ends here first
+            int top = 1;
+            while (top < TW_LEVELS - 1 && ((wheel.clk >> LVL_SHIFT(top)) & SLOT_MASK) == 0) top++;
+            for (int l = top; l >= 1; --l) {
+                tw_cascade(l, (unsigned)(wheel.clk >> LVL_SHIFT(l)) & SLOT_MASK);
+            }
+        }
+        if (wheel.occupied[0] & (1ull << idx)) fired += tw_expire_slot(idx);
+        // Skip straight to the next occupied level-0 slot or the end of the block
+        uint64_t block = wheel.clk & ~(uint64_t)SLOT_MASK;
+        uint64_t next = block + TW_SLOTS;
+        uint64_t later = idx + 1 < TW_SLOTS ? wheel.occupied[0] >> (idx + 1) << (idx + 1) : 0;
+        if (later) next = block + (uint64_t)__builtin_ctzll(later);
+        wheel.clk = next <= now_ms ? next : now_ms + 1;
+    }
+    return fired;
+}
+
+// Earliest time the loop must wake. Exact for level 0; for higher levels it is
+// the slot's cascade time, which is never later than any timer in it.
+uint64_t timer_wheel_next_expiry(void) {
+    if (wheel.count == 0) return TW_NO_TIMER;
+    uint64_t best = TW_NO_TIMER;
+    uint64_t block = wheel.clk & ~(uint64_t)SLOT_MASK;
+    unsigned idx = (unsigned)wheel.clk & SLOT_MASK;
+    uint64_t bits = wheel.occupied[0];
+    if (bits) {
+        uint64_t ahead = bits >> idx << idx;
+        if (ahead) best = block + (uint64_t)__builtin_ctzll(ahead);
+        else best = block + TW_SLOTS + (uint64_t)__builtin_ctzll(bits);
+    }
+    for (int l = 1; l < TW_LEVELS; ++l) {
+        bits = wheel.occupied[l];
+        uint64_t span = 1ull << LVL_SHIFT(l);
+        uint64_t first = (wheel.clk + span - 1) >> LVL_SHIFT(l); // First block not yet cascaded
+        while (bits) {
+            unsigned s = (unsigned)__builtin_ctzll(bits);
+            bits &= bits - 1;
+            uint64_t b = first + ((s - first) & SLOT_MASK);
+            uint64_t when = b << LVL_SHIFT(l);
+            if (when < best) best = when;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,646 @@
+// compressed RAM swap: same-filled pages, LZ4 pool, swap-file writeback
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "zswap.h"
+#include "lz4.h"
+#include "kheap.h"
+#include "page_alloc.h"
+#include "spinlock.h"
+#include "ktime.h"
+#include "shrinker.h"
+
+#define Z_NONE (-1)
+#define WRITEBACK_BATCH 8
+
+enum { ZE_FREE, ZE_SAME, ZE_POOL, ZE_WRITEBACK, ZE_FILE };
+enum { ANON_FREE, ANON_RESIDENT, ANON_SWAPPED, ANON_BUSY };
+
+typedef struct {
+    uint8_t kind;
+    uint8_t dead;           // Invalidated mid-writeback; the writer frees it
+    uint16_t len;           // Stored bytes
+    int32_t prev, next;     // Pool LRU while ZE_POOL, free list while ZE_FREE
+    uint8_t raw;            // ZE_FILE holding the page uncompressed
+    union {
+        uint64_t fill;
+        uint8_t* data;
+        uint32_t slot;
+    } u;
+} zswap_entry_t;
+
+typedef struct {
+    spinlock_t lock;
+    uint16_t hash[LZ4_WORKSPACE_SIZE / sizeof(uint16_t)];
+    uint8_t buf[PAGE_SIZE];
+} zswap_wrk_t;
+
+static struct {
+    spinlock_t lock;
+    zswap_entry_t entries[ZSWAP_MAX_ENTRIES];
+    int32_t free_head;
+    int32_t lru_head, lru_tail;     // Newest at the head
+    uint64_t slots[ZSWAP_FILE_SLOTS / 64];
+    uint32_t slot_hint;
+    fs_module_t* backing;
+    char path[256];
+    zswap_params_t params;
+    zswap_stats_t stats;
+} zs = { .lock = SPINLOCK_INIT };
+
+static zswap_wrk_t* wrk[ZSWAP_WORKSPACES];
+static spinlock_t init_lock = SPINLOCK_INIT;
+static volatile int initialized;
+static int zswap_tag;
+
+static spinlock_t anon_lock = SPINLOCK_INIT;
+static anon_page_t* anon_head;      // Most recently used
+static anon_page_t* anon_tail;
+
+static uint64_t pool_limit(const zswap_params_t* p) {
+    page_alloc_stats_t st;
+    page_alloc_stats(&st);
+    return st.total_pages * PAGE_SIZE / 100 * p->pool_pct;
+}
+
+// The pool shrinks by writing back to the swap file
+static unsigned long zswap_shrink_count(shrinker_t* s) {
+    (void)s;
+    if (!zs.backing) return 0;
+    return (unsigned long)(__atomic_load_n(&zs.stats.pool_bytes, __ATOMIC_RELAXED) / PAGE_SIZE);
+}
+
+static unsigned long zswap_shrink_scan(shrinker_t* s, unsigned long nr, int priority) {
+    (void)s; (void)priority;
+    uint64_t start = __atomic_load_n(&zs.stats.pool_bytes, __ATOMIC_RELAXED);
+    uint64_t now = start;
+    while (start - now < (uint64_t)nr * PAGE_SIZE) {
+        if (zswap_writeback(WRITEBACK_BATCH) <= 0) break;
+        now = __atomic_load_n(&zs.stats.pool_bytes, __ATOMIC_RELAXED);
+        if (now > start) break; // New stores are racing in
+    }
+    // Written-back data goes back to the heap; only emptied regions free RAM
+    return kheap_trim();
+}
+
+static shrinker_t zswap_shrinker = {
+    .name = "zswap",
+    .count = zswap_shrink_count,
+    .scan = zswap_shrink_scan,
+    .seeks = 2 * SHRINKER_DEFAULT_SEEKS, // A file write now, a read on the next load
+};
+
+int zswap_init(fs_module_t* backing, const char* path) {
+    spin_lock(&init_lock);
+    if (!initialized) {
+        zswap_params_t def = ZSWAP_DEFAULT_PARAMS;
+        zswap_tag = kheap_tag("zswap");
+        for (int i = 0; i < ZSWAP_WORKSPACES; ++i) {
+            wrk[i] = (zswap_wrk_t*)kheap_alloc(KHEAP_NORMAL, sizeof(zswap_wrk_t), zswap_tag);
+            if (!wrk[i]) {
+                while (i--) kheap_free(wrk[i]);
+                spin_unlock(&init_lock);
+                printf("[ZSwap] Out of memory for workspaces\n");
+                return -1;
+            }
+            spin_init(&wrk[i]->lock);
+        }
+        spin_lock(&zs.lock);
+        for (int i = 0; i < ZSWAP_MAX_ENTRIES; ++i) zs.entries[i].next = i + 1 < ZSWAP_MAX_ENTRIES ? i + 1 : Z_NONE;
+        zs.free_head = 0;
+        zs.lru_head = zs.lru_tail = Z_NONE;
+        zs.params = def;
+        zs.stats.pool_limit = pool_limit(&def);
+        spin_unlock(&zs.lock);
+        __atomic_store_n(&initialized, 1, __ATOMIC_RELEASE);
+        shrinker_register(&zswap_shrinker);
+    }
+    if (backing && path) {
+        spin_lock(&zs.lock);
+        zs.backing = backing;
+        strncpy(zs.path, path, sizeof(zs.path) - 1);
+        spin_unlock(&zs.lock);
+    }
+    spin_unlock(&init_lock);
+    printf("[ZSwap] Pool limit %llu KiB, swap file %s\n", (unsigned long long)(zs.stats.pool_limit / 1024),
+        zs.backing ? zs.path : "(none)");
+    return 0;
+}
+
+void zswap_get_params(zswap_params_t* out) {
+    if (!out) return;
+    if (!initialized) zswap_init(NULL, NULL);
+    spin_lock(&zs.lock);
+    *out = zs.params;
+    spin_unlock(&zs.lock);
+}
+
+int zswap_set_params(const zswap_params_t* p) {
+    if (!p || p->pool_pct > 100 || !p->max_ratio_pct || p->max_ratio_pct > 100) return -1;
+    if (!initialized) zswap_init(NULL, NULL);
+    uint64_t limit = pool_limit(p);
+    spin_lock(&zs.lock);
+    zs.params = *p;
+    zs.stats.pool_limit = limit;
+    spin_unlock(&zs.lock);
+    return 0;
+}
+
+// A free workspace if there is one, else wait on one
+static zswap_wrk_t* wrk_get(void) {
+    static uint32_t next;
+    uint32_t start = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i < ZSWAP_WORKSPACES; ++i) {
+        zswap_wrk_t* w = wrk[(start + i) % ZSWAP_WORKSPACES];
+        if (spin_trylock(&w->lock)) return w;
+    }
+    zswap_wrk_t* w = wrk[start % ZSWAP_WORKSPACES];
+    spin_lock(&w->lock);
+    return w;
+}
+
+// ---- entries, pool LRU and swap-file slots (zs.lock held) ----
+
+static int32_t entry_alloc(void) {
+    int32_t i = zs.free_head;
+    if (i == Z_NONE) return Z_NONE;
+    zs.free_head = zs.entries[i].next;
+    zs.entries[i].dead = 0;
+    return i;
+}
+
+static void entry_free(int32_t i) {
+    zs.entries[i].kind = ZE_FREE;
+    zs.entries[i].next = zs.free_head;
+    zs.free_head = i;
+    zs.stats.stored--;
+}
+
+static void lru_push(int32_t i) {
+    zswap_entry_t* e = &zs.entries[i];
+    e->prev = Z_NONE;
+    e->next = zs.lru_head;
+    if (zs.lru_head != Z_NONE) zs.entries[zs.lru_head].prev = i;
+    else zs.lru_tail = i;
+    zs.lru_head = i;
+}
+
+static void lru_del(int32_t i) {
+    zswap_entry_t* e = &zs.entries[i];
+    if (e->prev != Z_NONE) zs.entries[e->prev].next = e->next;
+    else zs.lru_head = e->next;
+    if (e->next != Z_NONE) zs.entries[e->next].prev = e->prev;
+    else zs.lru_tail = e->prev;
+}
+
+static int slot_alloc(void) {
+    for (uint32_t n = 0; n < ZSWAP_FILE_SLOTS / 64; ++n) {
+        uint32_t w = (zs.slot_hint + n) % (ZSWAP_FILE_SLOTS / 64);
+        if (zs.slots[w] == ~0ULL) continue;
+        int bit = __builtin_ctzll(~zs.slots[w]);
+        zs.slots[w] |= 1ULL << bit;
+        zs.slot_hint = w;
+        return (int)(w * 64 + (uint32_t)bit);
+    }
+    return -1;
+}
+
+static void slot_free(uint32_t slot) {
+    zs.slots[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+static uint64_t slot_offset(uint32_t slot) { return (uint64_t)slot * PAGE_SIZE; }
+
+// ---- store / load ----
+
+static int same_filled(const void* page, uint64_t* fill) {
+    const uint64_t* w = (const uint64_t*)page;
+    for (size_t i = 1; i < PAGE_SIZE / sizeof(uint64_t); ++i) {
+        if (w[i] != w[0]) return 0;
+    }
+    *fill = w[0];
+    return 1;
+}
+
+static uint32_t reject(void) {
+    spin_lock(&zs.lock);
+    zs.stats.rejected++;
+    spin_unlock(&zs.lock);
+    return ZSWAP_NONE;
+}
+
+// Writes len bytes straight to a new swap-file slot; raw when src is the
+// page itself rather than its compressed form. No spinlock may be held.
+static uint32_t store_file(const void* src, uint16_t len, int raw) {
+    spin_lock(&zs.lock);
+    int32_t i = zs.backing ? entry_alloc() : Z_NONE;
+    int slot = i != Z_NONE ? slot_alloc() : -1;
+    if (slot < 0) {
+        if (i != Z_NONE) { zs.entries[i].next = zs.free_head; zs.free_head = i; }
+        zs.stats.rejected++;
+        spin_unlock(&zs.lock);
+        return ZSWAP_NONE;
+    }
+    spin_unlock(&zs.lock);
+    // The entry is not handed out yet, so nobody else looks at it during the write
+    int w = fs_write(zs.backing, zs.path, src, len, slot_offset((uint32_t)slot), FS_IO_DIRECT);
+    spin_lock(&zs.lock);
+    if (w != (int)len) {
+        slot_free((uint32_t)slot);
+        zs.entries[i].next = zs.free_head;
+        zs.free_head = i;
+        zs.stats.rejected++;
+        spin_unlock(&zs.lock);
+        return ZSWAP_NONE;
+    }
+    zs.entries[i].kind = ZE_FILE;
+    zs.entries[i].len = len;
+    zs.entries[i].raw = (uint8_t)raw;
+    zs.entries[i].u.slot = (uint32_t)slot;
+    zs.stats.file_pages++;
+    zs.stats.stored++;
+    zs.stats.stores++;
+    spin_unlock(&zs.lock);
+    return (uint32_t)i + 1;
+}
+
+uint32_t zswap_store(const void* page) {
+    if (!page) return ZSWAP_NONE;
+    if (!initialized && zswap_init(NULL, NULL) < 0) return ZSWAP_NONE;
+    uint64_t fill;
+    if (same_filled(page, &fill)) {
+        spin_lock(&zs.lock);
+        int32_t i = entry_alloc();
+        if (i != Z_NONE) {
+            zs.entries[i].kind = ZE_SAME;
+            zs.entries[i].u.fill = fill;
+            zs.stats.same_filled++;
+            zs.stats.stored++;
+            zs.stats.stores++;
+        } else {
+            zs.stats.rejected++;
+        }
+        spin_unlock(&zs.lock);
+        return i == Z_NONE ? ZSWAP_NONE : (uint32_t)i + 1;
+    }
+    zswap_wrk_t* w = wrk_get();
+    int cap = (int)(PAGE_SIZE * zs.params.max_ratio_pct / 100);
+    int clen = lz4_compress((const uint8_t*)page, PAGE_SIZE, w->buf, cap, w->hash);
+    if (!clen) {
+        // Not worth the pool space
+        spin_unlock(&w->lock);
+        return store_file(page, PAGE_SIZE, 1);
+    }
+    // Out of the workspace before any file I/O, which must not spin others
+    uint8_t* data = (uint8_t*)kheap_alloc(KHEAP_NORMAL, (size_t)clen, zswap_tag);
+    if (data) memcpy(data, w->buf, (size_t)clen);
+    spin_unlock(&w->lock);
+    if (!data) return reject();
+    // Make room by pushing the oldest compressed pages out to the file
+    while (__atomic_load_n(&zs.stats.pool_bytes, __ATOMIC_RELAXED) + (uint64_t)clen > zs.stats.pool_limit) {
+        if (zswap_writeback(WRITEBACK_BATCH) <= 0) {
+            uint32_t e = store_file(data, (uint16_t)clen, 0);
+            kheap_free(data);
+            return e;
+        }
+    }
+    spin_lock(&zs.lock);
+    int32_t i = entry_alloc();
+    if (i == Z_NONE) {
+        zs.stats.rejected++;
+        spin_unlock(&zs.lock);
+        kheap_free(data);
+        return ZSWAP_NONE;
+    }
+    zs.entries[i].kind = ZE_POOL;
+    zs.entries[i].len = (uint16_t)clen;
+    zs.entries[i].u.data = data;
+    lru_push(i);
+    zs.stats.pool_bytes += (uint64_t)clen;
+    zs.stats.compressed++;
+    zs.stats.stored++;
+    zs.stats.stores++;
+    spin_unlock(&zs.lock);
+    return (uint32_t)i + 1;
+}
+
+int zswap_load(uint32_t entry, void* page) {
+    if (!entry || entry > ZSWAP_MAX_ENTRIES || !page) return -1;
+    int32_t i = (int32_t)entry - 1;
+    spin_lock(&zs.lock);
+    zswap_entry_t* e = &zs.entries[i];
+    switch (e->kind) {
+    case ZE_SAME: {
+        uint64_t* w = (uint64_t*)page;
+        for (size_t k = 0; k < PAGE_SIZE / sizeof(uint64_t); ++k) w[k] = e->u.fill;
+        zs.stats.same_filled--;
+        zs.stats.loads++;
+        entry_free(i);
+        spin_unlock(&zs.lock);
+        return 0;
+    }
+    case ZE_POOL:
+    case ZE_WRITEBACK: {
+        // LZ4 decodes a page in microseconds, so this stays under the lock
+        if (lz4_decompress(e->u.data, e->len, (uint8_t*)page, PAGE_SIZE) != PAGE_SIZE) {
+            spin_unlock(&zs.lock);
+            printf("[ZSwap] Corrupt entry %u\n", entry);
+            return -1;
+        }
+        zs.stats.loads++;
+        if (e->kind == ZE_WRITEBACK) {
+            e->dead = 1;
+            spin_unlock(&zs.lock);
+            return 0;
+        }
+        uint8_t* data = e->u.data;
+        lru_del(i);
+        zs.stats.pool_bytes -= e->len;
+        zs.stats.compressed--;
+        entry_free(i);
+        spin_unlock(&zs.lock);
+        kheap_free(data);
+        return 0;
+    }
+    case ZE_FILE:
+        break;
+    default:
+        spin_unlock(&zs.lock);
+        return -1;
+    }
+    // Only the entry's owner loads it and writeback is done with it, so the
+    // read can happen unlocked
+    uint32_t slot = e->u.slot;
+    uint16_t len = e->len;
+    int raw = e->raw;
+    spin_unlock(&zs.lock);
+    int ok;
+    if (raw) {
+        ok = fs_read(zs.backing, zs.path, page, PAGE_SIZE, slot_offset(slot), FS_IO_DIRECT) == PAGE_SIZE;
+    } else {
+        // Decoding needs no workspace, so no spinlock is held across the read
+        uint8_t* buf = (uint8_t*)kheap_alloc(KHEAP_NORMAL, len, zswap_tag);
+        ok = buf && fs_read(zs.backing, zs.path, buf, len, slot_offset(slot), FS_IO_DIRECT) == (int)len &&
+            lz4_decompress(buf, len, (uint8_t*)page, PAGE_SIZE) == PAGE_SIZE;
+        kheap_free(buf);
+    }
+    if (!ok) return -1;
+    spin_lock(&zs.lock);
+    slot_free(slot);
+    zs.stats.file_pages--;
+    zs.stats.loads++;
+    entry_free(i);
+    spin_unlock(&zs.lock);
+    return 0;
+}
+
+void zswap_invalidate(uint32_t entry) {
+    if (!entry || entry > ZSWAP_MAX_ENTRIES) return;
+    int32_t i = (int32_t)entry - 1;
+    uint8_t* data = NULL;
+    spin_lock(&zs.lock);
+    zswap_entry_t* e = &zs.entries[i];
+    switch (e->kind) {
+    case ZE_SAME:
+        zs.stats.same_filled--;
+        entry_free(i);
+        break;
+    case ZE_POOL:
+        data = e->u.data;
+        lru_del(i);
+        zs.stats.pool_bytes -= e->len;
+        zs.stats.compressed--;
+        entry_free(i);
+        break;
+    case ZE_WRITEBACK:
+        e->dead = 1;
+        break;
+    case ZE_FILE:
+        slot_free(e->u.slot);
+        zs.stats.file_pages--;
+        entry_free(i);
+        break;
+    default:
+        break;
+    }
+    spin_unlock(&zs.lock);
+    kheap_free(data);
+}
+
+int zswap_writeback(unsigned nr) {
+    if (!zs.backing) return 0;
+    int done = 0;
+    while ((unsigned)done < nr) {
+        spin_lock(&zs.lock);
+        int32_t i = zs.lru_tail;
+        int slot = i != Z_NONE ? slot_alloc() : -1;
+        if (slot < 0) {
+            spin_unlock(&zs.lock);
+            break;
+        }
+        zswap_entry_t* e = &zs.entries[i];
+        lru_del(i);
+        e->kind = ZE_WRITEBACK;
+        uint8_t* data = e->u.data;
+        uint16_t len = e->len;
+        spin_unlock(&zs.lock);
+        int w = fs_write(zs.backing, zs.path, data, len, slot_offset((uint32_t)slot), FS_IO_DIRECT);
+        spin_lock(&zs.lock);
+        if (w != (int)len && !e->dead) {
+            // Keep it in the pool and stop; the file is not taking writes
+            slot_free((uint32_t)slot);
+            e->kind = ZE_POOL;
+            lru_push(i);
+            spin_unlock(&zs.lock);
+            break;
+        }
+        zs.stats.pool_bytes -= len;
+        zs.stats.compressed--;
+        if (e->dead || w != (int)len) {
+            slot_free((uint32_t)slot);
+            entry_free(i);
+        } else {
+            e->kind = ZE_FILE;
+            e->raw = 0;
+            e->u.slot = (uint32_t)slot;
+            zs.stats.file_pages++;
+            zs.stats.written_back++;
+        }
+        spin_unlock(&zs.lock);
+        kheap_free(data);
+        done++;
+    }
+    return done;
+}
+
+void zswap_stats(zswap_stats_t* out) {
+    if (!out) return;
+    spin_lock(&zs.lock);
+    *out = zs.stats;
+    spin_unlock(&zs.lock);
+    out->swapouts = __atomic_load_n(&zs.stats.swapouts, __ATOMIC_RELAXED);
+    out->swapins = __atomic_load_n(&zs.stats.swapins, __ATOMIC_RELAXED);
+}
+
+void zswap_dump(void) {
+    zswap_stats_t st;
+    zswap_stats(&st);
+    uint64_t ratio = st.pool_bytes ? st.compressed * PAGE_SIZE * 100 / st.pool_bytes : 0;
+    printf("[ZSwap] stored=%llu same=%llu pool=%llu pages in %lluK/%lluK (%llu.%02llux) file=%llu\n",
+        (unsigned long long)st.stored, (unsigned long long)st.same_filled, (unsigned long long)st.compressed,
+        (unsigned long long)(st.pool_bytes / 1024), (unsigned long long)(st.pool_limit / 1024),
+        (unsigned long long)(ratio / 100), (unsigned long long)(ratio % 100), (unsigned long long)st.file_pages);
+    printf("[ZSwap] stores=%llu loads=%llu written_back=%llu rejected=%llu swapouts=%llu swapins=%llu\n",
+        (unsigned long long)st.stores, (unsigned long long)st.loads, (unsigned long long)st.written_back,
+        (unsigned long long)st.rejected, (unsigned long long)st.swapouts, (unsigned long long)st.swapins);
+}
+
+// ---- anonymous pages (anon_lock protects state, pins and the LRU) ----
+
+static void anon_lru_add(anon_page_t* ap) {
+    ap->lru_prev = NULL;
+    ap->lru_next = anon_head;
+    if (anon_head) anon_head->lru_prev = ap;
+    else anon_tail = ap;
+    anon_head = ap;
+}
+
+static void anon_lru_del(anon_page_t* ap) {
+    if (ap->lru_prev) ap->lru_prev->lru_next = ap->lru_next;
+    else anon_head = ap->lru_next;
+    if (ap->lru_next) ap->lru_next->lru_prev = ap->lru_prev;
+    else anon_tail = ap->lru_prev;
+    ap->lru_prev = ap->lru_next = NULL;
+}
+
+// Returns with anon_lock held and the page not mid swap
+static void anon_lock_idle(anon_page_t* ap) {
+    for (;;) {
+        spin_lock(&anon_lock);
+        if (ap->state != ANON_BUSY) return;
+        spin_unlock(&anon_lock);
+        cpu_relax();
+    }
+}
+
+int anon_page_alloc(anon_page_t* ap) {
+    if (!ap) return -1;
+    memset(ap, 0, sizeof(*ap));
+    ap->page = page_alloc(PA_ZERO);
+    if (!ap->page) return -1;
+    ap->state = ANON_RESIDENT;
+    ap->last_ms = ktime_ms();
+    spin_lock(&anon_lock);
+    anon_lru_add(ap);
+    spin_unlock(&anon_lock);
+    return 0;
+}
+
+void* anon_page_map(anon_page_t* ap) {
+    if (!ap) return NULL;
+    anon_lock_idle(ap);
+    if (ap->state == ANON_RESIDENT) {
+        ap->pins++;
+        ap->last_ms = ktime_ms();
+        anon_lru_del(ap);
+        anon_lru_add(ap);
+        spin_unlock(&anon_lock);
+        return ap->page;
+    }
+    if (ap->state != ANON_SWAPPED) {
+        spin_unlock(&anon_lock);
+        return NULL;
+    }
+    ap->state = ANON_BUSY;
+    spin_unlock(&anon_lock);
+    void* page = page_alloc(0);
+    if (page && zswap_load(ap->entry, page) < 0) {
+        page_free(page);
+        page = NULL;
+    }
+    spin_lock(&anon_lock);
+    if (page) {
+        ap->page = page;
+        ap->entry = ZSWAP_NONE;
+        ap->state = ANON_RESIDENT;
+        ap->pins = 1;
+        ap->last_ms = ktime_ms();
+        anon_lru_add(ap);
+        __atomic_add_fetch(&zs.stats.swapins, 1, __ATOMIC_RELAXED);
+    } else {
+        ap->state = ANON_SWAPPED;
+    }
+    spin_unlock(&anon_lock);
+    return page;
+}
+
+void anon_page_unmap(anon_page_t* ap) {
+    if (!ap) return;
+    spin_lock(&anon_lock);
+    if (ap->pins) ap->pins--;
+    ap->last_ms = ktime_ms();
+    spin_unlock(&anon_lock);
+}
+
+void anon_page_free(anon_page_t* ap) {
+    if (!ap) return;
+    anon_lock_idle(ap);
+    void* page = NULL;
+    uint32_t entry = ZSWAP_NONE;
+    if (ap->state == ANON_RESIDENT) {
+        anon_lru_del(ap);
+        page = ap->page;
+    } else if (ap->state == ANON_SWAPPED) {
+        entry = ap->entry;
+    }
+    ap->state = ANON_FREE;
+    ap->page = NULL;
+    ap->entry = ZSWAP_NONE;
+    spin_unlock(&anon_lock);
+    page_free(page);
+    zswap_invalidate(entry);
+}
+
+unsigned zswap_reclaim(unsigned nr) {
+    if (!initialized && zswap_init(NULL, NULL) < 0) return 0;
+    uint32_t cold_ms = zs.params.cold_ms;
+    unsigned freed = 0, failures = 0;
+    while (freed < nr && failures < 4) {
+        uint64_t now = ktime_ms();
+        spin_lock(&anon_lock);
+        // Coldest first; once one is too recent, all the rest are too
+        anon_page_t* ap = anon_tail;
+        while (ap && now - ap->last_ms >= cold_ms && ap->pins) ap = ap->lru_prev;
+        if (!ap || now - ap->last_ms < cold_ms) {
+            spin_unlock(&anon_lock);
+            break;
+        }
+        anon_lru_del(ap);
+        ap->state = ANON_BUSY;
+        spin_unlock(&anon_lock);
+        uint32_t entry = zswap_store(ap->page);
+        void* page = NULL;
+        spin_lock(&anon_lock);
+        if (entry != ZSWAP_NONE) {
+            page = ap->page;
+            ap->page = NULL;
+            ap->entry = entry;
+            ap->state = ANON_SWAPPED;
+        } else {
+            // Keep it, and look at the others before it again
+            ap->state = ANON_RESIDENT;
+            ap->last_ms = now;
+            anon_lru_add(ap);
+            failures++;
+        }
+        spin_unlock(&anon_lock);
+        if (page) {
+            page_free(page);
+            __atomic_add_fetch(&zs.stats.swapouts, 1, __ATOMIC_RELAXED);
+            freed++;
+        }
+    }
+    return freed;
+}
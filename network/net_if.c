@@ -1,9 +1,12 @@
 #include "net_if.h"
+#include "net_proto.h"
 #include <stdio.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #pragma comment(lib, "ws2_32.lib")
 
+#define NET_IF_MAX_FRAME 1518 // Ethernet frame with a VLAN tag
+
 static SOCKET udp_sock = INVALID_SOCKET;
 static struct sockaddr_in dest_addr = {0};
 
@@ -18,6 +21,8 @@ void net_if_init(void) {
         printf("[NetIF] Failed to create UDP socket\n");
         return;
     }
+    u_long nonblocking = 1;
+    ioctlsocket(udp_sock, FIONBIO, &nonblocking); // net_if_poll must not wait
     dest_addr.sin_family = AF_INET;
     dest_addr.sin_port = htons(12345); // Demo port
     inet_pton(AF_INET, "127.0.0.1", &dest_addr.sin_addr);
@@ -47,4 +52,58 @@ int net_if_recv(void* buf, int maxlen) {
     }
     printf("[NetIF] Received %d bytes\n", recvd);
     return recvd;
-} 
\ No newline at end of file
+}
+
+int net_if_send_pkt(pktbuf_t* pb) {
+    if (!pb) return -1;
+    if (udp_sock == INVALID_SOCKET) { pktbuf_free(pb); return -1; }
+    // Scatter-gather: each segment goes out from where it already is
+    WSABUF bufs[PKTBUF_MAX_SEGS];
+    DWORD nbufs = 0, sent = 0;
+    for (pktbuf_t* s = pb; s; s = s->next) {
+        if (!s->len) continue;
+        if (nbufs == PKTBUF_MAX_SEGS) {
+            printf("[NetIF] Frame has more than %d segments, dropped\n", PKTBUF_MAX_SEGS);
+            pktbuf_free(pb);
+            return -1;
+        }
+        bufs[nbufs].buf = (char*)s->data;
+        bufs[nbufs].len = s->len;
+        nbufs++;
+    }
+    int rc = WSASendTo(udp_sock, bufs, nbufs, &sent, 0, (struct sockaddr*)&dest_addr, sizeof(dest_addr), NULL, NULL);
+    pktbuf_free(pb);
+    if (rc == SOCKET_ERROR) {
+        printf("[NetIF] Send error: %d\n", WSAGetLastError());
+        return -1;
+    }
+    return (int)sent;
+}
+
+pktbuf_t* net_if_recv_pkt(void) {
+    if (udp_sock == INVALID_SOCKET) return NULL;
+    pktbuf_t* pb = pktbuf_alloc(NET_IF_MAX_FRAME);
+    if (!pb) return NULL;
+    struct sockaddr_in from;
+    int fromlen = sizeof(from);
+    int recvd = recvfrom(udp_sock, (char*)pb->data, (int)pktbuf_tailroom(pb), 0, (struct sockaddr*)&from, &fromlen);
+    if (recvd == SOCKET_ERROR || recvd == 0) {
+        int err = WSAGetLastError();
+        if (recvd == SOCKET_ERROR && err != WSAEWOULDBLOCK) printf("[NetIF] Recv error: %d\n", err);
+        pktbuf_free(pb);
+        return NULL;
+    }
+    pktbuf_put(pb, (uint32_t)recvd);
+    return pb;
+}
+
+int net_if_poll(int budget) {
+    int n = 0;
+    while (n < budget) {
+        pktbuf_t* pb = net_if_recv_pkt();
+        if (!pb) break;
+        net_proto_process(pb);
+        n++;
+    }
+    return n;
+}
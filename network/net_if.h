@@ -1,6 +1,13 @@
 #ifndef NET_IF_H
 #define NET_IF_H
+#include "pktbuf.h"
 void net_if_init(void);
 int net_if_send(const void* data, int len);
 int net_if_recv(void* buf, int maxlen);
-#endif // NET_IF_H 
\ No newline at end of file
+// Sends the segments as one frame without flattening them; always consumes pb
+int net_if_send_pkt(pktbuf_t* pb);
+// One frame received straight into a pool buffer, or NULL when none is waiting
+pktbuf_t* net_if_recv_pkt(void);
+// Hands up to budget received frames to net_proto_process; returns the count
+int net_if_poll(int budget);
+#endif // NET_IF_H
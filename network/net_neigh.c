@@ -0,0 +1,489 @@
+#include "net_neigh.h"
+#include "net_proto.h"
+#include "../kernel64/include/ktime.h"
+#include "../kernel64/include/timer_wheel.h"
+#include "../kernel64/include/spinlock.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct neigh {
+    struct neigh* next;         // Hash chain; readers walk it without the lock
+    struct neigh* free_next;    // Kept apart from next so readers never follow it
+    uint32_t seq;               // Odd while a writer changes the key, state or mac
+    uint8_t family;
+    uint8_t state;
+    uint8_t probes;             // Solicitations sent in this state
+    uint8_t addr[16];
+    uint8_t mac[6];
+    uint64_t confirmed_ms;      // Last proof of reachability
+    uint64_t reachable_until;   // confirmed_ms plus a fresh random reachable time
+    uint64_t used_ms;           // Last packet sent through it
+    ktimer_t timer;             // Retransmit in INCOMPLETE and PROBE, wait in DELAY
+    pktbuf_queue_t pending;     // Packets waiting for resolution
+} neigh_t;
+
+// Entries are never freed, only reused, so a reader holding a stale pointer
+// still reads a neigh_t; the sequence count tells it whether what it read is
+// consistent. Chains end in an odd pointer holding their bucket number. A
+// reader whose entry was reused under it follows the new chain to its end,
+// finds another bucket's marker and starts over.
+#define NULLS(b) ((neigh_t*)(((uintptr_t)(b) << 1) | 1))
+#define IS_NULLS(p) ((uintptr_t)(p) & 1)
+#define NULLS_BUCKET(p) ((uint32_t)((uintptr_t)(p) >> 1))
+
+static neigh_t pool[NEIGH_MAX];
+static neigh_t* buckets[NEIGH_BUCKETS];
+static neigh_t* free_list;
+static uint32_t neigh_count;
+static spinlock_t neigh_lock;   // Writers only
+static const neigh_ops_t* family_ops[2];
+static uint64_t hash_seed;
+static uint64_t rng;
+static ktimer_t gc_timer;
+static neigh_stats_t stats;
+
+static const char* state_names[NEIGH_STATES] = {
+    "NONE", "INCOMPLETE", "REACHABLE", "STALE", "DELAY", "PROBE", "FAILED"
+};
+
+// Work found under the lock and done after it is dropped
+typedef struct {
+    int family;
+    uint8_t addr[16];
+    int solicit;
+    const uint8_t* probe_mac;   // Unicast probe target, NULL to broadcast
+    uint8_t mac[6];             // Where flush goes, or the probe target
+    pktbuf_t* flush;            // Resolved packets, linked by nextpkt
+} neigh_work_t;
+
+static int addr_len(int family) { return family == NEIGH_V6 ? 16 : 4; }
+static const neigh_ops_t* ops_for(int family) { return family_ops[family == NEIGH_V6]; }
+
+static uint32_t neigh_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (uint32_t)(rng >> 32);
+}
+
+static uint32_t neigh_hash(int family, const uint8_t* addr) {
+    uint64_t h = hash_seed ^ (uint64_t)family;
+    for (int i = 0; i < addr_len(family); i += 4) {
+        uint32_t w;
+        memcpy(&w, addr + i, 4);
+        h = (h ^ w) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    return (uint32_t)(h >> 32) & (NEIGH_BUCKETS - 1);
+}
+
+static int key_eq(const neigh_t* e, int family, const uint8_t* addr) {
+    return e->family == family && memcmp(e->addr, addr, (size_t)addr_len(family)) == 0;
+}
+
+static uint64_t confirmed(const neigh_t* e) { return __atomic_load_n(&e->confirmed_ms, __ATOMIC_RELAXED); }
+
+static void write_begin(neigh_t* e) {
+    __atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(neigh_t* e) {
+    __atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELEASE);
+}
+
+static void neigh_set(neigh_t* e, uint8_t state, const uint8_t* mac) {
+    write_begin(e);
+    e->state = state;
+    if (mac) memcpy(e->mac, mac, 6);
+    write_end(e);
+}
+
+// What a lock-free reader copies out of an entry
+typedef struct {
+    neigh_t* e;
+    uint8_t state;
+    uint8_t mac[6];
+    uint64_t confirmed_ms;
+    uint64_t reachable_until;
+} neigh_snap_t;
+
+static int neigh_find_rcu(int family, const uint8_t* addr, neigh_snap_t* out) {
+    uint32_t b = neigh_hash(family, addr);
+    for (;;) {
+        neigh_t* e = __atomic_load_n(&buckets[b], __ATOMIC_ACQUIRE);
+        while (!IS_NULLS(e)) {
+            uint32_t s = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+            if (s & 1) { cpu_relax(); continue; }
+            int hit = e->state != NEIGH_NONE && key_eq(e, family, addr);
+            if (hit) {
+                out->state = e->state;
+                memcpy(out->mac, e->mac, 6);
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != s) continue; // Changed while read
+            if (hit) {
+                out->e = e;
+                out->confirmed_ms = confirmed(e);
+                out->reachable_until = __atomic_load_n(&e->reachable_until, __ATOMIC_RELAXED);
+                return 1;
+            }
+            e = __atomic_load_n(&e->next, __ATOMIC_ACQUIRE);
+        }
+        if (NULLS_BUCKET(e) == b) return 0;
+        __atomic_fetch_add(&stats.restarts, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static neigh_t* neigh_find_locked(int family, const uint8_t* addr) {
+    for (neigh_t* e = buckets[neigh_hash(family, addr)]; !IS_NULLS(e); e = e->next) {
+        if (key_eq(e, family, addr)) return e;
+    }
+    return NULL;
+}
+
+static int reachable(const neigh_t* e, uint64_t now) { return now < __atomic_load_n(&e->reachable_until, __ATOMIC_RELAXED); }
+
+// Each confirmation draws its own reachable time, 0.5x..1.5x the base, so
+// neighbors confirmed together do not all go stale together (RFC 4861 6.3.2)
+static void neigh_confirmed(neigh_t* e, uint64_t now) {
+    __atomic_store_n(&e->confirmed_ms, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->reachable_until, now + NEIGH_REACHABLE_MS / 2 + neigh_rand() % NEIGH_REACHABLE_MS, __ATOMIC_RELAXED);
+}
+
+static void neigh_drop_pending(neigh_t* e) {
+    stats.queue_drops += e->pending.count;
+    pktbuf_queue_purge(&e->pending);
+}
+
+// Readers may still be on e; it keeps its next pointer until it is reused
+static void neigh_release(neigh_t* e) {
+    neigh_t** pp = &buckets[neigh_hash(e->family, e->addr)];
+    while (*pp != e) pp = &(*pp)->next;
+    __atomic_store_n(pp, e->next, __ATOMIC_RELEASE);
+    ktimer_del(&e->timer);
+    neigh_drop_pending(e);
+    neigh_set(e, NEIGH_NONE, NULL);
+    e->free_next = free_list;
+    free_list = e;
+    neigh_count--;
+}
+
+// Stale and failed entries give way to new neighbors, least recently used
+// first; entries in use or being resolved are kept
+static int neigh_reclaim(uint64_t now) {
+    neigh_t* victim = NULL;
+    for (int i = 0; i < NEIGH_MAX; ++i) {
+        neigh_t* e = &pool[i];
+        int idle = e->state == NEIGH_STALE || e->state == NEIGH_FAILED ||
+            (e->state == NEIGH_REACHABLE && !reachable(e, now));
+        if (idle && (!victim || e->used_ms < victim->used_ms)) victim = e;
+    }
+    if (!victim) return -1;
+    neigh_release(victim);
+    stats.evictions++;
+    return 0;
+}
+
+static neigh_t* neigh_create(int family, const uint8_t* addr, uint64_t now) {
+    if (!free_list && neigh_reclaim(now) < 0) return NULL;
+    neigh_t* e = free_list;
+    free_list = e->free_next;
+    write_begin(e);
+    e->family = (uint8_t)family;
+    memset(e->addr, 0, sizeof(e->addr));
+    memcpy(e->addr, addr, (size_t)addr_len(family));
+    memset(e->mac, 0, 6);
+    e->state = NEIGH_INCOMPLETE;
+    write_end(e);
+    e->probes = 0;
+    __atomic_store_n(&e->confirmed_ms, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->reachable_until, 0, __ATOMIC_RELAXED);
+    e->used_ms = now;
+    // Insert at the head: a reader already in this chain sees it again, never skips
+    uint32_t b = neigh_hash(family, addr);
+    __atomic_store_n(&e->next, buckets[b], __ATOMIC_RELAXED);
+    __atomic_store_n(&buckets[b], e, __ATOMIC_RELEASE);
+    neigh_count++;
+    stats.creates++;
+    if (!ktimer_pending(&gc_timer)) ktimer_add(&gc_timer, now + NEIGH_GC_INTERVAL_MS);
+    return e;
+}
+
+static void neigh_fail(neigh_t* e) {
+    ktimer_del(&e->timer);
+    neigh_set(e, NEIGH_FAILED, NULL);
+    neigh_drop_pending(e);
+    stats.failed++;
+}
+
+// Queues a solicitation, to the cached address when unicast
+static void neigh_solicit(neigh_t* e, neigh_work_t* w, int unicast, uint64_t now) {
+    w->solicit = 1;
+    if (unicast) {
+        memcpy(w->mac, e->mac, 6);
+        w->probe_mac = w->mac;
+    }
+    e->probes++;
+    stats.solicits++;
+    ktimer_add(&e->timer, now + NEIGH_RETRANS_MS);
+}
+
+static void neigh_work_init(neigh_work_t* w, int family, const uint8_t* addr) {
+    memset(w, 0, sizeof(*w));
+    w->family = family;
+    memcpy(w->addr, addr, (size_t)addr_len(family));
+}
+
+static void neigh_work_run(neigh_work_t* w) {
+    const neigh_ops_t* ops = ops_for(w->family);
+    if (w->solicit && ops && ops->solicit) ops->solicit(w->addr, w->probe_mac);
+    while (w->flush) {
+        pktbuf_t* pb = w->flush;
+        w->flush = pb->nextpkt;
+        pb->nextpkt = NULL;
+        if (ops) net_proto_ethernet_output(pb, w->mac, ops->ethertype);
+        else pktbuf_free(pb);
+    }
+}
+
+static void neigh_timer(ktimer_t* t, void* arg) {
+    (void)t;
+    neigh_t* e = (neigh_t*)arg;
+    uint64_t now = ktime_ms();
+    neigh_work_t w;
+    spin_lock(&neigh_lock);
+    neigh_work_init(&w, e->family, e->addr);
+    if (e->state == NEIGH_DELAY || e->state == NEIGH_PROBE) {
+        if (reachable(e, now)) {
+            // An upper layer confirmed it while we waited
+            neigh_set(e, NEIGH_REACHABLE, NULL);
+        } else if (e->state == NEIGH_DELAY) {
+            neigh_set(e, NEIGH_PROBE, NULL);
+            e->probes = 0;
+            neigh_solicit(e, &w, 1, now);
+        } else if (e->probes < NEIGH_MAX_PROBES) {
+            neigh_solicit(e, &w, 1, now);
+        } else {
+            neigh_fail(e);
+        }
+    } else if (e->state == NEIGH_INCOMPLETE) {
+        if (e->probes < NEIGH_MAX_PROBES) neigh_solicit(e, &w, 0, now);
+        else neigh_fail(e);
+    }
+    spin_unlock(&neigh_lock);
+    neigh_work_run(&w);
+}
+
+// Ages confirmations and frees what nobody uses, so idle neighbors never
+// pin the table
+static void neigh_gc(ktimer_t* t, void* arg) {
+    (void)t; (void)arg;
+    uint64_t now = ktime_ms();
+    spin_lock(&neigh_lock);
+    for (int i = 0; i < NEIGH_MAX; ++i) {
+        neigh_t* e = &pool[i];
+        if (e->state == NEIGH_REACHABLE && !reachable(e, now)) neigh_set(e, NEIGH_STALE, NULL);
+        if (e->state == NEIGH_FAILED || (e->state == NEIGH_STALE && now - e->used_ms >= NEIGH_GC_STALE_MS)) {
+            neigh_release(e);
+            stats.gc_frees++;
+        }
+    }
+    if (neigh_count) ktimer_add(&gc_timer, now + NEIGH_GC_INTERVAL_MS);
+    spin_unlock(&neigh_lock);
+}
+
+void net_neigh_init(void) {
+    spin_init(&neigh_lock);
+    for (int b = 0; b < NEIGH_BUCKETS; ++b) buckets[b] = NULLS(b);
+    free_list = NULL;
+    for (int i = NEIGH_MAX - 1; i >= 0; --i) {
+        neigh_t* e = &pool[i];
+        memset(e, 0, sizeof(*e));
+        e->next = NULLS(0);
+        pktbuf_queue_init(&e->pending, NEIGH_QUEUE_LEN);
+        ktimer_init(&e->timer, "neigh", neigh_timer, e);
+        e->free_next = free_list;
+        free_list = e;
+    }
+    neigh_count = 0;
+    memset(&stats, 0, sizeof(stats));
+    hash_seed = ktime_ns() * 0x9E3779B97F4A7C15ull ^ (uint64_t)(uintptr_t)pool;
+    rng = hash_seed | 1;
+    ktimer_init(&gc_timer, "neigh_gc", neigh_gc, NULL);
+    printf("[Neigh] Initialized: %d entries, %d buckets\n", NEIGH_MAX, NEIGH_BUCKETS);
+}
+
+void net_neigh_register(int family, const neigh_ops_t* ops) {
+    family_ops[family == NEIGH_V6] = ops;
+}
+
+static int neigh_output_slow(pktbuf_t* pb, int family, const uint8_t* addr, const neigh_ops_t* ops, uint64_t now) {
+    neigh_work_t w;
+    neigh_work_init(&w, family, addr);
+    spin_lock(&neigh_lock);
+    stats.lookups++;
+    neigh_t* e = neigh_find_locked(family, addr);
+    if (!e) e = neigh_create(family, addr, now);
+    if (!e) {
+        spin_unlock(&neigh_lock);
+        pktbuf_free(pb);
+        return -1;
+    }
+    e->used_ms = now;
+    if (e->state == NEIGH_REACHABLE && !reachable(e, now)) neigh_set(e, NEIGH_STALE, NULL);
+    if (e->state == NEIGH_FAILED) {
+        // Someone wants it again: start over
+        neigh_set(e, NEIGH_INCOMPLETE, NULL);
+        e->probes = 0;
+    }
+    if (e->state == NEIGH_STALE) {
+        // Send on the cached address, and probe only if nobody confirms it
+        neigh_set(e, NEIGH_DELAY, NULL);
+        e->probes = 0;
+        ktimer_add(&e->timer, now + NEIGH_DELAY_MS);
+    }
+    if (e->state == NEIGH_INCOMPLETE) {
+        if (pktbuf_queue_put(&e->pending, pb) < 0) {
+            // Full: the oldest packet makes room
+            pktbuf_free(pktbuf_queue_get(&e->pending));
+            stats.queue_drops++;
+            pktbuf_queue_put(&e->pending, pb);
+        }
+        stats.queued++;
+        pb = NULL;
+        if (!e->probes) neigh_solicit(e, &w, 0, now);
+    } else {
+        memcpy(w.mac, e->mac, 6);
+    }
+    spin_unlock(&neigh_lock);
+    neigh_work_run(&w);
+    return pb ? net_proto_ethernet_output(pb, w.mac, ops->ethertype) : 0;
+}
+
+int net_neigh_output(pktbuf_t* pb, int family, const uint8_t* addr) {
+    const neigh_ops_t* ops = ops_for(family);
+    if (!ops) { pktbuf_free(pb); return -1; }
+    uint64_t now = ktime_ms();
+    neigh_snap_t s;
+    if (neigh_find_rcu(family, addr, &s)) {
+        int usable = s.state == NEIGH_DELAY || s.state == NEIGH_PROBE ||
+            (s.state == NEIGH_REACHABLE && now < s.reachable_until);
+        if (usable) {
+            if (__atomic_load_n(&s.e->used_ms, __ATOMIC_RELAXED) != now) __atomic_store_n(&s.e->used_ms, now, __ATOMIC_RELAXED);
+            return net_proto_ethernet_output(pb, s.mac, ops->ethertype);
+        }
+    }
+    return neigh_output_slow(pb, family, addr, ops, now);
+}
+
+int net_neigh_lookup(int family, const uint8_t* addr, uint8_t* mac) {
+    neigh_snap_t s;
+    if (!neigh_find_rcu(family, addr, &s) || s.state == NEIGH_INCOMPLETE || s.state == NEIGH_FAILED) return -1;
+    if (mac) memcpy(mac, s.mac, 6);
+    return 0;
+}
+
+int net_neigh_update(int family, const uint8_t* addr, const uint8_t* mac, unsigned flags) {
+    uint64_t now = ktime_ms();
+    int solicited = (flags & NEIGH_F_SOLICITED) != 0;
+    neigh_work_t w;
+    neigh_work_init(&w, family, addr);
+    spin_lock(&neigh_lock);
+    neigh_t* e = neigh_find_locked(family, addr);
+    if (!e && (flags & NEIGH_F_CREATE)) e = neigh_create(family, addr, now);
+    if (!e) {
+        spin_unlock(&neigh_lock);
+        return -1;
+    }
+    int changed = memcmp(e->mac, mac, 6) != 0;
+    if (e->state == NEIGH_INCOMPLETE || e->state == NEIGH_FAILED) {
+        if (e->state == NEIGH_INCOMPLETE && e->probes) stats.resolved++;
+        ktimer_del(&e->timer);
+        if (solicited) neigh_confirmed(e, now);
+        neigh_set(e, solicited ? NEIGH_REACHABLE : NEIGH_STALE, mac);
+        memcpy(w.mac, mac, 6);
+        pktbuf_t** tail = &w.flush;
+        pktbuf_t* pb;
+        while ((pb = pktbuf_queue_get(&e->pending))) {
+            *tail = pb;
+            tail = &pb->nextpkt;
+        }
+    } else if (changed && !(flags & NEIGH_F_OVERRIDE)) {
+        // RFC 4861 7.2.5: keep the cached address, but stop trusting it
+        if (e->state == NEIGH_REACHABLE) neigh_set(e, NEIGH_STALE, NULL);
+    } else if (solicited) {
+        ktimer_del(&e->timer);
+        neigh_confirmed(e, now);
+        neigh_set(e, NEIGH_REACHABLE, mac);
+    } else if (changed) {
+        ktimer_del(&e->timer);
+        neigh_set(e, NEIGH_STALE, mac);
+    }
+    spin_unlock(&neigh_lock);
+    neigh_work_run(&w);
+    return 0;
+}
+
+void net_neigh_confirm(int family, const uint8_t* addr) {
+    uint64_t now = ktime_ms();
+    neigh_snap_t s;
+    // At most one locked write per neighbor per millisecond
+    if (!neigh_find_rcu(family, addr, &s) || s.confirmed_ms == now) return;
+    if (s.state == NEIGH_INCOMPLETE || s.state == NEIGH_FAILED) return;
+    spin_lock(&neigh_lock);
+    neigh_t* e = neigh_find_locked(family, addr);
+    if (e && e->state != NEIGH_INCOMPLETE && e->state != NEIGH_FAILED) neigh_confirmed(e, now);
+    spin_unlock(&neigh_lock);
+}
+
+void net_neigh_stats(neigh_stats_t* out) {
+    if (!out) return;
+    spin_lock(&neigh_lock);
+    *out = stats;
+    out->restarts = __atomic_load_n(&stats.restarts, __ATOMIC_RELAXED);
+    spin_unlock(&neigh_lock);
+}
+
+static void print_addr(int family, const uint8_t* a) {
+    if (family == NEIGH_V4) {
+        printf("%u.%u.%u.%u", a[0], a[1], a[2], a[3]);
+        return;
+    }
+    for (int i = 0; i < 16; i += 2) printf(i ? ":%x" : "%x", (unsigned)(a[i] << 8 | a[i + 1]));
+}
+
+void net_neigh_dump(void) {
+    uint32_t by_state[NEIGH_STATES] = { 0 };
+    uint32_t longest = 0;
+    uint64_t now = ktime_ms();
+    spin_lock(&neigh_lock);
+    for (int b = 0; b < NEIGH_BUCKETS; ++b) {
+        uint32_t len = 0;
+        for (neigh_t* e = buckets[b]; !IS_NULLS(e); e = e->next) len++;
+        if (len > longest) longest = len;
+    }
+    printf("[Neigh] %u/%d entries, longest chain %u\n", neigh_count, NEIGH_MAX, longest);
+    for (int i = 0; i < NEIGH_MAX; ++i) {
+        neigh_t* e = &pool[i];
+        if (e->state == NEIGH_NONE) continue;
+        by_state[e->state]++;
+        printf("[Neigh]   ");
+        print_addr(e->family, e->addr);
+        printf(" %02X:%02X:%02X:%02X:%02X:%02X %s used %llu ms ago, reachable %llu ms more, %u queued\n",
+            e->mac[0], e->mac[1], e->mac[2], e->mac[3], e->mac[4], e->mac[5], state_names[e->state],
+            (unsigned long long)(now - e->used_ms),
+            (unsigned long long)(e->reachable_until > now ? e->reachable_until - now : 0), e->pending.count);
+    }
+    printf("[Neigh] incomplete %u reachable %u stale %u delay %u probe %u failed %u\n",
+        by_state[NEIGH_INCOMPLETE], by_state[NEIGH_REACHABLE], by_state[NEIGH_STALE],
+        by_state[NEIGH_DELAY], by_state[NEIGH_PROBE], by_state[NEIGH_FAILED]);
+    printf("[Neigh] slow lookups %llu creates %llu evictions %llu gc %llu resolved %llu failed %llu solicits %llu\n",
+        (unsigned long long)stats.lookups, (unsigned long long)stats.creates, (unsigned long long)stats.evictions,
+        (unsigned long long)stats.gc_frees, (unsigned long long)stats.resolved, (unsigned long long)stats.failed,
+        (unsigned long long)stats.solicits);
+    printf("[Neigh] queued %llu queue drops %llu walk restarts %llu\n",
+        (unsigned long long)stats.queued, (unsigned long long)stats.queue_drops,
+        (unsigned long long)__atomic_load_n(&stats.restarts, __ATOMIC_RELAXED));
+    spin_unlock(&neigh_lock);
+}
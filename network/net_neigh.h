@@ -0,0 +1,82 @@
+#ifndef NET_NEIGH_H
+#define NET_NEIGH_H
+
+#include <stdint.h>
+#include "pktbuf.h"
+
+// Neighbor cache: link addresses for on-link IPv4 (ARP) and IPv6 (NDP)
+// next hops in one hashed table. Entries follow the RFC 4861 state machine:
+// INCOMPLETE while a solicitation is outstanding, REACHABLE once confirmed,
+// STALE when the confirmation has aged out, then DELAY and PROBE to re-check
+// a stale entry that is still in use. Packets sent to an unresolved neighbor
+// wait on the entry and go out when it resolves.
+//
+// Lookups take no lock, so the transmit path scales across CPUs: entries
+// come from a static pool and are never handed back to the allocator, chains
+// end in a marker naming their bucket, and each entry's fields are read under
+// a sequence count. Writers serialise on one spinlock. Timers run from the
+// main loop. Addresses are in network byte order: 4 bytes for IPv4, 16 for
+// IPv6.
+#define NEIGH_MAX 1024                  // Entries across both families
+#define NEIGH_BUCKETS 256
+#define NEIGH_QUEUE_LEN 16              // Packets held per unresolved neighbor
+#define NEIGH_RETRANS_MS 1000           // Between solicitations
+#define NEIGH_MAX_PROBES 3              // Solicitations before giving up
+#define NEIGH_REACHABLE_MS 30000        // Base; each confirmation draws 0.5x..1.5x of it
+#define NEIGH_DELAY_MS 5000             // Grace for upper layers before probing
+#define NEIGH_GC_INTERVAL_MS 5000
+#define NEIGH_GC_STALE_MS 60000         // Unused STALE entries are freed after this
+
+enum { NEIGH_V4 = 4, NEIGH_V6 = 6 };
+
+typedef enum {
+    NEIGH_NONE,                         // Free
+    NEIGH_INCOMPLETE,
+    NEIGH_REACHABLE,
+    NEIGH_STALE,
+    NEIGH_DELAY,
+    NEIGH_PROBE,
+    NEIGH_FAILED,
+    NEIGH_STATES
+} neigh_state_t;
+
+// Update flags
+#define NEIGH_F_CREATE 0x01             // Add the neighbor if it is not cached
+#define NEIGH_F_OVERRIDE 0x02           // A new link address replaces the cached one
+#define NEIGH_F_SOLICITED 0x04          // Answer to our solicitation: proves reachability
+
+// Per-family hooks. solicit sends a request for addr, to dst_mac when set
+// (unicast probe) or to the broadcast/multicast group otherwise.
+typedef struct neigh_ops {
+    uint16_t ethertype;
+    uint8_t addr_len;
+    void (*solicit)(const uint8_t* addr, const uint8_t* dst_mac);
+} neigh_ops_t;
+
+typedef struct neigh_stats {
+    uint64_t lookups;                   // Slow path only; fast hits are not counted
+    uint64_t creates, evictions, gc_frees;
+    uint64_t resolved, failed;
+    uint64_t solicits;
+    uint64_t queued, queue_drops;       // Packets held for resolution and dropped from the hold queue
+    uint64_t restarts;                  // Lock-free walks that ended in another bucket
+} neigh_stats_t;
+
+void net_neigh_init(void);
+void net_neigh_register(int family, const neigh_ops_t* ops);
+// Sends pb to the neighbor at addr in a frame of the family's EtherType.
+// Consumes pb. Returns the bytes handed to the interface, 0 while the packet
+// waits for resolution, or -1.
+int net_neigh_output(pktbuf_t* pb, int family, const uint8_t* addr);
+// Lock-free. 0 and the link address when the neighbor is usable, -1 otherwise
+int net_neigh_lookup(int family, const uint8_t* addr, uint8_t* mac);
+// A link address learned from the wire. -1 if the table is full or the
+// neighbor is not cached and NEIGH_F_CREATE is clear.
+int net_neigh_update(int family, const uint8_t* addr, const uint8_t* mac, unsigned flags);
+// Forward progress from an upper layer (e.g. new data ACKed): the neighbor
+// is reachable without probing it. Lock-free.
+void net_neigh_confirm(int family, const uint8_t* addr);
+void net_neigh_stats(neigh_stats_t* out);
+void net_neigh_dump(void);
+
+#endif // NET_NEIGH_H
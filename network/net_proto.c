@@ -1,120 +1,348 @@
 #include "net_proto.h"
+#include "net_if.h"
+#include "net_tcp.h"
+#include "net_neigh.h"
+#include "../kernel64/include/ktime.h"
+#include "../kernel64/include/timer_wheel.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
-#include <arpa/inet.h>
+
+static uint8_t local_mac[6];
+static uint32_t local_ip;   // Host order, 0 until configured
+static uint32_t local_mask; // 0: no subnet known, every destination is on-link
+static uint32_t local_gw;   // 0: no default route
+
+static uint16_t rd16(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static uint32_t rd32(const uint8_t* p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+static void wr16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void wr32(uint8_t* p, uint32_t v) { p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v; }
+
+void net_proto_set_local(const uint8_t* mac, uint32_t ip, uint32_t netmask, uint32_t gateway) {
+    if (mac) memcpy(local_mac, mac, 6);
+    local_ip = ip;
+    local_mask = netmask;
+    local_gw = gateway;
+}
+
+uint32_t net_proto_local_ip(void) { return local_ip; }
+
+static int is_loopback(uint32_t ip) { return (ip >> 24) == 127 || (local_ip && ip == local_ip); }
+
+// Protocol registration
+static void (*registered_process)(pktbuf_t*) = NULL;
+void net_proto_register(void (*process)(pktbuf_t*)) { registered_process = process; printf("[NetProto] Protocol registered.\n"); }
 
 // Ethernet frame handler (real)
 void net_proto_ethernet_init(void) { printf("[NetProto] Ethernet init.\n"); }
-void net_proto_ethernet_process(const void* data, int len) {
-    if (len < 14) return;
-    const uint8_t* d = (const uint8_t*)data;
-    uint16_t eth_type = (d[12]<<8)|d[13];
+void net_proto_ethernet_process(pktbuf_t* pb) {
+    const uint8_t* d = (const uint8_t*)pktbuf_pullup(pb, ETH_HLEN);
+    if (!d) { pktbuf_free(pb); return; }
+    uint16_t eth_type = rd16(d + 12);
     printf("[Ethernet] dst=%02X:%02X:%02X:%02X:%02X:%02X src=%02X:%02X:%02X:%02X:%02X:%02X type=0x%04X\n",
         d[0],d[1],d[2],d[3],d[4],d[5], d[6],d[7],d[8],d[9],d[10],d[11], eth_type);
     // Dispatch to next protocol
-    if (eth_type == 0x0800) net_proto_ipv4_process(d+14, len-14);
-    else if (eth_type == 0x0806) net_proto_arp_process(d+14, len-14);
+    if (eth_type == ETH_P_IP) { pktbuf_pull(pb, ETH_HLEN); net_proto_ipv4_process(pb); }
+    else if (eth_type == ETH_P_ARP) { pktbuf_pull(pb, ETH_HLEN); net_proto_arp_process(pb); }
+    else if (registered_process) registered_process(pb);
+    else pktbuf_free(pb);
+}
+
+int net_proto_ethernet_output(pktbuf_t* pb, const uint8_t* dst_mac, uint16_t type) {
+    pktbuf_t* h = pktbuf_push(pb, ETH_HLEN);
+    if (!h) { pktbuf_free(pb); return -1; }
+    memcpy(h->data, dst_mac, 6);
+    memcpy(h->data + 6, local_mac, 6);
+    wr16(h->data + 12, type);
+    return net_if_send_pkt(h);
+}
+
+// ARP (RFC 826). Resolved addresses live in the neighbor cache (net_neigh.c),
+// which sends requests through arp_solicit while it resolves an address.
+static const uint8_t eth_broadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static int arp_send(uint16_t op, const uint8_t* eth_dst, const uint8_t* tha, const uint8_t* tpa) {
+    pktbuf_t* pb = pktbuf_alloc(ARP_HLEN);
+    if (!pb) return -1;
+    uint8_t* d = (uint8_t*)pktbuf_put(pb, ARP_HLEN);
+    wr16(d, 1);             // Ethernet
+    wr16(d + 2, ETH_P_IP);
+    d[4] = 6; d[5] = 4;
+    wr16(d + 6, op);
+    memcpy(d + 8, local_mac, 6);
+    wr32(d + 14, local_ip);
+    if (tha) memcpy(d + 18, tha, 6);
+    else memset(d + 18, 0, 6);
+    memcpy(d + 24, tpa, 4);
+    return net_proto_ethernet_output(pb, eth_dst, ETH_P_ARP);
+}
+
+static void arp_solicit(const uint8_t* addr, const uint8_t* dst_mac) {
+    arp_send(ARP_OP_REQUEST, dst_mac ? dst_mac : eth_broadcast, dst_mac, addr);
 }
 
-// ARP state
-static struct { uint32_t ip; uint8_t mac[6]; } arp_table[32];
-static int arp_count = 0;
+static const neigh_ops_t arp_ops = { ETH_P_IP, 4, arp_solicit };
 
-void net_proto_arp_init(void) { printf("[NetProto] ARP init.\n"); }
-void net_proto_arp_process(const void* data, int len) {
-    if (len < 28) return;
-    const uint8_t* d = (const uint8_t*)data;
-    uint16_t op = (d[6]<<8)|d[7];
-    uint32_t sender_ip = ntohl(*(uint32_t*)&d[14]);
-    uint32_t target_ip = ntohl(*(uint32_t*)&d[24]);
+void net_proto_arp_init(void) {
+    net_neigh_register(NEIGH_V4, &arp_ops);
+    printf("[NetProto] ARP init.\n");
+}
+
+void net_proto_arp_process(pktbuf_t* pb) {
+    const uint8_t* d = (const uint8_t*)pktbuf_pullup(pb, ARP_HLEN);
+    if (!d || rd16(d) != 1 || rd16(d + 2) != ETH_P_IP || d[4] != 6 || d[5] != 4) { pktbuf_free(pb); return; }
+    uint16_t op = rd16(d + 6);
+    uint32_t sender_ip = rd32(d + 14);
+    uint32_t target_ip = rd32(d + 24);
     printf("[ARP] op=%u sender_ip=%u.%u.%u.%u target_ip=%u.%u.%u.%u\n",
         op, d[14],d[15],d[16],d[17], d[24],d[25],d[26],d[27]);
-    // Update ARP table
-    int found = 0;
-    for (int i = 0; i < arp_count; ++i) {
-        if (arp_table[i].ip == sender_ip) {
-            memcpy(arp_table[i].mac, d+8, 6);
-            found = 1; break;
-        }
-    }
-    if (!found && arp_count < 32) {
-        arp_table[arp_count].ip = sender_ip;
-        memcpy(arp_table[arp_count].mac, d+8, 6);
-        arp_count++;
+    // Merge the sender (RFC 826); only traffic for us may add a neighbor
+    int for_us = local_ip && target_ip == local_ip;
+    if (sender_ip && memcmp(d + 8, local_mac, 6) != 0) {
+        unsigned flags = NEIGH_F_OVERRIDE;
+        if (for_us) flags |= NEIGH_F_CREATE;
+        if (for_us && op == ARP_OP_REPLY) flags |= NEIGH_F_SOLICITED;
+        net_neigh_update(NEIGH_V4, d + 14, d + 8, flags);
     }
-    // Optionally, reply to ARP requests
+    if (for_us && op == ARP_OP_REQUEST) arp_send(ARP_OP_REPLY, d + 8, d + 8, d + 14);
+    pktbuf_free(pb);
 }
 
 // IPv4 state
+static uint16_t ip_id;
 void net_proto_ipv4_init(void) { printf("[NetProto] IPv4 init.\n"); }
-void net_proto_ipv4_process(const void* data, int len) {
-    if (len < 20) return;
-    const uint8_t* d = (const uint8_t*)data;
-    uint8_t ihl = d[0] & 0x0F;
+void net_proto_ipv4_process(pktbuf_t* pb) {
+    const uint8_t* d = (const uint8_t*)pktbuf_pullup(pb, IPV4_HLEN);
+    if (!d || (d[0] >> 4) != 4) { pktbuf_free(pb); return; }
+    uint32_t hdrlen = (uint32_t)(d[0] & 0x0F) * 4;
+    uint16_t total = rd16(d + 2);
+    if (hdrlen < IPV4_HLEN || total < hdrlen || total > pb->pkt_len || !(d = (const uint8_t*)pktbuf_pullup(pb, hdrlen))) {
+        pktbuf_free(pb);
+        return;
+    }
+    // No reassembly: fragments are dropped
+    if (pktbuf_csum_fold(pktbuf_csum(pb, 0, hdrlen, 0)) != 0 || (rd16(d + 6) & 0x3FFF)) {
+        pktbuf_free(pb);
+        return;
+    }
     uint8_t proto = d[9];
-    uint32_t src = ntohl(*(uint32_t*)&d[12]);
-    uint32_t dst = ntohl(*(uint32_t*)&d[16]);
+    pb->src_ip = rd32(d + 12);
+    pb->dst_ip = rd32(d + 16);
+    pb->proto = proto;
     printf("[IPv4] src=%u.%u.%u.%u dst=%u.%u.%u.%u proto=%u\n",
         d[12],d[13],d[14],d[15], d[16],d[17],d[18],d[19], proto);
-    int hdrlen = ihl*4;
-    if (proto == 6) net_proto_tcp_process(d+hdrlen, len-hdrlen);
-    else if (proto == 17) net_proto_udp_process(d+hdrlen, len-hdrlen);
+    pktbuf_trim(pb, total); // Drop link-layer padding
+    pktbuf_pull(pb, hdrlen);
+    if (proto == IP_PROTO_TCP) net_proto_tcp_process(pb);
+    else if (proto == IP_PROTO_UDP) net_proto_udp_process(pb);
+    else pktbuf_free(pb);
+}
+
+// Loopback is a queue drained from the timer wheel, like a receive
+// interrupt, so a sender never re-enters its own protocol code. It can also
+// stand in for a real path (net_proto_loopback_set): one-way delay, random
+// loss, and a bottleneck of fixed rate with a drop-tail queue.
+#define LOOPBACK_QUEUE 8192
+static pktbuf_queue_t lo_queue;
+static ktimer_t lo_timer;
+static struct {
+    uint32_t delay_ms, loss_ppm, rate_kbps, queue_bytes;
+    uint64_t tx_free_us;    // When the bottleneck has sent everything it holds
+    uint64_t rng;
+    uint64_t drops;
+} lo_link;
+
+static uint32_t lo_rand(void) {
+    lo_link.rng ^= lo_link.rng << 13;
+    lo_link.rng ^= lo_link.rng >> 7;
+    lo_link.rng ^= lo_link.rng << 17;
+    return (uint32_t)(lo_link.rng >> 32);
+}
+
+void net_proto_loopback_set(uint32_t delay_ms, uint32_t loss_ppm, uint32_t rate_kbps, uint32_t queue_bytes) {
+    lo_link.delay_ms = delay_ms;
+    lo_link.loss_ppm = loss_ppm;
+    lo_link.rate_kbps = rate_kbps;
+    lo_link.queue_bytes = queue_bytes;
+    lo_link.tx_free_us = 0;
+    if (!lo_link.rng) lo_link.rng = ktime_ns() | 1;
+    printf("[NetProto] Loopback link: %u ms delay, %u ppm loss, %u kbit/s, %u byte queue\n",
+        delay_ms, loss_ppm, rate_kbps, queue_bytes);
+}
+
+static void lo_arm(void) {
+    if (!lo_queue.head || ktimer_pending(&lo_timer)) return;
+    uint64_t due = (lo_queue.head->tstamp_us + 999) / 1000;
+    uint64_t soon = ktime_ms() + 1;
+    ktimer_add(&lo_timer, due > soon ? due : soon);
+}
+
+static void loopback_deliver(ktimer_t* t, void* arg) {
+    (void)t; (void)arg;
+    uint64_t now = ktime_us();
+    // Only what was queued before this run: replies go out on the next one
+    for (uint32_t n = lo_queue.count; n && lo_queue.head && lo_queue.head->tstamp_us <= now; --n) {
+        net_proto_ipv4_process(pktbuf_queue_get(&lo_queue));
+    }
+    lo_arm();
+}
+
+// Whether the emulated link drops it; otherwise stamps when it arrives
+static int loopback_lost(pktbuf_t* pb, uint32_t len) {
+    uint64_t now = ktime_us();
+    uint64_t due = now;
+    if (lo_link.loss_ppm && lo_rand() % 1000000 < lo_link.loss_ppm) return 1;
+    if (lo_link.rate_kbps) {
+        uint64_t start = lo_link.tx_free_us > now ? lo_link.tx_free_us : now;
+        uint64_t backlog = (start - now) * lo_link.rate_kbps / 8000;
+        if (lo_link.queue_bytes && backlog + len > lo_link.queue_bytes) return 1;
+        lo_link.tx_free_us = start + (uint64_t)len * 8000 / lo_link.rate_kbps;
+        due = lo_link.tx_free_us;
+    }
+    pb->tstamp_us = due + (uint64_t)lo_link.delay_ms * 1000;
+    return 0;
+}
+
+uint64_t net_proto_loopback_drops(void) { return lo_link.drops; }
+
+int net_proto_ipv4_output(pktbuf_t* pb, uint32_t src_ip, uint32_t dst_ip, uint8_t proto) {
+    uint32_t total = pb->pkt_len + IPV4_HLEN;
+    if (total > 0xFFFF) { pktbuf_free(pb); return -1; }
+    pktbuf_t* h = pktbuf_push(pb, IPV4_HLEN);
+    if (!h) { pktbuf_free(pb); return -1; }
+    uint8_t* d = h->data;
+    d[0] = 0x45; d[1] = 0;
+    wr16(d + 2, (uint16_t)total);
+    wr16(d + 4, ip_id++);
+    wr16(d + 6, 0x4000); // Don't fragment
+    d[8] = 64; d[9] = proto;
+    wr16(d + 10, 0);
+    wr32(d + 12, src_ip ? src_ip : local_ip);
+    wr32(d + 16, dst_ip);
+    wr16(d + 10, pktbuf_csum_fold(pktbuf_csum(h, 0, IPV4_HLEN, 0)));
+    // Loopback never touches the interface: the same buffer goes back up
+    // A drop on the emulated link still counts as sent
+    if (is_loopback(dst_ip)) {
+        if (loopback_lost(h, total) || pktbuf_queue_put(&lo_queue, h) < 0) {
+            lo_link.drops++;
+            pktbuf_free(h);
+        }
+        lo_arm();
+        return (int)total;
+    }
+    static const uint8_t broadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    int on_link = !local_mask || !((dst_ip ^ local_ip) & local_mask);
+    if (dst_ip == 0xFFFFFFFF || (on_link && local_mask && (dst_ip | local_mask) == 0xFFFFFFFF)) {
+        return net_proto_ethernet_output(h, broadcast, ETH_P_IP);
+    }
+    // Off-link destinations are resolved through the default gateway
+    uint32_t hop = dst_ip;
+    if (!on_link) {
+        if (!local_gw) { pktbuf_free(h); return -1; } // No route
+        hop = local_gw;
+    }
+    uint8_t next_hop[4];
+    wr32(next_hop, hop);
+    return net_neigh_output(h, NEIGH_V4, next_hop);
 }
 
 // UDP state
-void net_proto_udp_init(void) { printf("[NetProto] UDP init.\n"); }
-void net_proto_udp_process(const void* data, int len) {
-    if (len < 8) return;
-    const uint8_t* d = (const uint8_t*)data;
-    uint16_t src_port = (d[0]<<8)|d[1];
-    uint16_t dst_port = (d[2]<<8)|d[3];
-    uint16_t ulen = (d[4]<<8)|d[5];
-    printf("[UDP] src_port=%u dst_port=%u len=%u\n", src_port, dst_port, ulen);
-    // Optionally, pass payload to application layer
-}
-
-// TCP state machine (minimal, real)
-typedef struct {
-    uint32_t src_ip, dst_ip;
-    uint16_t src_port, dst_port;
-    uint32_t seq, ack;
-    uint8_t state;
-} tcp_conn_t;
-#define MAX_TCP_CONNS 32
-static tcp_conn_t tcp_conns[MAX_TCP_CONNS];
-static int tcp_conn_count = 0;
-
-void net_proto_tcp_init(void) { printf("[NetProto] TCP init.\n"); }
-void net_proto_tcp_process(const void* data, int len) {
-    if (len < 20) return;
-    const uint8_t* d = (const uint8_t*)data;
-    uint16_t src_port = (d[0]<<8)|d[1];
-    uint16_t dst_port = (d[2]<<8)|d[3];
-    uint32_t seq = ntohl(*(uint32_t*)&d[4]);
-    uint32_t ack = ntohl(*(uint32_t*)&d[8]);
-    uint8_t flags = d[13];
-    printf("[TCP] src_port=%u dst_port=%u seq=%u ack=%u flags=0x%02X\n", src_port, dst_port, seq, ack, flags);
-    // Minimal TCP state machine: track connections
-    int found = 0;
-    for (int i = 0; i < tcp_conn_count; ++i) {
-        if (tcp_conns[i].src_port == src_port && tcp_conns[i].dst_port == dst_port) {
-            tcp_conns[i].seq = seq; tcp_conns[i].ack = ack; found = 1; break;
+static struct {
+    uint16_t port;
+    net_udp_deliver_fn deliver;
+    void* arg;
+} udp_binds[NET_UDP_BINDS];
+static uint16_t udp_next_ephemeral = NET_EPHEMERAL_FIRST;
+
+static uint32_t pseudo_sum(uint32_t src, uint32_t dst, uint8_t proto, uint32_t len) {
+    return (src >> 16) + (src & 0xFFFF) + (dst >> 16) + (dst & 0xFFFF) + proto + len;
+}
+
+static int udp_bind_find(uint16_t port) {
+    for (int i = 0; i < NET_UDP_BINDS; ++i) {
+        if (udp_binds[i].deliver && udp_binds[i].port == port) return i;
+    }
+    return -1;
+}
+
+int net_proto_udp_bind(uint16_t port, net_udp_deliver_fn deliver, void* arg) {
+    if (!deliver) return -1;
+    for (int tries = 0; !port && tries < 65536 - NET_EPHEMERAL_FIRST; ++tries) {
+        uint16_t p = udp_next_ephemeral;
+        udp_next_ephemeral = p == 0xFFFF ? NET_EPHEMERAL_FIRST : p + 1;
+        if (udp_bind_find(p) < 0) port = p;
+    }
+    if (!port || udp_bind_find(port) >= 0) return -1;
+    for (int i = 0; i < NET_UDP_BINDS; ++i) {
+        if (!udp_binds[i].deliver) {
+            udp_binds[i].port = port;
+            udp_binds[i].deliver = deliver;
+            udp_binds[i].arg = arg;
+            return port;
         }
     }
-    if (!found && tcp_conn_count < MAX_TCP_CONNS) {
-        tcp_conns[tcp_conn_count++] = (tcp_conn_t){.src_port=src_port, .dst_port=dst_port, .seq=seq, .ack=ack, .state=0};
+    return -1;
+}
+
+void net_proto_udp_unbind(uint16_t port) {
+    int i = udp_bind_find(port);
+    if (i >= 0) udp_binds[i].deliver = NULL;
+}
+
+void net_proto_udp_init(void) { printf("[NetProto] UDP init.\n"); }
+void net_proto_udp_process(pktbuf_t* pb) {
+    const uint8_t* d = (const uint8_t*)pktbuf_pullup(pb, UDP_HLEN);
+    if (!d) { pktbuf_free(pb); return; }
+    uint16_t src_port = rd16(d);
+    uint16_t dst_port = rd16(d + 2);
+    uint16_t ulen = rd16(d + 4);
+    printf("[UDP] src_port=%u dst_port=%u len=%u\n", src_port, dst_port, ulen);
+    if (ulen < UDP_HLEN || ulen > pb->pkt_len) { pktbuf_free(pb); return; }
+    pktbuf_trim(pb, ulen);
+    if (rd16(d + 6) && pktbuf_csum_fold(pktbuf_csum(pb, 0, ulen, pseudo_sum(pb->src_ip, pb->dst_ip, IP_PROTO_UDP, ulen))) != 0) {
+        pktbuf_free(pb);
+        return;
     }
-    // Optionally, handle SYN/ACK/FIN flags and state transitions
+    // Pass payload to the socket bound to the port, in the buffer it arrived in
+    int i = udp_bind_find(dst_port);
+    if (i < 0) { pktbuf_free(pb); return; }
+    pb->src_port = src_port;
+    pb->dst_port = dst_port;
+    pktbuf_pull(pb, UDP_HLEN);
+    udp_binds[i].deliver(udp_binds[i].arg, pb);
 }
 
-// Protocol registration
-static void (*registered_process)(const void*, int) = NULL;
-void net_proto_register(void (*process)(const void*, int)) { registered_process = process; printf("[NetProto] Protocol registered.\n"); }
+int net_proto_udp_output(pktbuf_t* pb, uint16_t src_port, uint32_t dst_ip, uint16_t dst_port) {
+    uint32_t ulen = pb->pkt_len + UDP_HLEN;
+    if (ulen > 0xFFFF - IPV4_HLEN) { pktbuf_free(pb); return -1; }
+    pktbuf_t* h = pktbuf_push(pb, UDP_HLEN);
+    if (!h) { pktbuf_free(pb); return -1; }
+    uint8_t* d = h->data;
+    wr16(d, src_port);
+    wr16(d + 2, dst_port);
+    wr16(d + 4, (uint16_t)ulen);
+    wr16(d + 6, 0);
+    uint16_t sum = pktbuf_csum_fold(pktbuf_csum(h, 0, ulen, pseudo_sum(local_ip, dst_ip, IP_PROTO_UDP, ulen)));
+    wr16(d + 6, sum ? sum : 0xFFFF);
+    return net_proto_ipv4_output(h, local_ip, dst_ip, IP_PROTO_UDP);
+}
+
+// TCP lives in net_tcp.c
+void net_proto_tcp_init(void) { net_tcp_init(); }
+void net_proto_tcp_process(pktbuf_t* pb) { net_tcp_input(pb); }
 
 // Main protocol process entry
-void net_proto_process(const void* data, int len) {
-    net_proto_ethernet_process(data, len);
+void net_proto_process(pktbuf_t* pb) {
+    if (!pb) return;
+    net_proto_ethernet_process(pb);
 }
 
-void net_proto_init(void) { printf("[NetProto] Initialized.\n"); } 
\ No newline at end of file
+void net_proto_init(void) {
+    pktbuf_init();
+    net_neigh_init();
+    net_proto_arp_init();
+    pktbuf_queue_init(&lo_queue, LOOPBACK_QUEUE);
+    ktimer_init(&lo_timer, "loopback", loopback_deliver, NULL);
+    net_proto_tcp_init();
+    printf("[NetProto] Initialized.\n");
+}
@@ -1,11 +1,55 @@
 #ifndef NET_PROTO_H
 #define NET_PROTO_H
+#include <stdint.h>
+#include "pktbuf.h"
+
+#define ETH_HLEN 14
+#define ETH_P_IP 0x0800
+#define ETH_P_ARP 0x0806
+#define ARP_HLEN 28
+#define ARP_OP_REQUEST 1
+#define ARP_OP_REPLY 2
+#define IP_PROTO_TCP 6
+#define IP_PROTO_UDP 17
+#define IPV4_HLEN 20
+#define UDP_HLEN 8
+#define NET_UDP_BINDS 64
+#define NET_EPHEMERAL_FIRST 49152
+
+typedef void (*net_udp_deliver_fn)(void* arg, pktbuf_t* pb);
+
 void net_proto_init(void);
-void net_proto_process(const void* data, int len);
 void net_proto_ethernet_init(void);
 void net_proto_arp_init(void);
 void net_proto_ipv4_init(void);
 void net_proto_udp_init(void);
 void net_proto_tcp_init(void);
-void net_proto_register(void (*process)(const void*, int));
-#endif // NET_PROTO_H 
\ No newline at end of file
+// Receive path, driver to sockets. Each handler owns the packet it is given
+// and strips its header before passing it up.
+void net_proto_process(pktbuf_t* pb);
+void net_proto_ethernet_process(pktbuf_t* pb);
+void net_proto_arp_process(pktbuf_t* pb);
+void net_proto_ipv4_process(pktbuf_t* pb);
+void net_proto_udp_process(pktbuf_t* pb);
+void net_proto_tcp_process(pktbuf_t* pb);
+// Transmit path, sockets to driver. Each layer pushes its header into the
+// headroom and passes the packet down; the packet is always consumed.
+// Returns the bytes handed to the interface (0 while the next hop is being
+// resolved), or -1.
+int net_proto_udp_output(pktbuf_t* pb, uint16_t src_port, uint32_t dst_ip, uint16_t dst_port);
+int net_proto_ipv4_output(pktbuf_t* pb, uint32_t src_ip, uint32_t dst_ip, uint8_t proto); // src 0 = local
+int net_proto_ethernet_output(pktbuf_t* pb, const uint8_t* dst_mac, uint16_t type);
+// Source addresses and the route for transmit; IPs here are in host order.
+// A zero netmask treats every destination as on-link.
+void net_proto_set_local(const uint8_t* mac, uint32_t ip, uint32_t netmask, uint32_t gateway);
+uint32_t net_proto_local_ip(void);
+// UDP demux to the socket layer. Port 0 picks an ephemeral port. Returns the port, or -1
+int net_proto_udp_bind(uint16_t port, net_udp_deliver_fn deliver, void* arg);
+void net_proto_udp_unbind(uint16_t port);
+// Makes loopback behave like a path: one-way delay, random loss in parts per
+// million, and a bottleneck rate (0 = unlimited) with a drop-tail queue
+void net_proto_loopback_set(uint32_t delay_ms, uint32_t loss_ppm, uint32_t rate_kbps, uint32_t queue_bytes);
+uint64_t net_proto_loopback_drops(void);
+// Handler for EtherTypes the stack does not know
+void net_proto_register(void (*process)(pktbuf_t*));
+#endif // NET_PROTO_H
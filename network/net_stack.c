@@ -1,12 +1,17 @@
 #include "net_stack.h"
 #include "net_proto.h"
+#include "net_neigh.h"
+#include "net_if.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <stdint.h>
-#include <time.h>
+#include "../kernel64/include/ktime.h"
+#include "../kernel64/include/fiber.h"
+#include "../kernel64/include/slot_map.h"
+#include "../core/resource_manager/resource_group.h"
 #ifdef _WIN32
 #include <wlanapi.h>
 #pragma comment(lib, "wlanapi.lib")
@@ -17,10 +22,22 @@
 #include <fwpmu.h>
 #pragma comment(lib, "fwpuclnt.lib")
 
-#define MAX_SOCKETS 16
-static net_socket_t sockets[MAX_SOCKETS];
-static SOCKET sock_handles[MAX_SOCKETS] = {0};
-static int next_sock_id = 1;
+#define MAX_SOCKETS 4096
+#define DHCP_TIMEOUT_MS 4000
+#define DNS_TIMEOUT_MS 3000
+#define NET_RX_BUDGET 64     // Frames taken from the interface per tick
+#define NET_SOCK_RXQ 256     // Datagrams queued per socket
+#define NET_DEMO_PORT 12345
+// Open sockets, packed; socket ids are slot map handles
+typedef struct {
+    net_socket_t info;
+    SOCKET handle;
+    pktbuf_queue_t rxq;     // Datagrams delivered by the NeoNova stack
+} sock_entry_t;
+static sock_entry_t sockets[MAX_SOCKETS];
+static uint32_t sock_dense_slot[MAX_SOCKETS];
+static slot_entry_t sock_slots[MAX_SOCKETS];
+static slot_map_t sock_map;
 #define MAX_IFACES 4
 static net_if_t ifaces[MAX_IFACES];
 static int iface_count = 0;
@@ -48,11 +65,6 @@ typedef struct net_if {
     uint8_t ipv6_gateway[16];
 } net_if_t;
 
-// ARP table
-#define ARP_TABLE_SIZE 16
-static struct { uint32_t ip; uint8_t mac[6]; } arp_table[ARP_TABLE_SIZE];
-static int arp_count = 0;
-
 // Wi-Fi networks (stub)
 #define WIFI_MAX_NETWORKS 8
 static net_wifi_network_t wifi_networks[WIFI_MAX_NETWORKS] = {
@@ -144,109 +156,163 @@ int net_fw_list_rules(net_fw_rule_t* out, int max_count) {
 
 void net_stack_init(void) {
     printf("[NetStack] Initialized.\n");
-    memset(sockets, 0, sizeof(sockets));
+    slot_map_init(&sock_map, sockets, sizeof(sock_entry_t), sock_dense_slot, sock_slots, MAX_SOCKETS);
     memset(ifaces, 0, sizeof(ifaces));
     iface_count = 1;
     strcpy(ifaces[0].name, "eth0");
     ifaces[0].mac[0] = 0xDE; ifaces[0].mac[1] = 0xAD; ifaces[0].mac[2] = 0xBE; ifaces[0].mac[3] = 0xEF; ifaces[0].mac[4] = 0x00; ifaces[0].mac[5] = 0x01;
     ifaces[0].ip_addr = 0; ifaces[0].netmask = 0; ifaces[0].gateway = 0; ifaces[0].up = 0;
+    net_proto_init();
+    net_proto_set_local(ifaces[0].mac, ntohl(ifaces[0].ip_addr), ntohl(ifaces[0].netmask), ntohl(ifaces[0].gateway));
 }
 void net_stack_shutdown(void) { printf("[NetStack] Shutdown.\n"); }
-void net_stack_tick(void) {
+// Renewal waits on the network; run it in a fiber so the tick returns at once
+static void dhcp_renew_fiber(void* arg) {
+    net_dhcp_request((net_if_t*)arg);
+}
+// Lease timers count wall-clock seconds, however often the tick runs
+void net_stack_tick(uint64_t now_ms) {
+    static uint64_t last_ms = 0;
+    if (!last_ms) last_ms = now_ms;
+    int elapsed = (int)((now_ms - last_ms) / 1000);
+    last_ms += (uint64_t)elapsed * 1000;
     printf("[NetStack] Tick.\n");
     for (int i = 0; i < iface_count; ++i) {
-        if (ifaces[i].up && ifaces[i].dhcp_lease_time > 0) {
-            ifaces[i].dhcp_lease_timer--;
-            if (ifaces[i].dhcp_lease_timer == 10) {
-                printf("[NetStack] DHCP lease for %s expiring soon, renewing...\n", ifaces[i].name);
-                net_dhcp_request(&ifaces[i]);
-            } else if (ifaces[i].dhcp_lease_timer <= 0) {
+        if (ifaces[i].up && ifaces[i].dhcp_lease_time > 0 && elapsed > 0) {
+            int before = ifaces[i].dhcp_lease_timer;
+            ifaces[i].dhcp_lease_timer -= elapsed;
+            if (ifaces[i].dhcp_lease_timer <= 0) {
                 printf("[NetStack] DHCP lease for %s expired, interface down\n", ifaces[i].name);
                 ifaces[i].up = 0;
+            } else if (before > 10 && ifaces[i].dhcp_lease_timer <= 10) {
+                printf("[NetStack] DHCP lease for %s expiring soon, renewing...\n", ifaces[i].name);
+                if (!fiber_spawn(dhcp_renew_fiber, &ifaces[i])) net_dhcp_request(&ifaces[i]);
             }
         }
     }
-    // Simulate sending a packet down the stack
-    char data[] = "Hello, network!";
-    net_packet_t pkt = { .data = data, .len = strlen(data) };
-    printf("[NetStack] Sending packet: %s\n", (char*)pkt.data);
-    net_proto_process(pkt.data, (int)pkt.len);
+    // Received frames go up the stack in the buffers they landed in
+    net_if_poll(NET_RX_BUDGET);
+    // Simulate sending a packet down the stack (over loopback, so it comes back up)
+    static const char data[] = "Hello, network!";
+    pktbuf_t* pkt = pktbuf_alloc(sizeof(data) - 1);
+    if (!pkt) return;
+    memcpy(pktbuf_put(pkt, sizeof(data) - 1), data, sizeof(data) - 1);
+    printf("[NetStack] Sending packet: %s\n", data);
+    net_proto_udp_output(pkt, NET_DEMO_PORT, 0x7F000001, NET_DEMO_PORT);
+}
+// UDP payloads from the stack queue on the socket in the buffer they arrived in
+static void sock_deliver(void* arg, pktbuf_t* pb) {
+    sock_entry_t* e = (sock_entry_t*)slot_map_get(&sock_map, (int)(intptr_t)arg);
+    if (!e || pktbuf_queue_put(&e->rxq, pb) < 0) pktbuf_free(pb);
 }
 // Sockets
 int net_socket_open(net_sock_type_t type, uint32_t remote_addr, int remote_port) {
-    for (int i = 0; i < MAX_SOCKETS; ++i) {
-        if (sockets[i].id == 0) {
-            SOCKET s = INVALID_SOCKET;
-            if (type == NET_SOCK_TCP) {
-                s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-            } else {
-                s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-            }
-            if (s == INVALID_SOCKET) {
-                printf("[NetStack] Failed to create socket\n");
-                return -1;
-            }
-            struct sockaddr_in addr = {0};
-            addr.sin_family = AF_INET;
-            addr.sin_port = htons(remote_port);
-            addr.sin_addr.s_addr = remote_addr;
-            if (type == NET_SOCK_TCP) {
-                if (connect(s, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
-                    printf("[NetStack] TCP connect failed\n");
-                    closesocket(s);
-                    return -1;
-                }
-            }
-            sockets[i].id = next_sock_id++;
-            sockets[i].type = type;
-            sockets[i].remote_addr = remote_addr;
-            sockets[i].remote_port = remote_port;
-            sock_handles[i] = s;
-            printf("[NetStack] Opened %s socket %d to %u:%d\n", type == NET_SOCK_TCP ? "TCP" : "UDP", sockets[i].id, remote_addr, remote_port);
-            return sockets[i].id;
+    if (sock_map.count >= sock_map.capacity) return -1;
+    SOCKET s = INVALID_SOCKET;
+    if (type == NET_SOCK_TCP) {
+        s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    } else {
+        s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    }
+    if (s == INVALID_SOCKET) {
+        printf("[NetStack] Failed to create socket\n");
+        return -1;
+    }
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(remote_port);
+    addr.sin_addr.s_addr = remote_addr;
+    if (type == NET_SOCK_TCP) {
+        if (connect(s, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            printf("[NetStack] TCP connect failed\n");
+            closesocket(s);
+            return -1;
         }
     }
-    return -1;
+    sock_entry_t* e;
+    int id = slot_map_insert(&sock_map, (void**)&e);
+    if (id < 0) { closesocket(s); return -1; }
+    e->info.id = id;
+    e->info.type = type;
+    e->info.remote_addr = remote_addr;
+    e->info.remote_port = remote_port;
+    e->handle = s;
+    e->info.local_port = 0;
+    pktbuf_queue_init(&e->rxq, NET_SOCK_RXQ);
+    if (type == NET_SOCK_UDP) {
+        int port = net_proto_udp_bind(0, sock_deliver, (void*)(intptr_t)id);
+        if (port > 0) e->info.local_port = port;
+    }
+    printf("[NetStack] Opened %s socket %d to %u:%d\n", type == NET_SOCK_TCP ? "TCP" : "UDP", id, remote_addr, remote_port);
+    return id;
 }
 int net_socket_close(int sock_id) {
-    for (int i = 0; i < MAX_SOCKETS; ++i) {
-        if (sockets[i].id == sock_id) {
-            closesocket(sock_handles[i]);
-            sockets[i].id = 0;
-            sock_handles[i] = 0;
-            printf("[NetStack] Closed socket %d\n", sock_id);
-            return 0;
-        }
-    }
-    return -1;
+    sock_entry_t* e = (sock_entry_t*)slot_map_get(&sock_map, sock_id);
+    if (!e) return -1;
+    closesocket(e->handle);
+    if (e->info.local_port) net_proto_udp_unbind((uint16_t)e->info.local_port);
+    pktbuf_queue_purge(&e->rxq);
+    slot_map_remove(&sock_map, sock_id);
+    printf("[NetStack] Closed socket %d\n", sock_id);
+    return 0;
+}
+int net_socket_set_rgroup(int sock_id, int rgroup) {
+    sock_entry_t* e = (sock_entry_t*)slot_map_get(&sock_map, sock_id);
+    if (!e) return -1;
+    e->info.rgroup = rgroup;
+    return 0;
 }
+// Over the group's NET quota: nothing is sent this period (0, like a full buffer)
 int net_socket_send(int sock_id, const void* data, int len) {
-    for (int i = 0; i < MAX_SOCKETS; ++i) {
-        if (sockets[i].id == sock_id) {
-            int sent = send(sock_handles[i], (const char*)data, len, 0);
-            if (sent == SOCKET_ERROR) {
-                printf("[NetStack] Send error: %d\n", WSAGetLastError());
-                return -1;
-            }
-            printf("[NetStack] Sent %d bytes on socket %d\n", sent, sock_id);
-            return sent;
-        }
+    sock_entry_t* e = (sock_entry_t*)slot_map_get(&sock_map, sock_id);
+    if (!e) return -1;
+    if (rgroup_throttled(e->info.rgroup, RG_NET)) return 0;
+    int sent = send(e->handle, (const char*)data, len, 0);
+    if (sent == SOCKET_ERROR) {
+        printf("[NetStack] Send error: %d\n", WSAGetLastError());
+        return -1;
     }
-    return -1;
+    rgroup_charge(e->info.rgroup, RG_NET, (uint64_t)sent);
+    printf("[NetStack] Sent %d bytes on socket %d\n", sent, sock_id);
+    return sent;
 }
 int net_socket_recv(int sock_id, void* buf, int maxlen) {
-    for (int i = 0; i < MAX_SOCKETS; ++i) {
-        if (sockets[i].id == sock_id) {
-            int recvd = recv(sock_handles[i], (char*)buf, maxlen, 0);
-            if (recvd == SOCKET_ERROR) {
-                printf("[NetStack] Recv error: %d\n", WSAGetLastError());
-                return -1;
-            }
-            printf("[NetStack] Received %d bytes on socket %d\n", recvd, sock_id);
-            return recvd;
-        }
+    sock_entry_t* e = (sock_entry_t*)slot_map_get(&sock_map, sock_id);
+    if (!e) return -1;
+    // The only copy a stack datagram sees: into the caller's buffer
+    pktbuf_t* pb = pktbuf_queue_get(&e->rxq);
+    if (pb) {
+        int n = maxlen > 0 ? (int)pktbuf_copy_out(pb, 0, (uint32_t)maxlen, buf) : 0;
+        pktbuf_free(pb);
+        rgroup_charge(e->info.rgroup, RG_NET, (uint64_t)n);
+        return n;
     }
-    return -1;
+    int recvd = recv(e->handle, (char*)buf, maxlen, 0);
+    if (recvd == SOCKET_ERROR) {
+        printf("[NetStack] Recv error: %d\n", WSAGetLastError());
+        return -1;
+    }
+    if (recvd > 0) rgroup_charge(e->info.rgroup, RG_NET, (uint64_t)recvd);
+    printf("[NetStack] Received %d bytes on socket %d\n", recvd, sock_id);
+    return recvd;
+}
+int net_socket_send_pkt(int sock_id, pktbuf_t* pb) {
+    sock_entry_t* e = (sock_entry_t*)slot_map_get(&sock_map, sock_id);
+    if (!pb) return -1;
+    if (!e || e->info.type != NET_SOCK_UDP || !e->info.local_port) { pktbuf_free(pb); return -1; }
+    if (rgroup_throttled(e->info.rgroup, RG_NET)) { pktbuf_free(pb); return 0; }
+    uint32_t len = pb->pkt_len;
+    if (net_proto_udp_output(pb, (uint16_t)e->info.local_port, ntohl(e->info.remote_addr), (uint16_t)e->info.remote_port) < 0) return -1;
+    rgroup_charge(e->info.rgroup, RG_NET, len);
+    return (int)len;
+}
+int net_socket_recv_pkt(int sock_id, pktbuf_t** out) {
+    sock_entry_t* e = (sock_entry_t*)slot_map_get(&sock_map, sock_id);
+    if (!e || !out) return -1;
+    *out = pktbuf_queue_get(&e->rxq);
+    if (!*out) return 0;
+    rgroup_charge(e->info.rgroup, RG_NET, (*out)->pkt_len);
+    return (int)(*out)->pkt_len;
 }
 // DHCP
 int net_dhcp_request(net_if_t* iface) {
@@ -265,7 +331,7 @@ int net_dhcp_request(net_if_t* iface) {
     buf[1] = 1; // htype=Ethernet
     buf[2] = 6; // hlen=6
     buf[3] = 0; // hops
-    uint32_t xid = (uint32_t)time(NULL);
+    uint32_t xid = (uint32_t)ktime_ns(); // Sub-second bits differ between requests
     buf[4] = (xid>>24)&0xFF; buf[5] = (xid>>16)&0xFF; buf[6] = (xid>>8)&0xFF; buf[7] = xid&0xFF;
     buf[236] = 99; buf[237] = 130; buf[238] = 83; buf[239] = 99; // magic cookie
     int p = 240;
@@ -276,6 +342,10 @@ int net_dhcp_request(net_if_t* iface) {
     int sent = sendto(s, (const char*)buf, 548, 0, (struct sockaddr*)&dest, sizeof(dest));
     if (sent != 548) { printf("[DHCP] sendto failed\n"); closesocket(s); return -1; }
     struct sockaddr_in from; int fromlen = sizeof(from);
+    // In a fiber this parks until the socket is readable instead of blocking the loop
+    if (fiber_wait_fd((intptr_t)s, FIBER_POLLIN, DHCP_TIMEOUT_MS) <= 0) {
+        printf("[DHCP] No offer received\n"); closesocket(s); return -1;
+    }
     int recvd = recvfrom(s, (char*)buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
     if (recvd < 0) { printf("[DHCP] recvfrom failed\n"); closesocket(s); return -1; }
     // Parse DHCPOFFER
@@ -302,6 +372,9 @@ int net_dhcp_request(net_if_t* iface) {
     buf[p++] = 255;
     sent = sendto(s, (const char*)buf, 548, 0, (struct sockaddr*)&dest, sizeof(dest));
     if (sent != 548) { printf("[DHCP] sendto (REQUEST) failed\n"); closesocket(s); return -1; }
+    if (fiber_wait_fd((intptr_t)s, FIBER_POLLIN, DHCP_TIMEOUT_MS) <= 0) {
+        printf("[DHCP] No ACK received\n"); closesocket(s); return -1;
+    }
     recvd = recvfrom(s, (char*)buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
     closesocket(s);
     if (recvd < 0) { printf("[DHCP] recvfrom (ACK) failed\n"); return -1; }
@@ -322,6 +395,7 @@ int net_dhcp_request(net_if_t* iface) {
     iface->up = 1;
     iface->dhcp_lease_time = 3600;
     iface->dhcp_lease_timer = 3600;
+    if (iface == &ifaces[0]) net_proto_set_local(iface->mac, ntohl(yiaddr), ntohl(subnet), ntohl(router)); // The stack sources from eth0
     printf("[DHCP] Assigned IP: %u.%u.%u.%u\n", (yiaddr)&0xFF, (yiaddr>>8)&0xFF, (yiaddr>>16)&0xFF, (yiaddr>>24)&0xFF);
     printf("[DHCP] Subnet: %u.%u.%u.%u\n", (subnet)&0xFF, (subnet>>8)&0xFF, (subnet>>16)&0xFF, (subnet>>24)&0xFF);
     printf("[DHCP] Gateway: %u.%u.%u.%u\n", (router)&0xFF, (router>>8)&0xFF, (router>>16)&0xFF, (router>>24)&0xFF);
@@ -341,7 +415,7 @@ int net_dns_resolve(const char* hostname, uint32_t* out_addr) {
     inet_pton(AF_INET, "8.8.8.8", &dns_addr.sin_addr);
     // Build DNS query
     uint8_t buf[512] = {0};
-    uint16_t id = (uint16_t)time(NULL);
+    uint16_t id = (uint16_t)(ktime_ns() >> 10);
     buf[0] = id >> 8; buf[1] = id & 0xFF; // ID
     buf[2] = 0x01; buf[5] = 0x01; // Recursion desired, QDCOUNT=1
     // Encode hostname
@@ -365,6 +439,9 @@ int net_dns_resolve(const char* hostname, uint32_t* out_addr) {
         printf("[NetStack] DNS: sendto failed\n"); closesocket(s); return -1;
     }
     struct sockaddr_in from; int fromlen = sizeof(from);
+    if (fiber_wait_fd((intptr_t)s, FIBER_POLLIN, DNS_TIMEOUT_MS) <= 0) {
+        printf("[NetStack] DNS: timed out\n"); closesocket(s); return -1;
+    }
     int recvd = recvfrom(s, (char*)buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
     if (recvd < 0) {
         printf("[NetStack] DNS: recvfrom failed\n"); closesocket(s); return -1;
@@ -413,6 +490,7 @@ int net_if_configure(const char* name, uint32_t ip, uint32_t netmask, uint32_t g
             ifaces[i].ip_addr = ip;
             ifaces[i].netmask = netmask;
             ifaces[i].gateway = gw;
+            if (i == 0) net_proto_set_local(ifaces[0].mac, ntohl(ip), ntohl(netmask), ntohl(gw));
             printf("[NetStack] Interface %s configured\n", name);
             return 0;
         }
@@ -431,70 +509,43 @@ int net_if_configure_v6(const char* name, const uint8_t* addr, uint8_t prefix_le
     }
     return -1;
 }
+// ARP and NDP entries live in the neighbor cache shared with the protocol layer
 int net_arp_resolve(uint32_t ip, uint8_t* out_mac) {
-    for (int i = 0; i < arp_count; ++i) {
-        if (arp_table[i].ip == ip) {
-            memcpy(out_mac, arp_table[i].mac, 6);
-            printf("[NetStack] ARP resolve %u.%u.%u.%u -> %02X:%02X:%02X:%02X:%02X:%02X\n",
-                (ip>>24)&0xFF, (ip>>16)&0xFF, (ip>>8)&0xFF, ip&0xFF,
-                arp_table[i].mac[0], arp_table[i].mac[1], arp_table[i].mac[2], arp_table[i].mac[3], arp_table[i].mac[4], arp_table[i].mac[5]);
-            return 0;
-        }
+    uint8_t addr[4] = { (uint8_t)(ip >> 24), (uint8_t)(ip >> 16), (uint8_t)(ip >> 8), (uint8_t)ip };
+    if (net_neigh_lookup(NEIGH_V4, addr, out_mac) == 0) {
+        printf("[NetStack] ARP resolve %u.%u.%u.%u -> %02X:%02X:%02X:%02X:%02X:%02X\n",
+            (ip>>24)&0xFF, (ip>>16)&0xFF, (ip>>8)&0xFF, ip&0xFF,
+            out_mac[0], out_mac[1], out_mac[2], out_mac[3], out_mac[4], out_mac[5]);
+        return 0;
     }
     printf("[NetStack] ARP resolve miss for %u.%u.%u.%u\n", (ip>>24)&0xFF, (ip>>16)&0xFF, (ip>>8)&0xFF, ip&0xFF);
     return -1;
 }
 int net_arp_update(uint32_t ip, const uint8_t* mac) {
-    for (int i = 0; i < arp_count; ++i) {
-        if (arp_table[i].ip == ip) {
-            memcpy(arp_table[i].mac, mac, 6);
-            printf("[NetStack] ARP update %u.%u.%u.%u\n", (ip>>24)&0xFF, (ip>>16)&0xFF, (ip>>8)&0xFF, ip&0xFF);
-            return 0;
-        }
-    }
-    if (arp_count < ARP_TABLE_SIZE) {
-        arp_table[arp_count].ip = ip;
-        memcpy(arp_table[arp_count].mac, mac, 6);
-        arp_count++;
-        printf("[NetStack] ARP add %u.%u.%u.%u\n", (ip>>24)&0xFF, (ip>>16)&0xFF, (ip>>8)&0xFF, ip&0xFF);
-        return 0;
+    uint8_t addr[4] = { (uint8_t)(ip >> 24), (uint8_t)(ip >> 16), (uint8_t)(ip >> 8), (uint8_t)ip };
+    if (net_neigh_update(NEIGH_V4, addr, mac, NEIGH_F_CREATE | NEIGH_F_OVERRIDE) < 0) {
+        printf("[NetStack] ARP table full\n");
+        return -1;
     }
-    printf("[NetStack] ARP table full\n");
-    return -1;
+    printf("[NetStack] ARP update %u.%u.%u.%u\n", (ip>>24)&0xFF, (ip>>16)&0xFF, (ip>>8)&0xFF, ip&0xFF);
+    return 0;
 }
-// NDP table
-#define NDP_TABLE_SIZE 16
-static struct { uint8_t ipv6[16]; uint8_t mac[6]; } ndp_table[NDP_TABLE_SIZE];
-static int ndp_count = 0;
 int net_ndp_resolve(const uint8_t* ipv6_addr, uint8_t* out_mac) {
-    for (int i = 0; i < ndp_count; ++i) {
-        if (memcmp(ndp_table[i].ipv6, ipv6_addr, 16) == 0) {
-            memcpy(out_mac, ndp_table[i].mac, 6);
-            printf("[NetStack] NDP resolve -> %02X:%02X:%02X:%02X:%02X:%02X\n",
-                out_mac[0], out_mac[1], out_mac[2], out_mac[3], out_mac[4], out_mac[5]);
-            return 0;
-        }
+    if (net_neigh_lookup(NEIGH_V6, ipv6_addr, out_mac) == 0) {
+        printf("[NetStack] NDP resolve -> %02X:%02X:%02X:%02X:%02X:%02X\n",
+            out_mac[0], out_mac[1], out_mac[2], out_mac[3], out_mac[4], out_mac[5]);
+        return 0;
     }
     printf("[NetStack] NDP resolve miss\n");
     return -1;
 }
 int net_ndp_update(const uint8_t* ipv6_addr, const uint8_t* mac) {
-    for (int i = 0; i < ndp_count; ++i) {
-        if (memcmp(ndp_table[i].ipv6, ipv6_addr, 16) == 0) {
-            memcpy(ndp_table[i].mac, mac, 6);
-            printf("[NetStack] NDP update\n");
-            return 0;
-        }
-    }
-    if (ndp_count < NDP_TABLE_SIZE) {
-        memcpy(ndp_table[ndp_count].ipv6, ipv6_addr, 16);
-        memcpy(ndp_table[ndp_count].mac, mac, 6);
-        ndp_count++;
-        printf("[NetStack] NDP add\n");
-        return 0;
+    if (net_neigh_update(NEIGH_V6, ipv6_addr, mac, NEIGH_F_CREATE | NEIGH_F_OVERRIDE) < 0) {
+        printf("[NetStack] NDP table full\n");
+        return -1;
     }
-    printf("[NetStack] NDP table full\n");
-    return -1;
+    printf("[NetStack] NDP update\n");
+    return 0;
 }
 // Hotplug support
 int net_if_hotplug_add(const char* name, const uint8_t* mac) {
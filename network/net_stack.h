@@ -2,11 +2,7 @@
 #define NET_STACK_H
 #include <stddef.h>
 #include <stdint.h>
-// Generic network packet structure
-typedef struct net_packet {
-    void* data;
-    size_t len;
-} net_packet_t;
+#include "pktbuf.h" // Packets move through the stack as pktbuf_t chains
 // Socket types
 typedef enum { NET_SOCK_TCP, NET_SOCK_UDP } net_sock_type_t;
 typedef struct net_socket {
@@ -16,6 +12,7 @@ typedef struct net_socket {
     int remote_port;
     uint32_t remote_addr;
     int state;
+    int rgroup; // Resource group charged for traffic (0: root)
 } net_socket_t;
 // Network interface
 typedef struct net_if {
@@ -34,12 +31,18 @@ typedef struct net_if {
 // API
 void net_stack_init(void);
 void net_stack_shutdown(void);
-void net_stack_tick(void);
+void net_stack_tick(uint64_t now_ms);
 // Sockets
 int net_socket_open(net_sock_type_t type, uint32_t remote_addr, int remote_port);
 int net_socket_close(int sock_id);
 int net_socket_send(int sock_id, const void* data, int len);
 int net_socket_recv(int sock_id, void* buf, int maxlen);
+int net_socket_set_rgroup(int sock_id, int rgroup);
+// Zero-copy UDP through the NeoNova stack. send_pkt always consumes pb and
+// builds the headers in its headroom; recv_pkt hands over the buffer the
+// datagram arrived in (0 when none is queued).
+int net_socket_send_pkt(int sock_id, pktbuf_t* pb);
+int net_socket_recv_pkt(int sock_id, pktbuf_t** out);
 // DHCP
 int net_dhcp_request(net_if_t* iface);
 // DNS
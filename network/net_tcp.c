@@ -0,0 +1,1634 @@
+// TCP: connection tables, state machine, data transfer and loss recovery
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "net_tcp.h"
+#include "net_proto.h"
+#include "net_neigh.h"
+#include "../kernel64/include/slab.h"
+#include "../kernel64/include/kheap.h"
+#include "../kernel64/include/ktime.h"
+
+#define EPHEMERAL_RANGE (65536 - NET_EPHEMERAL_FIRST)
+#define COOKIE_BITS 24
+#define COOKIE_MASK ((1u << COOKIE_BITS) - 1)
+#define SYN_WINDOW (TCP_RCVBUF < 0xFFFF ? TCP_RCVBUF : 0xFFFF) // Windows on SYNs are never scaled
+
+// A parsed segment, addressed from our side
+typedef struct {
+    uint32_t laddr, raddr;
+    uint16_t lport, rport;
+    uint32_t seq, ack;
+    uint32_t len;                           // Payload bytes
+    uint16_t wnd;                           // As sent, unscaled
+    uint16_t mss;                           // 0 when the option is absent
+    uint8_t flags;
+    uint8_t wscale;                         // 0xFF when absent
+    uint8_t sack_perm;
+    uint8_t nsack;
+    uint32_t sack[TCP_SACK_BLOCKS][2];
+} tcp_in_t;
+
+static tcp_conn_t** conn_hash;
+static uint32_t hash_mask;
+static tcp_listener_t* listen_hash[TCP_LISTEN_BUCKETS];
+static kmem_cache_t* conn_cache;
+static kmem_cache_t* seg_cache;
+static uint64_t secret[6];                  // Key pairs: tuple hash and ISNs, then two for cookies
+static uint32_t ephemeral_next;
+static tcp_cc_ops_t* cc_list;
+static const tcp_cc_ops_t* cc_default;
+static tcp_stats_t stats;
+
+static const uint16_t cookie_mss[] = { 536, 1220, 1440, 1460 };
+
+static uint16_t rd16(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static uint32_t rd32(const uint8_t* p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+static void wr16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+static void wr32(uint8_t* p, uint32_t v) { p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v; }
+
+static uint32_t pseudo_sum(uint32_t src, uint32_t dst, uint32_t len) {
+    return (src >> 16) + (src & 0xFFFF) + (dst >> 16) + (dst & 0xFFFF) + IP_PROTO_TCP + len;
+}
+
+// SipHash-1-3 of two words: keyed, so bucket and ISN choice cannot be predicted
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define SIPROUND do { \
+    v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+    v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+} while (0)
+
+static uint64_t siphash_2u64(uint64_t a, uint64_t b, const uint64_t* key) {
+    uint64_t v0 = 0x736f6d6570736575ull ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dull ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ull ^ key[0];
+    uint64_t v3 = 0x7465646279746573ull ^ key[1];
+    uint64_t last = (uint64_t)16 << 56;
+    v3 ^= a; SIPROUND; v0 ^= a;
+    v3 ^= b; SIPROUND; v0 ^= b;
+    v3 ^= last; SIPROUND; v0 ^= last;
+    v2 ^= 0xFF;
+    SIPROUND; SIPROUND; SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+static uint64_t tuple_hash(uint32_t laddr, uint16_t lport, uint32_t raddr, uint16_t rport, uint32_t extra, const uint64_t* key) {
+    return siphash_2u64((uint64_t)laddr << 32 | raddr, (uint64_t)lport << 48 | (uint64_t)rport << 32 | extra, key);
+}
+
+static tcp_conn_t** bucket(uint32_t laddr, uint16_t lport, uint32_t raddr, uint16_t rport) {
+    return &conn_hash[tuple_hash(laddr, lport, raddr, rport, 0, secret) & hash_mask];
+}
+
+// RFC 6528: a clock that moves every 64 ns plus a keyed hash of the tuple
+static uint32_t new_isn(uint32_t laddr, uint16_t lport, uint32_t raddr, uint16_t rport) {
+    return (uint32_t)(ktime_ns() >> 6) + (uint32_t)tuple_hash(laddr, lport, raddr, rport, 1, secret);
+}
+
+int net_tcp_init(void) {
+    if (conn_hash) return 0;
+    if (pktbuf_init() < 0) return -1;
+    conn_cache = kmem_cache_create("tcp_conn", sizeof(tcp_conn_t), 0, NULL);
+    seg_cache = kmem_cache_create("tcp_seg", sizeof(tcp_seg_t), 0, NULL);
+    if (!conn_cache || !seg_cache) return -1;
+    int tag = kheap_tag("net");
+    uint32_t bits = TCP_HASH_BITS;
+    for (; bits >= TCP_HASH_MIN_BITS && !conn_hash; --bits) {
+        conn_hash = (tcp_conn_t**)kheap_zalloc(KHEAP_NORMAL, sizeof(tcp_conn_t*) << bits, tag);
+        if (conn_hash) hash_mask = (1u << bits) - 1;
+    }
+    if (!conn_hash) {
+        printf("[TCP] No memory for the connection hash\n");
+        return -1;
+    }
+    // No entropy source: the TSC at boot and where the stack landed
+    uint64_t seed = ktime_ns() ^ (uint64_t)(uintptr_t)&seed;
+    for (int i = 0; i < 6; ++i) {
+        seed += 0x9E3779B97F4A7C15ull;
+        uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        secret[i] = z ^ (z >> 31) ^ ktime_ns();
+    }
+    ephemeral_next = (uint32_t)secret[5];
+    stats.hash_buckets = hash_mask + 1;
+    net_tcp_cc_builtin_init();
+    printf("[TCP] Initialized (%u hash buckets, %s congestion control)\n", hash_mask + 1,
+        cc_default ? cc_default->name : "no");
+    return 0;
+}
+
+const char* net_tcp_state_name(int state) {
+    static const char* names[] = { "CLOSED", "LISTEN", "SYN_SENT", "SYN_RECEIVED", "ESTABLISHED", "FIN_WAIT_1",
+        "FIN_WAIT_2", "CLOSE_WAIT", "CLOSING", "LAST_ACK", "TIME_WAIT" };
+    return state >= 0 && state <= TCP_TIME_WAIT ? names[state] : "?";
+}
+
+tcp_conn_t* net_tcp_lookup(uint32_t laddr, uint16_t lport, uint32_t raddr, uint16_t rport) {
+    if (!conn_hash) return NULL;
+    for (tcp_conn_t* c = *bucket(laddr, lport, raddr, rport); c; c = c->hnext) {
+        if (c->lport == lport && c->rport == rport && c->laddr == laddr && c->raddr == raddr) return c;
+    }
+    return NULL;
+}
+
+static void hash_insert(tcp_conn_t* c) {
+    tcp_conn_t** head = bucket(c->laddr, c->lport, c->raddr, c->rport);
+    c->hnext = *head;
+    if (*head) (*head)->hpprev = &c->hnext;
+    *head = c;
+    c->hpprev = head;
+    stats.conns++;
+}
+
+static void hash_remove(tcp_conn_t* c) {
+    if (!c->hpprev) return;
+    *c->hpprev = c->hnext;
+    if (c->hnext) c->hnext->hpprev = c->hpprev;
+    c->hnext = NULL;
+    c->hpprev = NULL;
+    stats.conns--;
+}
+
+// Listen table
+
+static tcp_listener_t** listen_bucket(uint16_t lport) {
+    return &listen_hash[(uint16_t)(lport * 0x9E37u) >> 10 & (TCP_LISTEN_BUCKETS - 1)];
+}
+
+// A listener on the exact address wins over one on any address
+static tcp_listener_t* listen_lookup(uint32_t laddr, uint16_t lport) {
+    tcp_listener_t* any = NULL;
+    for (tcp_listener_t* l = *listen_bucket(lport); l; l = l->next) {
+        if (l->lport != lport) continue;
+        if (l->laddr == laddr) return l;
+        if (!l->laddr) any = l;
+    }
+    return any;
+}
+
+// Congestion control modules
+
+int net_tcp_cc_register(tcp_cc_ops_t* ops) {
+    if (!ops || !ops->name || (!ops->cong_control && (!ops->ssthresh || !ops->cong_avoid))) return -1;
+    if (net_tcp_cc_find(ops->name)) return -1;
+    ops->next = cc_list;
+    cc_list = ops;
+    if (!cc_default) cc_default = ops;
+    return 0;
+}
+
+const tcp_cc_ops_t* net_tcp_cc_find(const char* name) {
+    for (tcp_cc_ops_t* ops = cc_list; ops && name; ops = ops->next) {
+        if (!strncmp(ops->name, name, TCP_CC_NAME_MAX)) return ops;
+    }
+    return NULL;
+}
+
+int net_tcp_cc_set_default(const char* name) {
+    const tcp_cc_ops_t* ops = net_tcp_cc_find(name);
+    if (!ops) return -1;
+    cc_default = ops;
+    return 0;
+}
+
+static void cc_start(tcp_conn_t* c) {
+    memset(c->cc_priv, 0, sizeof(c->cc_priv));
+    c->cwnd_cnt = 0;
+    c->pacing_rate = 0;
+    if (c->cc && c->cc->init) c->cc->init(c);
+}
+
+int net_tcp_set_cc(tcp_conn_t* c, const char* name) {
+    const tcp_cc_ops_t* ops = net_tcp_cc_find(name);
+    if (!c || !ops) return -1;
+    c->cc = ops;
+    if (c->state >= TCP_ESTABLISHED) cc_start(c);
+    return 0;
+}
+
+uint32_t net_tcp_flight_size(const tcp_conn_t* c) { return c->snd_nxt - c->snd_una; }
+
+// RFC 3465: at most two segments of growth per ACK in slow start
+uint32_t net_tcp_slow_start(tcp_conn_t* c, uint32_t acked) {
+    uint32_t inc = acked < 2u * c->mss ? acked : 2u * c->mss;
+    uint32_t cwnd = c->cwnd + inc;
+    if (cwnd > c->ssthresh) cwnd = c->ssthresh;
+    uint32_t used = cwnd > c->cwnd ? cwnd - c->cwnd : 0;
+    c->cwnd = cwnd;
+    return cwnd < c->ssthresh ? 0 : acked - used;
+}
+
+void net_tcp_cong_avoid_ai(tcp_conn_t* c, uint32_t w, uint32_t acked) {
+    if (w < c->mss) w = c->mss;
+    c->cwnd_cnt += acked;
+    while (c->cwnd_cnt >= w) {
+        c->cwnd_cnt -= w;
+        c->cwnd += c->mss;
+    }
+}
+
+// Segments
+
+static tcp_seg_t* seg_new(pktbuf_t* data, uint32_t seq, uint32_t len, uint16_t flags) {
+    tcp_seg_t* s = (tcp_seg_t*)kmem_cache_zalloc(seg_cache);
+    if (!s) return NULL;
+    s->data = data;
+    s->seq = seq;
+    s->len = len;
+    s->flags = flags;
+    return s;
+}
+
+static void seg_free(tcp_seg_t* s) {
+    if (s->data) pktbuf_free(s->data);
+    kmem_cache_free(seg_cache, s);
+}
+
+static void seg_list_free(tcp_seg_t* s) {
+    while (s) {
+        tcp_seg_t* next = s->next;
+        seg_free(s);
+        s = next;
+    }
+}
+
+static uint32_t seg_data_len(const tcp_seg_t* s) { return s->len - (s->flags & TCP_FIN ? 1 : 0); }
+
+// Receive window
+
+static uint8_t pick_wscale(void) {
+    uint8_t ws = 0;
+    while (ws < TCP_WSCALE_MAX && ((uint32_t)TCP_RCVBUF >> ws) > 0xFFFF) ws++;
+    return ws;
+}
+
+// Moves the advertised right edge forward when the buffer has room, by at
+// least an MSS (receiver SWS avoidance, RFC 1122), and never back
+static uint16_t rcv_window(tcp_conn_t* c) {
+    uint32_t used = c->rcv_queued + c->ooo_bytes;
+    uint32_t space = used < TCP_RCVBUF ? TCP_RCVBUF - used : 0;
+    if (space > (uint32_t)0xFFFF << c->rcv_wscale) space = (uint32_t)0xFFFF << c->rcv_wscale;
+    space &= ~((1u << c->rcv_wscale) - 1);
+    uint32_t cur = SEQ_GT(c->rcv_adv, c->rcv_nxt) ? c->rcv_adv - c->rcv_nxt : 0;
+    if (space > cur && space - cur >= c->mss) {
+        c->rcv_adv = c->rcv_nxt + space;
+        cur = space;
+    }
+    return (uint16_t)(cur >> c->rcv_wscale);
+}
+
+// Output
+
+static int tcp_xmit(uint32_t laddr, uint16_t lport, uint32_t raddr, uint16_t rport, uint32_t seq, uint32_t ack,
+    uint8_t flags, uint16_t wnd, const uint8_t* opts, uint32_t optlen, pktbuf_t* data) {
+    uint32_t hlen = TCP_HLEN + optlen;
+    pktbuf_t* pb = data ? data : pktbuf_alloc(0);
+    if (!pb) return -1;
+    uint32_t len = pb->pkt_len + hlen;
+    pktbuf_t* h = pktbuf_push(pb, hlen);
+    if (!h) { pktbuf_free(pb); return -1; }
+    uint8_t* d = h->data;
+    wr16(d, lport);
+    wr16(d + 2, rport);
+    wr32(d + 4, seq);
+    wr32(d + 8, ack);
+    d[12] = (uint8_t)(hlen / 4) << 4;
+    d[13] = flags;
+    wr16(d + 14, wnd);
+    wr16(d + 16, 0);
+    wr16(d + 18, 0);
+    if (optlen) memcpy(d + TCP_HLEN, opts, optlen);
+    wr16(d + 16, pktbuf_csum_fold(pktbuf_csum(h, 0, len, pseudo_sum(laddr, raddr, len))));
+    stats.segs_out++;
+    return net_proto_ipv4_output(h, laddr, raddr, IP_PROTO_TCP);
+}
+
+// MSS, then window scale and SACK-permitted when offered (on a SYN-ACK, only
+// when the peer offered them first)
+static uint32_t syn_options(const tcp_conn_t* c, uint8_t* o) {
+    uint32_t n = 0;
+    o[n++] = 2; o[n++] = 4;
+    wr16(o + n, TCP_MSS_LOCAL);
+    n += 2;
+    if (c->ws_ok) {
+        o[n++] = 1;
+        o[n++] = 3; o[n++] = 3; o[n++] = c->rcv_wscale;
+    }
+    if (c->sack_ok) {
+        o[n++] = 1; o[n++] = 1;
+        o[n++] = 4; o[n++] = 2;
+    }
+    return n;
+}
+
+// RFC 2018: one block per run of out-of-order data, the run holding the
+// newest segment first
+static uint32_t sack_options(const tcp_conn_t* c, uint8_t* o) {
+    uint32_t blocks[TCP_SACK_BLOCKS][2];
+    uint32_t n = 1;
+    int have_first = 0;
+    for (const tcp_seg_t* s = c->ooo_head; s;) {
+        uint32_t start = s->seq, end = s->seq + s->len;
+        int newest = 0;
+        for (; s && SEQ_LEQ(s->seq, end); s = s->next) {
+            if (SEQ_GT(s->seq + s->len, end)) end = s->seq + s->len;
+            if (s->seq == c->ooo_last) newest = 1;
+        }
+        uint32_t slot = newest && !have_first ? 0 : n;
+        if (slot >= TCP_SACK_BLOCKS) continue;
+        blocks[slot][0] = start;
+        blocks[slot][1] = end;
+        if (slot) n++;
+        else have_first = 1;
+    }
+    uint32_t* first = have_first ? blocks[0] : blocks[1];
+    uint32_t count = have_first ? n : n - 1;
+    if (!count) return 0;
+    o[0] = 1; o[1] = 1;
+    o[2] = 5; o[3] = (uint8_t)(2 + 8 * count);
+    for (uint32_t i = 0; i < count; ++i) {
+        wr32(o + 4 + 8 * i, first[2 * i]);
+        wr32(o + 8 + 8 * i, first[2 * i + 1]);
+    }
+    return 4 + 8 * count;
+}
+
+static int conn_xmit(tcp_conn_t* c, uint32_t seq, uint8_t flags, pktbuf_t* data) {
+    uint8_t opts[TCP_MAX_OPTLEN];
+    uint32_t optlen;
+    uint16_t wnd;
+    if (flags & TCP_SYN) {
+        optlen = syn_options(c, opts);
+        wnd = SYN_WINDOW;
+    } else {
+        optlen = c->sack_ok && c->ooo_head ? sack_options(c, opts) : 0;
+        wnd = rcv_window(c);
+    }
+    if (flags & TCP_ACK) {
+        c->rcv_unacked = 0;
+        ktimer_del(&c->dack_timer);
+    }
+    return tcp_xmit(c->laddr, c->lport, c->raddr, c->rport, seq, c->rcv_nxt, flags, wnd, opts, optlen, data);
+}
+
+static void tcp_send_ack(tcp_conn_t* c) { conn_xmit(c, c->snd_nxt, TCP_ACK, NULL); }
+
+// RFC 9293 3.10.7.1: the reset takes its numbers from the segment it answers
+static void tcp_send_rst(const tcp_in_t* s) {
+    if (s->flags & TCP_RST) return;
+    stats.resets_sent++;
+    if (s->flags & TCP_ACK) {
+        tcp_xmit(s->laddr, s->lport, s->raddr, s->rport, s->ack, 0, TCP_RST, 0, NULL, 0, NULL);
+    } else {
+        uint32_t ack = s->seq + s->len + !!(s->flags & TCP_SYN) + !!(s->flags & TCP_FIN);
+        tcp_xmit(s->laddr, s->lport, s->raddr, s->rport, 0, ack, TCP_RST | TCP_ACK, 0, NULL, 0, NULL);
+    }
+}
+
+// Timers and lifetime
+
+static void tcp_rtx_timeout(ktimer_t* t, void* arg);
+static void tcp_ka_timeout(ktimer_t* t, void* arg);
+static void tcp_dack_timeout(ktimer_t* t, void* arg);
+static void tcp_pace_timeout(ktimer_t* t, void* arg);
+static void tcp_output(tcp_conn_t* c);
+
+static void arm_rtx(tcp_conn_t* c) { ktimer_add(&c->rtx_timer, ktime_ms() + c->rto_ms); }
+
+static void backoff(tcp_conn_t* c) { c->rto_ms = c->rto_ms * 2 > TCP_RTO_MAX_MS ? TCP_RTO_MAX_MS : c->rto_ms * 2; }
+
+static void arm_keepalive(tcp_conn_t* c) {
+    if (c->ka_idle_ms && c->state == TCP_ESTABLISHED) ktimer_add(&c->ka_timer, c->last_rx_ms + c->ka_idle_ms);
+    else ktimer_del(&c->ka_timer);
+}
+
+static void notify(tcp_conn_t* c, int events) {
+    if (c->owned && c->notify) c->notify(c, c->user, events);
+}
+
+static tcp_conn_t* conn_new(uint32_t laddr, uint16_t lport, uint32_t raddr, uint16_t rport, uint8_t state) {
+    tcp_conn_t* c = (tcp_conn_t*)kmem_cache_zalloc(conn_cache);
+    if (!c) return NULL;
+    c->laddr = laddr;
+    c->lport = lport;
+    c->raddr = raddr;
+    c->rport = rport;
+    c->state = state;
+    c->mss = TCP_MSS_DEFAULT;
+    c->rcv_wscale = pick_wscale();
+    c->rto_ms = TCP_RTO_INIT_MS;
+    c->ka_idle_ms = TCP_KEEPALIVE_IDLE_MS;
+    c->last_rx_ms = ktime_ms();
+    c->cc = cc_default;
+    ktimer_init(&c->rtx_timer, "tcp_rtx", tcp_rtx_timeout, c);
+    ktimer_init(&c->ka_timer, "tcp_keepalive", tcp_ka_timeout, c);
+    ktimer_init(&c->dack_timer, "tcp_delack", tcp_dack_timeout, c);
+    ktimer_init(&c->pace_timer, "tcp_pace", tcp_pace_timeout, c);
+    pktbuf_queue_init(&c->rcvq, 0);
+    hash_insert(c);
+    return c;
+}
+
+static void accept_unlink(tcp_conn_t* c) {
+    tcp_listener_t* l = c->parent;
+    tcp_conn_t* prev = NULL;
+    for (tcp_conn_t* it = l->accept_head; it; prev = it, it = it->accept_next) {
+        if (it != c) continue;
+        if (prev) prev->accept_next = c->accept_next;
+        else l->accept_head = c->accept_next;
+        if (l->accept_tail == c) l->accept_tail = prev;
+        l->accept_queued--;
+        break;
+    }
+    c->accept_next = NULL;
+}
+
+// Drops everything but the object itself and what the reader has yet to take
+static void conn_release(tcp_conn_t* c) {
+    ktimer_del(&c->rtx_timer);
+    ktimer_del(&c->ka_timer);
+    ktimer_del(&c->dack_timer);
+    ktimer_del(&c->pace_timer);
+    hash_remove(c);
+    seg_list_free(c->snd_head);
+    c->snd_head = c->snd_tail = c->snd_next = NULL;
+    c->snd_queued = 0;
+    seg_list_free(c->ooo_head);
+    c->ooo_head = NULL;
+    c->ooo_bytes = 0;
+}
+
+static void conn_free(tcp_conn_t* c) {
+    conn_release(c);
+    if (c->parent) {
+        if (c->state == TCP_SYN_RECEIVED) {
+            c->parent->syn_queued--;
+            stats.half_open--;
+        } else {
+            accept_unlink(c);
+        }
+    }
+    pktbuf_queue_purge(&c->rcvq);
+    kmem_cache_free(conn_cache, c);
+}
+
+// Reached CLOSED: orphans go away, owned connections stay for the user to close
+static void conn_done(tcp_conn_t* c, int err) {
+    if (!c->owned) {
+        conn_free(c);
+        return;
+    }
+    conn_release(c);
+    c->state = TCP_CLOSED;
+    c->error = (uint8_t)err;
+    if (err != TCP_ERR_NONE) {
+        pktbuf_queue_purge(&c->rcvq);
+        c->rcv_queued = 0;
+    }
+    notify(c, TCP_EV_CLOSED);
+}
+
+static void enter_time_wait(tcp_conn_t* c) {
+    c->state = TCP_TIME_WAIT;
+    ktimer_del(&c->ka_timer);
+    ktimer_del(&c->pace_timer);
+    ktimer_add(&c->rtx_timer, ktime_ms() + TCP_TIME_WAIT_MS);
+}
+
+static void establish(tcp_conn_t* c) {
+    c->state = TCP_ESTABLISHED;
+    c->retries = 0;
+    ktimer_del(&c->rtx_timer);
+    c->cwnd = TCP_INIT_CWND * c->mss;
+    c->ssthresh = 0xFFFFFFFF;
+    c->recover = c->snd_una;
+    c->delivered_us = ktime_us();
+    c->pace_next_us = 0;
+    cc_start(c);
+    // A close that came during the handshake
+    if (c->snd_tail && (c->snd_tail->flags & TCP_FIN)) c->state = TCP_FIN_WAIT_1;
+    arm_keepalive(c);
+}
+
+static void tcp_rtx_timeout(ktimer_t* t, void* arg) {
+    (void)t;
+    tcp_conn_t* c = (tcp_conn_t*)arg;
+    switch (c->state) {
+    case TCP_TIME_WAIT:
+    case TCP_FIN_WAIT_2:
+        conn_done(c, TCP_ERR_NONE);
+        return;
+    case TCP_SYN_SENT:
+    case TCP_SYN_RECEIVED: {
+        int limit = c->state == TCP_SYN_SENT ? TCP_SYN_RETRIES : TCP_SYNACK_RETRIES;
+        if (++c->retries > limit) {
+            stats.timeouts++;
+            conn_done(c, TCP_ERR_TIMEOUT);
+            return;
+        }
+        stats.retransmits++;
+        backoff(c);
+        conn_xmit(c, c->iss, c->state == TCP_SYN_SENT ? TCP_SYN : TCP_SYN | TCP_ACK, NULL);
+        arm_rtx(c);
+        return;
+    }
+    default:
+        break;
+    }
+    if (c->snd_una == c->snd_nxt) {
+        // Persist: data waits on a zero window; an old sequence number makes the peer restate it
+        if (c->snd_next) {
+            conn_xmit(c, c->snd_una - 1, TCP_ACK, NULL);
+            backoff(c);
+            arm_rtx(c);
+        }
+        return;
+    }
+    if (++c->retries > TCP_RETRIES) {
+        stats.timeouts++;
+        stats.resets_sent++;
+        tcp_xmit(c->laddr, c->lport, c->raddr, c->rport, c->snd_nxt, 0, TCP_RST, 0, NULL, 0, NULL);
+        conn_done(c, TCP_ERR_TIMEOUT);
+        return;
+    }
+    // RFC 6298 5.5-5.7 and RFC 5681 3.1: back off, collapse the window and
+    // resend everything not known to have arrived
+    stats.rto_timeouts++;
+    c->rto_count++;
+    if (c->cc->ssthresh) c->ssthresh = c->cc->ssthresh(c);
+    c->cwnd = c->mss;
+    c->cwnd_cnt = 0;
+    c->in_recovery = 0;
+    c->recover = c->snd_nxt;
+    c->dupacks = 0;
+    if (c->cc->event) c->cc->event(c, TCP_CC_EV_RTO);
+    for (tcp_seg_t* s = c->snd_head; s && s != c->snd_next; s = s->next) {
+        if (!(s->flags & TCP_SEG_SACKED)) s->flags = (uint16_t)((s->flags | TCP_SEG_LOST) & ~TCP_SEG_RETRANS);
+    }
+    backoff(c);
+    c->pace_next_us = 0;
+    arm_rtx(c);
+    tcp_output(c);
+}
+
+// Idle past ka_idle_ms: probe with an already-acked byte so the peer must answer
+static void tcp_ka_timeout(ktimer_t* t, void* arg) {
+    (void)t;
+    tcp_conn_t* c = (tcp_conn_t*)arg;
+    uint64_t now = ktime_ms();
+    if (now < c->last_rx_ms + c->ka_idle_ms) {
+        arm_keepalive(c);
+        return;
+    }
+    if (c->ka_probes >= TCP_KEEPALIVE_PROBES) {
+        stats.keepalive_drops++;
+        stats.resets_sent++;
+        tcp_xmit(c->laddr, c->lport, c->raddr, c->rport, c->snd_nxt, 0, TCP_RST, 0, NULL, 0, NULL);
+        conn_done(c, TCP_ERR_TIMEOUT);
+        return;
+    }
+    c->ka_probes++;
+    stats.keepalive_probes++;
+    conn_xmit(c, c->snd_una - 1, TCP_ACK, NULL);
+    ktimer_add(&c->ka_timer, now + TCP_KEEPALIVE_INTVL_MS);
+}
+
+static void tcp_dack_timeout(ktimer_t* t, void* arg) {
+    (void)t;
+    tcp_conn_t* c = (tcp_conn_t*)arg;
+    if (c->rcv_unacked) tcp_send_ack(c);
+}
+
+static void tcp_pace_timeout(ktimer_t* t, void* arg) {
+    (void)t;
+    tcp_output((tcp_conn_t*)arg);
+}
+
+void net_tcp_set_keepalive(tcp_conn_t* c, uint32_t idle_ms) {
+    if (!c) return;
+    c->ka_idle_ms = idle_ms;
+    c->ka_probes = 0;
+    arm_keepalive(c);
+}
+
+void net_tcp_set_notify(tcp_conn_t* c, tcp_notify_fn fn, void* user) {
+    if (!c) return;
+    c->notify = fn;
+    c->user = user;
+}
+
+// Transmit path
+
+// RFC 6675 pipe: sent, not SACKed, and not lost unless since retransmitted.
+// Without SACK each duplicate ACK stands for a segment that left the network.
+static uint32_t tcp_pipe(const tcp_conn_t* c) {
+    uint32_t pipe = 0;
+    for (const tcp_seg_t* s = c->snd_head; s && s != c->snd_next; s = s->next) {
+        if (s->flags & TCP_SEG_SACKED) continue;
+        if ((s->flags & TCP_SEG_LOST) && !(s->flags & TCP_SEG_RETRANS)) continue;
+        pipe += s->len;
+    }
+    if (!c->sack_ok) {
+        uint32_t left = (uint32_t)c->dupacks * c->mss;
+        pipe = left < pipe ? pipe - left : 0;
+    }
+    return pipe;
+}
+
+// Paced connections may run a millisecond ahead: the wheel cannot wake them sooner
+static int pace_ok(const tcp_conn_t* c, uint64_t now_us) {
+    return !c->pacing_rate || c->pace_next_us <= now_us + 1000;
+}
+
+static void pace_sent(tcp_conn_t* c, uint32_t len, uint64_t now_us) {
+    if (!c->pacing_rate) return;
+    uint64_t base = c->pace_next_us > now_us ? c->pace_next_us : now_us;
+    c->pace_next_us = base + (uint64_t)len * 1000000 / c->pacing_rate;
+}
+
+static int xmit_seg(tcp_conn_t* c, tcp_seg_t* s, uint64_t now_us) {
+    pktbuf_t* data = NULL;
+    if (s->data && !(data = pktbuf_clone(s->data))) return -1;
+    uint8_t flags = (uint8_t)(TCP_ACK | (s->flags & TCP_FIN));
+    if (data && !s->next) flags |= TCP_PSH;
+    if (s->xmits < 0xFF) s->xmits++;
+    s->sent_us = now_us;
+    s->delivered = c->delivered;
+    s->delivered_us = c->delivered_us;
+    s->app_limited = s->next == NULL;
+    c->bytes_sent += seg_data_len(s);
+    pace_sent(c, s->len, now_us);
+    conn_xmit(c, s->seq, flags, data);
+    return 0;
+}
+
+static int can_output(const tcp_conn_t* c) {
+    return c->state == TCP_ESTABLISHED || c->state == TCP_CLOSE_WAIT || c->state == TCP_FIN_WAIT_1 ||
+        c->state == TCP_CLOSING || c->state == TCP_LAST_ACK;
+}
+
+// Sends what the congestion window, the peer's window and the pacing rate
+// allow: repairs of lost segments first, then new data
+static void tcp_output(tcp_conn_t* c) {
+    if (!can_output(c)) return;
+    uint64_t now_us = ktime_us();
+    uint32_t pipe = tcp_pipe(c);
+    if (!pipe) c->delivered_us = now_us; // A new flight: rate samples start here
+    int paced = 0;
+    for (tcp_seg_t* s = c->snd_head; s && s != c->snd_next; s = s->next) {
+        if ((s->flags & (TCP_SEG_LOST | TCP_SEG_RETRANS | TCP_SEG_SACKED)) != TCP_SEG_LOST) continue;
+        if (pipe + s->len > c->cwnd) break;
+        if (!pace_ok(c, now_us)) { paced = 1; break; }
+        if (xmit_seg(c, s, now_us) < 0) break;
+        s->flags |= TCP_SEG_RETRANS;
+        pipe += s->len;
+        stats.retransmits++;
+        c->retrans_segs++;
+    }
+    tcp_seg_t* s;
+    while (!paced && (s = c->snd_next)) {
+        if (pipe + s->len > c->cwnd) break;
+        if (SEQ_GT(s->seq + seg_data_len(s), c->snd_una + c->snd_wnd)) break;
+        if (!pace_ok(c, now_us)) { paced = 1; break; }
+        if (xmit_seg(c, s, now_us) < 0) break;
+        pipe += s->len;
+        c->snd_next = s->next;
+        if (SEQ_GT(s->seq + s->len, c->snd_nxt)) c->snd_nxt = s->seq + s->len;
+    }
+    if (paced && !ktimer_pending(&c->pace_timer)) {
+        uint64_t at = (c->pace_next_us - 1000 + 999) / 1000;
+        uint64_t soon = ktime_ms() + 1;
+        ktimer_add(&c->pace_timer, at > soon ? at : soon);
+    }
+    // Outstanding data, or data held back by a zero window, needs the timer
+    if ((c->snd_una != c->snd_nxt || c->snd_next) && !ktimer_pending(&c->rtx_timer)) arm_rtx(c);
+}
+
+static void snd_link(tcp_conn_t* c, tcp_seg_t* s) {
+    s->seq = c->snd_tail ? c->snd_tail->seq + c->snd_tail->len : c->snd_nxt;
+    s->next = NULL;
+    if (c->snd_tail) c->snd_tail->next = s;
+    else c->snd_head = s;
+    c->snd_tail = s;
+    if (!c->snd_next) c->snd_next = s;
+    c->snd_queued += seg_data_len(s);
+}
+
+static int can_send(const tcp_conn_t* c) {
+    if (c->snd_tail && (c->snd_tail->flags & TCP_FIN)) return 0;
+    return c->state == TCP_ESTABLISHED || c->state == TCP_CLOSE_WAIT || c->state == TCP_SYN_SENT ||
+        c->state == TCP_SYN_RECEIVED;
+}
+
+int net_tcp_send(tcp_conn_t* c, const void* buf, uint32_t len) {
+    if (!c || !can_send(c)) return -1;
+    uint32_t space = c->snd_queued < TCP_SNDBUF ? TCP_SNDBUF - c->snd_queued : 0;
+    if (!space) return NET_TCP_AGAIN;
+    if (len > space) len = space;
+    const uint8_t* p = (const uint8_t*)buf;
+    uint32_t done = 0;
+    // Top up the last unsent segment before starting a new one
+    tcp_seg_t* t = c->snd_tail;
+    if (t && c->snd_next && t->data && t->len < c->mss && pktbuf_writable(t->data)) {
+        uint32_t n = c->mss - t->len;
+        if (n > pktbuf_tailroom(t->data)) n = pktbuf_tailroom(t->data);
+        if (n > len) n = len;
+        uint8_t* dst = n ? (uint8_t*)pktbuf_put(t->data, n) : NULL;
+        if (dst) {
+            memcpy(dst, p, n);
+            t->len += n;
+            c->snd_queued += n;
+            done = n;
+        }
+    }
+    while (done < len) {
+        uint32_t n = len - done < c->mss ? len - done : c->mss;
+        pktbuf_t* pb = pktbuf_alloc(c->mss);
+        uint8_t* dst = pb ? (uint8_t*)pktbuf_put(pb, n) : NULL;
+        tcp_seg_t* s = dst ? seg_new(pb, 0, n, 0) : NULL;
+        if (!s) {
+            if (pb) pktbuf_free(pb);
+            break;
+        }
+        memcpy(dst, p + done, n);
+        snd_link(c, s);
+        done += n;
+    }
+    tcp_output(c);
+    return done ? (int)done : -1;
+}
+
+int net_tcp_send_pkt(tcp_conn_t* c, pktbuf_t* pb) {
+    if (!c || !pb || !can_send(c)) return -1;
+    uint32_t len = pb->pkt_len;
+    if (!len) return -1;
+    if (c->snd_queued + len > TCP_SNDBUF) return NET_TCP_AGAIN;
+    if (len <= c->mss) {
+        tcp_seg_t* s = seg_new(pb, 0, len, 0);
+        if (!s) return -1;
+        snd_link(c, s);
+        tcp_output(c);
+        return (int)len;
+    }
+    // MSS-sized views of the same bytes, all made before any is queued so
+    // that running out of memory leaves the packet with the caller
+    tcp_seg_t* head = NULL;
+    tcp_seg_t** link = &head;
+    for (uint32_t off = 0; off < len; off += c->mss) {
+        uint32_t part = len - off < c->mss ? len - off : c->mss;
+        pktbuf_t* view = pktbuf_clone(pb);
+        tcp_seg_t* s = view ? seg_new(view, 0, part, 0) : NULL;
+        if (!s) {
+            if (view) pktbuf_free(view);
+            seg_list_free(head);
+            return -1;
+        }
+        pktbuf_pull(view, off);
+        pktbuf_trim(view, part);
+        *link = s;
+        link = &s->next;
+    }
+    pktbuf_free(pb);
+    while (head) {
+        tcp_seg_t* s = head;
+        head = s->next;
+        snd_link(c, s);
+    }
+    tcp_output(c);
+    return (int)len;
+}
+
+// Receive path, user side
+
+static int fin_received(const tcp_conn_t* c) {
+    return c->state == TCP_CLOSE_WAIT || c->state == TCP_CLOSING || c->state == TCP_LAST_ACK ||
+        c->state == TCP_TIME_WAIT || (c->state == TCP_CLOSED && c->error == TCP_ERR_NONE);
+}
+
+// Reading opened the window: tell the peer if it may be holding back
+static void rcv_consumed(tcp_conn_t* c, uint32_t n) {
+    c->rcv_queued -= n < c->rcv_queued ? n : c->rcv_queued;
+    if (c->state != TCP_ESTABLISHED && c->state != TCP_FIN_WAIT_1 && c->state != TCP_FIN_WAIT_2) return;
+    uint32_t before = SEQ_GT(c->rcv_adv, c->rcv_nxt) ? c->rcv_adv - c->rcv_nxt : 0;
+    uint32_t edge = c->rcv_adv;
+    rcv_window(c);
+    if (c->rcv_adv != edge && before < TCP_RCVBUF / 2) tcp_send_ack(c);
+}
+
+int net_tcp_recv(tcp_conn_t* c, void* buf, uint32_t len) {
+    if (!c) return -1;
+    uint8_t* p = (uint8_t*)buf;
+    uint32_t done = 0;
+    pktbuf_t* pb;
+    while (done < len && (pb = c->rcvq.head)) {
+        uint32_t n = pktbuf_copy_out(pb, 0, len - done, p + done);
+        done += n;
+        if (n >= pb->pkt_len) pktbuf_free(pktbuf_queue_get(&c->rcvq));
+        else pktbuf_pull(pb, n);
+    }
+    if (done) {
+        rcv_consumed(c, done);
+        return (int)done;
+    }
+    if (fin_received(c)) return 0;
+    if (c->state == TCP_CLOSED) return -1;
+    return NET_TCP_AGAIN;
+}
+
+pktbuf_t* net_tcp_recv_pkt(tcp_conn_t* c) {
+    pktbuf_t* pb = c ? pktbuf_queue_get(&c->rcvq) : NULL;
+    if (pb) rcv_consumed(c, pb->pkt_len);
+    return pb;
+}
+
+// Receive path, from the network
+
+// RFC 9293 3.10.7.4: acceptable if any of the segment falls in the window
+static int seq_acceptable(const tcp_conn_t* c, uint32_t seq, uint32_t seglen) {
+    uint32_t wnd = SEQ_GT(c->rcv_adv, c->rcv_nxt) ? c->rcv_adv - c->rcv_nxt : 0;
+    if (!seglen) {
+        if (!wnd) return seq == c->rcv_nxt;
+        return SEQ_GEQ(seq, c->rcv_nxt) && SEQ_LT(seq, c->rcv_nxt + wnd);
+    }
+    if (!wnd) return 0;
+    uint32_t last = seq + seglen - 1;
+    return (SEQ_GEQ(seq, c->rcv_nxt) && SEQ_LT(seq, c->rcv_nxt + wnd)) ||
+        (SEQ_GEQ(last, c->rcv_nxt) && SEQ_LT(last, c->rcv_nxt + wnd));
+}
+
+// RFC 6298 2.2-2.4, with one wheel tick as the clock granularity
+static void rtt_update(tcp_conn_t* c, uint32_t r) {
+    if (!r) r = 1;
+    c->rtt_us = r;
+    if (!c->srtt_us) {
+        c->srtt_us = r;
+        c->rttvar_us = r / 2;
+    } else {
+        uint32_t delta = c->srtt_us > r ? c->srtt_us - r : r - c->srtt_us;
+        c->rttvar_us = (3 * c->rttvar_us + delta) / 4;
+        c->srtt_us = (7 * c->srtt_us + r) / 8;
+    }
+    uint32_t var = 4 * c->rttvar_us > 1000 ? 4 * c->rttvar_us : 1000;
+    uint32_t rto = (c->srtt_us + var + 999) / 1000;
+    c->rto_ms = rto < TCP_RTO_MIN_MS ? TCP_RTO_MIN_MS : rto > TCP_RTO_MAX_MS ? TCP_RTO_MAX_MS : rto;
+}
+
+// Newest segment delivered by an ACK, for the rate sample
+typedef struct {
+    int valid;
+    uint64_t sent_us, delivered, delivered_us;
+    uint8_t app_limited;
+} tcp_newest_t;
+
+static void newest_note(tcp_newest_t* n, const tcp_seg_t* s) {
+    if (n->valid && s->sent_us < n->sent_us) return;
+    n->valid = 1;
+    n->sent_us = s->sent_us;
+    n->delivered = s->delivered;
+    n->delivered_us = s->delivered_us;
+    n->app_limited = s->app_limited;
+}
+
+// Marks segments covered by the peer's SACK blocks
+static void sack_tag(tcp_conn_t* c, const tcp_in_t* in, tcp_rate_sample_t* rs, tcp_newest_t* newest) {
+    for (uint32_t b = 0; b < in->nsack; ++b) {
+        uint32_t start = in->sack[b][0], end = in->sack[b][1];
+        if (!SEQ_GT(end, start) || SEQ_LEQ(end, c->snd_una) || SEQ_GT(end, c->snd_nxt)) continue;
+        for (tcp_seg_t* s = c->snd_head; s && s != c->snd_next; s = s->next) {
+            if (SEQ_LT(s->seq, start)) continue;
+            if (SEQ_GT(s->seq + s->len, end)) break;
+            if (s->flags & TCP_SEG_SACKED) continue;
+            s->flags |= TCP_SEG_SACKED;
+            rs->acked_sacked += s->len;
+            c->delivered += s->len;
+            newest_note(newest, s);
+        }
+    }
+}
+
+// RFC 6675 IsLost: a hole with DupThresh segments' worth of SACKed data above it
+static uint32_t mark_lost(tcp_conn_t* c) {
+    if (!c->sack_ok) return 0;
+    uint32_t above = 0, lost = 0;
+    for (tcp_seg_t* s = c->snd_head; s && s != c->snd_next; s = s->next) {
+        if (s->flags & TCP_SEG_SACKED) above += s->len;
+    }
+    for (tcp_seg_t* s = c->snd_head; s && s != c->snd_next; s = s->next) {
+        if (above < TCP_DUPTHRESH * (uint32_t)c->mss) break;
+        if (s->flags & TCP_SEG_SACKED) {
+            above -= s->len;
+        } else if (!(s->flags & TCP_SEG_LOST)) {
+            s->flags |= TCP_SEG_LOST;
+            lost += s->len;
+        }
+    }
+    return lost;
+}
+
+static uint32_t mark_head_lost(tcp_conn_t* c) {
+    tcp_seg_t* s = c->snd_head;
+    if (!s || s == c->snd_next || (s->flags & (TCP_SEG_SACKED | TCP_SEG_LOST))) return 0;
+    s->flags |= TCP_SEG_LOST;
+    return s->len;
+}
+
+// Processes the acknowledgment field: window update, SACK, the retransmit
+// queue, RTT, loss recovery and congestion control. Returns -1 when the
+// segment must be dropped; *fin_acked reports our FIN acknowledged.
+static int tcp_ack(tcp_conn_t* c, const tcp_in_t* in, int* fin_acked) {
+    uint32_t ack = in->ack;
+    if (SEQ_GT(ack, c->snd_nxt)) {
+        tcp_send_ack(c);
+        return -1;
+    }
+    uint64_t now_us = ktime_us();
+    tcp_rate_sample_t rs;
+    tcp_newest_t newest;
+    memset(&rs, 0, sizeof(rs));
+    memset(&newest, 0, sizeof(newest));
+    uint32_t old_wnd = c->snd_wnd;
+    if (SEQ_LT(c->snd_wl1, in->seq) || (c->snd_wl1 == in->seq && SEQ_LEQ(c->snd_wl2, ack))) {
+        c->snd_wnd = (uint32_t)in->wnd << c->snd_wscale;
+        c->snd_wl1 = in->seq;
+        c->snd_wl2 = ack;
+    }
+    if (c->sack_ok && in->nsack) sack_tag(c, in, &rs, &newest);
+    uint32_t acked = 0;
+    if (SEQ_GT(ack, c->snd_una)) {
+        acked = ack - c->snd_una;
+        uint32_t rtt = 0;
+        tcp_seg_t* s;
+        while ((s = c->snd_head) && s != c->snd_next && SEQ_LEQ(s->seq + s->len, ack)) {
+            if (!(s->flags & TCP_SEG_SACKED)) {
+                rs.acked_sacked += s->len;
+                c->delivered += s->len;
+            }
+            if (s->xmits == 1) rtt = (uint32_t)(now_us - s->sent_us); // Karn
+            newest_note(&newest, s);
+            if (s->flags & TCP_FIN) *fin_acked = 1;
+            c->snd_queued -= seg_data_len(s);
+            c->bytes_acked += seg_data_len(s);
+            c->snd_head = s->next;
+            seg_free(s);
+        }
+        if (!c->snd_head) c->snd_tail = NULL;
+        // Part of a segment acked: keep only the rest
+        if (s && s != c->snd_next && SEQ_GT(ack, s->seq)) {
+            uint32_t cut = ack - s->seq;
+            if (s->data) pktbuf_pull(s->data, cut);
+            s->seq = ack;
+            s->len -= cut;
+            c->snd_queued -= cut;
+            c->bytes_acked += cut;
+            if (!(s->flags & TCP_SEG_SACKED)) {
+                rs.acked_sacked += cut;
+                c->delivered += cut;
+            }
+        }
+        c->snd_una = ack;
+        c->retries = 0;
+        c->dupacks = 0;
+        // New data acknowledged proves the next hop too (RFC 4861 7.3.1)
+        uint8_t next_hop[4];
+        wr32(next_hop, c->raddr);
+        net_neigh_confirm(NEIGH_V4, next_hop);
+        if (rtt) {
+            rtt_update(c, rtt);
+            rs.rtt_us = rtt;
+        }
+    } else if (ack == c->snd_una && !in->len && !(in->flags & (TCP_SYN | TCP_FIN)) &&
+        c->snd_wnd == old_wnd && c->snd_una != c->snd_nxt) {
+        if (c->dupacks < 0xFF) c->dupacks++;
+    }
+    if (rs.acked_sacked) c->delivered_us = now_us;
+    if (newest.valid) {
+        rs.prior_delivered = newest.delivered;
+        rs.delivered = c->delivered - newest.delivered;
+        rs.interval_us = now_us - newest.delivered_us;
+        rs.app_limited = newest.app_limited;
+    }
+    // Loss detection and recovery: SACK scoreboard (RFC 6675) or NewReno (RFC 6582)
+    rs.lost = mark_lost(c);
+    if (!c->in_recovery && SEQ_GEQ(c->snd_una, c->recover) && (c->dupacks >= TCP_DUPTHRESH || rs.lost)) {
+        c->in_recovery = 1;
+        c->recover = c->snd_nxt;
+        c->recoveries++;
+        stats.fast_recoveries++;
+        if (c->cc->ssthresh) {
+            c->ssthresh = c->cc->ssthresh(c);
+            c->cwnd = c->ssthresh;
+        }
+        if (c->cc->event) c->cc->event(c, TCP_CC_EV_LOSS);
+        rs.lost += mark_head_lost(c);
+    } else if (c->in_recovery) {
+        if (SEQ_GEQ(c->snd_una, c->recover)) {
+            c->in_recovery = 0;
+            if (c->cc->ssthresh) c->cwnd = c->ssthresh;
+            if (c->cc->event) c->cc->event(c, TCP_CC_EV_RECOVERED);
+        } else if (acked) {
+            rs.lost += mark_head_lost(c); // Partial ACK: the next hole is gone too
+        }
+    }
+    if (c->cc->cong_control) {
+        rs.inflight = tcp_pipe(c);
+        c->cc->cong_control(c, &rs);
+    } else if (acked && !c->in_recovery) {
+        c->cc->cong_avoid(c, acked);
+    }
+    if (c->cwnd < c->mss) c->cwnd = c->mss;
+    if (acked) {
+        if (c->snd_una == c->snd_nxt && !c->snd_next) ktimer_del(&c->rtx_timer);
+        else arm_rtx(c); // RFC 6298 5.3
+        notify(c, TCP_EV_WRITABLE);
+    }
+    return 0;
+}
+
+static void ooo_insert(tcp_conn_t* c, uint32_t seq, uint32_t len, int fin, pktbuf_t* pb) {
+    uint32_t span = len + (fin ? 1 : 0);
+    tcp_seg_t** link = &c->ooo_head;
+    for (; *link && SEQ_LEQ((*link)->seq, seq); link = &(*link)->next) {
+        if (SEQ_GEQ((*link)->seq + (*link)->len, seq + span)) {
+            pktbuf_free(pb); // Already have all of it
+            return;
+        }
+    }
+    tcp_seg_t* s = seg_new(pb, seq, span, fin ? TCP_FIN : 0);
+    if (!s) {
+        pktbuf_free(pb);
+        return;
+    }
+    s->next = *link;
+    *link = s;
+    c->ooo_bytes += len;
+    c->ooo_last = seq;
+    stats.ooo_segments++;
+}
+
+// Queues payload for the reader, out-of-order data aside. Returns 1 once
+// the peer's FIN has been reached in sequence
+static int tcp_data(tcp_conn_t* c, const tcp_in_t* in, pktbuf_t* pb, int* ack_now) {
+    uint32_t seq = in->seq, len = in->len;
+    int fin = (in->flags & TCP_FIN) != 0;
+    if (SEQ_LT(seq, c->rcv_nxt)) {
+        uint32_t cut = c->rcv_nxt - seq;
+        if (cut > len || (cut == len && !fin)) {
+            pktbuf_free(pb); // Nothing new: a retransmission
+            *ack_now = 1;
+            return 0;
+        }
+        pktbuf_pull(pb, cut);
+        len -= cut;
+        seq = c->rcv_nxt;
+    }
+    uint32_t wnd = SEQ_GT(c->rcv_adv, seq) ? c->rcv_adv - seq : 0;
+    if (len > wnd) {
+        pktbuf_trim(pb, wnd);
+        len = wnd;
+        fin = 0;
+    }
+    if (seq != c->rcv_nxt) {
+        if (len || fin) ooo_insert(c, seq, len, fin, pb);
+        else pktbuf_free(pb);
+        *ack_now = 1; // A duplicate ACK, with SACK blocks
+        return 0;
+    }
+    if (len) {
+        pktbuf_queue_put(&c->rcvq, pb);
+        c->rcv_queued += len;
+        c->rcv_nxt += len;
+        c->rcv_unacked += len;
+        c->bytes_received += len;
+    } else {
+        pktbuf_free(pb);
+    }
+    // Whatever now lines up in the out-of-order queue follows
+    if (c->ooo_head) *ack_now = 1;
+    while (!fin && c->ooo_head && SEQ_LEQ(c->ooo_head->seq, c->rcv_nxt)) {
+        tcp_seg_t* s = c->ooo_head;
+        c->ooo_head = s->next;
+        uint32_t dlen = seg_data_len(s);
+        uint32_t end = s->seq + dlen;
+        c->ooo_bytes -= dlen;
+        if (SEQ_GT(end, c->rcv_nxt)) {
+            pktbuf_pull(s->data, c->rcv_nxt - s->seq);
+            pktbuf_queue_put(&c->rcvq, s->data);
+            s->data = NULL;
+            c->rcv_queued += end - c->rcv_nxt;
+            c->bytes_received += end - c->rcv_nxt;
+            c->rcv_nxt = end;
+        }
+        if ((s->flags & TCP_FIN) && end == c->rcv_nxt) fin = 1;
+        seg_free(s);
+    }
+    if (fin) {
+        c->rcv_nxt++;
+        seg_list_free(c->ooo_head); // Nothing can follow a FIN
+        c->ooo_head = NULL;
+        c->ooo_bytes = 0;
+        *ack_now = 1;
+    }
+    return fin;
+}
+
+static void syn_options_apply(tcp_conn_t* c, const tcp_in_t* in) {
+    uint16_t mss = in->mss ? in->mss : TCP_MSS_DEFAULT;
+    c->mss = mss < TCP_MSS_LOCAL ? mss : TCP_MSS_LOCAL;
+    if (c->mss < 64) c->mss = 64;
+    c->ws_ok = in->wscale != 0xFF;
+    c->snd_wscale = c->ws_ok ? (in->wscale < TCP_WSCALE_MAX ? in->wscale : TCP_WSCALE_MAX) : 0;
+    if (!c->ws_ok) c->rcv_wscale = 0;
+    c->sack_ok = in->sack_perm;
+}
+
+static void syn_sent_input(tcp_conn_t* c, const tcp_in_t* in, pktbuf_t* pb) {
+    pktbuf_free(pb);
+    int ack_ok = (in->flags & TCP_ACK) && SEQ_GT(in->ack, c->iss) && SEQ_LEQ(in->ack, c->snd_nxt);
+    if ((in->flags & TCP_ACK) && !ack_ok) {
+        tcp_send_rst(in);
+        return;
+    }
+    if (in->flags & TCP_RST) {
+        if (ack_ok) {
+            stats.resets_received++;
+            conn_done(c, TCP_ERR_REFUSED);
+        }
+        return;
+    }
+    if (!(in->flags & TCP_SYN)) return;
+    c->irs = in->seq;
+    c->rcv_nxt = in->seq + 1;
+    c->rcv_adv = c->rcv_nxt + SYN_WINDOW;
+    syn_options_apply(c, in);
+    c->last_rx_ms = ktime_ms();
+    if (!ack_ok) {
+        // Simultaneous open
+        c->state = TCP_SYN_RECEIVED;
+        conn_xmit(c, c->iss, TCP_SYN | TCP_ACK, NULL);
+        return;
+    }
+    c->snd_una = in->ack;
+    c->snd_wnd = in->wnd;
+    c->snd_wl1 = in->seq;
+    c->snd_wl2 = in->ack;
+    establish(c);
+    tcp_send_ack(c);
+    notify(c, TCP_EV_CONNECTED | TCP_EV_WRITABLE);
+    tcp_output(c);
+}
+
+static void accept_enqueue(tcp_listener_t* l, tcp_conn_t* c) {
+    c->accept_next = NULL;
+    if (l->accept_tail) l->accept_tail->accept_next = c;
+    else l->accept_head = c;
+    l->accept_tail = c;
+    l->accept_queued++;
+    if (l->notify) l->notify(c, l->user, TCP_EV_CONNECTED);
+}
+
+static void conn_input(tcp_conn_t* c, const tcp_in_t* in, pktbuf_t* pb) {
+    if (c->state == TCP_SYN_SENT) {
+        syn_sent_input(c, in, pb);
+        return;
+    }
+    // The peer missed our SYN-ACK and sent its SYN again
+    if (c->state == TCP_SYN_RECEIVED && (in->flags & (TCP_SYN | TCP_ACK | TCP_RST)) == TCP_SYN && in->seq == c->irs) {
+        conn_xmit(c, c->iss, TCP_SYN | TCP_ACK, NULL);
+        pktbuf_free(pb);
+        return;
+    }
+    uint32_t seglen = in->len + !!(in->flags & TCP_FIN);
+    if (!seq_acceptable(c, in->seq, seglen)) {
+        if (!(in->flags & TCP_RST)) tcp_send_ack(c);
+        pktbuf_free(pb);
+        return;
+    }
+    if (in->flags & TCP_RST) {
+        pktbuf_free(pb);
+        // RFC 5961 3.2: only an exact match resets; the rest get a challenge ACK
+        if (in->seq != c->rcv_nxt) {
+            tcp_send_ack(c);
+            return;
+        }
+        stats.resets_received++;
+        if (c->state == TCP_SYN_RECEIVED && c->parent) conn_free(c); // Back to LISTEN
+        else conn_done(c, c->state == TCP_SYN_RECEIVED ? TCP_ERR_REFUSED : TCP_ERR_RESET);
+        return;
+    }
+    if ((in->flags & TCP_SYN) || !(in->flags & TCP_ACK)) {
+        if (in->flags & TCP_SYN) tcp_send_ack(c); // RFC 5961 4.2 challenge ACK
+        pktbuf_free(pb);
+        return;
+    }
+    c->last_rx_ms = ktime_ms();
+    c->ka_probes = 0;
+    if (c->state == TCP_SYN_RECEIVED) {
+        if (SEQ_LEQ(in->ack, c->snd_una) || SEQ_GT(in->ack, c->snd_nxt)) {
+            tcp_send_rst(in);
+            pktbuf_free(pb);
+            return;
+        }
+        tcp_listener_t* l = c->parent;
+        if (l && l->accept_queued >= l->backlog) {
+            pktbuf_free(pb); // Stays half-open; the SYN-ACK timer tries again
+            return;
+        }
+        c->snd_una = c->iss + 1;
+        c->snd_wnd = (uint32_t)in->wnd << c->snd_wscale;
+        c->snd_wl1 = in->seq;
+        c->snd_wl2 = in->ack;
+        if (l) {
+            l->syn_queued--;
+            stats.half_open--;
+            stats.passive_opens++;
+        }
+        establish(c);
+        if (l) accept_enqueue(l, c);
+        else notify(c, TCP_EV_CONNECTED | TCP_EV_WRITABLE);
+    }
+    int fin_acked = 0;
+    if (tcp_ack(c, in, &fin_acked) < 0) {
+        pktbuf_free(pb);
+        return;
+    }
+    if (fin_acked) {
+        if (c->state == TCP_FIN_WAIT_1) {
+            c->state = TCP_FIN_WAIT_2;
+            if (!c->owned) ktimer_add(&c->rtx_timer, ktime_ms() + TCP_FIN_WAIT2_MS);
+        } else if (c->state == TCP_CLOSING) {
+            enter_time_wait(c);
+        } else if (c->state == TCP_LAST_ACK) {
+            pktbuf_free(pb);
+            conn_done(c, TCP_ERR_NONE);
+            return;
+        }
+    }
+    int ack_now = 0;
+    if ((c->state == TCP_ESTABLISHED || c->state == TCP_FIN_WAIT_1 || c->state == TCP_FIN_WAIT_2) &&
+        (in->len || (in->flags & TCP_FIN))) {
+        uint32_t had = c->rcv_queued;
+        if (tcp_data(c, in, pb, &ack_now)) {
+            if (c->state == TCP_ESTABLISHED) c->state = TCP_CLOSE_WAIT;
+            else if (c->state == TCP_FIN_WAIT_1) c->state = TCP_CLOSING;
+            else enter_time_wait(c);
+            ktimer_del(&c->ka_timer);
+            notify(c, TCP_EV_READABLE);
+        } else if (c->rcv_queued != had) {
+            notify(c, TCP_EV_READABLE);
+        }
+    } else {
+        // Past the peer's FIN anything more is a retransmission: ACK it again
+        if (in->flags & TCP_FIN) ack_now = 1;
+        if (c->state == TCP_TIME_WAIT && (in->flags & TCP_FIN)) enter_time_wait(c);
+        pktbuf_free(pb);
+    }
+    tcp_output(c);
+    // RFC 9293 3.8.6.3: ACK at least every second full segment, otherwise within TCP_DELACK_MS
+    if (ack_now || c->rcv_unacked >= 2u * c->mss) tcp_send_ack(c);
+    else if (c->rcv_unacked && !ktimer_pending(&c->dack_timer)) ktimer_add(&c->dack_timer, ktime_ms() + TCP_DELACK_MS);
+}
+
+// SYN cookies, after Linux: the ISN encodes a minute counter in its top byte
+// and an MSS index in the low 24 bits, both bound to the tuple by the secret
+
+static uint32_t cookie_hash(const tcp_in_t* s, uint32_t count, int which) {
+    return (uint32_t)tuple_hash(s->laddr, s->lport, s->raddr, s->rport, count, secret + 2 + 2 * which);
+}
+
+static uint32_t cookie_make(const tcp_in_t* s, uint32_t mssind) {
+    uint32_t count = (uint32_t)(ktime_ms() / 60000);
+    return cookie_hash(s, 0, 0) + s->seq + (count << COOKIE_BITS) +
+        ((cookie_hash(s, count, 1) + mssind) & COOKIE_MASK);
+}
+
+// The peer's ACK carries cookie + 1 and its ISN + 1. Returns the MSS index, or -1
+static int cookie_check(const tcp_in_t* s) {
+    uint32_t count = (uint32_t)(ktime_ms() / 60000);
+    uint32_t cookie = s->ack - 1 - cookie_hash(s, 0, 0) - (s->seq - 1);
+    uint32_t diff = (count - (cookie >> COOKIE_BITS)) & (0xFFFFFFFF >> COOKIE_BITS);
+    if (diff >= TCP_SYNCOOKIE_AGE) return -1;
+    uint32_t ind = (cookie - cookie_hash(s, count - diff, 1)) & COOKIE_MASK;
+    return ind < sizeof(cookie_mss) / sizeof(cookie_mss[0]) ? (int)ind : -1;
+}
+
+static uint32_t cookie_mss_index(uint16_t mss) {
+    uint32_t i = sizeof(cookie_mss) / sizeof(cookie_mss[0]) - 1;
+    while (i > 0 && cookie_mss[i] > mss) i--;
+    return i;
+}
+
+// Listeners
+
+tcp_listener_t* net_tcp_listen(uint32_t laddr, uint16_t lport, int backlog) {
+    if (!lport || (!conn_hash && net_tcp_init() < 0)) return NULL;
+    for (tcp_listener_t* l = *listen_bucket(lport); l; l = l->next) {
+        if (l->lport == lport && l->laddr == laddr) return NULL;
+    }
+    tcp_listener_t* l = (tcp_listener_t*)kheap_zalloc(KHEAP_NORMAL, sizeof(*l), kheap_tag("net"));
+    if (!l) return NULL;
+    l->laddr = laddr;
+    l->lport = lport;
+    l->backlog = (uint16_t)(backlog > 0 && backlog < 0xFFFF ? backlog : TCP_BACKLOG_DEFAULT);
+    tcp_listener_t** head = listen_bucket(lport);
+    l->next = *head;
+    *head = l;
+    stats.listeners++;
+    return l;
+}
+
+void net_tcp_unlisten(tcp_listener_t* l) {
+    if (!l) return;
+    for (tcp_listener_t** link = listen_bucket(l->lport); *link; link = &(*link)->next) {
+        if (*link == l) {
+            *link = l->next;
+            break;
+        }
+    }
+    while (l->accept_head) net_tcp_abort(l->accept_head);
+    // Half-open children are only reachable through the hash
+    for (uint32_t b = 0; l->syn_queued && b <= hash_mask; ++b) {
+        tcp_conn_t* c = conn_hash[b];
+        while (c) {
+            tcp_conn_t* next = c->hnext;
+            if (c->parent == l) net_tcp_abort(c);
+            c = next;
+        }
+    }
+    stats.listeners--;
+    kheap_free(l);
+}
+
+tcp_conn_t* net_tcp_accept(tcp_listener_t* l) {
+    if (!l || !l->accept_head) return NULL;
+    tcp_conn_t* c = l->accept_head;
+    l->accept_head = c->accept_next;
+    if (!l->accept_head) l->accept_tail = NULL;
+    l->accept_queued--;
+    c->accept_next = NULL;
+    c->parent = NULL;
+    c->owned = 1;
+    return c;
+}
+
+static void listen_input(tcp_listener_t* l, const tcp_in_t* s, pktbuf_t* pb) {
+    if (s->flags & TCP_RST) {
+        pktbuf_free(pb);
+        return;
+    }
+    if ((s->flags & (TCP_SYN | TCP_ACK)) == TCP_ACK) {
+        // Only a handshake finished from a cookie gets here; half-open ones are in the hash
+        int ind = cookie_check(s);
+        if (ind < 0) {
+            stats.syncookies_failed++;
+            tcp_send_rst(s);
+            pktbuf_free(pb);
+            return;
+        }
+        if (l->accept_queued >= l->backlog) {
+            pktbuf_free(pb); // The peer retransmits; the cookie is still good for a while
+            return;
+        }
+        tcp_conn_t* c = conn_new(s->laddr, s->lport, s->raddr, s->rport, TCP_SYN_RECEIVED);
+        if (!c) {
+            pktbuf_free(pb);
+            return;
+        }
+        // The cookie had no room for window scale or SACK, so the connection runs without them
+        stats.syncookies_ok++;
+        stats.passive_opens++;
+        c->iss = s->ack - 1;
+        c->snd_una = c->snd_nxt = s->ack;
+        c->snd_wnd = s->wnd;
+        c->snd_wl1 = s->seq;
+        c->snd_wl2 = s->ack;
+        c->irs = s->seq - 1;
+        c->rcv_nxt = s->seq;
+        c->rcv_wscale = 0;
+        c->rcv_adv = c->rcv_nxt + SYN_WINDOW;
+        c->mss = cookie_mss[ind];
+        c->parent = l;
+        establish(c);
+        accept_enqueue(l, c);
+        conn_input(c, s, pb); // Data riding on the ACK
+        return;
+    }
+    if (!(s->flags & TCP_SYN) || (s->flags & TCP_ACK)) {
+        if (s->flags & TCP_ACK) tcp_send_rst(s);
+        pktbuf_free(pb);
+        return;
+    }
+    pktbuf_free(pb);
+    if (l->syn_queued < l->backlog && l->accept_queued < l->backlog) {
+        tcp_conn_t* c = conn_new(s->laddr, s->lport, s->raddr, s->rport, TCP_SYN_RECEIVED);
+        if (c) {
+            c->parent = l;
+            l->syn_queued++;
+            stats.half_open++;
+            c->irs = s->seq;
+            c->rcv_nxt = s->seq + 1;
+            c->rcv_adv = c->rcv_nxt + SYN_WINDOW;
+            syn_options_apply(c, s);
+            c->iss = new_isn(s->laddr, s->lport, s->raddr, s->rport);
+            c->snd_una = c->iss;
+            c->snd_nxt = c->iss + 1;
+            c->snd_wnd = s->wnd;
+            arm_rtx(c);
+            conn_xmit(c, c->iss, TCP_SYN | TCP_ACK, NULL);
+            return;
+        }
+    }
+    if (l->accept_queued >= l->backlog) {
+        stats.syn_dropped++;
+        return;
+    }
+    // SYN queue full (or no memory): answer statelessly
+    uint32_t ind = cookie_mss_index(s->mss ? s->mss : TCP_MSS_DEFAULT);
+    uint8_t opt[4] = { 2, 4, TCP_MSS_LOCAL >> 8, TCP_MSS_LOCAL & 0xFF };
+    stats.syncookies_sent++;
+    tcp_xmit(s->laddr, s->lport, s->raddr, s->rport, cookie_make(s, ind), s->seq + 1, TCP_SYN | TCP_ACK,
+        SYN_WINDOW, opt, sizeof(opt), NULL);
+}
+
+static int parse_options(const uint8_t* o, uint32_t n, tcp_in_t* s) {
+    for (uint32_t i = 0; i < n;) {
+        if (o[i] == 0) break;
+        if (o[i] == 1) { i++; continue; }
+        if (i + 1 >= n || o[i + 1] < 2 || i + o[i + 1] > n) return -1;
+        uint8_t kind = o[i], len = o[i + 1];
+        if (kind == 2 && len == 4) {
+            s->mss = rd16(o + i + 2);
+        } else if (kind == 3 && len == 3) {
+            s->wscale = o[i + 2];
+        } else if (kind == 4 && len == 2) {
+            s->sack_perm = 1;
+        } else if (kind == 5 && len >= 10 && (len - 2) % 8 == 0) {
+            for (uint32_t b = 0; b < (uint32_t)(len - 2) / 8 && s->nsack < TCP_SACK_BLOCKS; ++b) {
+                s->sack[s->nsack][0] = rd32(o + i + 2 + 8 * b);
+                s->sack[s->nsack][1] = rd32(o + i + 6 + 8 * b);
+                s->nsack++;
+            }
+        }
+        i += len;
+    }
+    return 0;
+}
+
+void net_tcp_input(pktbuf_t* pb) {
+    const uint8_t* d = (const uint8_t*)pktbuf_pullup(pb, TCP_HLEN);
+    uint32_t hlen = d ? (uint32_t)(d[12] >> 4) * 4 : 0;
+    if (!conn_hash || hlen < TCP_HLEN || hlen > pb->pkt_len || !(d = (const uint8_t*)pktbuf_pullup(pb, hlen)) ||
+        pktbuf_csum_fold(pktbuf_csum(pb, 0, pb->pkt_len, pseudo_sum(pb->src_ip, pb->dst_ip, pb->pkt_len))) != 0) {
+        stats.bad_segments++;
+        pktbuf_free(pb);
+        return;
+    }
+    tcp_in_t s;
+    memset(&s, 0, sizeof(s));
+    s.laddr = pb->dst_ip;
+    s.raddr = pb->src_ip;
+    s.rport = rd16(d);
+    s.lport = rd16(d + 2);
+    s.seq = rd32(d + 4);
+    s.ack = rd32(d + 8);
+    s.flags = d[13];
+    s.wnd = rd16(d + 14);
+    s.wscale = 0xFF;
+    s.len = pb->pkt_len - hlen;
+    if (parse_options(d + TCP_HLEN, hlen - TCP_HLEN, &s) < 0) {
+        stats.bad_segments++;
+        pktbuf_free(pb);
+        return;
+    }
+    stats.segs_in++;
+    pb->src_port = s.rport;
+    pb->dst_port = s.lport;
+    pktbuf_pull(pb, hlen);
+    tcp_conn_t* c = net_tcp_lookup(s.laddr, s.lport, s.raddr, s.rport);
+    if (c) {
+        conn_input(c, &s, pb);
+        return;
+    }
+    tcp_listener_t* l = listen_lookup(s.laddr, s.lport);
+    if (l) {
+        listen_input(l, &s, pb);
+        return;
+    }
+    tcp_send_rst(&s);
+    pktbuf_free(pb);
+}
+
+// RFC 6056 algorithm 3: each destination walks the range from its own
+// keyed offset, so ports are hard to guess but rarely collide
+static int pick_port(uint32_t laddr, uint32_t raddr, uint16_t rport) {
+    uint32_t offset = (uint32_t)tuple_hash(laddr, 0, raddr, rport, 2, secret);
+    for (uint32_t i = 0; i < EPHEMERAL_RANGE; ++i) {
+        uint16_t port = (uint16_t)(NET_EPHEMERAL_FIRST + (offset + ephemeral_next + i) % EPHEMERAL_RANGE);
+        if (listen_lookup(laddr, port) || net_tcp_lookup(laddr, port, raddr, rport)) continue;
+        ephemeral_next += i + 1;
+        return port;
+    }
+    return -1;
+}
+
+tcp_conn_t* net_tcp_connect(uint32_t raddr, uint16_t rport) {
+    if (!rport || (!conn_hash && net_tcp_init() < 0)) return NULL;
+    uint32_t laddr = (raddr >> 24) == 127 ? raddr : net_proto_local_ip();
+    int port = pick_port(laddr, raddr, rport);
+    if (port < 0) return NULL;
+    tcp_conn_t* c = conn_new(laddr, (uint16_t)port, raddr, rport, TCP_SYN_SENT);
+    if (!c) return NULL;
+    stats.active_opens++;
+    c->owned = 1;
+    c->ws_ok = 1; // Offered; kept only if the peer answers in kind
+    c->sack_ok = 1;
+    c->iss = new_isn(laddr, (uint16_t)port, raddr, rport);
+    c->snd_una = c->iss;
+    c->snd_nxt = c->iss + 1;
+    arm_rtx(c);
+    conn_xmit(c, c->iss, TCP_SYN, NULL);
+    return c;
+}
+
+void net_tcp_close(tcp_conn_t* c) {
+    if (!c) return;
+    c->owned = 0;
+    c->notify = NULL;
+    // RFC 2525 2.17: closing with unread data loses it, so the peer must hear a reset
+    if (c->rcvq.count && c->state != TCP_CLOSED) {
+        net_tcp_abort(c);
+        return;
+    }
+    tcp_seg_t* fin = NULL;
+    switch (c->state) {
+    case TCP_CLOSED:
+    case TCP_SYN_SENT:
+        conn_free(c);
+        return;
+    case TCP_SYN_RECEIVED:
+        // Sent once the handshake completes
+        if ((fin = seg_new(NULL, 0, 1, TCP_FIN))) snd_link(c, fin);
+        return;
+    case TCP_ESTABLISHED:
+    case TCP_CLOSE_WAIT:
+        if (!(fin = seg_new(NULL, 0, 1, TCP_FIN))) {
+            net_tcp_abort(c);
+            return;
+        }
+        snd_link(c, fin);
+        c->state = c->state == TCP_ESTABLISHED ? TCP_FIN_WAIT_1 : TCP_LAST_ACK;
+        ktimer_del(&c->ka_timer);
+        tcp_output(c);
+        return;
+    default:
+        return; // Already closing; the timers finish it
+    }
+}
+
+void net_tcp_abort(tcp_conn_t* c) {
+    if (!c) return;
+    if (c->state != TCP_SYN_SENT && c->state != TCP_CLOSED && c->state != TCP_TIME_WAIT) {
+        stats.resets_sent++;
+        tcp_xmit(c->laddr, c->lport, c->raddr, c->rport, c->snd_nxt, 0, TCP_RST, 0, NULL, 0, NULL);
+    }
+    conn_free(c);
+}
+
+void net_tcp_stats(tcp_stats_t* out) {
+    if (out) *out = stats;
+}
+
+void net_tcp_dump(void) {
+    uint64_t max_chain = 0, used = 0;
+    for (uint32_t b = 0; conn_hash && b <= hash_mask; ++b) {
+        uint64_t n = 0;
+        for (tcp_conn_t* c = conn_hash[b]; c; c = c->hnext) n++;
+        if (n) used++;
+        if (n > max_chain) max_chain = n;
+    }
+    stats.max_chain = max_chain;
+    printf("[TCP] %llu connections (%llu half-open) in %llu/%llu buckets, longest chain %llu, %llu listeners\n",
+        (unsigned long long)stats.conns, (unsigned long long)stats.half_open, (unsigned long long)used,
+        (unsigned long long)stats.hash_buckets, (unsigned long long)max_chain, (unsigned long long)stats.listeners);
+    printf("[TCP] opens active=%llu passive=%llu; syncookies sent=%llu ok=%llu failed=%llu; syn dropped=%llu\n",
+        (unsigned long long)stats.active_opens, (unsigned long long)stats.passive_opens,
+        (unsigned long long)stats.syncookies_sent, (unsigned long long)stats.syncookies_ok,
+        (unsigned long long)stats.syncookies_failed, (unsigned long long)stats.syn_dropped);
+    printf("[TCP] segments in=%llu out=%llu retransmitted=%llu out-of-order=%llu; fast recoveries=%llu rto=%llu\n",
+        (unsigned long long)stats.segs_in, (unsigned long long)stats.segs_out,
+        (unsigned long long)stats.retransmits, (unsigned long long)stats.ooo_segments,
+        (unsigned long long)stats.fast_recoveries, (unsigned long long)stats.rto_timeouts);
+    printf("[TCP] resets sent=%llu received=%llu; timeouts=%llu keepalive probes=%llu drops=%llu bad=%llu\n",
+        (unsigned long long)stats.resets_sent, (unsigned long long)stats.resets_received,
+        (unsigned long long)stats.timeouts, (unsigned long long)stats.keepalive_probes,
+        (unsigned long long)stats.keepalive_drops, (unsigned long long)stats.bad_segments);
+    printf("[TCP] congestion control:");
+    for (const tcp_cc_ops_t* ops = cc_list; ops; ops = ops->next) {
+        printf(" %s%s", ops->name, ops == cc_default ? " (default)" : "");
+    }
+    printf("\n");
+}
@@ -0,0 +1,280 @@
+#ifndef NET_TCP_H
+#define NET_TCP_H
+
+#include <stdint.h>
+#include "pktbuf.h"
+#include "../kernel64/include/timer_wheel.h"
+
+// TCP (RFC 9293). Established and half-open connections live in one hash
+// keyed on the full (local ip, local port, remote ip, remote port) tuple with
+// a boot-time secret, so peers cannot aim collisions at a bucket. Listeners
+// have their own small table keyed on port. A listener keeps up to its backlog
+// of half-open connections (the SYN queue); past that, SYNs are answered with
+// SYN cookies and no state is kept until the peer's ACK proves it.
+//
+// Data goes out from a retransmit queue of MSS-sized segments that share
+// their bytes with the caller's buffers. Loss is found from SACK blocks
+// (RFC 6675) or three duplicate ACKs (NewReno, RFC 6582) and repaired in fast
+// recovery; the retransmit timer (RFC 6298) is the fallback. How much may be
+// in flight is decided by a pluggable congestion control module. Each
+// connection carries its timers on the timer wheel.
+//
+// Runs from the main loop (receive poll and timer wheel); not thread-safe.
+// Addresses and ports are in host order.
+#define TCP_HASH_BITS 17                    // 128k buckets: ~1 entry per chain at 100k connections
+#define TCP_HASH_MIN_BITS 10                // Fallback when the heap cannot spare the full table
+#define TCP_LISTEN_BUCKETS 64
+#define TCP_HLEN 20
+#define TCP_MAX_OPTLEN 40
+#define TCP_MSS_DEFAULT 536                 // RFC 9293 default when the peer sends none
+#define TCP_MSS_LOCAL 1460                  // Ethernet MTU minus IPv4 and TCP headers
+#define TCP_SNDBUF (512 * 1024)
+#define TCP_RCVBUF (512 * 1024)
+#define TCP_WSCALE_MAX 14
+#define TCP_INIT_CWND 10                    // Segments, RFC 6928
+#define TCP_SACK_BLOCKS 4
+#define TCP_DUPTHRESH 3
+#define TCP_BACKLOG_DEFAULT 128
+#define TCP_RTO_INIT_MS 1000
+#define TCP_RTO_MIN_MS 200
+#define TCP_RTO_MAX_MS 60000
+#define TCP_SYN_RETRIES 6
+#define TCP_SYNACK_RETRIES 5
+#define TCP_RETRIES 15                      // Data retransmits before the connection is dropped
+#define TCP_DELACK_MS 40
+#define TCP_TIME_WAIT_MS 60000              // 2 MSL
+#define TCP_FIN_WAIT2_MS 60000              // Orphans waiting for the peer's FIN
+#define TCP_KEEPALIVE_IDLE_MS (2 * 60 * 60 * 1000)
+#define TCP_KEEPALIVE_INTVL_MS 75000
+#define TCP_KEEPALIVE_PROBES 9
+#define TCP_SYNCOOKIE_AGE 2                 // Minutes a cookie stays valid
+#define TCP_CC_PRIV 16                      // Words of per-connection congestion control state
+#define TCP_CC_NAME_MAX 16
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+#define TCP_URG 0x20
+
+// Returned by send and receive when they would have to wait
+#define NET_TCP_AGAIN (-2)
+
+// Sequence number comparisons modulo 2^32
+#define SEQ_LT(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+#define SEQ_LEQ(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) <= 0)
+#define SEQ_GT(a, b) SEQ_LT(b, a)
+#define SEQ_GEQ(a, b) SEQ_LEQ(b, a)
+
+typedef enum {
+    TCP_CLOSED,
+    TCP_LISTEN,
+    TCP_SYN_SENT,
+    TCP_SYN_RECEIVED,
+    TCP_ESTABLISHED,
+    TCP_FIN_WAIT_1,
+    TCP_FIN_WAIT_2,
+    TCP_CLOSE_WAIT,
+    TCP_CLOSING,
+    TCP_LAST_ACK,
+    TCP_TIME_WAIT,
+} tcp_state_t;
+
+// Why a connection reached CLOSED
+enum { TCP_ERR_NONE, TCP_ERR_RESET, TCP_ERR_REFUSED, TCP_ERR_TIMEOUT };
+
+// Events passed to the notify callback
+#define TCP_EV_CONNECTED 0x01
+#define TCP_EV_READABLE 0x02                // Data, or the peer's FIN
+#define TCP_EV_WRITABLE 0x04                // Send buffer space freed
+#define TCP_EV_CLOSED 0x08                  // Reached CLOSED; see error
+
+// Segment flags beyond the header bits
+#define TCP_SEG_SACKED 0x40
+#define TCP_SEG_LOST 0x80
+#define TCP_SEG_RETRANS 0x100
+
+// A stretch of sequence space: on the retransmit queue, or received out of order
+typedef struct tcp_seg {
+    struct tcp_seg* next;
+    pktbuf_t* data;                         // NULL for a bare FIN
+    uint32_t seq;
+    uint32_t len;                           // Sequence space, FIN included
+    uint16_t flags;                         // TCP_FIN and TCP_SEG_*
+    uint8_t xmits;
+    uint8_t app_limited;                    // Sent with nothing more queued
+    uint64_t sent_us;
+    uint64_t delivered;                     // Connection's delivered count when sent
+    uint64_t delivered_us;
+} tcp_seg_t;
+
+struct tcp_conn;
+struct tcp_listener;
+
+// One ACK's worth of delivery information for congestion control
+typedef struct tcp_rate_sample {
+    uint32_t acked_sacked;                  // Bytes newly delivered by this ACK
+    uint32_t lost;                          // Bytes newly marked lost
+    uint32_t rtt_us;                        // 0 when the ACK gave no sample
+    uint32_t inflight;                      // Bytes still in flight
+    uint64_t delivered;                     // Bytes delivered over the interval
+    uint64_t prior_delivered;               // Connection's count when the newest acked segment was sent
+    uint64_t interval_us;
+    uint8_t app_limited;
+} tcp_rate_sample_t;
+
+enum { TCP_CC_EV_LOSS, TCP_CC_EV_RECOVERED, TCP_CC_EV_RTO };
+
+// Congestion control module. Window-based modules supply ssthresh and
+// cong_avoid; model-based ones supply cong_control, which sees every ACK and
+// sets cwnd and pacing_rate itself.
+typedef struct tcp_cc_ops {
+    const char* name;
+    void (*init)(struct tcp_conn* c);
+    uint32_t (*ssthresh)(struct tcp_conn* c);           // Window to fall back to after a loss
+    void (*cong_avoid)(struct tcp_conn* c, uint32_t acked);
+    void (*cong_control)(struct tcp_conn* c, const tcp_rate_sample_t* rs);
+    void (*event)(struct tcp_conn* c, int ev);          // TCP_CC_EV_*
+    struct tcp_cc_ops* next;
+} tcp_cc_ops_t;
+
+typedef void (*tcp_notify_fn)(struct tcp_conn* c, void* user, int events);
+
+typedef struct tcp_conn {
+    struct tcp_conn* hnext;                 // Hash chain
+    struct tcp_conn** hpprev;
+    struct tcp_listener* parent;            // Until accepted
+    struct tcp_conn* accept_next;
+    uint32_t laddr, raddr;
+    uint16_t lport, rport;
+    uint8_t state;
+    uint8_t error;                          // TCP_ERR_*
+    uint8_t owned;                          // The user holds this; cleared by net_tcp_close
+    uint8_t sack_ok;                        // Both sides sent SACK-permitted
+    uint8_t ws_ok;                          // Both sides sent window scale
+    uint8_t snd_wscale, rcv_wscale;
+    uint8_t retries;                        // Retransmissions of the oldest unacked segment
+    uint8_t ka_probes;                      // Unanswered keepalive probes
+    uint8_t in_recovery;
+    uint8_t dupacks;
+    uint16_t mss;                           // Largest segment we send
+    // Send sequence space
+    uint32_t iss, snd_una, snd_nxt, snd_wnd;
+    uint32_t snd_wl1, snd_wl2;              // Segment that last updated snd_wnd
+    uint32_t recover;                       // snd_nxt when recovery began
+    tcp_seg_t* snd_head;                    // Retransmit queue, snd_una onwards
+    tcp_seg_t* snd_tail;
+    tcp_seg_t* snd_next;                    // First segment not yet sent
+    uint32_t snd_queued;                    // Data bytes on the queue
+    // Receive sequence space
+    uint32_t irs, rcv_nxt;
+    uint32_t rcv_adv;                       // Right edge of the window we advertised
+    uint32_t rcv_queued;                    // Bytes in rcvq
+    uint32_t rcv_unacked;                   // Bytes received since our last ACK
+    uint32_t ooo_bytes;
+    uint32_t ooo_last;                      // seq of the newest out-of-order segment
+    tcp_seg_t* ooo_head;                    // Out of order, sorted by seq
+    pktbuf_queue_t rcvq;                    // In-order payload for the reader
+    // Congestion control
+    const tcp_cc_ops_t* cc;
+    uint32_t cwnd, ssthresh;                // Bytes
+    uint32_t cwnd_cnt;                      // Acked bytes toward the next increase
+    uint64_t pacing_rate;                   // Bytes per second, 0 = unpaced
+    uint64_t pace_next_us;
+    uint64_t delivered;                     // Bytes acked or SACKed so far
+    uint64_t delivered_us;
+    uint64_t cc_priv[TCP_CC_PRIV];
+    // RTT estimator, microseconds
+    uint32_t srtt_us, rttvar_us, rtt_us;
+    uint32_t rto_ms;
+    uint32_t ka_idle_ms;                    // 0 disables keepalive
+    uint64_t last_rx_ms;
+    ktimer_t rtx_timer;                     // Retransmit, persist, TIME_WAIT and FIN_WAIT_2
+    ktimer_t ka_timer;
+    ktimer_t dack_timer;
+    ktimer_t pace_timer;
+    // Counters
+    uint64_t bytes_sent, bytes_acked, bytes_received;
+    uint32_t retrans_segs, recoveries, rto_count;
+    tcp_notify_fn notify;
+    void* user;
+} tcp_conn_t;
+
+typedef struct tcp_listener {
+    struct tcp_listener* next;
+    uint32_t laddr;                         // 0 = any local address
+    uint16_t lport;
+    uint16_t backlog;                       // Limit for both queues
+    uint16_t syn_queued;                    // Half-open connections in the hash
+    uint16_t accept_queued;
+    tcp_conn_t* accept_head;
+    tcp_conn_t* accept_tail;
+    tcp_notify_fn notify;                   // TCP_EV_CONNECTED when a connection is ready to accept
+    void* user;
+} tcp_listener_t;
+
+typedef struct tcp_stats {
+    uint64_t conns;                         // In the hash, half-open included
+    uint64_t half_open;
+    uint64_t listeners;
+    uint64_t hash_buckets;
+    uint64_t max_chain;                     // Longest chain, from net_tcp_dump's scan
+    uint64_t active_opens, passive_opens;
+    uint64_t syncookies_sent, syncookies_ok, syncookies_failed;
+    uint64_t syn_dropped;                   // Both queues full
+    uint64_t resets_sent, resets_received;
+    uint64_t segs_out, segs_in;
+    uint64_t retransmits;
+    uint64_t fast_recoveries;
+    uint64_t rto_timeouts;
+    uint64_t timeouts;                      // Connections dropped after too many retries
+    uint64_t ooo_segments;
+    uint64_t keepalive_probes, keepalive_drops;
+    uint64_t bad_segments;                  // Short or bad checksum
+} tcp_stats_t;
+
+int net_tcp_init(void);
+void net_tcp_input(pktbuf_t* pb);           // From IPv4 with the IP header stripped
+tcp_conn_t* net_tcp_lookup(uint32_t laddr, uint16_t lport, uint32_t raddr, uint16_t rport);
+
+tcp_listener_t* net_tcp_listen(uint32_t laddr, uint16_t lport, int backlog);
+void net_tcp_unlisten(tcp_listener_t* l);   // Resets queued connections
+tcp_conn_t* net_tcp_accept(tcp_listener_t* l); // NULL when none are ready
+// Active open from an ephemeral port; the SYN is sent before this returns
+tcp_conn_t* net_tcp_connect(uint32_t raddr, uint16_t rport);
+
+// Bytes queued (possibly fewer than len), NET_TCP_AGAIN when the send buffer
+// is full, -1 once the connection can no longer send
+int net_tcp_send(tcp_conn_t* c, const void* buf, uint32_t len);
+// Zero-copy send of a whole packet. Takes it on success; on NET_TCP_AGAIN or
+// -1 the packet stays the caller's
+int net_tcp_send_pkt(tcp_conn_t* c, pktbuf_t* pb);
+// Bytes read, NET_TCP_AGAIN when nothing is buffered, 0 at end of stream, -1 after a reset
+int net_tcp_recv(tcp_conn_t* c, void* buf, uint32_t len);
+pktbuf_t* net_tcp_recv_pkt(tcp_conn_t* c);  // Next in-order buffer, NULL when none
+// Orderly close: sends FIN after queued data. The stack frees the connection
+// once the close completes, so c must not be used afterwards
+void net_tcp_close(tcp_conn_t* c);
+void net_tcp_abort(tcp_conn_t* c);          // Sends RST and frees the connection
+void net_tcp_set_keepalive(tcp_conn_t* c, uint32_t idle_ms);
+// Called from the stack on TCP_EV_*; must not close or abort the connection
+void net_tcp_set_notify(tcp_conn_t* c, tcp_notify_fn fn, void* user);
+
+// Congestion control modules. reno, cubic and bbr are built in; cubic is the default
+int net_tcp_cc_register(tcp_cc_ops_t* ops);
+const tcp_cc_ops_t* net_tcp_cc_find(const char* name);
+int net_tcp_cc_set_default(const char* name);
+int net_tcp_set_cc(tcp_conn_t* c, const char* name);
+// Helpers for modules: slow start returns the acked bytes it did not use;
+// additive increase adds one MSS per w bytes acked
+uint32_t net_tcp_slow_start(tcp_conn_t* c, uint32_t acked);
+void net_tcp_cong_avoid_ai(tcp_conn_t* c, uint32_t w, uint32_t acked);
+uint32_t net_tcp_flight_size(const tcp_conn_t* c);
+void net_tcp_cc_builtin_init(void);         // net_tcp_cc.c
+
+void net_tcp_stats(tcp_stats_t* out);
+void net_tcp_dump(void);
+const char* net_tcp_state_name(int state);
+
+#endif // NET_TCP_H
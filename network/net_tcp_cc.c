@@ -0,0 +1,309 @@
+// TCP congestion control modules: reno, cubic and bbr
+
+#include <stdint.h>
+#include "net_tcp.h"
+#include "../kernel64/include/ktime.h"
+
+// Per-connection state lives in cc_priv
+#define CC_PRIV(c, type) ((type*)(c)->cc_priv)
+
+static uint32_t max_u32(uint32_t a, uint32_t b) { return a > b ? a : b; }
+static uint32_t min_u32(uint32_t a, uint32_t b) { return a < b ? a : b; }
+
+// Reno (RFC 5681): halve on loss, one MSS per window of ACKs
+
+static uint32_t reno_ssthresh(tcp_conn_t* c) {
+    return max_u32(net_tcp_flight_size(c) / 2, 2u * c->mss);
+}
+
+static void reno_cong_avoid(tcp_conn_t* c, uint32_t acked) {
+    if (c->cwnd < c->ssthresh && !(acked = net_tcp_slow_start(c, acked))) return;
+    net_tcp_cong_avoid_ai(c, c->cwnd, acked);
+}
+
+static tcp_cc_ops_t reno_ops = {
+    .name = "reno",
+    .ssthresh = reno_ssthresh,
+    .cong_avoid = reno_cong_avoid,
+};
+
+// CUBIC (RFC 9438). The window follows W(t) = C(t - K)^3 + W_max, in
+// bytes and milliseconds, with C = 0.4 segments/s^3 and beta = 0.7, and
+// never grows slower than Reno would.
+
+typedef struct {
+    uint64_t epoch_ms;                      // Start of this congestion avoidance period, 0 = none
+    uint64_t k_ms;                          // Time to get back to origin
+    uint32_t w_max;                         // Window before the last reduction
+    uint32_t origin;
+    uint32_t w_est;                         // What Reno would have by now
+    uint32_t frac;                          // Remainder of the last increase
+} cubic_t;
+
+_Static_assert(sizeof(cubic_t) <= sizeof(((tcp_conn_t*)0)->cc_priv), "cubic state too large");
+
+// Integer cube root, a bit at a time
+static uint64_t icbrt(uint64_t x) {
+    uint64_t y = 0;
+    for (int s = 63; s >= 0; s -= 3) {
+        y <<= 1;
+        uint64_t b = 3 * y * (y + 1) + 1;
+        if ((x >> s) >= b) {
+            x -= b << s;
+            y++;
+        }
+    }
+    return y;
+}
+
+static uint32_t cubic_ssthresh(tcp_conn_t* c) {
+    cubic_t* cu = CC_PRIV(c, cubic_t);
+    cu->epoch_ms = 0;
+    // Fast convergence: a flow losing ground lets go of some more
+    cu->w_max = c->cwnd < cu->w_max ? c->cwnd * 17 / 20 : c->cwnd;
+    return max_u32(c->cwnd * 7 / 10, 2u * c->mss);
+}
+
+static void cubic_cong_avoid(tcp_conn_t* c, uint32_t acked) {
+    cubic_t* cu = CC_PRIV(c, cubic_t);
+    if (c->cwnd < c->ssthresh && !(acked = net_tcp_slow_start(c, acked))) return;
+    uint64_t now = ktime_ms();
+    if (!cu->epoch_ms) {
+        cu->epoch_ms = now;
+        cu->w_est = c->cwnd;
+        cu->frac = 0;
+        if (c->cwnd < cu->w_max) {
+            // K^3 = (W_max - cwnd) / C, in ms^3: segments * 2.5e9
+            uint64_t segs_x1000 = (uint64_t)(cu->w_max - c->cwnd) * 1000 / c->mss;
+            cu->k_ms = icbrt(segs_x1000 * 2500000);
+            cu->origin = cu->w_max;
+        } else {
+            cu->k_ms = 0;
+            cu->origin = c->cwnd;
+        }
+    }
+    // Aim one RTT ahead
+    int64_t d = (int64_t)(now - cu->epoch_ms + c->srtt_us / 1000) - (int64_t)cu->k_ms;
+    if (d > 60000) d = 60000;
+    if (d < -60000) d = -60000;
+    int64_t delta = 4 * (int64_t)c->mss * d * d * d / 10000000000ll;
+    int64_t target = (int64_t)cu->origin + delta;
+    // Reno-friendly region: alpha = 3(1 - beta)/(1 + beta) segments per RTT
+    cu->w_est += (uint32_t)((uint64_t)529 * acked * c->mss / (1000ull * c->cwnd));
+    if (target < (int64_t)cu->w_est) target = cu->w_est;
+    if (target > (int64_t)c->cwnd * 3 / 2) target = (int64_t)c->cwnd * 3 / 2;
+    if (target > (int64_t)c->cwnd) {
+        uint64_t num = (uint64_t)(target - c->cwnd) * acked + cu->frac;
+        uint32_t cwnd = c->cwnd;
+        c->cwnd += (uint32_t)(num / cwnd);
+        cu->frac = (uint32_t)(num % cwnd);
+    } else {
+        net_tcp_cong_avoid_ai(c, 100 * c->cwnd, acked); // On the plateau: barely move
+    }
+}
+
+static void cubic_event(tcp_conn_t* c, int ev) {
+    if (ev == TCP_CC_EV_RTO) CC_PRIV(c, cubic_t)->epoch_ms = 0;
+}
+
+static tcp_cc_ops_t cubic_ops = {
+    .name = "cubic",
+    .ssthresh = cubic_ssthresh,
+    .cong_avoid = cubic_cong_avoid,
+    .event = cubic_event,
+};
+
+// BBR, a simplified version 1: estimates the bottleneck bandwidth (windowed
+// max of delivery rate) and the round-trip propagation time (windowed min of
+// RTT), paces at a gain times the bandwidth and keeps about two BDPs in
+// flight. Losses only bound the window while recovery lasts.
+
+#define BBR_UNIT 256
+#define BBR_BW_ROUNDS 10
+#define BBR_MIN_RTT_MS 10000
+#define BBR_PROBE_RTT_MS 200
+#define BBR_HIGH_GAIN 739                   // 2/ln(2) * 256
+#define BBR_DRAIN_GAIN 89                   // 256 / high gain
+#define BBR_CYCLE 8
+
+enum { BBR_STARTUP, BBR_DRAIN, BBR_PROBE_BW, BBR_PROBE_RTT };
+
+static const uint16_t bbr_cycle_gain[BBR_CYCLE] = { 320, 192, 256, 256, 256, 256, 256, 256 };
+
+typedef struct {
+    uint64_t bw[3];                         // Windowed max: best, second and third samples
+    uint32_t bw_round[3];
+    uint32_t min_rtt_us;                    // UINT32_MAX until the first sample
+    uint64_t min_rtt_ms;                    // When min_rtt_us was taken
+    uint64_t next_round_delivered;
+    uint32_t round;
+    uint8_t mode;
+    uint8_t cycle;
+    uint8_t full_cnt;                       // Rounds without 25% bandwidth growth
+    uint8_t full;
+    uint64_t full_bw;
+    uint64_t cycle_ms;
+    uint64_t probe_rtt_done_ms;             // 0 until inflight has drained
+    uint32_t prior_cwnd;                    // Restored after recovery and PROBE_RTT
+    uint8_t conserving;
+} bbr_t;
+
+_Static_assert(sizeof(bbr_t) <= sizeof(((tcp_conn_t*)0)->cc_priv), "bbr state too large");
+
+// Kathleen Nichols' windowed max over rounds, kept in three samples
+static void bbr_bw_update(bbr_t* b, uint64_t bw) {
+    uint32_t t = b->round;
+    if (bw >= b->bw[0] || t - b->bw_round[2] > BBR_BW_ROUNDS) {
+        for (int i = 0; i < 3; ++i) {
+            b->bw[i] = bw;
+            b->bw_round[i] = t;
+        }
+        return;
+    }
+    if (bw >= b->bw[1]) {
+        b->bw[1] = b->bw[2] = bw;
+        b->bw_round[1] = b->bw_round[2] = t;
+    } else if (bw >= b->bw[2]) {
+        b->bw[2] = bw;
+        b->bw_round[2] = t;
+    }
+    uint32_t dt = t - b->bw_round[0];
+    if (dt > BBR_BW_ROUNDS) {
+        for (int pass = 0; pass < 2 && t - b->bw_round[0] > BBR_BW_ROUNDS; ++pass) {
+            b->bw[0] = b->bw[1]; b->bw_round[0] = b->bw_round[1];
+            b->bw[1] = b->bw[2]; b->bw_round[1] = b->bw_round[2];
+            b->bw[2] = bw; b->bw_round[2] = t;
+        }
+    } else if (b->bw_round[1] == b->bw_round[0] && dt > BBR_BW_ROUNDS / 4) {
+        b->bw[1] = b->bw[2] = bw;
+        b->bw_round[1] = b->bw_round[2] = t;
+    } else if (b->bw_round[2] == b->bw_round[1] && dt > BBR_BW_ROUNDS / 2) {
+        b->bw[2] = bw;
+        b->bw_round[2] = t;
+    }
+}
+
+static uint32_t bbr_bdp(const tcp_conn_t* c, const bbr_t* b, uint32_t gain) {
+    if (b->min_rtt_us == UINT32_MAX || !b->bw[0]) return TCP_INIT_CWND * c->mss;
+    uint64_t w = b->bw[0] * b->min_rtt_us / 1000000 * gain / BBR_UNIT;
+    return w > 0x7FFFFFFF ? 0x7FFFFFFF : (uint32_t)w;
+}
+
+static void bbr_init(tcp_conn_t* c) {
+    bbr_t* b = CC_PRIV(c, bbr_t);
+    b->min_rtt_us = UINT32_MAX;
+    b->min_rtt_ms = ktime_ms();
+    b->mode = BBR_STARTUP;
+    b->next_round_delivered = c->delivered;
+    c->ssthresh = 0xFFFFFFFF;
+}
+
+static void bbr_cong_control(tcp_conn_t* c, const tcp_rate_sample_t* rs) {
+    bbr_t* b = CC_PRIV(c, bbr_t);
+    uint64_t now = ktime_ms();
+    int round_start = 0;
+    if (rs->delivered && rs->prior_delivered >= b->next_round_delivered) {
+        b->next_round_delivered = c->delivered;
+        b->round++;
+        round_start = 1;
+    }
+    if (rs->delivered && rs->interval_us) {
+        uint64_t bw = rs->delivered * 1000000 / rs->interval_us;
+        if (!rs->app_limited || bw >= b->bw[0]) bbr_bw_update(b, bw);
+    }
+    int rtt_expired = now - b->min_rtt_ms > BBR_MIN_RTT_MS;
+    if (rs->rtt_us && (rs->rtt_us <= b->min_rtt_us || rtt_expired)) {
+        b->min_rtt_us = rs->rtt_us;
+        b->min_rtt_ms = now;
+    }
+    // Startup ends when three rounds in a row fail to grow the bandwidth by a quarter
+    if (round_start && !b->full && !rs->app_limited) {
+        if (b->bw[0] >= b->full_bw * 5 / 4) {
+            b->full_bw = b->bw[0];
+            b->full_cnt = 0;
+        } else if (++b->full_cnt >= 3) {
+            b->full = 1;
+        }
+    }
+    uint32_t bdp = bbr_bdp(c, b, BBR_UNIT);
+    if (b->mode == BBR_STARTUP && b->full) b->mode = BBR_DRAIN;
+    if (b->mode == BBR_DRAIN && rs->inflight <= bdp) {
+        b->mode = BBR_PROBE_BW;
+        b->cycle = (uint8_t)((c->delivered % (BBR_CYCLE - 1) + 2) % BBR_CYCLE); // Anywhere but the drain phase
+        b->cycle_ms = now;
+    }
+    if (b->mode == BBR_PROBE_BW) {
+        uint32_t gain = bbr_cycle_gain[b->cycle];
+        int elapsed = b->min_rtt_us != UINT32_MAX && (now - b->cycle_ms) * 1000 > b->min_rtt_us;
+        // Probing lasts until the queue it builds shows; draining until it is gone
+        if ((gain > BBR_UNIT && elapsed && (rs->lost || rs->inflight >= bbr_bdp(c, b, gain))) ||
+            (gain < BBR_UNIT && (elapsed || rs->inflight <= bdp)) || (gain == BBR_UNIT && elapsed)) {
+            b->cycle = (uint8_t)((b->cycle + 1) % BBR_CYCLE);
+            b->cycle_ms = now;
+        }
+    }
+    // Refresh min_rtt: drain to four segments for a moment every ten seconds
+    if (rtt_expired && b->mode != BBR_PROBE_RTT) {
+        b->mode = BBR_PROBE_RTT;
+        b->prior_cwnd = max_u32(b->prior_cwnd, c->cwnd);
+        b->probe_rtt_done_ms = 0;
+    }
+    if (b->mode == BBR_PROBE_RTT) {
+        if (!b->probe_rtt_done_ms && rs->inflight <= 4u * c->mss) b->probe_rtt_done_ms = now + BBR_PROBE_RTT_MS;
+        if (b->probe_rtt_done_ms && now >= b->probe_rtt_done_ms) {
+            b->min_rtt_ms = now;
+            b->mode = b->full ? BBR_PROBE_BW : BBR_STARTUP;
+            b->cycle = 2;
+            b->cycle_ms = now;
+            c->cwnd = max_u32(c->cwnd, b->prior_cwnd);
+            b->prior_cwnd = 0;
+        }
+    }
+    uint32_t pacing_gain = b->mode == BBR_STARTUP ? BBR_HIGH_GAIN : b->mode == BBR_DRAIN ? BBR_DRAIN_GAIN :
+        b->mode == BBR_PROBE_BW ? bbr_cycle_gain[b->cycle] : BBR_UNIT;
+    uint32_t cwnd_gain = b->mode == BBR_PROBE_BW ? 2 * BBR_UNIT : BBR_HIGH_GAIN;
+    if (b->bw[0]) c->pacing_rate = b->bw[0] * pacing_gain / BBR_UNIT;
+    // Window: the gained BDP plus room for delayed and stretched ACKs
+    uint32_t target = bbr_bdp(c, b, cwnd_gain) + 3u * c->mss;
+    uint32_t cwnd = c->cwnd;
+    if (c->in_recovery) {
+        // Packet conservation for the first round, then no more than was lost allows
+        cwnd = cwnd > rs->lost ? cwnd - rs->lost : c->mss;
+        if (b->conserving) cwnd = max_u32(cwnd, rs->inflight + rs->acked_sacked);
+        if (round_start) b->conserving = 0;
+    }
+    if (b->full) cwnd = min_u32(cwnd + rs->acked_sacked, target);
+    else if (cwnd < target || c->delivered < TCP_INIT_CWND * (uint64_t)c->mss) cwnd += rs->acked_sacked;
+    cwnd = max_u32(cwnd, 4u * c->mss);
+    if (b->mode == BBR_PROBE_RTT) cwnd = min_u32(cwnd, 4u * c->mss);
+    c->cwnd = cwnd;
+}
+
+static void bbr_event(tcp_conn_t* c, int ev) {
+    bbr_t* b = CC_PRIV(c, bbr_t);
+    if (ev == TCP_CC_EV_LOSS) {
+        b->prior_cwnd = c->cwnd;
+        b->conserving = 1;
+    } else if (ev == TCP_CC_EV_RECOVERED) {
+        c->cwnd = max_u32(c->cwnd, b->prior_cwnd);
+        b->prior_cwnd = 0;
+        b->conserving = 0;
+    } else if (ev == TCP_CC_EV_RTO) {
+        b->prior_cwnd = max_u32(b->prior_cwnd, c->cwnd);
+        b->conserving = 0;
+    }
+}
+
+static tcp_cc_ops_t bbr_ops = {
+    .name = "bbr",
+    .init = bbr_init,
+    .cong_control = bbr_cong_control,
+    .event = bbr_event,
+};
+
+void net_tcp_cc_builtin_init(void) {
+    net_tcp_cc_register(&reno_ops);
+    net_tcp_cc_register(&bbr_ops);
+    net_tcp_cc_register(&cubic_ops);
+    net_tcp_cc_set_default("cubic");
+}
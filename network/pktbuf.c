@@ -0,0 +1,357 @@
+// packet buffers: refcounted segments with headroom, chaining and clones
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "pktbuf.h"
+#include "../kernel64/include/slab.h"
+#include "../kernel64/include/kheap.h"
+
+enum { PKT_POOL, PKT_HEAP, PKT_WRAPPED };
+
+#define POOL_ROOM (PKTBUF_SIZE - sizeof(pktbuf_shared_t))
+
+static kmem_cache_t* desc_cache;        // pktbuf_t
+static kmem_cache_t* data_cache;        // pktbuf_shared_t + PKTBUF_SIZE storage
+static kmem_cache_t* shared_cache;      // pktbuf_shared_t for wrapped storage
+static int net_tag;
+static pktbuf_stats_t stats;
+
+#define STAT_INC(f) __atomic_add_fetch(&stats.f, 1, __ATOMIC_RELAXED)
+
+int pktbuf_init(void) {
+    if (desc_cache) return 0;
+    net_tag = kheap_tag("net");
+    desc_cache = kmem_cache_create("pktbuf", sizeof(pktbuf_t), 0, NULL);
+    data_cache = kmem_cache_create("pktbuf_data", PKTBUF_SIZE, 64, NULL);
+    shared_cache = kmem_cache_create("pktbuf_shared", sizeof(pktbuf_shared_t), 0, NULL);
+    if (!desc_cache || !data_cache || !shared_cache) {
+        printf("[PktBuf] Failed to create pools\n");
+        return -1;
+    }
+    printf("[PktBuf] Initialized (%u-byte buffers, %u headroom)\n", PKTBUF_SIZE, PKTBUF_HEADROOM);
+    return 0;
+}
+
+static pktbuf_t* seg_new(pktbuf_shared_t* sh, uint8_t* data, uint32_t len) {
+    pktbuf_t* pb = (pktbuf_t*)kmem_cache_zalloc(desc_cache);
+    if (!pb) return NULL;
+    pb->shared = sh;
+    pb->data = data;
+    pb->len = len;
+    pb->pkt_len = len;
+    STAT_INC(allocs);
+    return pb;
+}
+
+static void shared_put(pktbuf_shared_t* sh) {
+    if (__atomic_sub_fetch(&sh->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    switch (sh->kind) {
+    case PKT_POOL: kmem_cache_free(data_cache, sh); break;
+    case PKT_HEAP: kheap_free(sh); break;
+    default:
+        if (sh->free_fn) sh->free_fn(sh->base, sh->arg);
+        kmem_cache_free(shared_cache, sh);
+        break;
+    }
+}
+
+// Fresh storage, pool-sized when it fits
+static pktbuf_shared_t* shared_new(uint32_t size) {
+    pktbuf_shared_t* sh;
+    if (size <= POOL_ROOM) {
+        sh = (pktbuf_shared_t*)kmem_cache_alloc(data_cache);
+        if (!sh) return NULL;
+        sh->kind = PKT_POOL;
+        sh->size = (uint32_t)POOL_ROOM;
+    } else {
+        sh = (pktbuf_shared_t*)kheap_alloc(KHEAP_NORMAL, sizeof(*sh) + size, net_tag);
+        if (!sh) return NULL;
+        sh->kind = PKT_HEAP;
+        sh->size = size;
+    }
+    sh->refs = 1;
+    sh->base = (uint8_t*)(sh + 1);
+    sh->free_fn = NULL;
+    sh->arg = NULL;
+    return sh;
+}
+
+pktbuf_t* pktbuf_alloc_headroom(uint32_t headroom, uint32_t room) {
+    if (!desc_cache && pktbuf_init() < 0) return NULL;
+    pktbuf_shared_t* sh = shared_new(headroom + room);
+    if (!sh) return NULL;
+    pktbuf_t* pb = seg_new(sh, sh->base + headroom, 0);
+    if (!pb) shared_put(sh);
+    return pb;
+}
+
+pktbuf_t* pktbuf_alloc(uint32_t room) {
+    return pktbuf_alloc_headroom(PKTBUF_HEADROOM, room);
+}
+
+pktbuf_t* pktbuf_wrap(void* base, uint32_t len, pktbuf_free_fn free_fn, void* arg) {
+    if (!base || (!desc_cache && pktbuf_init() < 0)) return NULL;
+    pktbuf_shared_t* sh = (pktbuf_shared_t*)kmem_cache_alloc(shared_cache);
+    if (!sh) return NULL;
+    sh->refs = 1;
+    sh->size = len;
+    sh->base = (uint8_t*)base;
+    sh->kind = PKT_WRAPPED;
+    sh->free_fn = free_fn;
+    sh->arg = arg;
+    pktbuf_t* pb = seg_new(sh, sh->base, len);
+    if (!pb) {
+        kmem_cache_free(shared_cache, sh);
+        return NULL;
+    }
+    STAT_INC(wrapped);
+    return pb;
+}
+
+void pktbuf_free(pktbuf_t* pb) {
+    while (pb) {
+        pktbuf_t* next = pb->next;
+        shared_put(pb->shared);
+        kmem_cache_free(desc_cache, pb);
+        STAT_INC(frees);
+        pb = next;
+    }
+}
+
+pktbuf_t* pktbuf_clone(const pktbuf_t* pb) {
+    pktbuf_t* head = NULL;
+    pktbuf_t** link = &head;
+    for (const pktbuf_t* s = pb; s; s = s->next) {
+        pktbuf_t* c = (pktbuf_t*)kmem_cache_alloc(desc_cache);
+        if (!c) {
+            pktbuf_free(head);
+            return NULL;
+        }
+        *c = *s;
+        c->next = c->nextpkt = NULL;
+        __atomic_add_fetch(&s->shared->refs, 1, __ATOMIC_RELAXED);
+        STAT_INC(allocs);
+        *link = c;
+        link = &c->next;
+    }
+    STAT_INC(clones);
+    return head;
+}
+
+static pktbuf_t* last_seg(pktbuf_t* pb) {
+    while (pb->next) pb = pb->next;
+    return pb;
+}
+
+uint32_t pktbuf_headroom(const pktbuf_t* pb) {
+    return (uint32_t)(pb->data - pb->shared->base);
+}
+
+uint32_t pktbuf_tailroom(const pktbuf_t* pb) {
+    while (pb->next) pb = pb->next;
+    return (uint32_t)(pb->shared->base + pb->shared->size - (pb->data + pb->len));
+}
+
+int pktbuf_writable(const pktbuf_t* pb) {
+    return pb->shared->kind != PKT_WRAPPED && __atomic_load_n(&pb->shared->refs, __ATOMIC_ACQUIRE) == 1;
+}
+
+pktbuf_t* pktbuf_push(pktbuf_t* pb, uint32_t n) {
+    if (pktbuf_writable(pb) && pktbuf_headroom(pb) >= n) {
+        pb->data -= n;
+        pb->len += n;
+        pb->pkt_len += n;
+        return pb;
+    }
+    // Shared or full: the header goes in a segment of its own in front
+    uint32_t hr = n > PKTBUF_HEADROOM ? n : PKTBUF_HEADROOM;
+    pktbuf_t* h = pktbuf_alloc_headroom(hr, 0);
+    if (!h) return NULL;
+    h->data -= n;
+    h->len = n;
+    h->src_ip = pb->src_ip; h->dst_ip = pb->dst_ip;
+    h->src_port = pb->src_port; h->dst_port = pb->dst_port;
+    h->proto = pb->proto;
+    h->pkt_len = pb->pkt_len + n;
+    h->next = pb;
+    pb->pkt_len = 0;
+    STAT_INC(head_splits);
+    return h;
+}
+
+int pktbuf_pull(pktbuf_t* pb, uint32_t n) {
+    if (n > pb->pkt_len) return -1;
+    pb->pkt_len -= n;
+    for (pktbuf_t* s = pb; n; s = s->next) {
+        uint32_t take = n < s->len ? n : s->len;
+        s->data += take;
+        s->len -= take;
+        n -= take;
+    }
+    return 0;
+}
+
+void* pktbuf_put(pktbuf_t* pb, uint32_t n) {
+    pktbuf_t* last = last_seg(pb);
+    if (!pktbuf_writable(last) || pktbuf_tailroom(last) < n) {
+        pktbuf_t* s = pktbuf_alloc_headroom(0, n);
+        if (!s) return NULL;
+        last->next = s;
+        last = s;
+    }
+    uint8_t* p = last->data + last->len;
+    last->len += n;
+    if (last != pb) last->pkt_len = 0;
+    pb->pkt_len += n;
+    return p;
+}
+
+void pktbuf_trim(pktbuf_t* pb, uint32_t len) {
+    if (len >= pb->pkt_len) return;
+    pb->pkt_len = len;
+    pktbuf_t* s = pb;
+    for (;;) {
+        if (s->len >= len) {
+            s->len = len;
+            break;
+        }
+        len -= s->len;
+        s = s->next;
+    }
+    pktbuf_free(s->next);
+    s->next = NULL;
+}
+
+void pktbuf_append(pktbuf_t* pb, pktbuf_t* tail) {
+    if (!tail) return;
+    last_seg(pb)->next = tail;
+    pb->pkt_len += tail->pkt_len;
+    tail->pkt_len = 0;
+}
+
+void* pktbuf_pullup(pktbuf_t* pb, uint32_t n) {
+    if (n > pb->pkt_len) return NULL;
+    if (pb->len >= n) return pb->data;
+    uint32_t need = n - pb->len;    // Bytes that live in later segments
+    uint32_t copied = need;
+    if (pktbuf_writable(pb) && (size_t)(pb->shared->base + pb->shared->size - pb->data) >= n) {
+        // Room behind the head's bytes: gather the rest of the header there
+        pktbuf_copy_out(pb->next, 0, need, pb->data + pb->len);
+    } else {
+        if (n > POOL_ROOM - PKTBUF_HEADROOM) return NULL;
+        pktbuf_shared_t* sh = shared_new(PKTBUF_HEADROOM + n);
+        if (!sh) return NULL;
+        pktbuf_copy_out(pb, 0, n, sh->base + PKTBUF_HEADROOM);
+        shared_put(pb->shared);
+        pb->shared = sh;
+        pb->data = sh->base + PKTBUF_HEADROOM;
+        copied = n;
+    }
+    pb->len = n;
+    // The gathered bytes leave the segments they came from
+    for (pktbuf_t* s = pb->next; need; s = s->next) {
+        uint32_t take = need < s->len ? need : s->len;
+        s->data += take;
+        s->len -= take;
+        need -= take;
+    }
+    __atomic_add_fetch(&stats.pullup_bytes, copied, __ATOMIC_RELAXED);
+    return pb->data;
+}
+
+uint32_t pktbuf_copy_out(const pktbuf_t* pb, uint32_t off, uint32_t len, void* dst) {
+    uint8_t* d = (uint8_t*)dst;
+    uint32_t done = 0;
+    for (const pktbuf_t* s = pb; s && done < len; s = s->next) {
+        if (off >= s->len) {
+            off -= s->len;
+            continue;
+        }
+        uint32_t n = s->len - off;
+        if (n > len - done) n = len - done;
+        memcpy(d + done, s->data + off, n);
+        done += n;
+        off = 0;
+    }
+    return done;
+}
+
+uint32_t pktbuf_csum(const pktbuf_t* pb, uint32_t off, uint32_t len, uint32_t sum) {
+    int odd = 0;    // Next byte is the low half of a 16-bit word
+    for (const pktbuf_t* s = pb; s && len; s = s->next) {
+        if (off >= s->len) {
+            off -= s->len;
+            continue;
+        }
+        const uint8_t* p = s->data + off;
+        uint32_t n = s->len - off;
+        if (n > len) n = len;
+        len -= n;
+        off = 0;
+        if (odd && n) { sum += *p++; n--; odd = 0; }
+        for (; n >= 2; n -= 2, p += 2) sum += (uint32_t)(p[0] << 8 | p[1]);
+        if (n) { sum += (uint32_t)*p << 8; odd = 1; }
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return sum;
+}
+
+void pktbuf_queue_init(pktbuf_queue_t* q, uint32_t limit) {
+    spin_init(&q->lock);
+    q->head = q->tail = NULL;
+    q->count = 0;
+    q->limit = limit;
+}
+
+int pktbuf_queue_put(pktbuf_queue_t* q, pktbuf_t* pb) {
+    spin_lock(&q->lock);
+    if (q->limit && q->count >= q->limit) {
+        spin_unlock(&q->lock);
+        return -1;
+    }
+    pb->nextpkt = NULL;
+    if (q->tail) q->tail->nextpkt = pb;
+    else q->head = pb;
+    q->tail = pb;
+    q->count++;
+    spin_unlock(&q->lock);
+    return 0;
+}
+
+pktbuf_t* pktbuf_queue_get(pktbuf_queue_t* q) {
+    spin_lock(&q->lock);
+    pktbuf_t* pb = q->head;
+    if (pb) {
+        q->head = pb->nextpkt;
+        if (!q->head) q->tail = NULL;
+        q->count--;
+        pb->nextpkt = NULL;
+    }
+    spin_unlock(&q->lock);
+    return pb;
+}
+
+void pktbuf_queue_purge(pktbuf_queue_t* q) {
+    pktbuf_t* pb;
+    while ((pb = pktbuf_queue_get(q))) pktbuf_free(pb);
+}
+
+void pktbuf_stats(pktbuf_stats_t* out) {
+    if (!out) return;
+    out->allocs = __atomic_load_n(&stats.allocs, __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&stats.frees, __ATOMIC_RELAXED);
+    out->clones = __atomic_load_n(&stats.clones, __ATOMIC_RELAXED);
+    out->wrapped = __atomic_load_n(&stats.wrapped, __ATOMIC_RELAXED);
+    out->head_splits = __atomic_load_n(&stats.head_splits, __ATOMIC_RELAXED);
+    out->pullup_bytes = __atomic_load_n(&stats.pullup_bytes, __ATOMIC_RELAXED);
+}
+
+void pktbuf_dump(void) {
+    pktbuf_stats_t st;
+    pktbuf_stats(&st);
+    printf("[PktBuf] live=%llu allocs=%llu clones=%llu wrapped=%llu head_splits=%llu pullup_bytes=%llu\n",
+        (unsigned long long)(st.allocs - st.frees), (unsigned long long)st.allocs, (unsigned long long)st.clones,
+        (unsigned long long)st.wrapped, (unsigned long long)st.head_splits, (unsigned long long)st.pullup_bytes);
+}
@@ -0,0 +1,99 @@
+#ifndef PKTBUF_H
+#define PKTBUF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../kernel64/include/spinlock.h"
+
+// Packet buffers. A packet is a chain of segments; each segment is a small
+// descriptor (data pointer and length) over refcounted storage, so clones
+// and chained payloads share bytes instead of copying them. Storage comes
+// from slab pools, from the kernel heap when larger, or from the driver
+// (pktbuf_wrap). Headers are added in the headroom on the way down
+// (pktbuf_push) and stripped on the way up (pktbuf_pull).
+//
+// Functions that take a packet and return nothing take ownership of it.
+#define PKTBUF_SIZE 2048                // Pool buffer, one Ethernet frame and headroom
+#define PKTBUF_HEADROOM 128             // Enough for Ethernet + IPv6 + TCP with options
+#define PKTBUF_MAX_SEGS 16              // Segments a driver can gather in one send
+
+typedef void (*pktbuf_free_fn)(void* base, void* arg);
+
+typedef struct pktbuf_shared {
+    uint32_t refs;
+    uint32_t size;                      // Bytes at base
+    uint8_t* base;
+    uint8_t kind;                       // Pool, heap or wrapped
+    pktbuf_free_fn free_fn;             // Wrapped storage goes back through this
+    void* arg;
+} pktbuf_shared_t;
+
+typedef struct pktbuf {
+    struct pktbuf* next;                // Next segment of this packet
+    struct pktbuf* nextpkt;             // Next packet in a queue
+    pktbuf_shared_t* shared;
+    uint8_t* data;
+    uint32_t len;                       // Bytes in this segment
+    uint32_t pkt_len;                   // Bytes in the whole packet (head only)
+    // Filled in by the receive path for the socket layer
+    uint32_t src_ip, dst_ip;            // Host order
+    uint16_t src_port, dst_port;
+    uint8_t proto;
+    uint64_t tstamp_us;                 // When a link emulator may deliver it
+} pktbuf_t;
+
+typedef struct pktbuf_stats {
+    uint64_t allocs, frees;             // Segments
+    uint64_t clones;
+    uint64_t wrapped;                   // Driver-owned storage
+    uint64_t head_splits;               // Pushes that chained a new header segment
+    uint64_t pullup_bytes;              // Header bytes gathered across segments
+} pktbuf_stats_t;
+
+typedef struct pktbuf_queue {
+    spinlock_t lock;
+    pktbuf_t* head;
+    pktbuf_t* tail;
+    uint32_t count, limit;
+} pktbuf_queue_t;
+
+int pktbuf_init(void);
+// room bytes of tailroom after PKTBUF_HEADROOM (or headroom) bytes of headroom
+pktbuf_t* pktbuf_alloc(uint32_t room);
+pktbuf_t* pktbuf_alloc_headroom(uint32_t headroom, uint32_t room);
+// Driver memory holding len bytes; free_fn runs when the last reference goes
+pktbuf_t* pktbuf_wrap(void* base, uint32_t len, pktbuf_free_fn free_fn, void* arg);
+void pktbuf_free(pktbuf_t* pb);         // The whole chain
+pktbuf_t* pktbuf_clone(const pktbuf_t* pb); // Shares the bytes, copies descriptors
+
+uint32_t pktbuf_headroom(const pktbuf_t* pb);
+uint32_t pktbuf_tailroom(const pktbuf_t* pb); // Of the last segment
+int pktbuf_writable(const pktbuf_t* pb);   // Head storage not shared
+
+// Prepends n bytes and returns the head, which is new when the current one
+// has no room or is shared. NULL when out of memory (pb is untouched).
+pktbuf_t* pktbuf_push(pktbuf_t* pb, uint32_t n);
+int pktbuf_pull(pktbuf_t* pb, uint32_t n);    // Strip from the front
+void* pktbuf_put(pktbuf_t* pb, uint32_t n);   // Extend the tail, NULL without room
+void pktbuf_trim(pktbuf_t* pb, uint32_t len); // Cut the packet down to len
+void pktbuf_append(pktbuf_t* pb, pktbuf_t* tail); // Chain tail's segments after pb's
+// First n bytes contiguous at pb->data, for header parsing; NULL if too short
+void* pktbuf_pullup(pktbuf_t* pb, uint32_t n);
+
+uint32_t pktbuf_copy_out(const pktbuf_t* pb, uint32_t off, uint32_t len, void* dst);
+// Ones'-complement sum of len bytes from off, for Internet checksums
+uint32_t pktbuf_csum(const pktbuf_t* pb, uint32_t off, uint32_t len, uint32_t sum);
+static inline uint16_t pktbuf_csum_fold(uint32_t sum) {
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+void pktbuf_queue_init(pktbuf_queue_t* q, uint32_t limit);
+int pktbuf_queue_put(pktbuf_queue_t* q, pktbuf_t* pb); // -1 when full; pb stays the caller's
+pktbuf_t* pktbuf_queue_get(pktbuf_queue_t* q);
+void pktbuf_queue_purge(pktbuf_queue_t* q);
+
+void pktbuf_stats(pktbuf_stats_t* out);
+void pktbuf_dump(void);
+
+#endif // PKTBUF_H
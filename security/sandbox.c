@@ -6,11 +6,12 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include "../core/resource_manager/resource_group.h"
 
 // Sandbox context (real)
 typedef struct {
     uint32_t id;
-    void* resources;
+    int rgroup; // Resource group everything in the sandbox is charged to
     // Add more fields as needed
 } sandbox_t;
 
@@ -23,7 +24,10 @@ static int sandbox_count = 0;
 bool sandbox_create(sandbox_t* sb) {
     if (sandbox_count >= MAX_SANDBOXES) return false;
     sb->id = next_sandbox_id++;
-    sb->resources = NULL; // In real code, allocate resource limits
+    char name[RG_NAME_LEN];
+    snprintf(name, sizeof(name), "sandbox-%u", sb->id);
+    sb->rgroup = rgroup_create(name, RG_ROOT);
+    if (sb->rgroup < 0) sb->rgroup = RG_ROOT; // Unlimited rather than failing the sandbox
     sandboxes[sandbox_count++] = *sb;
     printf("[Sandbox] Created sandbox %u\n", sb->id);
     return true;
@@ -63,6 +67,7 @@ bool sandbox_enter(const sandbox_t* sb) {
 bool sandbox_destroy(sandbox_t* sb) {
     for (int i = 0; i < sandbox_count; ++i) {
         if (sandboxes[i].id == sb->id) {
+            if (sandboxes[i].rgroup != RG_ROOT) rgroup_destroy(sandboxes[i].rgroup);
             for (int j = i; j < sandbox_count - 1; ++j) sandboxes[j] = sandboxes[j+1];
             sandbox_count--;
             printf("[Sandbox] Destroyed sandbox %u\n", sb->id);